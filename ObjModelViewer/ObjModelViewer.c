@@ -1,7 +1,8 @@
 /**********************************************************
 * Solar System OpenGL ES2
 * Description: 3D obj model loader
-* Build command: gcc ObjModelViewer.c ../lib/glmath.c -lGLESv2 -lglfw -lm -Wall
+* Build command: gcc ObjModelViewer.c ../lib/glmath.c ../lib/glarray.c ../lib/glthreadpool.c ../lib/glcache.c ../lib/glmeshopt.c ../lib/glstringtable.c ../lib/gletc.c ../lib/glimage.c ../lib/glatlas.c ../lib/gltexcache.c ../lib/glbvh.c ../lib/glheadless.c ../lib/glprofile.c ../lib/gltime.c -lGLESv2 -lEGL -lglfw -lm -lpthread -Wall -O2
+* Usage: ./a.out [--bench-load N] [--parser mmap|stdio] [--threads N] [--no-cache] [--layout interleaved|separate] [--no-vao] [--bench-draw N] [--vertex-format float|compact] [--stream] [--normal-weight area|angle] [--crease DEG] [--bench-textures N] [--bench-decode N] [--no-etc] [--atlas] [--lod PIXELS] [--cull] [--bench-rays N] [--profile N] [--headless N [--json FILE] [--dump-frames LIST]] model.obj [camera distance]
 **********************************************************/
 
 #define GLFW_INCLUDE_ES2
@@ -15,8 +16,27 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <termios.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <float.h>
+#include <stddef.h>
 
 #include "../lib/glmath.h"
+#include "../lib/gltime.h"
+#include "../lib/glarray.h"
+#include "../lib/glthreadpool.h"
+#include "../lib/glcache.h"
+#include "../lib/glmeshopt.h"
+#include "../lib/glstringtable.h"
+#include "../lib/glimage.h"
+#include "../lib/glatlas.h"
+#include "../lib/gltexcache.h"
+#include "../lib/glbvh.h"
+#include "../lib/glheadless.h"
+#include "../lib/glprofile.h"
 
 /*******************************************************************/
 /*  Defines                                                        */
@@ -28,20 +48,40 @@
 #define ELEMENTS_PER_FACE           3
 #define ELEMENTS_PER_VERTEX         3
 #define ELEMENTS_PER_TEXCOORDS      2
+#define ELEMENTS_PER_CORNER         3
+#define INDICES_PER_FACE            (ELEMENTS_PER_FACE*ELEMENTS_PER_CORNER)
+
+#define BENCH_MAX_ITERATIONS        1000
+#define BENCH_WARMUP_FRAMES         10
+
+#define MAX_PARSE_THREADS           64
+
+#define STREAM_SLICE_SIZE           (64*1024)
+#define STREAM_MIN_VBO_VERTICES     (16*1024)
+#define STREAM_PLACEHOLDER_COLOR    0x80, 0x80, 0x80
+#define UNTEXTURED_COLOR            0xFF, 0xFF, 0xFF
+#define MIN_PARSE_CHUNK_SIZE        (256*1024)
 
 #define VBO_VERT                    0
 #define VBO_TEX                     1
 #define VBO_NORM                    2
+#define VBO_INDEX                   3
+#define VBO_INTERLEAVED             4
+#define NUM_OF_VBOS                 5
+
+#define QUANT_UNORM16_MAX           65535.0f
+#define QUANT_UNORM8_MAX            255.0f
+
+#define DEDUP_EMPTY_SLOT            0xFFFFFFFF
+#define MAX_SHORT_INDEX_VERTICES    65536
 
 #define STRLEN                      128
+#define FLOAT_TOKEN_LEN             64
+#define FLOAT_HALFWAY_SLACK         4
 
 #define DISPLAY_WIDTH               1024.0f
 #define DISPLAY_HEIGHT              768.0f
 
-#define BMP_WIDTH_OFFSET            18
-#define BMP_HEIGHT_OFFSET           22
-#define BMP_PIX_PER_COL             3
-#define BMP_HEADER_SIZE             54
 
 #define SCENE_NEAR                  0.1f
 #define SCENE_FAR                   20000.0f
@@ -53,8 +93,54 @@
 #define MOVE                        10.0f
 #define MOVE_BIG                    50.0f
 
-#define MAX_MATERIALS               32
-#define MAX_MATERIAL_CHANGES        300
+#define OBJ_SETTING_LIGHTPOS        (1 << 0)
+#define OBJ_SETTING_CAMPOS          (1 << 1)
+#define OBJ_SETTING_CAMFRONT        (1 << 2)
+#define OBJ_SETTING_CAMUP           (1 << 3)
+
+#define MESH_CACHE_SUFFIX           "c"
+#define MESH_CACHE_MAGIC            0x434A424F
+#define MESH_CACHE_VERSION          4
+#define MESH_CACHE_NO_STRING        0xFFFFFFFF
+
+#define MATERIAL_NONE               0xFFFFFFFF
+
+/* Material decoding its own texture, not sharing one with an earlier material */
+#define TEXTURE_LOAD_NONE           0xFFFFFFFF
+
+/* Atlas pages never grow past this, even when the GL allows more */
+#define ATLAS_MAX_SIZE              4096
+
+/* Texcoords this far past a whole repeat still sample inside the padding */
+#define ATLAS_TEXCOORD_SLACK        0.002f
+
+/* Ka and d, Kd, Ks, one lookup texel each per atlas cell */
+#define MATERIAL_MAP_TEXELS         3
+
+/* Each level of detail aims for half the faces of the one before it */
+#define LOD_MAX_LEVELS              6
+#define LOD_REDUCTION               0.5f
+#define LOD_MIN_FACES               256
+
+/* A level must drop at least this share of faces to be kept */
+#define LOD_MIN_SAVING              0.15f
+
+/* Largest surface movement allowed per level, relative to the model radius */
+#define LOD_MAX_ERROR               0.02f
+
+/* Triangles and vertices of a cluster culled as one */
+#define CLUSTER_MAX_TRIANGLES       128
+#define CLUSTER_MAX_VERTICES        128
+
+#define CULL_REPORT_FRAMES          120
+
+#define BENCH_MAX_RAYS              (1 << 24)
+
+/* Ray origins sit on a sphere this many model radii out, aimed inside the model's sphere */
+#define BENCH_RAY_ORIGIN_RADIUS     2.0f
+
+/* Report and dumped frame names for --headless */
+#define HEADLESS_NAME               "ObjModelViewer"
 
 #define DEFAULT_CAM_DIST            100.0f
 #define DEFAULT_FOV                 35.0f
@@ -79,8 +165,8 @@
 /*******************************************************************/
 typedef struct _material_t
 {
-    char *name;
-    char *fileName;
+    const char *name;
+    const char *fileName;
     GLuint texId;
     GLfloat Ns;
     vec3_t Ka;
@@ -89,39 +175,316 @@ typedef struct _material_t
     GLfloat Ni;
     GLfloat d;
     GLfloat illum;
+
+    /* Lookup texture of the atlas page the texture was packed into, 0 when it has its own */
+    GLuint materialMapId;
 } material_t;
 
 typedef struct _material_change_t
 {
     GLuint startFace;
-    material_t *material;
+    GLuint material;
 } material_change_t;
 
+/* Materials in order of first use, names and texture file names are interned */
+typedef struct _materialLib_t
+{
+    array_t materials;
+
+    /* Material index for each interned string, MATERIAL_NONE for file names */
+    array_t byName;
+    stringTable_t strings;
+} materialLib_t;
+
+/* GL calls one frame of drawVertices() makes */
+typedef struct _drawStats_t
+{
+    GLuint draws;
+    GLuint textureBinds;
+    GLuint materialUploads;
+    GLuint blendChanges;
+} drawStats_t;
+
+/* A coarser copy of the mesh, its indices follow the full mesh in the element buffer */
+typedef struct _objectLod_t
+{
+    /* material_change_t, start faces count from the start of the element buffer */
+    array_t materialChange;
+    GLuint endFace;
+    GLuint numOfFaces;
+
+    /* Farthest the surface may have moved from the full mesh, in model units */
+    GLfloat error;
+
+    GLuint firstCluster;
+    GLuint numOfClusters;
+} objectLod_t;
+
+/* The material runs drawn for one level of detail */
+typedef struct _drawRuns_t
+{
+    const material_change_t *changes;
+    GLuint count;
+    GLuint endFace;
+
+    /* Clusters covering the runs in order, none when culling is off */
+    GLuint firstCluster;
+    GLuint numOfClusters;
+} drawRuns_t;
+
+/* Clusters and triangles culled since the last report */
+typedef struct _cullStats_t
+{
+    GLuint frames;
+    GLuint clusters;
+    GLuint frustumCulled;
+    GLuint backfaceCulled;
+    GLuint triangles;
+    GLuint trianglesCulled;
+    GLuint draws;
+} cullStats_t;
+
+/* A slice of the ray benchmark, rays are an origin and a direction, closest point queries only use the origin */
+typedef struct _rayBenchTask_t
+{
+    const bvh_t *bvh;
+    const GLfloat *rays;
+    GLboolean closestPoint;
+    GLuint start;
+    GLuint end;
+    GLuint hits;
+} rayBenchTask_t;
+
 typedef struct _object_t
 {
     GLfloat *vertArray;
     GLfloat *texArray;
     GLfloat *normArray;
+    GLvoid *indexArray;
+    GLenum indexType;
+    GLuint indexSize;
+    GLuint numOfUniqueVertices;
 
-	GLfloat *v;
-	GLuint numOfVertices;
+    array_t v;
+    GLuint numOfVertices;
 
-	GLfloat *vt;
+    array_t vt;
     GLuint numOfTexCoords;
 
-	GLfloat *vn;
-	GLuint numOfNormals;
+    array_t vn;
+    GLuint numOfNormals;
 
-    GLuint *f;
+    array_t f;
     GLuint numOfFaces;
 
+    /* No vn lines in the file, the normals were computed from the faces */
+    GLboolean generatedNormals;
+
     char *materialLibFilename;
-    GLuint materialCount;
 
-    material_change_t materialChange[MAX_MATERIAL_CHANGES];
-    GLuint materialChangeCount;
+    /* lightpos/campos/camfront/camup lines found in the file */
+    GLuint settings;
+    vec3_t lightPosition;
+    vec3_t cameraPosition;
+    vec3_t cameraFront;
+    vec3_t cameraUp;
+
+    /* Mapped mesh cache backing the vertex and index arrays */
+    const void *cacheData;
+    size_t cacheSize;
+
+    /* material_change_t, the face each material starts at */
+    array_t materialChange;
+
+    /* objectLod_t from finer to coarser and the GLuint indices of all of them */
+    array_t lods;
+    array_t lodIndices;
+    GLuint lodLevel;
+
+    /* Distance of the farthest vertex from the origin the model turns around */
+    GLfloat radius;
+
+    /* meshCluster_t of every level, full mesh first, first indices count from the start of the element buffer */
+    array_t clusters;
+    GLuint numOfClusters;
+
+    /* Per cluster visibility and the merged ranges of one draw */
+    GLubyte *clusterVisible;
+    GLsizei *drawCounts;
+    const GLvoid **drawOffsets;
+
+    /* Triangles of the full mesh, built on the first pick or ray benchmark */
+    bvh_t bvh;
 } object_t;
 
+/* A material library parsed on its own, alongside the OBJ when there is a pool */
+typedef struct _mtlLoad_t
+{
+    char *fileName;
+    materialLib_t library;
+    double time;
+    GLboolean submitted;
+    GLboolean result;
+} mtlLoad_t;
+
+typedef struct _objEvent_t
+{
+    GLuint type;
+    GLuint face;
+    const char *name;
+    GLuint length;
+    GLfloat value[3];
+} objEvent_t;
+
+typedef struct _objChunkOffset_t
+{
+    GLuint v;
+    GLuint vt;
+    GLuint vn;
+    GLuint f;
+} objChunkOffset_t;
+
+typedef struct _objChunk_t
+{
+    object_t *object;
+    const char *start;
+    const char *end;
+
+    array_t v;
+    array_t vt;
+    array_t vn;
+    array_t f;
+
+    /* Positions in f holding negative indices resolved within the chunk */
+    array_t relativeIndices;
+
+    /* Material and setting lines, replayed in order after the merge */
+    array_t events;
+
+    array_t corners;
+    objChunkOffset_t offset;
+} objChunk_t;
+
+/* Interleaved vertex, one fetch stream for all attributes */
+typedef struct _vertex_t
+{
+    GLfloat position[ELEMENTS_PER_VERTEX];
+    GLfloat texCoord[ELEMENTS_PER_TEXCOORDS];
+    GLfloat normal[ELEMENTS_PER_VERTEX];
+} vertex_t;
+
+/* Quantized vertex, positions and texcoords relative to their bounds, octahedral normal */
+typedef struct _compactVertex_t
+{
+    GLushort position[4];
+    GLushort texCoord[2];
+    GLubyte normal[2];
+    GLubyte padding[2];
+} compactVertex_t;
+
+typedef struct _meshCacheMaterial_t
+{
+    GLuint nameOffset;
+    GLuint fileNameOffset;
+    GLfloat Ns;
+    vec3_t Ka;
+    vec3_t Kd;
+    vec3_t Ks;
+    GLfloat Ni;
+    GLfloat d;
+    GLfloat illum;
+} meshCacheMaterial_t;
+
+typedef struct _meshCacheChange_t
+{
+    GLuint startFace;
+    GLuint material;
+} meshCacheChange_t;
+
+/* Header of the .objc file, offsets are from the start of the file */
+typedef struct _meshCacheHeader_t
+{
+    GLuint magic;
+    GLuint version;
+
+    cacheKey_t objKey;
+    cacheKey_t mtlKey;
+
+    GLuint numOfVertices;
+    GLuint numOfTexCoords;
+    GLuint numOfNormals;
+    GLuint numOfFaces;
+    GLuint numOfUniqueVertices;
+    GLuint indexSize;
+    GLuint materialCount;
+    GLuint materialChangeCount;
+
+    /* Options the normals were generated with, 0 if the file had its own */
+    GLuint generatedNormals;
+    GLuint normalWeighting;
+    GLfloat creaseAngle;
+
+    GLuint settings;
+    vec3_t lightPosition;
+    vec3_t cameraPosition;
+    vec3_t cameraFront;
+    vec3_t cameraUp;
+
+    GLuint vertOffset;
+    GLuint texOffset;
+    GLuint normOffset;
+    GLuint indexOffset;
+    GLuint materialOffset;
+    GLuint materialChangeOffset;
+    GLuint stringOffset;
+    GLuint stringSize;
+    GLuint materialLibOffset;
+} meshCacheHeader_t;
+
+typedef struct _streamTexture_t
+{
+    GLuint material;
+    image_t image;
+} streamTexture_t;
+
+/* Shared between the render loop and the background loader */
+typedef struct _streamLoad_t
+{
+    object_t *object;
+    materialLib_t *materials;
+    char *objFileName;
+    char *path;
+    char *cacheFileName;
+    threadPool_t *loader;
+    double start;
+
+    pthread_mutex_t lock;
+    array_t pendingVertices;
+    array_t pendingTextures;
+    GLuint settings;
+    vec3_t lightPosition;
+    vec3_t cameraPosition;
+    vec3_t cameraFront;
+    vec3_t cameraUp;
+    GLboolean meshReady;
+    GLboolean finished;
+    GLboolean result;
+
+    /* Render loop only */
+    array_t previewVertices;
+    GLuint previewVbo;
+    GLuint previewCapacity;
+    GLuint placeholderTexId;
+    GLboolean meshActive;
+} streamLoad_t;
+
+/* What the texture load benchmark frees and loads again */
+typedef struct _textureBench_t
+{
+    materialLib_t *materials;
+    char *path;
+} textureBench_t;
+
 typedef struct _objVerts3_t 
 {
    GLfloat x;
@@ -144,13 +507,59 @@ typedef enum _retCode_e {
     RET_SUCCESS,
 } retCode_e;
 
+typedef enum _objParser_e {
+    OBJ_PARSER_MMAP,
+    OBJ_PARSER_STDIO,
+} objParser_e;
+
+typedef enum _vertexLayout_e {
+    VERTEX_LAYOUT_INTERLEAVED,
+    VERTEX_LAYOUT_SEPARATE,
+} vertexLayout_e;
+
+typedef enum _vertexFormat_e {
+    VERTEX_FORMAT_FLOAT,
+    VERTEX_FORMAT_COMPACT,
+} vertexFormat_e;
+
+typedef enum _objEvent_e {
+    OBJ_EVENT_USEMTL,
+    OBJ_EVENT_MTLLIB,
+    OBJ_EVENT_LIGHTPOS,
+    OBJ_EVENT_CAMPOS,
+    OBJ_EVENT_CAMFRONT,
+    OBJ_EVENT_CAMUP,
+} objEvent_e;
+
+typedef enum _framePhase_e {
+    FRAME_PHASE_INPUT,
+    FRAME_PHASE_UPDATE,
+    FRAME_PHASE_DRAW,
+    FRAME_PHASE_SWAP,
+    NUM_OF_FRAME_PHASES,
+} framePhase_e;
+
 
 /*******************************************************************/
 /*  Global Variables                                               */
 /*******************************************************************/
-static GLuint vboids[3]                  = {0};
+static GLuint vboids[NUM_OF_VBOS]        = {0};
+
+static const char *framePhaseNames[NUM_OF_FRAME_PHASES] = { "input", "update", "draw", "swap" };
+
+/* Headless camera in starting distances, one turn of the model from close up to far enough for the coarse levels of detail */
+static const headlessCameraKey_t cameraPath[] =
+{
+    {0.00f, {0.00f, 0.00f, 1.0f},    0.0f,   0.0f},
+    {0.25f, {0.00f, 0.00f, 0.6f},  -90.0f,  15.0f},
+    {0.50f, {0.00f, 0.00f, 1.5f}, -180.0f, -15.0f},
+    {0.75f, {0.00f, 0.00f, 3.0f}, -270.0f,  10.0f},
+    {1.00f, {0.00f, 0.00f, 1.0f}, -360.0f,   0.0f},
+};
+
 
 static GLfloat persepctiveProjMatrix[16] = {0.0f};
+static GLfloat modelViewMatrix[16]       = {0.0f};
 static GLfloat modelViewProjMatrix[16]   = {0.0f};
 static GLfloat rotationMatrixUp[16]      = {0};
 static GLfloat rotationMatrixRight[16]   = {0};
@@ -185,12 +594,56 @@ static GLint uKaLoc                      = -1;
 static GLint uKdLoc                      = -1;
 static GLint uKsLoc                      = -1;
 static GLint uDLoc                       = -1;
+static GLint uPositionScaleLoc           = -1;
+static GLint uPositionOffsetLoc          = -1;
+static GLint uTexCoordScaleLoc           = -1;
+static GLint uTexCoordOffsetLoc          = -1;
+static GLint uMaterialMapLoc             = -1;
+static GLint uMaterialMapMixLoc          = -1;
 
 static GLint appShutdown                 = 0;
 
+static objParser_e objParser             = OBJ_PARSER_MMAP;
+static GLuint objParseThreads            = 1;
+static threadPool_t *threadPool          = NULL;
+static GLboolean useMeshCache            = GL_TRUE;
+static GLuint textureLoadFlags           = IMAGE_LOAD_MIPS | IMAGE_LOAD_CACHE;
+static GLboolean useEtc                  = GL_TRUE;
+static GLboolean useAtlas                = GL_FALSE;
+static GLfloat lodPixelError             = 0.0f;
+static GLboolean useCulling              = GL_FALSE;
+static cullStats_t cullStats;
+static GLboolean pickPending             = GL_FALSE;
+static double pickX                      = 0.0;
+static double pickY                      = 0.0;
+static texCache_t textureCache;
+
+static vertexLayout_e vertexLayout       = VERTEX_LAYOUT_INTERLEAVED;
+static vertexFormat_e vertexFormat       = VERTEX_FORMAT_FLOAT;
+static vec3_t positionScale              = {1.0f, 1.0f, 1.0f};
+static vec3_t positionOffset             = {0.0f, 0.0f, 0.0f};
+
+static GLboolean useStreamLoad           = GL_FALSE;
+
+static meshNormalWeight_e normalWeighting = MESH_NORMAL_WEIGHT_ANGLE;
+static GLfloat creaseAngle               = MESH_NORMAL_NO_CREASE;
+static streamLoad_t streamLoad;
+static GLboolean useVao                  = GL_TRUE;
+static GLuint vaoId                      = 0;
+static GLboolean useUintIndices          = GL_FALSE;
+static GLuint untexturedTexId            = 0;
+static GLboolean useHeadless             = GL_FALSE;
+static headless_t headless;
+static profile_t profile;
+
+static PFNGLGENVERTEXARRAYSOESPROC genVertexArraysOES       = NULL;
+static PFNGLBINDVERTEXARRAYOESPROC bindVertexArrayOES       = NULL;
+static PFNGLDELETEVERTEXARRAYSOESPROC deleteVertexArraysOES = NULL;
+static PFNGLMULTIDRAWELEMENTSEXTPROC multiDrawElementsEXT   = NULL;
+
 static const GLchar* vertex_shader_source =    
 {
-    "precision mediump float;\n"
+    "precision highp float;\n"
 
     "attribute vec2 aTexCoord;\n"
     "attribute vec3 aPosition;\n"
@@ -211,6 +664,39 @@ static const GLchar* vertex_shader_source =
     "}\n"
 };
 
+/* Decodes compactVertex_t, the position decode is folded into uMVP */
+static const GLchar* compact_vertex_shader_source =
+{
+    "precision highp float;\n"
+
+    "attribute vec2 aTexCoord;\n"
+    "attribute vec3 aPosition;\n"
+    "attribute vec2 aNormal;\n"
+
+    "varying vec2 vTexCoord;\n"
+    "varying vec3 vPosition;\n"
+    "varying vec3 vNormal;\n"
+
+    "uniform mat4 uMVP;\n"
+    "uniform vec3 uPositionScale;\n"
+    "uniform vec3 uPositionOffset;\n"
+    "uniform vec2 uTexCoordScale;\n"
+    "uniform vec2 uTexCoordOffset;\n"
+
+    "void main(void)\n"
+    "{\n"
+        "vec2 octahedral = (aNormal * 2.0) - 1.0;\n"
+        "vec3 normal = vec3(octahedral, 1.0 - abs(octahedral.x) - abs(octahedral.y));\n"
+        "float fold = max(-normal.z, 0.0);\n"
+        "normal.xy += fold * (1.0 - (2.0 * step(0.0, normal.xy)));\n"
+
+        "vTexCoord = (aTexCoord * uTexCoordScale) + uTexCoordOffset;\n"
+        "vPosition = (aPosition * uPositionScale) + uPositionOffset;\n"
+        "vNormal = normal;\n"
+        "gl_Position = vec4(aPosition, 1.0) * uMVP;\n"
+    "}\n"
+};
+
 static const GLchar* fragment_shader_source =
 {
     "precision mediump float;\n"
@@ -229,16 +715,34 @@ static const GLchar* fragment_shader_source =
     "uniform vec3 uKd;\n"
     "uniform float uD;\n"
 
+    /* Atlased materials read their parameters from the cell their texcoords land in */
+    "#ifdef MATERIAL_MAP\n"
+    "uniform sampler2D uMaterialMap;\n"
+    "uniform float uMaterialMapMix;\n"
+    "#endif\n"
+
     "varying vec3 vPosition;\n;"
     "varying vec2 vTexCoord;\n;"
     "varying vec3 vNormal;\n;"
 
     "void main(void)\n"
     "{\n"
-        "vec3 Ka = clamp(uKa, -1.0, 1.0)\n;"
-        "vec3 Ks = clamp(uKs, -1.0, 1.0)\n;"
-        "vec3 Kd = clamp(uKd, -1.0, 1.0)\n;"
-        "float d = clamp(uD, -1.0, 1.0)\n;"
+    "#ifdef MATERIAL_MAP\n"
+        "vec2 cell = vec2(vTexCoord.x / 3.0, vTexCoord.y);\n"
+        "vec4 mapKa = texture2D(uMaterialMap, cell);\n"
+        "vec3 mapKd = texture2D(uMaterialMap, cell + vec2(1.0 / 3.0, 0.0)).rgb;\n"
+        "vec3 mapKs = texture2D(uMaterialMap, cell + vec2(2.0 / 3.0, 0.0)).rgb;\n"
+
+        "vec3 Ka = clamp(mix(uKa, mapKa.rgb, uMaterialMapMix), -1.0, 1.0);\n"
+        "vec3 Ks = clamp(mix(uKs, mapKs, uMaterialMapMix), -1.0, 1.0);\n"
+        "vec3 Kd = clamp(mix(uKd, mapKd, uMaterialMapMix), -1.0, 1.0);\n"
+        "float d = clamp(mix(uD, mapKa.a, uMaterialMapMix), -1.0, 1.0);\n"
+    "#else\n"
+        "vec3 Ka = clamp(uKa, -1.0, 1.0);\n"
+        "vec3 Ks = clamp(uKs, -1.0, 1.0);\n"
+        "vec3 Kd = clamp(uKd, -1.0, 1.0);\n"
+        "float d = clamp(uD, -1.0, 1.0);\n"
+    "#endif\n"
 
         "vec3 normal = normalize(vNormal);\n"
 
@@ -251,7 +755,7 @@ static const GLchar* fragment_shader_source =
 
         "vec4 color = texture2D(uTextureColor, vTexCoord);\n"
 
-        "gl_FragColor = color.bgra * vec4(diffuse + specular + uAmbientLight, d);\n"
+        "gl_FragColor = color * vec4(diffuse + specular + uAmbientLight, d);\n"
 
    "}\n"
 };
@@ -380,8 +884,18 @@ GLint loadShaderProgram(const char *vertex_shader_source, const char *fragment_s
 
 void loadShader(void)
 {
+    static const char materialMapDefine[] = "#define MATERIAL_MAP\n";
+    char *fragmentSource;
+
+    /* The atlas lookups are only compiled in when there may be an atlas */
+    fragmentSource = (char *)malloc(sizeof(materialMapDefine) + strlen(fragment_shader_source));
+    strcpy(fragmentSource, (GL_TRUE == useAtlas) ? materialMapDefine : "");
+    strcat(fragmentSource, fragment_shader_source);
+
     /* Load shader program */
-    shaderProgram = loadShaderProgram(vertex_shader_source, fragment_shader_source);
+    shaderProgram = loadShaderProgram((vertexFormat == VERTEX_FORMAT_COMPACT) ? compact_vertex_shader_source : vertex_shader_source,
+                                      fragmentSource);
+    free(fragmentSource);
 
     /* Get the vertex attribute and color uniform locations */
     aVertexLoc = glGetAttribLocation(shaderProgram, "aPosition");
@@ -400,6 +914,13 @@ void loadShader(void)
     uKsLoc = glGetUniformLocation(shaderProgram, "uKs");
     uDLoc = glGetUniformLocation(shaderProgram, "uD");
 
+    uPositionScaleLoc = glGetUniformLocation(shaderProgram, "uPositionScale");
+    uPositionOffsetLoc = glGetUniformLocation(shaderProgram, "uPositionOffset");
+    uTexCoordScaleLoc = glGetUniformLocation(shaderProgram, "uTexCoordScale");
+    uTexCoordOffsetLoc = glGetUniformLocation(shaderProgram, "uTexCoordOffset");
+    uMaterialMapLoc = glGetUniformLocation(shaderProgram, "uMaterialMap");
+    uMaterialMapMixLoc = glGetUniformLocation(shaderProgram, "uMaterialMapMix");
+
     uLightSrcColorLoc = glGetUniformLocation(shaderProgram, "uLightSrcColor");
 
 
@@ -408,63 +929,54 @@ void loadShader(void)
 
     /* Bind uniform samplers to texture units */
     glUniform1i(uTextureColorLoc, 0);
+    glUniform1i(uMaterialMapLoc, 1);
 }
 
 
-GLboolean loadTexture(material_t *materials, char *path)
+void uploadTexture(material_t *material, const image_t *image)
 {
-    GLubyte *data = NULL;
-    FILE *pFile = NULL;
-    char *fullPath;
-    
-    fullPath = malloc(strlen(path) + strlen(materials->fileName));
-    memset(fullPath, 0, strlen(path) + strlen(materials->fileName));
-    strcpy(fullPath, path);
-    strcat(fullPath, materials->fileName);
-
-    pFile = fopen(fullPath, "rb");
-    if (pFile == NULL)
-    {
-       printf("Error opening TEX file\n");
-       return GL_FALSE;
-    }
+    /* Generate and store texture, every level the loader built */
+    glGenTextures(1, &material->texId);
+    glBindTexture(GL_TEXTURE_2D, material->texId);
+    imageUploadTexture(image);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (image->levels > 1) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+}
 
-    /* Read file */
-    data = (GLubyte *)malloc( BMP_HEADER_SIZE );
 
-    /* Read BMP Header */
-    fread(data, BMP_HEADER_SIZE, 1, pFile);
+char *getTexturePath(material_t *material, char *path)
+{
+    char *fullPath;
 
-    /* Get width and height from header */
-    GLuint width = *(GLuint *)(&data[BMP_WIDTH_OFFSET]);
-    GLuint height = *(GLuint *)(&data[BMP_HEIGHT_OFFSET]);
+    fullPath = malloc(strlen(path) + strlen(material->fileName) + 1);
+    strcpy(fullPath, path);
+    strcat(fullPath, material->fileName);
 
-    /* Read pixel data */
-    data = (GLubyte *)realloc( data, width * height * 3 );
-    fread( data, width * height * BMP_PIX_PER_COL, 1, pFile );
-    fclose( pFile );
+    return fullPath;
+}
 
-    /* Generate and store texture */
-    glGenTextures(1, &materials->texId);
-    glBindTexture(GL_TEXTURE_2D, materials->texId);
-    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB8, width, height);
-    glTexSubImage2D(GL_TEXTURE_2D, 0,0,0, width, height, GL_RGB, GL_UNSIGNED_BYTE, data);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
 
-    /* Free data */
-    free(data);
-    free(fullPath);
+void foldPositionDecode(GLfloat *matrix, GLfloat *dest)
+{
+    GLint i;
 
-    return GL_TRUE;
+    /* Row vector convention: p * uMVP with p = q * scale + offset */
+    for (i = 0; i < 4; i++)
+    {
+        dest[i*4]   = matrix[i*4]   * positionScale.x;
+        dest[i*4+1] = matrix[i*4+1] * positionScale.y;
+        dest[i*4+2] = matrix[i*4+2] * positionScale.z;
+        dest[i*4+3] = (matrix[i*4] * positionOffset.x) + (matrix[i*4+1] * positionOffset.y) + (matrix[i*4+2] * positionOffset.z) + matrix[i*4+3];
+    }
 }
 
 
 void updateModelViewProjMatrix(void)
 {
     GLfloat viewMatrix[16] = {0.0f};
+    GLfloat quantizedMVPMatrix[16] = {0.0f};
 
     /* Generate lookAt matrix for camera */
     generateLookAtMatrix(cameraPosition,
@@ -479,12 +991,88 @@ void updateModelViewProjMatrix(void)
     matrix4x4By4x4(rotationMatrixUp, rotationMatrixRight, rotationMatrixRight);
     matrix4x4By4x4(viewMatrix, rotationMatrixRight, viewMatrix);
 
-    /* Set the modelViewMatrix */
+    /* Set the modelViewMatrix, kept for culling in model space */
+    memcpy(modelViewMatrix, viewMatrix, sizeof(modelViewMatrix));
     matrix4x4By4x4(persepctiveProjMatrix, viewMatrix, modelViewProjMatrix);
 
-    /* Load modelview matrix */
-    glUniformMatrix4fv(uMVPLoc, 1, 0, modelViewProjMatrix);
+    /* Load modelview matrix, compact positions need their decode applied first */
+    if (vertexFormat == VERTEX_FORMAT_COMPACT)
+    {
+        foldPositionDecode(modelViewProjMatrix, quantizedMVPMatrix);
+        glUniformMatrix4fv(uMVPLoc, 1, 0, quantizedMVPMatrix);
+    }
+    else
+    {
+        glUniformMatrix4fv(uMVPLoc, 1, 0, modelViewProjMatrix);
+    }
+
+}
+
+
+void initVertexArrayObject(void)
+{
+    /* Vertex array objects are an extension on ES2 */
+    if ( GL_TRUE == useVao && GL_TRUE == headlessExtensionSupported("GL_OES_vertex_array_object") )
+    {
+        genVertexArraysOES = (PFNGLGENVERTEXARRAYSOESPROC)headlessGetProcAddress("glGenVertexArraysOES");
+        bindVertexArrayOES = (PFNGLBINDVERTEXARRAYOESPROC)headlessGetProcAddress("glBindVertexArrayOES");
+        deleteVertexArraysOES = (PFNGLDELETEVERTEXARRAYSOESPROC)headlessGetProcAddress("glDeleteVertexArraysOES");
+    }
+
+    if (genVertexArraysOES == NULL || bindVertexArrayOES == NULL || deleteVertexArraysOES == NULL)
+    {
+        useVao = GL_FALSE;
+        return;
+    }
+
+    genVertexArraysOES(1, &vaoId);
+}
+
+
+void initUntexturedTexture(void)
+{
+    GLubyte color[] = { UNTEXTURED_COLOR };
+
+    /* Materials without a texture, or whose file did not load, sample white and show their Kd */
+    glGenTextures(1, &untexturedTexId);
+    glBindTexture(GL_TEXTURE_2D, untexturedTexId);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB8, 1, 1);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGB, GL_UNSIGNED_BYTE, color);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+}
+
+
+void initIndexType(void)
+{
+    const char *version = (const char *)glGetString(GL_VERSION);
+    GLint major = 0;
+
+    /* 32-bit indices are core in ES3, an extension on ES2 */
+    if (version != NULL && sscanf(version, "OpenGL ES %d", &major) == 1 && major >= 3)
+    {
+        useUintIndices = GL_TRUE;
+        return;
+    }
+
+    useUintIndices = headlessExtensionSupported("GL_OES_element_index_uint");
+}
 
+
+void initCulling(void)
+{
+    /* Back faces go to the rasterizer's cull, whole clusters to the CPU pass */
+    glEnable(GL_CULL_FACE);
+    glCullFace(GL_BACK);
+    glFrontFace(GL_CCW);
+
+    /* Visible clusters of a material draw as one call when the extension is there */
+    if ( GL_TRUE == headlessExtensionSupported("GL_EXT_multi_draw_arrays") )
+    {
+        multiDrawElementsEXT = (PFNGLMULTIDRAWELEMENTSEXTPROC)headlessGetProcAddress("glMultiDrawElementsEXT");
+    }
 }
 
 
@@ -520,7 +1108,20 @@ void initGL(void)
     updateModelViewProjMatrix();
 
     /* Generate VBO buffers */
-    glGenBuffers(3, vboids);
+    glGenBuffers(NUM_OF_VBOS, vboids);
+
+    /* Create a vertex array object if the extension is there */
+    initVertexArrayObject();
+
+    /* Whether models past 65536 vertices can be drawn */
+    initIndexType();
+
+    initUntexturedTexture();
+
+    if ( GL_TRUE == useCulling )
+    {
+        initCulling();
+    }
 
     /* Load spotligt position */
     glUniform3fv(uLightPosLoc, 1, (GLfloat*)&lightPosition);
@@ -554,6 +1155,17 @@ void updateCameraPosition(void)
 }
 
 
+void setCameraKey(const headlessCameraKey_t *key)
+{
+    cameraPosition = (vec3_t){key->position[0], key->position[1], key->position[2]};
+    modelRotationUp = key->rotationUp;
+    modelRotationRight = key->rotationRight;
+
+    /* Update camera position */
+    updateCameraPosition();
+}
+
+
 void checkUserInput(void)
 {
     if(kbhit())
@@ -582,28 +1194,19 @@ void checkUserInput(void)
 
 
 
-void addFloatData(GLfloat **buffer, GLfloat *data, GLuint *numOfData, GLuint count)
-{
-    GLuint i;
-    for(i=0;i<count;i++)
-    {
-        *buffer = (GLfloat *)realloc(*buffer, ((*numOfData)+1) * sizeof(GLfloat));
-        *(*buffer+(*numOfData)) = *(data+i);
-        (*numOfData)++;
-    }
-}
-
-
-void addIntegerData(GLuint **buffer, GLint *data, GLuint *numOfData, GLuint count)
+void initObject(object_t *object)
 {
-    GLuint i;
-    
-    for(i=0;i<count;i++)
-    {
-        *buffer = (GLuint *)realloc(*buffer, ((*numOfData)+1) * sizeof(GLuint));
-        *(*buffer+(*numOfData)) = *(data+i);
-        (*numOfData)++;
-    }
+    memset(object, 0, sizeof(object_t));
+
+    arrayInit(&object->v, sizeof(GLfloat));
+    arrayInit(&object->vt, sizeof(GLfloat));
+    arrayInit(&object->vn, sizeof(GLfloat));
+    arrayInit(&object->f, sizeof(GLuint));
+    arrayInit(&object->materialChange, sizeof(material_change_t));
+    arrayInit(&object->lods, sizeof(objectLod_t));
+    arrayInit(&object->lodIndices, sizeof(GLuint));
+    arrayInit(&object->clusters, sizeof(meshCluster_t));
+    bvhInit(&object->bvh);
 }
 
 
@@ -635,114 +1238,144 @@ void setMaterialDefaults(material_t *material)
 }
 
 
-GLboolean loadMtlFile(object_t *object, material_t *materials, char *mtlFilename)
+void initMaterialLib(materialLib_t *materials)
 {
- 	char line[STRLEN];
-    char stringName[STRLEN];
-    char keyword[STRLEN];
-    FILE *pFile;
-    GLuint i;
-    GLboolean endOfEntry = GL_FALSE;
+    arrayInit(&materials->materials, sizeof(material_t));
+    arrayInit(&materials->byName, sizeof(GLuint));
+    stringTableInit(&materials->strings);
+}
 
-    pFile = fopen(mtlFilename, "rb");
-    if (pFile == NULL)
-    {
-       printf("Error opening MTL file\n");
-       return GL_FALSE;
-    }
 
-    /* Get the line entry */
-    while(fgets(line, STRLEN, pFile) != NULL)
-    {
-        if ( checkPrefix(line, "newmtl ") )
-        {
-            endOfEntry = GL_FALSE;
-            sscanf(line, "%s %s", keyword, stringName);
+void freeMaterialLib(materialLib_t *materials)
+{
+    /* Names and file names belong to the string table */
+    arrayFree(&materials->materials);
+    arrayFree(&materials->byName);
+    stringTableFree(&materials->strings);
+}
 
-            for(i=0;i<object->materialCount && !endOfEntry;i++)
-            {
-                /* Check if newmtl matches one of the names in the material list */                        
-                if( 0 == strcmp(materials[i].name, stringName) )
-                {
-                    /* Set the default values in case the material file does not specify them */
-                    setMaterialDefaults(&materials[i]);
 
-                    /* If so, cycle through each entry until a blank line is found */
-                    while(!endOfEntry)
-                    {
-                        memset(line, 0, STRLEN);
-                        fgets(line, STRLEN, pFile);
-
-                        if( checkPrefix(line, "Ns ") )
-                        {
-                            sscanf(line, "%s %f", keyword, &materials[i].Ns);
-                        }
-                        else if( checkPrefix(line, "Ka ") )
-                        {
-                            sscanf(line, "%s %f %f %f", keyword, &materials[i].Ka.x, &materials[i].Ka.y, &materials[i].Ka.z);
-                        }
-                        else if( checkPrefix(line, "Kd ") )
-                        {
-                            sscanf(line, "%s %f %f %f", keyword, &materials[i].Kd.x, &materials[i].Kd.y, &materials[i].Kd.z);
-                        }
-                        else if( checkPrefix(line, "Ks ") )
-                        {
-                            sscanf(line, "%s %f %f %f", keyword, &materials[i].Ks.x, &materials[i].Ks.y, &materials[i].Ks.z);
-                        }
-                        else if( checkPrefix(line, "Ni ") )
-                        {
-                            sscanf(line, "%s %f", keyword, &materials[i].Ni);
-                        }
-                        else if( checkPrefix(line, "d ") )
-                        {
-                            sscanf(line, "%s %f", keyword, &materials[i].d);
-                        }
-                        else if( checkPrefix(line, "illum ") )
-                        {
-                            sscanf(line, "%s %f", keyword, &materials[i].illum);
-                        }
-                        else if( checkPrefix(line, "map_Kd ") )
-                        {
-                            sscanf(line, "%s %s", keyword, stringName);
-                            materials[i].fileName = (char *)malloc(strlen(stringName));
-                            strcpy(materials[i].fileName, stringName);                                    
-                        }
-                        else
-                        {
-                            /* Check for blank line */
-                            if ( strlen(line) <= 2 )
-                            {
-                                  endOfEntry = GL_TRUE;
-                            }
-                        }
-                    }
-                }
-            }
+material_t *getMaterial(materialLib_t *materials, GLuint index)
+{
+    return &ARRAY_DATA(&materials->materials, material_t)[index];
+}
+
+
+GLuint internString(materialLib_t *materials, const char *string, GLuint length)
+{
+    GLuint id = stringTableIntern(&materials->strings, string, length);
+    GLuint *entry;
+
+    /* Every string gets a slot, only the material names point at a material */
+    while (id != STRING_TABLE_NOT_FOUND && materials->byName.count <= id)
+    {
+        entry = (GLuint *)arrayAppend(&materials->byName, NULL, 1);
+        if (entry == NULL)
+        {
+            return STRING_TABLE_NOT_FOUND;
         }
+
+        *entry = MATERIAL_NONE;
     }
 
-    fclose(pFile);
+    return id;
+}
 
-    return GL_TRUE;
+
+GLuint findMaterial(materialLib_t *materials, const char *name, GLuint length)
+{
+    GLuint id = stringTableFind(&materials->strings, name, length);
+
+    return (id != STRING_TABLE_NOT_FOUND) ? ARRAY_DATA(&materials->byName, GLuint)[id] : MATERIAL_NONE;
 }
 
 
-GLboolean loadObjFile(object_t *object, material_t *materials, char *objFilename)
+GLuint addMaterial(materialLib_t *materials, const char *name, GLuint length)
 {
-    char prefix[STRLEN];
- 	char line[STRLEN];
-    char stringName[STRLEN];
-    char keyword[STRLEN];
-    GLfloat value[3];
-    GLint indices[9];
-    FILE *pFile = NULL;
-    GLboolean haveTexture = GL_FALSE;
-    GLuint i;
+    material_t *material;
+    GLuint id = internString(materials, name, length);
 
-    /* Open object file */
-    pFile = fopen(objFilename, "r");
+    if (id == STRING_TABLE_NOT_FOUND)
+    {
+        return MATERIAL_NONE;
+    }
 
-    if (pFile == NULL)
+    /* Each name is one material, a repeated name returns the existing one */
+    if (ARRAY_DATA(&materials->byName, GLuint)[id] == MATERIAL_NONE)
+    {
+        material = (material_t *)arrayAppend(&materials->materials, NULL, 1);
+        if (material == NULL)
+        {
+            return MATERIAL_NONE;
+        }
+
+        memset(material, 0, sizeof(material_t));
+        material->name = stringTableGet(&materials->strings, id);
+
+        ARRAY_DATA(&materials->byName, GLuint)[id] = materials->materials.count - 1;
+    }
+
+    return ARRAY_DATA(&materials->byName, GLuint)[id];
+}
+
+
+GLboolean useMaterial(object_t *object, materialLib_t *materials, const char *name, GLuint length, GLuint startFace)
+{
+    material_change_t change;
+
+    /* Hashed lookup, a name not seen before adds a material */
+    change.material = addMaterial(materials, name, length);
+    change.startFace = startFace;
+
+    if ( change.material == MATERIAL_NONE || NULL == arrayAppend(&object->materialChange, &change, 1) )
+    {
+        printf("Out of memory for materials\n");
+        return GL_FALSE;
+    }
+
+    return GL_TRUE;
+}
+
+
+void applyObjSettings(object_t *object)
+{
+    /* The light position is uploaded to the shader by initGL() */
+    lightPosition = (object->settings & OBJ_SETTING_LIGHTPOS) ? object->lightPosition : lightPosition;
+    cameraPosition = (object->settings & OBJ_SETTING_CAMPOS) ? object->cameraPosition : cameraPosition;
+    cameraFront = (object->settings & OBJ_SETTING_CAMFRONT) ? object->cameraFront : cameraFront;
+    cameraUp = (object->settings & OBJ_SETTING_CAMUP) ? object->cameraUp : cameraUp;
+}
+
+
+void finishObjectData(object_t *object)
+{
+    object->numOfVertices = object->v.count / ELEMENTS_PER_VERTEX;
+    object->numOfTexCoords = object->vt.count / ELEMENTS_PER_TEXCOORDS;
+    object->numOfNormals = object->vn.count / ELEMENTS_PER_VERTEX;
+    object->numOfFaces = object->f.count / INDICES_PER_FACE;
+
+    /* Release the unused growth headroom */
+    arrayShrink(&object->v);
+    arrayShrink(&object->vt);
+    arrayShrink(&object->vn);
+    arrayShrink(&object->f);
+}
+
+
+GLboolean loadObjFileStdio(object_t *object, materialLib_t *materials, char *objFilename)
+{
+    char prefix[STRLEN];
+ 	char line[STRLEN];
+    char stringName[STRLEN];
+    char keyword[STRLEN];
+    GLfloat value[3];
+    GLint indices[INDICES_PER_FACE] = {0};
+    FILE *pFile = NULL;
+
+    /* Open object file */
+    pFile = fopen(objFilename, "r");
+
+    if (pFile == NULL)
     {
        printf("Error opening OBJ file\n");
        return GL_FALSE;
@@ -754,28 +1387,26 @@ GLboolean loadObjFile(object_t *object, material_t *materials, char *objFilename
         if( checkPrefix(line, "v ") )
         {
             sscanf(line, "%s %f %f %f", prefix, &value[0], &value[1], &value[2]);
-            addFloatData(&object->v, value, &object->numOfVertices, 3); 
+            arrayAppend(&object->v, value, 3);
         }
         else if( checkPrefix(line, "vt ") )
         {
             sscanf(line, "%s %f %f", prefix, &value[0], &value[1]);
-            addFloatData(&object->vt, value, &object->numOfTexCoords, 2); 
+            arrayAppend(&object->vt, value, 2);
         }
         else if( checkPrefix(line, "vn ") )
         {
             sscanf(line, "%s %f %f %f", prefix, &value[0], &value[1], &value[2]);
-            addFloatData(&object->vn, value, &object->numOfNormals, 3); 
+            arrayAppend(&object->vn, value, 3);
         }
         else if( checkPrefix(line, "f ") )
         {
-            if(object->numOfNormals == 0)
+            if(object->vn.count == 0)
             {
                 sscanf(line, "%s %d/%d %d/%d %d/%d", prefix, 
                                 &indices[0], &indices[1],
-                                &indices[2], &indices[3],
-                                &indices[4], &indices[5]);
-
-                addIntegerData(&object->f, indices, &object->numOfFaces, 6);
+                                &indices[3], &indices[4],
+                                &indices[6], &indices[7]);
             }
             else
             {
@@ -783,49 +1414,17 @@ GLboolean loadObjFile(object_t *object, material_t *materials, char *objFilename
                                 &indices[0], &indices[1], &indices[2],
                                 &indices[3], &indices[4], &indices[5],
                                 &indices[6], &indices[7], &indices[8]);
-                addIntegerData(&object->f, indices, &object->numOfFaces, 9);
             }
+            arrayAppend(&object->f, indices, INDICES_PER_FACE);
         }
         else if( checkPrefix(line, "usemtl ") )
         {
-            /* Reset flag */
-            haveTexture = GL_FALSE;
-
             sscanf(line, "%s %s", keyword, stringName);
 
-            /* Check if we have this texture */
-            for(i=0;i<object->materialCount;i++)
-            {
-                if(0 == strcmp(materials[i].name, stringName)) 
-                {
-                    /* We have this material already */
-                    haveTexture = GL_TRUE;
-
-                    /* Mark the start face that uses this texture */
-                    object->materialChange[object->materialChangeCount].startFace = object->numOfFaces;
-                    object->materialChange[object->materialChangeCount].startFace /= (ELEMENTS_PER_FACE*ELEMENTS_PER_VERTEX);
-                    object->materialChange[object->materialChangeCount].material = &materials[i];
-                    object->materialChangeCount++;
-                    break;
-                }
-            }
-
-            /* If we dont have this texture name stored yet */
-            if ( GL_FALSE == haveTexture ) 
+            if ( GL_FALSE == useMaterial(object, materials, stringName, strlen(stringName), object->f.count / INDICES_PER_FACE) )
             {
-                /* Add material name */
-                materials[object->materialCount].name = (char *)malloc(strlen(stringName));
-                memset(materials[object->materialCount].name, 0, strlen(stringName));
-                strcpy(materials[object->materialCount].name, stringName);
-
-                /* Mark the start face that uses this texture */
-                object->materialChange[object->materialChangeCount].startFace = object->numOfFaces;
-                object->materialChange[object->materialChangeCount].startFace /= (ELEMENTS_PER_FACE*ELEMENTS_PER_VERTEX);
-                object->materialChange[object->materialChangeCount].material = &materials[object->materialCount];
-                object->materialChangeCount++;
-
-                /* Increment material count */
-                object->materialCount++;
+                fclose(pFile);
+                return GL_FALSE;
             }
         }
         else if( checkPrefix(line, "mtllib ") )
@@ -833,27 +1432,30 @@ GLboolean loadObjFile(object_t *object, material_t *materials, char *objFilename
             sscanf(line, "%s %s", keyword, stringName);
 
             /* Add material filename */
+            free(object->materialLibFilename);
             object->materialLibFilename = (char *)malloc(strlen(stringName)+1);
             memset(object->materialLibFilename, 0, strlen(stringName)+1);
             strcpy(object->materialLibFilename, stringName);
         }
         else if( checkPrefix(line, "lightpos ") )
         {
-            sscanf(line, "%s %f %f %f", prefix, &lightPosition.x, &lightPosition.y, &lightPosition.z);
-            /* Load spotligt position */
-            glUniform3fv(uLightPosLoc, 1, (GLfloat*)&lightPosition);
+            sscanf(line, "%s %f %f %f", prefix, &object->lightPosition.x, &object->lightPosition.y, &object->lightPosition.z);
+            object->settings |= OBJ_SETTING_LIGHTPOS;
         }
         else if( checkPrefix(line, "campos ") )
         {
-            sscanf(line, "%s %f %f %f", prefix, &cameraPosition.x, &cameraPosition.y, &cameraPosition.z);
+            sscanf(line, "%s %f %f %f", prefix, &object->cameraPosition.x, &object->cameraPosition.y, &object->cameraPosition.z);
+            object->settings |= OBJ_SETTING_CAMPOS;
         }
         else if( checkPrefix(line, "camfront ") )
         {
-            sscanf(line, "%s %f %f %f", prefix, &cameraFront.x, &cameraFront.y, &cameraFront.z);
+            sscanf(line, "%s %f %f %f", prefix, &object->cameraFront.x, &object->cameraFront.y, &object->cameraFront.z);
+            object->settings |= OBJ_SETTING_CAMFRONT;
         }
         else if( checkPrefix(line, "camup ") )
         {
-            sscanf(line, "%s %f %f %f", prefix, &cameraUp.x, &cameraUp.y, &cameraUp.z);
+            sscanf(line, "%s %f %f %f", prefix, &object->cameraUp.x, &object->cameraUp.y, &object->cameraUp.z);
+            object->settings |= OBJ_SETTING_CAMUP;
         }
         else
         {
@@ -861,12 +1463,7 @@ GLboolean loadObjFile(object_t *object, material_t *materials, char *objFilename
         }
     }
 
-    object->numOfVertices /= ELEMENTS_PER_VERTEX;
-    object->numOfTexCoords /= ELEMENTS_PER_TEXCOORDS;
-    object->numOfNormals /= ELEMENTS_PER_VERTEX;
-
-    /* Check if we have normals in the file, calculate the face count accordingly */
-    object->numOfFaces /= (object->numOfNormals) ? (ELEMENTS_PER_FACE*3) : (ELEMENTS_PER_FACE*2);
+    finishObjectData(object);
   
     fclose (pFile);
 
@@ -874,323 +1471,5104 @@ GLboolean loadObjFile(object_t *object, material_t *materials, char *objFilename
 }
 
 
-void drawVertices(object_t *object, material_t *materials)
+const char *mapFile(const char *fileName, size_t *size)
 {
-    GLint i;
-    GLuint faceCount;
-    GLuint endFace;
-    
-    for(i=0;i<object->materialChangeCount;i++)
+    struct stat fileInfo;
+    void *data;
+    GLint fd;
+
+    fd = open(fileName, O_RDONLY);
+    if (fd < 0)
     {
-        /* Calculate the end face for this material */
-        endFace = (i < object->materialChangeCount - 1) ? object->materialChange[i+1].startFace : object->numOfFaces;
+        return NULL;
+    }
 
-        /* If a texture is specified, bind it */
-        if(object->materialChange[i].material->texId != -1)
-        {
-            glBindTexture(GL_TEXTURE_2D, object->materialChange[i].material->texId);
-        }
+    if (fstat(fd, &fileInfo) != 0 || fileInfo.st_size == 0)
+    {
+        close(fd);
+        return NULL;
+    }
 
-        /* Apply material parameters */
-        glUniform3fv(uKaLoc, 1, (GLfloat *)&object->materialChange[i].material->Ka);
-        glUniform3fv(uKdLoc, 1, (GLfloat *)&object->materialChange[i].material->Kd);
-        glUniform3fv(uKsLoc, 1, (GLfloat *)&object->materialChange[i].material->Ks);
-        glUniform1f(uDLoc, object->materialChange[i].material->d);
+    data = mmap(NULL, fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
 
-        /* Check dissolve factor */
-        if (object->materialChange[i].material->d != 1.0f) 
-        {
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        }
-        else
-        {
-            glDisable(GL_BLEND);
-        }
+    if (data == MAP_FAILED)
+    {
+        return NULL;
+    }
 
-        /* Calculate the face count for this material */
-        faceCount = (endFace - object->materialChange[i].startFace);
+    /* The tokenizer walks the file front to back exactly once */
+    madvise(data, fileInfo.st_size, MADV_SEQUENTIAL);
 
-        /* Draw faces */
-        glDrawArrays(GL_TRIANGLES, object->materialChange[i].startFace*ELEMENTS_PER_FACE, faceCount*ELEMENTS_PER_FACE);
+    *size = fileInfo.st_size;
+
+    return (const char *)data;
+}
+
+
+void unmapFile(const char *data, size_t size)
+{
+    munmap((void *)data, size);
+}
+
+
+const char *skipSpaces(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+    {
+        p++;
     }
+
+    return p;
 }
 
 
-void prepareObjectArrays(object_t *object)
+const char *parseName(const char *p, const char *end, GLuint *length)
 {
-    GLint i, j;
-    GLint v[3];
-    GLint vt[3];
-    GLint vn[3];
-    GLuint vc = 0, tc = 0, vnc = 0;
+    const char *start;
 
-    /* Assign pointers to input values */
-    GLuint *faces = (GLuint *)object->f;
+    p = skipSpaces(p, end);
+    start = p;
 
-    /* Create vertex and texture buffers */
-    object->vertArray = (GLfloat *)malloc(sizeof(GLfloat)*object->numOfFaces*(ELEMENTS_PER_FACE*ELEMENTS_PER_VERTEX));
-    object->texArray = (GLfloat *)malloc(sizeof(GLfloat)*object->numOfFaces*(ELEMENTS_PER_FACE*ELEMENTS_PER_TEXCOORDS));
-    object->normArray = (GLfloat *)malloc(sizeof(GLfloat)*object->numOfFaces*(ELEMENTS_PER_FACE*ELEMENTS_PER_VERTEX));
-    
-    GLuint stride = (object->numOfNormals == 0) ? (ELEMENTS_PER_FACE*ELEMENTS_PER_TEXCOORDS) : (ELEMENTS_PER_FACE*ELEMENTS_PER_VERTEX);
-    GLuint offset = (object->numOfNormals == 0) ? 0 : 1;
-
-    for(i=0;i<object->numOfFaces;i++)
-    {
-        /* Get offsets from face inputs */
-        v[0]  = faces[(stride*i)+0]-1;
-        vt[0] = faces[(stride*i)+1]-1;
-        v[1]  = faces[(stride*i)+2+offset]-1;
-        vt[1] = faces[(stride*i)+3+offset]-1;
-        v[2]  = faces[(stride*i)+4+(offset*2)]-1;           
-        vt[2] = faces[(stride*i)+5+(offset*2)]-1;
-        
-        /* If this file contains normals */
-        if(object->numOfNormals != 0)
-        {
-            vn[0] = faces[(stride*i)+2]-1;
-            vn[1] = faces[(stride*i)+5]-1;
-            vn[2] = faces[(stride*i)+8]-1;
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\r')
+    {
+        p++;
+    }
 
-            for(j=0; j<3; j++)
-            {
-                object->normArray[vnc++] = *(object->vn + (vn[j]*ELEMENTS_PER_VERTEX + 0)); 
-                object->normArray[vnc++] = *(object->vn + (vn[j]*ELEMENTS_PER_VERTEX + 1)); 
-                object->normArray[vnc++] = *(object->vn + (vn[j]*ELEMENTS_PER_VERTEX + 2)); 
-            }
-        }
+    *length = p - start;
 
-        /* Load vertices */
-        for(j=0; j<3; j++)
-        {
-            object->vertArray[vc++] = *(object->v + (v[j]*ELEMENTS_PER_VERTEX + 0));  
-            object->vertArray[vc++] = *(object->v + (v[j]*ELEMENTS_PER_VERTEX + 1));
-            object->vertArray[vc++] = *(object->v + (v[j]*ELEMENTS_PER_VERTEX + 2));
-        }
+    return start;
+}
 
-        /* Load tex coords */
-        for(j=0; j<3; j++)
-        {
-            object->texArray[tc++] = *(object->vt + (vt[j]*ELEMENTS_PER_TEXCOORDS + 0));  
-            object->texArray[tc++] = *(object->vt + (vt[j]*ELEMENTS_PER_TEXCOORDS + 1));  
-        }
+
+const char *matchKeyword(const char *p, const char *end, const char *keyword)
+{
+    size_t length = strlen(keyword);
+
+    if ( (size_t)(end - p) > length && 0 == memcmp(p, keyword, length) && (p[length] == ' ' || p[length] == '\t') )
+    {
+        return p + length;
     }
+
+    return NULL;
 }
 
 
-void cleanUp(object_t *object, material_t *material)
+const char *parseDigits(const char *p, const char *end, uint64_t *mantissa)
 {
-    GLuint i;
+    static const uint64_t scale[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+    GLuint digit;
 
-    glDisableVertexAttribArray(aVertexLoc);
-    glDisableVertexAttribArray(aNormalLoc);
-    glDisableVertexAttribArray(aTexCoordsLoc);
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    uint64_t chunk, nonDigits, digits;
+    GLuint count;
 
-    for(i=0;i<object->materialCount;i++)
+    /* Decode up to eight digits at a time with SWAR arithmetic */
+    while (p + 8 <= end)
     {
-        if ( (material+i)->fileName != NULL )
+        memcpy(&chunk, p, sizeof(chunk));
+        digits = chunk - 0x3030303030303030ULL;
+        nonDigits = (digits | (digits + 0x7676767676767676ULL)) & 0x8080808080808080ULL;
+        count = (nonDigits == 0) ? 8 : (GLuint)(__builtin_ctzll(nonDigits) >> 3);
+
+        if (count == 0)
         {
-            free((material+i)->fileName);
+            return p;
         }
-    }
 
+        /* Move the digits to the top bytes, zero fill below, then combine pairwise */
+        digits = (count == 8) ? digits : (digits << (8 * (8 - count)));
+        digits = (digits * 10) + (digits >> 8);
+        digits = (((digits & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+                  (((digits >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
 
-    if( object->materialLibFilename != NULL )
-    {
-        free(object->materialLibFilename);
-    }
+        *mantissa = (*mantissa * scale[count]) + digits;
+        p += count;
 
-    if( object->vertArray != NULL )
-    {
-        free(object->vertArray);
+        if (count < 8)
+        {
+            return p;
+        }
     }
+#endif
 
-    if( object->texArray != NULL )
+    while (p < end && (digit = (GLuint)(*p - '0')) < 10)
     {
-        free(object->texArray);
+        *mantissa = (*mantissa * 10) + digit;
+        p++;
     }
 
-    if( object->normArray != NULL )
-    {
-        free(object->normArray);
-    }
+    return p;
 }
 
 
-char* getPath(char *string)
+const char *parseIndex(const char *p, const char *end, GLint *value)
 {
-    char *path = NULL;
-    GLint position = strlen(string);    
+    const char *start;
+    uint64_t result = 0;
+    GLint sign = 1;
 
-    while(position != 0 && string[--position] != '/');
+    if (p < end && *p == '-')
+    {
+        sign = -1;
+        p++;
+    }
 
-    path = (char *)malloc(position+2);
-    memset(path, 0, position+2);
-    strncpy(path, string, position+1);
+    start = p;
+    p = parseDigits(p, end, &result);
 
-    return path;
+    *value = sign * (GLint)result;
+
+    return (p == start) ? NULL : p;
 }
 
 
-GLboolean loadModel(object_t *object, material_t *materials, char *objFileName)
+const char *parseFloat(const char *p, const char *end, GLfloat *value)
 {
-    GLint i;
-    char *mtlFile;
-    char *path;
-
-    mtlFile = getPath(objFileName);
-    path = getPath(objFileName);
-
-    /* Load and parse obj file */
-    printf("Loading object file: %s...", objFileName);
-
-    if ( GL_FALSE == loadObjFile(object, materials, objFileName) )
+    static const double powersOfTen[] =
     {
-        cleanUp(object, materials);
-        return GL_FALSE;
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    static const double inversePowersOfTen[] =
+    {
+        1e-0,  1e-1,  1e-2,  1e-3,  1e-4,  1e-5,  1e-6,  1e-7,  1e-8,  1e-9,  1e-10, 1e-11,
+        1e-12, 1e-13, 1e-14, 1e-15, 1e-16, 1e-17, 1e-18, 1e-19, 1e-20, 1e-21, 1e-22
+    };
+    char token[FLOAT_TOKEN_LEN];
+    const char *start;
+    const char *digits;
+    const char *fraction;
+    uint64_t mantissa = 0;
+    uint64_t bits;
+    int64_t halfwayDistance;
+    GLint exponent = 0;
+    GLint numOfDigits;
+    GLboolean negative = GL_FALSE;
+    GLuint digit;
+    double result;
+
+    p = skipSpaces(p, end);
+    start = p;
+
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = (*p == '-') ? GL_TRUE : GL_FALSE;
+        p++;
     }
-    printf("done\n");
 
-    /* Construct material filenamd */
-    mtlFile = (char*)realloc(mtlFile, (strlen(mtlFile) + strlen(object->materialLibFilename))+1);
-    strncat(mtlFile, object->materialLibFilename, strlen(object->materialLibFilename)+1);
+    /* Integer part */
+    digits = p;
+    p = parseDigits(p, end, &mantissa);
+    numOfDigits = p - digits;
 
-    /* Load and parse material file */
-    printf("Loading mtl file: %s...", mtlFile);
-    if ( GL_FALSE == loadMtlFile(object, materials, mtlFile) )
+    /* Fraction part */
+    if (p < end && *p == '.')
     {
-        return GL_FALSE;
+        fraction = ++p;
+        p = parseDigits(p, end, &mantissa);
+        exponent = -(GLint)(p - fraction);
+        numOfDigits += p - fraction;
     }
-    printf("done\n");
-
-    printf("\tvertices:   %d\n", object->numOfVertices);
-    printf("\ttex coords: %d\n", object->numOfTexCoords);
-    printf("\tnormals:    %d\n", object->numOfNormals);
-    printf("\tfaces:      %d\n", object->numOfFaces);
-    printf("\tmaterials:  %d\n", object->materialCount);
 
-    for(i=0; i<object->materialCount; i++)
+    if (numOfDigits == 0)
     {
-        printf("\t%3d:   %s\tfilename: %s\n", i, materials[i].name, materials[i].fileName);
+        return NULL;
     }
 
-    /* Load texture files */
-    for(i=0;i<object->materialCount;i++)
+    /* Exponent part */
+    if (p + 1 < end && (*p == 'e' || *p == 'E'))
     {
-        if(materials[i].fileName != NULL)
+        const char *q = p + 1;
+        GLint sign = 1;
+        GLint explicitExponent = 0;
+
+        if (*q == '-' || *q == '+')
+        {
+            sign = (*q == '-') ? -1 : 1;
+            q++;
+        }
+
+        if (q < end && (GLuint)(*q - '0') < 10)
         {
-            printf("Loading tex files: %s...", materials[i].fileName);
-            if ( GL_FALSE == loadTexture(&materials[i], path) )
+            while (q < end && (digit = (GLuint)(*q - '0')) < 10)
             {
-                return GL_FALSE;
+                explicitExponent = (explicitExponent < 10000) ? (explicitExponent * 10) + digit : explicitExponent;
+                q++;
             }
-            printf("done\n");
+            exponent += sign * explicitExponent;
+            p = q;
         }
     }
 
-    free(mtlFile);
-    free(path);
+    /*
+     * Fast path: the mantissa is an exact double and the scale carries at most
+     * half an ulp of error, so the product is within 1.5 ulp of the true value.
+     * Rounding that double to a float is exact unless it lies within a few ulp
+     * of a float halfway point, or outside the normal float range, in which
+     * case strtof settles it.
+     */
+    if (numOfDigits <= 19 && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22)
+    {
+        result = (double)mantissa * ((exponent < 0) ? inversePowersOfTen[-exponent] : powersOfTen[exponent]);
 
-    return GL_TRUE;
+        memcpy(&bits, &result, sizeof(bits));
+        halfwayDistance = (int64_t)(bits & 0x1FFFFFFFULL) - 0x10000000LL;
+
+        if ( mantissa == 0 ||
+             ((halfwayDistance > FLOAT_HALFWAY_SLACK || halfwayDistance < -FLOAT_HALFWAY_SLACK) && result >= FLT_MIN && result <= FLT_MAX) )
+        {
+            *value = (GLfloat)((negative) ? -result : result);
+            return p;
+        }
+    }
+
+    /* Slow path for long, huge, tiny or halfway values, strtof needs a terminated copy */
+    if ( (size_t)(p - start) < FLOAT_TOKEN_LEN )
+    {
+        memcpy(token, start, p - start);
+        token[p - start] = '\0';
+        *value = strtof(token, NULL);
+    }
+    else
+    {
+        char *longToken = (char *)malloc((p - start) + 1);
+
+        memcpy(longToken, start, p - start);
+        longToken[p - start] = '\0';
+        *value = strtof(longToken, NULL);
+        free(longToken);
+    }
+
+    return p;
 }
 
 
-void prepareVbos(object_t *object)
+const char *parseFloats(const char *p, const char *end, GLfloat *values, GLuint count)
 {
-    glBindBuffer(GL_ARRAY_BUFFER, vboids[VBO_VERT]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*object->numOfFaces*(ELEMENTS_PER_FACE*ELEMENTS_PER_VERTEX), object->vertArray, GL_STATIC_DRAW);
-    glVertexAttribPointer(aVertexLoc, ELEMENTS_PER_VERTEX, GL_FLOAT, 0, 0, BUFFER_OFFSET(0));
-
-    glBindBuffer(GL_ARRAY_BUFFER, vboids[VBO_TEX]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*object->numOfFaces*(ELEMENTS_PER_FACE*ELEMENTS_PER_TEXCOORDS), object->texArray, GL_STATIC_DRAW);
-    glVertexAttribPointer(aTexCoordsLoc, ELEMENTS_PER_TEXCOORDS, GL_FLOAT, 0, 0, BUFFER_OFFSET(0));
+    GLuint i;
+    const char *next;
 
-    glBindBuffer(GL_ARRAY_BUFFER, vboids[VBO_NORM]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*object->numOfFaces*(ELEMENTS_PER_FACE*ELEMENTS_PER_VERTEX), object->normArray, GL_STATIC_DRAW);
-    glVertexAttribPointer(aNormalLoc, ELEMENTS_PER_VERTEX, GL_FLOAT, 0, 0, BUFFER_OFFSET(0));
+    for(i=0;i<count;i++)
+    {
+        next = parseFloat(p, end, &values[i]);
+        if (next == NULL)
+        {
+            /* Missing components default to zero */
+            for(;i<count;i++)
+            {
+                values[i] = 0.0f;
+            }
+            break;
+        }
+        p = next;
+    }
 
-    glEnableVertexAttribArray(aVertexLoc);
-    glEnableVertexAttribArray(aNormalLoc);
-    glEnableVertexAttribArray(aTexCoordsLoc);
+    return p;
 }
 
 
-int main(int argc, char **argv)
+void parseFaceLine(objChunk_t *chunk, const char *p, const char *end)
 {
-    object_t object = { 0 };
-    material_t materials[MAX_MATERIALS] = { 0 };
+    GLint corner[ELEMENTS_PER_CORNER + 1];
+    GLuint counts[ELEMENTS_PER_CORNER];
+    GLuint *indices;
+    GLuint *face;
+    GLuint i, j, k, numOfCorners, position;
+    const char *next;
 
-    GLFWwindow* window;
-    
-    glfwInit();    
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+    counts[0] = chunk->v.count / ELEMENTS_PER_VERTEX;
+    counts[1] = chunk->vt.count / ELEMENTS_PER_TEXCOORDS;
+    counts[2] = chunk->vn.count / ELEMENTS_PER_VERTEX;
 
-    /* Create window */
-    window = glfwCreateWindow(DISPLAY_WIDTH, DISPLAY_HEIGHT, __FILE__, NULL, NULL);
+    chunk->corners.count = 0;
 
-    /* Make window current */
-    glfwMakeContextCurrent(window);
+    /* Read every v, v/vt, v//vn or v/vt/vn corner on the line */
+    while (1)
+    {
+        p = skipSpaces(p, end);
+        if (p >= end || (next = parseIndex(p, end, &corner[0])) == NULL)
+        {
+            break;
+        }
+        p = next;
+        corner[1] = 0;
+        corner[2] = 0;
+        corner[3] = 0;
 
-    /* Load Shader */
-    loadShader();
+        if (p < end && *p == '/')
+        {
+            p++;
+            if (p < end && *p != '/' && (next = parseIndex(p, end, &corner[1])) != NULL)
+            {
+                p = next;
+            }
 
-    /* Set camera distance if provided */
-    if (argc > 2)
+            if (p < end && *p == '/')
+            {
+                p++;
+                if ((next = parseIndex(p, end, &corner[2])) != NULL)
+                {
+                    p = next;
+                }
+            }
+        }
+
+        /*
+         * Negative indices count back from the elements read so far.  Resolve
+         * them against this chunk and remember which ones need the element
+         * counts of the preceding chunks added once every chunk is parsed.
+         */
+        for(k=0;k<ELEMENTS_PER_CORNER;k++)
+        {
+            if (corner[k] < 0)
+            {
+                corner[k] = (GLint)counts[k] + corner[k] + 1;
+                corner[ELEMENTS_PER_CORNER] |= (1 << k);
+            }
+        }
+
+        arrayAppend(&chunk->corners, corner, ELEMENTS_PER_CORNER + 1);
+
+        /* Skip anything unexpected up to the next corner */
+        while (p < end && *p != ' ' && *p != '\t')
+        {
+            p++;
+        }
+    }
+
+    numOfCorners = chunk->corners.count / (ELEMENTS_PER_CORNER + 1);
+    if (numOfCorners < 3)
     {
-        cameraPosition.z = atof(argv[2]);
+        return;
     }
 
-    /* Load model */
-    if ( GL_FALSE == loadModel(&object, materials, argv[1]) )
+    /* Triangulate n-gons as a fan around the first corner */
+    indices = ARRAY_DATA(&chunk->corners, GLuint);
+    position = chunk->f.count;
+    face = (GLuint *)arrayAppend(&chunk->f, NULL, (numOfCorners - 2) * INDICES_PER_FACE);
+
+    for(i=1;i<numOfCorners-1;i++)
     {
-        printf("\nError loading model\n");
-        return -1;
+        GLuint fan[ELEMENTS_PER_FACE] = { 0, i, i + 1 };
+
+        for(j=0;j<ELEMENTS_PER_FACE;j++)
+        {
+            memcpy(face, &indices[fan[j] * (ELEMENTS_PER_CORNER + 1)], sizeof(GLuint) * ELEMENTS_PER_CORNER);
+
+            for(k=0;k<ELEMENTS_PER_CORNER;k++)
+            {
+                if (indices[(fan[j] * (ELEMENTS_PER_CORNER + 1)) + ELEMENTS_PER_CORNER] & (1 << k))
+                {
+                    arrayAppend(&chunk->relativeIndices, &position, 1);
+                }
+                position++;
+            }
+            face += ELEMENTS_PER_CORNER;
+        }
     }
+}
 
-    /* GL initialization */
-    initGL();
 
-    /* Prepare vertex and texture arrays */
-    prepareObjectArrays(&object);
+void addObjEvent(objChunk_t *chunk, objEvent_e type, const char *args, const char *end)
+{
+    objEvent_t *event = (objEvent_t *)arrayAppend(&chunk->events, NULL, 1);
 
-    /* Prepare VBOs */
-    prepareVbos(&object);
+    event->type = type;
+    event->face = chunk->f.count / INDICES_PER_FACE;
 
-    /* Loop until we need to shutdown */
-    while (!glfwWindowShouldClose(window) && appShutdown == 0) 
+    if (type == OBJ_EVENT_USEMTL || type == OBJ_EVENT_MTLLIB)
     {
-        /* Check for events */
-        glfwPollEvents();
-
-        /* Check user input */
-        checkUserInput();
+        event->name = parseName(args, end, &event->length);
+    }
+    else
+    {
+        parseFloats(args, end, event->value, 3);
+    }
+}
 
-        /* Clear the color and depth buffer */
-        glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
 
-        /* Draw the object */
-        drawVertices(&object, materials);
+void parseObjLine(objChunk_t *chunk, const char *p, const char *end)
+{
+    const char *args;
 
-        /* Rotate the object */
-        modelRotationUp -= 0.5f;
-        if(modelRotationUp > 360.0f)
-        {
-            modelRotationUp = modelRotationUp-360.0f;
-        }
+    p = skipSpaces(p, end);
+    if (end - p < 2)
+    {
+        return;
+    }
 
-        /* Update camera position */
-        updateCameraPosition();
+    /* Geometry lines make up nearly all of the file, test for them first */
+    if ( p[0] == 'v' && (p[1] == ' ' || p[1] == '\t') )
+    {
+        parseFloats(p + 2, end, (GLfloat *)arrayAppend(&chunk->v, NULL, 3), 3);
+    }
+    else if ( p[0] == 'v' && p[1] == 't' && end - p > 2 && (p[2] == ' ' || p[2] == '\t') )
+    {
+        parseFloats(p + 3, end, (GLfloat *)arrayAppend(&chunk->vt, NULL, 2), 2);
+    }
+    else if ( p[0] == 'v' && p[1] == 'n' && end - p > 2 && (p[2] == ' ' || p[2] == '\t') )
+    {
+        parseFloats(p + 3, end, (GLfloat *)arrayAppend(&chunk->vn, NULL, 3), 3);
+    }
+    else if ( p[0] == 'f' && (p[1] == ' ' || p[1] == '\t') )
+    {
+        parseFaceLine(chunk, p + 2, end);
+    }
+    else if ( (args = matchKeyword(p, end, "usemtl")) != NULL )
+    {
+        addObjEvent(chunk, OBJ_EVENT_USEMTL, args, end);
+    }
+    else if ( (args = matchKeyword(p, end, "mtllib")) != NULL )
+    {
+        addObjEvent(chunk, OBJ_EVENT_MTLLIB, args, end);
+    }
+    else if ( (args = matchKeyword(p, end, "lightpos")) != NULL )
+    {
+        addObjEvent(chunk, OBJ_EVENT_LIGHTPOS, args, end);
+    }
+    else if ( (args = matchKeyword(p, end, "campos")) != NULL )
+    {
+        addObjEvent(chunk, OBJ_EVENT_CAMPOS, args, end);
+    }
+    else if ( (args = matchKeyword(p, end, "camfront")) != NULL )
+    {
+        addObjEvent(chunk, OBJ_EVENT_CAMFRONT, args, end);
+    }
+    else if ( (args = matchKeyword(p, end, "camup")) != NULL )
+    {
+        addObjEvent(chunk, OBJ_EVENT_CAMUP, args, end);
+    }
+}
+
+
+void parseObjChunk(void *arg)
+{
+    objChunk_t *chunk = (objChunk_t *)arg;
+    const char *p = chunk->start;
+    const char *lineEnd;
+
+    /* Walk the chunk one line at a time, lines may be any length */
+    while (p < chunk->end)
+    {
+        lineEnd = (const char *)memchr(p, '\n', chunk->end - p);
+        if (lineEnd == NULL)
+        {
+            lineEnd = chunk->end;
+        }
+
+        parseObjLine(chunk, p, lineEnd);
+
+        p = lineEnd + 1;
+    }
+}
+
+
+void initObjChunk(objChunk_t *chunk)
+{
+    memset(chunk, 0, sizeof(objChunk_t));
+
+    arrayInit(&chunk->v, sizeof(GLfloat));
+    arrayInit(&chunk->vt, sizeof(GLfloat));
+    arrayInit(&chunk->vn, sizeof(GLfloat));
+    arrayInit(&chunk->f, sizeof(GLuint));
+    arrayInit(&chunk->corners, sizeof(GLuint));
+    arrayInit(&chunk->relativeIndices, sizeof(GLuint));
+    arrayInit(&chunk->events, sizeof(objEvent_t));
+}
+
+
+void freeObjChunk(objChunk_t *chunk)
+{
+    arrayFree(&chunk->v);
+    arrayFree(&chunk->vt);
+    arrayFree(&chunk->vn);
+    arrayFree(&chunk->f);
+    arrayFree(&chunk->corners);
+    arrayFree(&chunk->relativeIndices);
+    arrayFree(&chunk->events);
+}
+
+
+void copyChunkArray(array_t *dest, array_t *src, GLuint offset)
+{
+    if (src->count != 0)
+    {
+        memcpy((GLubyte *)dest->data + ((size_t)offset * dest->elementSize), src->data, (size_t)src->count * src->elementSize);
+    }
+}
+
+
+void takeChunkArray(array_t *dest, array_t *src)
+{
+    arrayFree(dest);
+    *dest = *src;
+    arrayInit(src, src->elementSize);
+}
+
+
+void mergeObjChunk(void *arg)
+{
+    objChunk_t *chunk = (objChunk_t *)arg;
+    object_t *object = chunk->object;
+    GLuint *faces = ARRAY_DATA(&object->f, GLuint);
+    GLuint *relative = ARRAY_DATA(&chunk->relativeIndices, GLuint);
+    GLuint offsets[ELEMENTS_PER_CORNER];
+    GLuint i, position;
+
+    copyChunkArray(&object->v, &chunk->v, chunk->offset.v);
+    copyChunkArray(&object->vt, &chunk->vt, chunk->offset.vt);
+    copyChunkArray(&object->vn, &chunk->vn, chunk->offset.vn);
+    copyChunkArray(&object->f, &chunk->f, chunk->offset.f);
+
+    offsets[0] = chunk->offset.v / ELEMENTS_PER_VERTEX;
+    offsets[1] = chunk->offset.vt / ELEMENTS_PER_TEXCOORDS;
+    offsets[2] = chunk->offset.vn / ELEMENTS_PER_VERTEX;
+
+    /* Rebase the relative indices onto the elements of the preceding chunks */
+    for(i=0;i<chunk->relativeIndices.count;i++)
+    {
+        position = chunk->offset.f + relative[i];
+        faces[position] += offsets[relative[i] % ELEMENTS_PER_CORNER];
+    }
+}
+
+
+void parseMtlLine(materialLib_t *library, GLuint *current, const char *p, const char *end)
+{
+    material_t *material;
+    const char *args;
+    const char *name;
+    GLuint length, id;
+
+    p = skipSpaces(p, end);
+
+    /* Every newmtl starts an entry, it runs to the next newmtl or the end of the file */
+    if ( (args = matchKeyword(p, end, "newmtl")) != NULL )
+    {
+        name = parseName(args, end, &length);
+        *current = (length != 0) ? addMaterial(library, name, length) : MATERIAL_NONE;
+
+        if (*current != MATERIAL_NONE)
+        {
+            setMaterialDefaults(getMaterial(library, *current));
+        }
+        return;
+    }
+
+    if (*current == MATERIAL_NONE)
+    {
+        return;
+    }
+
+    material = getMaterial(library, *current);
+
+    if ( (args = matchKeyword(p, end, "Ns")) != NULL )
+    {
+        parseFloats(args, end, &material->Ns, 1);
+    }
+    else if ( (args = matchKeyword(p, end, "Ka")) != NULL )
+    {
+        parseFloats(args, end, (GLfloat *)&material->Ka, 3);
+    }
+    else if ( (args = matchKeyword(p, end, "Kd")) != NULL )
+    {
+        parseFloats(args, end, (GLfloat *)&material->Kd, 3);
+    }
+    else if ( (args = matchKeyword(p, end, "Ks")) != NULL )
+    {
+        parseFloats(args, end, (GLfloat *)&material->Ks, 3);
+    }
+    else if ( (args = matchKeyword(p, end, "Ni")) != NULL )
+    {
+        parseFloats(args, end, &material->Ni, 1);
+    }
+    else if ( (args = matchKeyword(p, end, "d")) != NULL )
+    {
+        parseFloats(args, end, &material->d, 1);
+    }
+    else if ( (args = matchKeyword(p, end, "illum")) != NULL )
+    {
+        parseFloats(args, end, &material->illum, 1);
+    }
+    else if ( (args = matchKeyword(p, end, "map_Kd")) != NULL )
+    {
+        name = parseName(args, end, &length);
+        id = (length != 0) ? internString(library, name, length) : STRING_TABLE_NOT_FOUND;
+        material->fileName = (id != STRING_TABLE_NOT_FOUND) ? stringTableGet(&library->strings, id) : NULL;
+    }
+}
+
+
+GLboolean loadMtlFile(materialLib_t *library, char *mtlFilename)
+{
+    const char *data;
+    const char *p;
+    const char *lineEnd;
+    size_t size;
+    GLuint current = MATERIAL_NONE;
+
+    data = mapFile(mtlFilename, &size);
+    if (data == NULL)
+    {
+       printf("Error opening MTL file\n");
+       return GL_FALSE;
+    }
+
+    /* One pass over the file, every material goes into the library */
+    for(p=data;p<data+size;p=lineEnd+1)
+    {
+        lineEnd = (const char *)memchr(p, '\n', (data + size) - p);
+        if (lineEnd == NULL)
+        {
+            lineEnd = data + size;
+        }
+
+        parseMtlLine(library, &current, p, lineEnd);
+    }
+
+    unmapFile(data, size);
+
+    return GL_TRUE;
+}
+
+
+void loadMtlTask(void *arg)
+{
+    mtlLoad_t *mtl = (mtlLoad_t *)arg;
+    double start = getTimeMs();
+
+    mtl->result = loadMtlFile(&mtl->library, mtl->fileName);
+    mtl->time = getTimeMs() - start;
+}
+
+
+char *findMaterialLibName(char *objFileName)
+{
+    const char *data;
+    const char *p;
+    const char *name;
+    const char *lineEnd;
+    char *copy = NULL;
+    size_t size;
+    GLuint length;
+
+    data = mapFile(objFileName, &size);
+    if (data == NULL)
+    {
+        return NULL;
+    }
+
+    /* Numbers never contain an 'm', so jumping between them skips the geometry quickly */
+    for(p=data;(p = (const char *)memchr(p, 'm', (data + size) - p)) != NULL;p++)
+    {
+        if ( (p == data || p[-1] == '\n') && matchKeyword(p, data + size, "mtllib") != NULL )
+        {
+            lineEnd = (const char *)memchr(p, '\n', (data + size) - p);
+            name = parseName(p + 6, (lineEnd != NULL) ? lineEnd : data + size, &length);
+
+            copy = (char *)malloc(length + 1);
+            memcpy(copy, name, length);
+            copy[length] = '\0';
+            break;
+        }
+    }
+
+    unmapFile(data, size);
+
+    return copy;
+}
+
+
+void startMtlLoad(mtlLoad_t *mtl, char *objFileName, char *path)
+{
+    char *name;
+
+    memset(mtl, 0, sizeof(mtlLoad_t));
+    initMaterialLib(&mtl->library);
+
+    /* Without a pool the library is parsed after the OBJ instead */
+    if (threadPool == NULL || (name = findMaterialLibName(objFileName)) == NULL)
+    {
+        return;
+    }
+
+    mtl->fileName = (char *)malloc(strlen(path) + strlen(name) + 1);
+    strcpy(mtl->fileName, path);
+    strcat(mtl->fileName, name);
+    free(name);
+
+    mtl->submitted = GL_TRUE;
+    threadPoolSubmit(threadPool, loadMtlTask, mtl);
+}
+
+
+void freeMtlLoad(mtlLoad_t *mtl)
+{
+    freeMaterialLib(&mtl->library);
+    free(mtl->fileName);
+    mtl->fileName = NULL;
+}
+
+
+void resolveMaterials(materialLib_t *materials, materialLib_t *library)
+{
+    material_t *material;
+    const material_t *definition;
+    GLuint i, index, id;
+
+    /* Look every material the OBJ uses up in the parsed library */
+    for(i=0;i<materials->materials.count;i++)
+    {
+        material = getMaterial(materials, i);
+        index = findMaterial(library, material->name, strlen(material->name));
+        if (index == MATERIAL_NONE)
+        {
+            continue;
+        }
+
+        definition = getMaterial(library, index);
+        material->Ns = definition->Ns;
+        material->Ka = definition->Ka;
+        material->Kd = definition->Kd;
+        material->Ks = definition->Ks;
+        material->Ni = definition->Ni;
+        material->d = definition->d;
+        material->illum = definition->illum;
+
+        /* File names move to the object's string table, the library is freed after */
+        id = (definition->fileName != NULL) ? internString(materials, definition->fileName, strlen(definition->fileName)) : STRING_TABLE_NOT_FOUND;
+        material->fileName = (id != STRING_TABLE_NOT_FOUND) ? stringTableGet(&materials->strings, id) : NULL;
+    }
+}
+
+
+GLboolean applyObjEvents(object_t *object, materialLib_t *materials, objChunk_t *chunk)
+{
+    objEvent_t *events = ARRAY_DATA(&chunk->events, objEvent_t);
+    GLuint i;
+
+    for(i=0;i<chunk->events.count;i++)
+    {
+        switch(events[i].type)
+        {
+            case OBJ_EVENT_USEMTL:
+                if ( GL_FALSE == useMaterial(object, materials, events[i].name, events[i].length, (chunk->offset.f / INDICES_PER_FACE) + events[i].face) )
+                {
+                    return GL_FALSE;
+                }
+                break;
+
+            case OBJ_EVENT_MTLLIB:
+                /* Add material filename */
+                free(object->materialLibFilename);
+                object->materialLibFilename = (char *)malloc(events[i].length+1);
+                memcpy(object->materialLibFilename, events[i].name, events[i].length);
+                object->materialLibFilename[events[i].length] = '\0';
+                break;
+
+            case OBJ_EVENT_LIGHTPOS: memcpy(&object->lightPosition, events[i].value, sizeof(vec3_t));  object->settings |= OBJ_SETTING_LIGHTPOS; break;
+            case OBJ_EVENT_CAMPOS:   memcpy(&object->cameraPosition, events[i].value, sizeof(vec3_t)); object->settings |= OBJ_SETTING_CAMPOS;   break;
+            case OBJ_EVENT_CAMFRONT: memcpy(&object->cameraFront, events[i].value, sizeof(vec3_t));    object->settings |= OBJ_SETTING_CAMFRONT; break;
+            case OBJ_EVENT_CAMUP:    memcpy(&object->cameraUp, events[i].value, sizeof(vec3_t));       object->settings |= OBJ_SETTING_CAMUP;    break;
+            default: break;
+        }
+    }
+
+    return GL_TRUE;
+}
+
+
+GLboolean loadObjFileMapped(object_t *object, materialLib_t *materials, char *objFilename)
+{
+    objChunk_t chunks[MAX_PARSE_THREADS];
+    const char *data;
+    const char *split;
+    size_t size;
+    GLuint numOfChunks;
+    GLuint i;
+    GLboolean result = GL_TRUE;
+
+    /* Map object file */
+    data = mapFile(objFilename, &size);
+    if (data == NULL)
+    {
+       printf("Error opening OBJ file\n");
+       return GL_FALSE;
+    }
+
+    /* Small files are not worth splitting */
+    numOfChunks = (objParseThreads > 1) ? objParseThreads : 1;
+    while (numOfChunks > 1 && size / numOfChunks < MIN_PARSE_CHUNK_SIZE)
+    {
+        numOfChunks--;
+    }
+
+    /* Split the file into chunks that start and end on line boundaries */
+    for(i=0;i<numOfChunks;i++)
+    {
+        initObjChunk(&chunks[i]);
+        chunks[i].object = object;
+        chunks[i].start = (i == 0) ? data : chunks[i-1].end;
+        chunks[i].end = data + size;
+
+        if (i < numOfChunks - 1)
+        {
+            split = data + ((size / numOfChunks) * (i + 1));
+            split = (split < chunks[i].start) ? chunks[i].start : split;
+            split = (const char *)memchr(split, '\n', (data + size) - split);
+            chunks[i].end = (split == NULL) ? data + size : split + 1;
+        }
+    }
+
+    /* Parse the chunks in parallel, each into its own arrays */
+    if (numOfChunks > 1)
+    {
+        for(i=0;i<numOfChunks;i++)
+        {
+            threadPoolSubmit(threadPool, parseObjChunk, &chunks[i]);
+        }
+        threadPoolWait(threadPool);
+    }
+    else
+    {
+        parseObjChunk(&chunks[0]);
+    }
+
+    /* Work out where every chunk lands in the merged arrays */
+    for(i=0;i<numOfChunks;i++)
+    {
+        chunks[i].offset.v = object->v.count;
+        chunks[i].offset.vt = object->vt.count;
+        chunks[i].offset.vn = object->vn.count;
+        chunks[i].offset.f = object->f.count;
+
+        object->v.count += chunks[i].v.count;
+        object->vt.count += chunks[i].vt.count;
+        object->vn.count += chunks[i].vn.count;
+        object->f.count += chunks[i].f.count;
+    }
+
+    if (numOfChunks > 1)
+    {
+        arrayReserve(&object->v, object->v.count);
+        arrayReserve(&object->vt, object->vt.count);
+        arrayReserve(&object->vn, object->vn.count);
+        arrayReserve(&object->f, object->f.count);
+
+        /* Copy the chunks into place and rebase their relative indices */
+        for(i=0;i<numOfChunks;i++)
+        {
+            threadPoolSubmit(threadPool, mergeObjChunk, &chunks[i]);
+        }
+        threadPoolWait(threadPool);
+    }
+    else
+    {
+        /* A single chunk already is the object, take its arrays over */
+        takeChunkArray(&object->v, &chunks[0].v);
+        takeChunkArray(&object->vt, &chunks[0].vt);
+        takeChunkArray(&object->vn, &chunks[0].vn);
+        takeChunkArray(&object->f, &chunks[0].f);
+    }
+
+    /* Replay materials and settings in file order */
+    for(i=0;i<numOfChunks && result == GL_TRUE;i++)
+    {
+        result = applyObjEvents(object, materials, &chunks[i]);
+    }
+
+    for(i=0;i<numOfChunks;i++)
+    {
+        freeObjChunk(&chunks[i]);
+    }
+
+    finishObjectData(object);
+
+    unmapFile(data, size);
+
+    return result;
+}
+
+
+GLboolean loadObjFile(object_t *object, materialLib_t *materials, char *objFilename)
+{
+    if (objParser == OBJ_PARSER_STDIO)
+    {
+        return loadObjFileStdio(object, materials, objFilename);
+    }
+
+    return loadObjFileMapped(object, materials, objFilename);
+}
+
+
+GLboolean isMaterialBlended(const material_t *material)
+{
+    return (material->d != 1.0f) ? GL_TRUE : GL_FALSE;
+}
+
+
+GLboolean isSameTexture(const material_t *a, const material_t *b)
+{
+    /* Textures may not be loaded yet, so compare by file name until they are */
+    if (a->texId != 0 || b->texId != 0)
+    {
+        return (a->texId == b->texId) ? GL_TRUE : GL_FALSE;
+    }
+
+    /* File names are interned, the same name is the same pointer */
+    return (a->fileName == b->fileName) ? GL_TRUE : GL_FALSE;
+}
+
+
+GLboolean isSameMaterial(const material_t *a, const material_t *b)
+{
+    /* Materials packed into one atlas page read their parameters from its lookup texture */
+    return (a == b || (a->materialMapId != 0 && a->materialMapId == b->materialMapId)) ? GL_TRUE : GL_FALSE;
+}
+
+
+drawRuns_t getDrawRuns(object_t *object, GLuint level)
+{
+    drawRuns_t runs;
+    objectLod_t *lod;
+
+    /* Level 0 is the full mesh, the others are stored after it */
+    if (level == 0 || level > object->lods.count)
+    {
+        runs.changes = ARRAY_DATA(&object->materialChange, material_change_t);
+        runs.count = object->materialChange.count;
+        runs.endFace = object->numOfFaces;
+        runs.firstCluster = 0;
+        runs.numOfClusters = object->numOfClusters;
+        return runs;
+    }
+
+    lod = &ARRAY_DATA(&object->lods, objectLod_t)[level - 1];
+    runs.changes = ARRAY_DATA(&lod->materialChange, material_change_t);
+    runs.count = lod->materialChange.count;
+    runs.endFace = lod->endFace;
+    runs.firstCluster = lod->firstCluster;
+    runs.numOfClusters = lod->numOfClusters;
+
+    return runs;
+}
+
+
+GLuint getDrawEnd(const drawRuns_t *runs, materialLib_t *materials, GLuint *change)
+{
+    const material_change_t *changes = runs->changes;
+    const material_t *material = getMaterial(materials, changes[*change].material);
+    const material_t *next;
+
+    /* Runs of one atlas page and blend state draw as one, change is left on the last run */
+    while (*change + 1 < runs->count)
+    {
+        next = getMaterial(materials, changes[*change + 1].material);
+        if ( material->materialMapId == 0 || GL_FALSE == isSameMaterial(material, next) || isMaterialBlended(material) != isMaterialBlended(next) )
+        {
+            break;
+        }
+        (*change)++;
+    }
+
+    return (*change < runs->count - 1) ? changes[*change + 1].startFace : runs->endFace;
+}
+
+
+void getDrawStats(object_t *object, materialLib_t *materials, GLboolean skipRedundant, drawStats_t *stats)
+{
+    drawRuns_t runs = getDrawRuns(object, 0);
+    const material_change_t *changes = runs.changes;
+    const material_t *material;
+    const material_t *current = NULL;
+    GLint blended = -1;
+    GLuint i, startFace, endFace;
+
+    memset(stats, 0, sizeof(drawStats_t));
+
+    /* Replays drawVertices(), or every run setting all of its state when not skipping */
+    for(i=0;i<runs.count;i++)
+    {
+        startFace = changes[i].startFace;
+        material = getMaterial(materials, changes[i].material);
+
+        if ( GL_FALSE == skipRedundant )
+        {
+            stats->draws++;
+            stats->textureBinds++;
+            stats->materialUploads++;
+            stats->blendChanges++;
+            continue;
+        }
+
+        endFace = getDrawEnd(&runs, materials, &i);
+        if (endFace == startFace)
+        {
+            continue;
+        }
+
+        stats->textureBinds += (current == NULL || GL_FALSE == isSameTexture(material, current)) ? 1 : 0;
+        stats->materialUploads += (current == NULL || GL_FALSE == isSameMaterial(material, current)) ? 1 : 0;
+        stats->blendChanges += (blended != (GLint)isMaterialBlended(material)) ? 1 : 0;
+        stats->draws++;
+
+        current = material;
+        blended = isMaterialBlended(material);
+    }
+}
+
+
+void applyMaterial(const material_t *material)
+{
+    /* An atlased material only needs its page's lookup texture */
+    if (material->materialMapId != 0)
+    {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, material->materialMapId);
+        glActiveTexture(GL_TEXTURE0);
+        glUniform1f(uMaterialMapMixLoc, 1.0f);
+        return;
+    }
+
+    glUniform3fv(uKaLoc, 1, (GLfloat *)&material->Ka);
+    glUniform3fv(uKdLoc, 1, (GLfloat *)&material->Kd);
+    glUniform3fv(uKsLoc, 1, (GLfloat *)&material->Ks);
+    glUniform1f(uDLoc, material->d);
+
+    if (uMaterialMapMixLoc != -1)
+    {
+        glUniform1f(uMaterialMapMixLoc, 0.0f);
+    }
+}
+
+
+void cullObjectClusters(object_t *object, const drawRuns_t *runs)
+{
+    const meshCluster_t *cluster;
+    GLfloat planes[6][4];
+    GLfloat camera[3], toCluster[3];
+    GLfloat distance, length;
+    GLuint i, j, k;
+    GLboolean outside;
+
+    /* Frustum planes in model space straight from the rows of the MVP */
+    for(i=0;i<3;i++)
+    {
+        for(k=0;k<4;k++)
+        {
+            planes[i*2][k] = modelViewProjMatrix[12+k] + modelViewProjMatrix[i*4+k];
+            planes[i*2+1][k] = modelViewProjMatrix[12+k] - modelViewProjMatrix[i*4+k];
+        }
+    }
+
+    getCameraPosition(modelViewMatrix, camera);
+
+    for(i=runs->firstCluster;i<runs->firstCluster+runs->numOfClusters;i++)
+    {
+        cluster = &ARRAY_DATA(&object->clusters, meshCluster_t)[i];
+        outside = GL_FALSE;
+
+        for(j=0;j<6 && GL_FALSE == outside;j++)
+        {
+            distance = (planes[j][0] * cluster->center[0]) + (planes[j][1] * cluster->center[1]) + (planes[j][2] * cluster->center[2]) + planes[j][3];
+            length = sqrtf((planes[j][0] * planes[j][0]) + (planes[j][1] * planes[j][1]) + (planes[j][2] * planes[j][2]));
+            outside = (distance < -cluster->radius * length) ? GL_TRUE : GL_FALSE;
+        }
+
+        object->clusterVisible[i] = 0;
+        cullStats.clusters++;
+        cullStats.triangles += cluster->indexCount / ELEMENTS_PER_FACE;
+
+        if ( GL_TRUE == outside )
+        {
+            cullStats.frustumCulled++;
+            cullStats.trianglesCulled += cluster->indexCount / ELEMENTS_PER_FACE;
+            continue;
+        }
+
+        /* Back facing when the camera is outside the cone's mirror around the whole sphere */
+        toCluster[0] = cluster->center[0] - camera[0];
+        toCluster[1] = cluster->center[1] - camera[1];
+        toCluster[2] = cluster->center[2] - camera[2];
+        length = sqrtf((toCluster[0] * toCluster[0]) + (toCluster[1] * toCluster[1]) + (toCluster[2] * toCluster[2]));
+
+        if ((toCluster[0] * cluster->axis[0]) + (toCluster[1] * cluster->axis[1]) + (toCluster[2] * cluster->axis[2]) >= (cluster->cutoff * length) + cluster->radius)
+        {
+            cullStats.backfaceCulled++;
+            cullStats.trianglesCulled += cluster->indexCount / ELEMENTS_PER_FACE;
+            continue;
+        }
+
+        object->clusterVisible[i] = 1;
+    }
+}
+
+
+GLuint getVisibleRanges(object_t *object, GLuint *cluster, GLuint clusterEnd, GLuint startFace, GLuint endFace)
+{
+    const meshCluster_t *clusters = ARRAY_DATA(&object->clusters, meshCluster_t);
+    GLuint numOfRanges = 0;
+    GLuint last = 0;
+
+    /* Clusters are in index order, neighbors that are both visible share one range */
+    for(;*cluster<clusterEnd && clusters[*cluster].firstIndex<endFace*ELEMENTS_PER_FACE;(*cluster)++)
+    {
+        if (clusters[*cluster].firstIndex < startFace*ELEMENTS_PER_FACE || 0 == object->clusterVisible[*cluster])
+        {
+            continue;
+        }
+
+        if (numOfRanges != 0 && last == clusters[*cluster].firstIndex)
+        {
+            object->drawCounts[numOfRanges-1] += clusters[*cluster].indexCount;
+        }
+        else
+        {
+            object->drawCounts[numOfRanges] = clusters[*cluster].indexCount;
+            object->drawOffsets[numOfRanges] = BUFFER_OFFSET(clusters[*cluster].firstIndex*object->indexSize);
+            numOfRanges++;
+        }
+
+        last = clusters[*cluster].firstIndex + clusters[*cluster].indexCount;
+    }
+
+    return numOfRanges;
+}
+
+
+void drawRanges(object_t *object, GLuint numOfRanges)
+{
+    GLuint i;
+
+    if (multiDrawElementsEXT != NULL)
+    {
+        multiDrawElementsEXT(GL_TRIANGLES, object->drawCounts, object->indexType, object->drawOffsets, numOfRanges);
+        return;
+    }
+
+    for(i=0;i<numOfRanges;i++)
+    {
+        glDrawElements(GL_TRIANGLES, object->drawCounts[i], object->indexType, object->drawOffsets[i]);
+    }
+}
+
+
+void drawVertices(object_t *object, materialLib_t *materials)
+{
+    drawRuns_t runs = getDrawRuns(object, object->lodLevel);
+    const material_change_t *changes = runs.changes;
+    GLuint i;
+    GLuint cluster = runs.firstCluster;
+    GLuint numOfRanges = 0;
+    GLuint faceCount;
+    GLuint startFace;
+    material_t *material;
+    material_t *current = NULL;
+    GLint blended = -1;
+
+    /* The VAO holds all of the attribute and index buffer state */
+    if (vaoId != 0)
+    {
+        bindVertexArrayOES(vaoId);
+    }
+
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    if (runs.numOfClusters != 0)
+    {
+        cullObjectClusters(object, &runs);
+        cullStats.frames++;
+    }
+    
+    for(i=0;i<runs.count;i++)
+    {
+        startFace = changes[i].startFace;
+        material = getMaterial(materials, changes[i].material);
+
+        /* Calculate the face count up to the last run drawn with this one */
+        faceCount = getDrawEnd(&runs, materials, &i) - startFace;
+
+        /* With clusters only the visible ones of the range are drawn */
+        if (runs.numOfClusters != 0)
+        {
+            numOfRanges = getVisibleRanges(object, &cluster, runs.firstCluster + runs.numOfClusters, startFace, startFace + faceCount);
+            faceCount = (numOfRanges != 0) ? faceCount : 0;
+        }
+
+        if (faceCount == 0)
+        {
+            continue;
+        }
+
+        /* Only touch the state that differs from the previous run */
+        if ( current == NULL || material->texId != current->texId )
+        {
+            glBindTexture(GL_TEXTURE_2D, (material->texId != 0) ? material->texId : untexturedTexId);
+        }
+
+        if ( current == NULL || GL_FALSE == isSameMaterial(material, current) )
+        {
+            /* Apply material parameters */
+            applyMaterial(material);
+        }
+
+        /* Check dissolve factor */
+        if ( blended != (GLint)isMaterialBlended(material) )
+        {
+            blended = isMaterialBlended(material);
+            (GL_TRUE == blended) ? glEnable(GL_BLEND) : glDisable(GL_BLEND);
+        }
+
+        current = material;
+
+        /* Draw faces */
+        if (runs.numOfClusters != 0)
+        {
+            drawRanges(object, numOfRanges);
+            cullStats.draws += (multiDrawElementsEXT != NULL) ? 1 : numOfRanges;
+            continue;
+        }
+
+        glDrawElements(GL_TRIANGLES, faceCount*ELEMENTS_PER_FACE, object->indexType,
+                       BUFFER_OFFSET(startFace*ELEMENTS_PER_FACE*object->indexSize));
+    }
+}
+
+
+void copyIndexedElement(GLfloat *dest, GLfloat *src, GLuint index, GLuint numOfElements, GLuint size)
+{
+    GLuint i;
+
+    /* OBJ indices are one based, zero marks an element missing from the face */
+    for(i=0;i<size;i++)
+    {
+        dest[i] = (index != 0 && index <= numOfElements) ? src[((index-1)*size)+i] : 0.0f;
+    }
+}
+
+
+GLuint hashCorner(const GLuint *corner)
+{
+    /* Mix the v/vt/vn indices together, the table size is a power of two */
+    GLuint hash = corner[0] * 0x9E3779B1u;
+
+    hash = (hash ^ corner[1]) * 0x85EBCA77u;
+    hash = (hash ^ corner[2]) * 0xC2B2AE3Du;
+
+    return hash ^ (hash >> 16);
+}
+
+
+void printVertexStats(object_t *object)
+{
+    GLuint numOfCorners = object->numOfFaces * ELEMENTS_PER_FACE;
+    GLuint vertexSize = sizeof(GLfloat) * (ELEMENTS_PER_VERTEX + ELEMENTS_PER_TEXCOORDS + ELEMENTS_PER_VERTEX);
+    GLuint arrayBytes = numOfCorners * vertexSize;
+    GLuint indexedBytes = (object->numOfUniqueVertices * vertexSize) + (numOfCorners * object->indexSize);
+
+    printf("\tunique vertices: %d of %d face corners\n", object->numOfUniqueVertices, numOfCorners);
+    printf("\tVBO memory: %.1f KB -> %.1f KB with %d-bit indices (%.1f%% saved)\n",
+           arrayBytes / 1024.0f, indexedBytes / 1024.0f, object->indexSize * 8,
+           (numOfCorners != 0) ? 100.0f * (1.0f - ((GLfloat)indexedBytes / arrayBytes)) : 0.0f);
+
+    /* Indexed vertices are shaded once while they stay in the post-transform cache */
+    printf("\tvertex shader invocations: %d -> %d at best (%.1f%% saved)\n",
+           numOfCorners, object->numOfUniqueVertices,
+           (numOfCorners != 0) ? 100.0f * (1.0f - ((GLfloat)object->numOfUniqueVertices / numOfCorners)) : 0.0f);
+}
+
+
+void optimizeObjectIndices(object_t *object, GLuint *indices, GLuint *firstCorner)
+{
+    const material_change_t *changes = ARRAY_DATA(&object->materialChange, material_change_t);
+    GLuint i, endFace;
+    GLuint startFace = 0;
+    GLuint numOfIndices = object->numOfFaces * ELEMENTS_PER_FACE;
+    GLuint *optimized;
+    GLuint *remap;
+    GLuint *remappedCorner;
+    GLuint *localIndex;
+    GLuint *globalIndex;
+    GLuint j, localCount, rangeStart, rangeCount;
+    meshCacheStats_t before, after;
+
+    before = meshAnalyzeVertexCache(indices, numOfIndices, object->numOfUniqueVertices, MESH_VERTEX_CACHE_SIZE);
+
+    optimized = (GLuint *)malloc(sizeof(GLuint)*(numOfIndices + 1));
+    globalIndex = (GLuint *)malloc(sizeof(GLuint)*(numOfIndices + 1));
+    localIndex = (GLuint *)malloc(sizeof(GLuint)*(object->numOfUniqueVertices + 1));
+    memset(localIndex, 0xFF, sizeof(GLuint)*object->numOfUniqueVertices);
+
+    /* Triangles only move inside their material range so the draw ranges stay valid */
+    for(i=0;i<=object->materialChange.count;i++)
+    {
+        endFace = (i < object->materialChange.count) ? changes[i].startFace : object->numOfFaces;
+
+        if (endFace > startFace)
+        {
+            rangeStart = startFace*ELEMENTS_PER_FACE;
+            rangeCount = (endFace - startFace)*ELEMENTS_PER_FACE;
+            localCount = 0;
+
+            /* Number the range's vertices from zero, the optimizer is linear in the vertex count */
+            for(j=rangeStart;j<rangeStart+rangeCount;j++)
+            {
+                if (localIndex[indices[j]] == DEDUP_EMPTY_SLOT)
+                {
+                    localIndex[indices[j]] = localCount;
+                    globalIndex[localCount++] = indices[j];
+                }
+                indices[j] = localIndex[indices[j]];
+            }
+
+            meshOptimizeVertexCache(&optimized[rangeStart], &indices[rangeStart], rangeCount, localCount, MESH_VERTEX_CACHE_SIZE);
+
+            for(j=rangeStart;j<rangeStart+rangeCount;j++)
+            {
+                indices[j] = globalIndex[optimized[j]];
+            }
+
+            for(j=0;j<localCount;j++)
+            {
+                localIndex[globalIndex[j]] = DEDUP_EMPTY_SLOT;
+            }
+
+            startFace = endFace;
+        }
+    }
+
+    free(optimized);
+    free(globalIndex);
+    free(localIndex);
+
+    /* Number the vertices in the order the triangles now use them */
+    remap = (GLuint *)malloc(sizeof(GLuint)*object->numOfUniqueVertices);
+    remappedCorner = (GLuint *)malloc(sizeof(GLuint)*object->numOfUniqueVertices);
+
+    meshOptimizeVertexFetchRemap(remap, indices, numOfIndices, object->numOfUniqueVertices);
+    meshRemapIndices(indices, numOfIndices, remap);
+
+    for(i=0;i<object->numOfUniqueVertices;i++)
+    {
+        remappedCorner[remap[i]] = firstCorner[i];
+    }
+    memcpy(firstCorner, remappedCorner, sizeof(GLuint)*object->numOfUniqueVertices);
+
+    free(remap);
+    free(remappedCorner);
+
+    after = meshAnalyzeVertexCache(indices, numOfIndices, object->numOfUniqueVertices, MESH_VERTEX_CACHE_SIZE);
+
+    printf("\tvertex cache (%d entry FIFO): ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+           MESH_VERTEX_CACHE_SIZE, before.acmr, after.acmr, before.atvr, after.atvr);
+}
+
+
+void batchObjectMaterials(object_t *object, materialLib_t *materials)
+{
+    material_change_t *changes = ARRAY_DATA(&object->materialChange, material_change_t);
+    GLuint numOfChanges = object->materialChange.count;
+    GLuint numOfMaterials = materials->materials.count;
+    GLuint numOfOrdered = 0;
+    GLuint pass, i, endFace, faceCount, firstFace;
+    GLuint *faces = ARRAY_DATA(&object->f, GLuint);
+    GLuint *order;
+    GLuint *rank;
+    GLuint *rankStart;
+    GLuint *sorted;
+    drawStats_t before, after;
+
+    if (numOfChanges == 0)
+    {
+        return;
+    }
+
+    getDrawStats(object, materials, GL_FALSE, &before);
+
+    order = (GLuint *)malloc(sizeof(GLuint)*numOfMaterials);
+    rank = (GLuint *)malloc(sizeof(GLuint)*numOfMaterials);
+    rankStart = (GLuint *)calloc(numOfMaterials + 1, sizeof(GLuint));
+    sorted = (GLuint *)malloc(sizeof(GLuint)*object->f.count);
+
+    memset(rank, 0xFF, sizeof(GLuint)*numOfMaterials);
+
+    /* Opaque materials first, then blended ones, each kept in order of first use */
+    for(pass=0;pass<2;pass++)
+    {
+        for(i=0;i<numOfChanges;i++)
+        {
+            if ( rank[changes[i].material] == MATERIAL_NONE &&
+                 isMaterialBlended(getMaterial(materials, changes[i].material)) == (GLboolean)pass )
+            {
+                rank[changes[i].material] = numOfOrdered;
+                order[numOfOrdered++] = changes[i].material;
+            }
+        }
+    }
+
+    /* Count the faces of each material, the prefix sum is where its range starts */
+    for(i=0;i<numOfChanges;i++)
+    {
+        endFace = (i < numOfChanges - 1) ? changes[i+1].startFace : object->numOfFaces;
+        rankStart[rank[changes[i].material] + 1] += endFace - changes[i].startFace;
+    }
+
+    /* Faces ahead of the first usemtl are not drawn, they stay in front */
+    firstFace = changes[0].startFace;
+    rankStart[0] = firstFace;
+    for(i=0;i<numOfOrdered;i++)
+    {
+        rankStart[i+1] += rankStart[i];
+    }
+
+    memcpy(sorted, faces, sizeof(GLuint)*firstFace*INDICES_PER_FACE);
+
+    /* Move every run into its material's range, one pass over the faces */
+    for(i=0;i<numOfChanges;i++)
+    {
+        endFace = (i < numOfChanges - 1) ? changes[i+1].startFace : object->numOfFaces;
+        faceCount = endFace - changes[i].startFace;
+
+        memcpy(&sorted[rankStart[rank[changes[i].material]]*INDICES_PER_FACE], &faces[changes[i].startFace*INDICES_PER_FACE],
+               sizeof(GLuint)*faceCount*INDICES_PER_FACE);
+        rankStart[rank[changes[i].material]] += faceCount;
+    }
+
+    memcpy(faces, sorted, sizeof(GLuint)*object->f.count);
+
+    /* Each start was advanced to the next one, so the range is [start - count, start) */
+    object->materialChange.count = 0;
+    for(i=0;i<numOfOrdered;i++)
+    {
+        endFace = rankStart[i];
+        faceCount = endFace - ((i == 0) ? firstFace : rankStart[i-1]);
+
+        if (faceCount != 0)
+        {
+            changes[object->materialChange.count].startFace = endFace - faceCount;
+            changes[object->materialChange.count].material = order[i];
+            object->materialChange.count++;
+        }
+    }
+
+    free(order);
+    free(rank);
+    free(rankStart);
+    free(sorted);
+
+    getDrawStats(object, materials, GL_TRUE, &after);
+
+    printf("\tdraw calls per frame: %d -> %d, texture binds %d -> %d, material uploads %d -> %d, blend changes %d -> %d\n",
+           before.draws, after.draws, before.textureBinds, after.textureBinds,
+           before.materialUploads, after.materialUploads, before.blendChanges, after.blendChanges);
+}
+
+
+void generateObjectNormals(object_t *object)
+{
+    GLuint i;
+    GLuint numOfCorners = object->numOfFaces * ELEMENTS_PER_FACE;
+    GLuint numOfPositions = object->numOfVertices;
+    GLuint numOfNormals;
+    GLuint *faces = ARRAY_DATA(&object->f, GLuint);
+    GLuint *indices;
+    GLuint *normalIndices;
+    GLfloat *positions = ARRAY_DATA(&object->v, GLfloat);
+    GLfloat *padded = NULL;
+    GLboolean valid = GL_TRUE;
+    double start = getTimeMs();
+
+    indices = (GLuint *)malloc(sizeof(GLuint)*numOfCorners);
+    normalIndices = (GLuint *)malloc(sizeof(GLuint)*numOfCorners);
+
+    for(i=0;i<numOfCorners;i++)
+    {
+        indices[i] = faces[i*ELEMENTS_PER_CORNER] - 1;
+        valid = (faces[i*ELEMENTS_PER_CORNER] != 0 && faces[i*ELEMENTS_PER_CORNER] <= object->numOfVertices) ? valid : GL_FALSE;
+    }
+
+    /* Out of range corners get a zero position of their own, like copyIndexedElement() gives them */
+    if ( GL_FALSE == valid )
+    {
+        numOfPositions = object->numOfVertices + 1;
+        padded = (GLfloat *)calloc(numOfPositions*ELEMENTS_PER_VERTEX, sizeof(GLfloat));
+        memcpy(padded, positions, sizeof(GLfloat)*object->numOfVertices*ELEMENTS_PER_VERTEX);
+        positions = padded;
+
+        for(i=0;i<numOfCorners;i++)
+        {
+            indices[i] = (faces[i*ELEMENTS_PER_CORNER] != 0 && faces[i*ELEMENTS_PER_CORNER] <= object->numOfVertices) ? indices[i] : object->numOfVertices;
+        }
+    }
+
+    /* Hard edges can give every corner its own normal, otherwise there is one per position */
+    arrayFree(&object->vn);
+    arrayInit(&object->vn, sizeof(GLfloat));
+    arrayReserve(&object->vn, ((creaseAngle < MESH_NORMAL_NO_CREASE) ? numOfCorners : numOfPositions)*ELEMENTS_PER_VERTEX);
+
+    numOfNormals = meshGenerateNormals(ARRAY_DATA(&object->vn, GLfloat), normalIndices, positions, numOfPositions,
+                                       indices, numOfCorners, normalWeighting, creaseAngle, threadPool);
+
+    object->vn.count = numOfNormals*ELEMENTS_PER_VERTEX;
+    arrayShrink(&object->vn);
+
+    for(i=0;i<numOfCorners;i++)
+    {
+        faces[(i*ELEMENTS_PER_CORNER)+2] = normalIndices[i] + 1;
+    }
+
+    object->numOfNormals = numOfNormals;
+    object->generatedNormals = GL_TRUE;
+
+    free(padded);
+    free(indices);
+    free(normalIndices);
+
+    printf("\tgenerated %d %s weighted normals", numOfNormals, (normalWeighting == MESH_NORMAL_WEIGHT_AREA) ? "area" : "angle");
+    if (creaseAngle < MESH_NORMAL_NO_CREASE)
+    {
+        printf(", hard edges above %.1f degrees", creaseAngle);
+    }
+    printf(" in %.2f ms\n", getTimeMs() - start);
+}
+
+
+void prepareObjectArrays(object_t *object, materialLib_t *materials)
+{
+    GLuint i, slot, mask;
+    GLuint tableSize;
+    GLuint numOfCorners = object->numOfFaces * ELEMENTS_PER_FACE;
+    GLuint *corner;
+    GLuint *table;
+    GLuint *firstCorner;
+    GLuint *indices;
+    GLushort *shortIndices;
+    GLuint *faces;
+    GLfloat *verts;
+    GLfloat *texCoords;
+    GLfloat *normals;
+
+    /* One draw per material, opaque ones ahead of blended ones */
+    batchObjectMaterials(object, materials);
+
+    /* Without vn lines every normal would be zero, compute them from the faces */
+    if (object->numOfNormals == 0 && numOfCorners != 0)
+    {
+        generateObjectNormals(object);
+    }
+
+    /* Assign pointers to input values */
+    faces = ARRAY_DATA(&object->f, GLuint);
+    verts = ARRAY_DATA(&object->v, GLfloat);
+    texCoords = ARRAY_DATA(&object->vt, GLfloat);
+    normals = ARRAY_DATA(&object->vn, GLfloat);
+
+    /* Open addressed table at most half full, slots hold unique vertex numbers */
+    for(tableSize=1;tableSize<numOfCorners*2;tableSize*=2);
+    mask = tableSize - 1;
+
+    table = (GLuint *)malloc(sizeof(GLuint)*tableSize);
+    memset(table, 0xFF, sizeof(GLuint)*tableSize);
+
+    firstCorner = (GLuint *)malloc(sizeof(GLuint)*numOfCorners);
+    indices = (GLuint *)malloc(sizeof(GLuint)*numOfCorners);
+
+    object->numOfUniqueVertices = 0;
+
+    /* Give every distinct v/vt/vn triple a single vertex */
+    for(i=0;i<numOfCorners;i++)
+    {
+        corner = &faces[i*ELEMENTS_PER_CORNER];
+
+        for(slot=hashCorner(corner)&mask; table[slot] != DEDUP_EMPTY_SLOT; slot=(slot+1)&mask)
+        {
+            if ( 0 == memcmp(&faces[firstCorner[table[slot]]*ELEMENTS_PER_CORNER], corner, sizeof(GLuint)*ELEMENTS_PER_CORNER) )
+            {
+                break;
+            }
+        }
+
+        if (table[slot] == DEDUP_EMPTY_SLOT)
+        {
+            table[slot] = object->numOfUniqueVertices;
+            firstCorner[object->numOfUniqueVertices++] = i;
+        }
+
+        indices[i] = table[slot];
+    }
+
+    free(table);
+
+    /* Reorder triangles for the post-transform cache and vertices for fetch */
+    optimizeObjectIndices(object, indices, firstCorner);
+
+    /* Create vertex, texture and normal buffers for the unique vertices */
+    object->vertArray = (GLfloat *)malloc(sizeof(GLfloat)*object->numOfUniqueVertices*ELEMENTS_PER_VERTEX);
+    object->texArray = (GLfloat *)malloc(sizeof(GLfloat)*object->numOfUniqueVertices*ELEMENTS_PER_TEXCOORDS);
+    object->normArray = (GLfloat *)malloc(sizeof(GLfloat)*object->numOfUniqueVertices*ELEMENTS_PER_VERTEX);
+
+    for(i=0;i<object->numOfUniqueVertices;i++)
+    {
+        /* Each face corner holds a v/vt/vn index triple */
+        corner = &faces[firstCorner[i]*ELEMENTS_PER_CORNER];
+
+        copyIndexedElement(&object->vertArray[i*ELEMENTS_PER_VERTEX], verts, corner[0], object->numOfVertices, ELEMENTS_PER_VERTEX);
+        copyIndexedElement(&object->texArray[i*ELEMENTS_PER_TEXCOORDS], texCoords, corner[1], object->numOfTexCoords, ELEMENTS_PER_TEXCOORDS);
+        copyIndexedElement(&object->normArray[i*ELEMENTS_PER_VERTEX], normals, corner[2], object->numOfNormals, ELEMENTS_PER_VERTEX);
+    }
+
+    free(firstCorner);
+
+    /* Use 16-bit indices whenever the vertex count allows it, prepareVbos() refuses 32-bit ones without ES3 or OES_element_index_uint */
+    if (object->numOfUniqueVertices <= MAX_SHORT_INDEX_VERTICES)
+    {
+        shortIndices = (GLushort *)indices;
+        for(i=0;i<numOfCorners;i++)
+        {
+            shortIndices[i] = (GLushort)indices[i];
+        }
+
+        object->indexArray = indices;
+        object->indexType = GL_UNSIGNED_SHORT;
+        object->indexSize = sizeof(GLushort);
+    }
+    else
+    {
+        object->indexArray = indices;
+        object->indexType = GL_UNSIGNED_INT;
+        object->indexSize = sizeof(GLuint);
+    }
+}
+
+
+void releaseTextures(materialLib_t *materials)
+{
+    material_t *material;
+    GLuint i, j;
+
+    for(i=0;i<materials->materials.count;i++)
+    {
+        material = getMaterial(materials, i);
+
+        /* Atlas pages and their lookups are the model's own, deleted with the first material on them */
+        if (material->materialMapId != 0)
+        {
+            for(j=0;j<i && getMaterial(materials, j)->materialMapId != material->materialMapId;j++);
+            if (j == i)
+            {
+                glDeleteTextures(1, &material->texId);
+                glDeleteTextures(1, &material->materialMapId);
+            }
+        }
+        else
+        {
+            texCacheRelease(&textureCache, material->texId);
+        }
+    }
+
+    for(i=0;i<materials->materials.count;i++)
+    {
+        getMaterial(materials, i)->texId = 0;
+        getMaterial(materials, i)->materialMapId = 0;
+    }
+}
+
+
+void printTextureCacheStats(void)
+{
+    printf("Texture cache: %u hits, %u misses, %.2f MB resident, %.2f MB VRAM saved\n", textureCache.hits, textureCache.misses,
+           texCacheGetResidentSize(&textureCache) / (1024.0 * 1024.0), textureCache.savedSize / (1024.0 * 1024.0));
+}
+
+
+void freeObjectClusters(object_t *object)
+{
+    GLuint i;
+
+    arrayFree(&object->clusters);
+    object->numOfClusters = 0;
+
+    for(i=0;i<object->lods.count;i++)
+    {
+        ARRAY_DATA(&object->lods, objectLod_t)[i].numOfClusters = 0;
+    }
+
+    free(object->clusterVisible);
+    free(object->drawCounts);
+    free((void *)object->drawOffsets);
+    object->clusterVisible = NULL;
+    object->drawCounts = NULL;
+    object->drawOffsets = NULL;
+}
+
+
+void freeObject(object_t *object, materialLib_t *materials)
+{
+    GLuint i;
+
+    freeMaterialLib(materials);
+
+    if( object->materialLibFilename != NULL )
+    {
+        free(object->materialLibFilename);
+    }
+
+    /* Arrays loaded from the mesh cache point into the mapping */
+    if( object->cacheData != NULL )
+    {
+        cacheUnmapFile(object->cacheData, object->cacheSize);
+        object->vertArray = NULL;
+        object->texArray = NULL;
+        object->normArray = NULL;
+        object->indexArray = NULL;
+    }
+
+    if( object->vertArray != NULL )
+    {
+        free(object->vertArray);
+    }
+
+    if( object->texArray != NULL )
+    {
+        free(object->texArray);
+    }
+
+    if( object->normArray != NULL )
+    {
+        free(object->normArray);
+    }
+
+    if( object->indexArray != NULL )
+    {
+        free(object->indexArray);
+    }
+
+    arrayFree(&object->v);
+    arrayFree(&object->vt);
+    arrayFree(&object->vn);
+    arrayFree(&object->f);
+    arrayFree(&object->materialChange);
+
+    for(i=0;i<object->lods.count;i++)
+    {
+        arrayFree(&ARRAY_DATA(&object->lods, objectLod_t)[i].materialChange);
+    }
+
+    freeObjectClusters(object);
+
+    arrayFree(&object->lods);
+    arrayFree(&object->lodIndices);
+    bvhFree(&object->bvh);
+}
+
+
+void cleanUp(object_t *object, materialLib_t *materials)
+{
+    glDisableVertexAttribArray(aVertexLoc);
+    glDisableVertexAttribArray(aNormalLoc);
+    glDisableVertexAttribArray(aTexCoordsLoc);
+
+    releaseTextures(materials);
+    freeObject(object, materials);
+}
+
+
+char* getPath(char *string)
+{
+    char *path = NULL;
+    GLint position = strlen(string);    
+
+    while(position != 0 && string[--position] != '/');
+
+    path = (char *)malloc(position+2);
+    memset(path, 0, position+2);
+    strncpy(path, string, position+1);
+
+    return path;
+}
+
+
+GLuint appendCacheSection(array_t *buffer, const void *data, size_t size)
+{
+    GLuint offset = CACHE_ALIGN(buffer->count);
+
+    /* Zero the alignment padding so identical meshes give identical files */
+    memset(arrayAppend(buffer, NULL, offset - buffer->count), 0, offset - buffer->count);
+    arrayAppend(buffer, data, size);
+
+    return offset;
+}
+
+
+GLuint appendCacheString(array_t *strings, const char *string)
+{
+    GLuint offset = strings->count;
+
+    if (string == NULL)
+    {
+        return MESH_CACHE_NO_STRING;
+    }
+
+    arrayAppend(strings, string, strlen(string) + 1);
+
+    return offset;
+}
+
+
+GLboolean saveMeshCache(object_t *object, materialLib_t *materials, char *cacheFileName, char *objFileName, char *mtlFileName)
+{
+    meshCacheHeader_t header;
+    const material_change_t *changes = ARRAY_DATA(&object->materialChange, material_change_t);
+    const material_t *material;
+    meshCacheMaterial_t *cacheMaterials;
+    meshCacheChange_t *cacheChanges;
+    array_t buffer;
+    array_t strings;
+    GLuint i;
+    GLboolean result;
+
+    memset(&header, 0, sizeof(header));
+
+    /* A model without a material library leaves the MTL key zeroed */
+    if ( GL_FALSE == cacheMakeKey(objFileName, &header.objKey) ||
+         (mtlFileName != NULL && GL_FALSE == cacheMakeKey(mtlFileName, &header.mtlKey)) )
+    {
+        return GL_FALSE;
+    }
+
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+
+    header.numOfVertices = object->numOfVertices;
+    header.numOfTexCoords = object->numOfTexCoords;
+    header.numOfNormals = object->numOfNormals;
+    header.numOfFaces = object->numOfFaces;
+    header.numOfUniqueVertices = object->numOfUniqueVertices;
+    header.indexSize = object->indexSize;
+    header.materialCount = materials->materials.count;
+    header.materialChangeCount = object->materialChange.count;
+
+    header.generatedNormals = object->generatedNormals;
+    header.normalWeighting = normalWeighting;
+    header.creaseAngle = creaseAngle;
+
+    header.settings = object->settings;
+    header.lightPosition = object->lightPosition;
+    header.cameraPosition = object->cameraPosition;
+    header.cameraFront = object->cameraFront;
+    header.cameraUp = object->cameraUp;
+
+    /* Material names and texture file names go to a shared string table */
+    arrayInit(&strings, sizeof(char));
+    header.materialLibOffset = appendCacheString(&strings, object->materialLibFilename);
+
+    cacheMaterials = (meshCacheMaterial_t *)calloc(header.materialCount + 1, sizeof(meshCacheMaterial_t));
+    cacheChanges = (meshCacheChange_t *)calloc(header.materialChangeCount + 1, sizeof(meshCacheChange_t));
+
+    for(i=0;i<header.materialCount;i++)
+    {
+        material = getMaterial(materials, i);
+        cacheMaterials[i].nameOffset = appendCacheString(&strings, material->name);
+        cacheMaterials[i].fileNameOffset = appendCacheString(&strings, material->fileName);
+        cacheMaterials[i].Ns = material->Ns;
+        cacheMaterials[i].Ka = material->Ka;
+        cacheMaterials[i].Kd = material->Kd;
+        cacheMaterials[i].Ks = material->Ks;
+        cacheMaterials[i].Ni = material->Ni;
+        cacheMaterials[i].d = material->d;
+        cacheMaterials[i].illum = material->illum;
+    }
+
+    for(i=0;i<header.materialChangeCount;i++)
+    {
+        cacheChanges[i].startFace = changes[i].startFace;
+        cacheChanges[i].material = changes[i].material;
+    }
+
+    /* Header first, the sections follow in the order they are uploaded */
+    arrayInit(&buffer, sizeof(GLubyte));
+    arrayAppend(&buffer, &header, sizeof(header));
+
+    header.vertOffset = appendCacheSection(&buffer, object->vertArray, sizeof(GLfloat)*object->numOfUniqueVertices*ELEMENTS_PER_VERTEX);
+    header.texOffset = appendCacheSection(&buffer, object->texArray, sizeof(GLfloat)*object->numOfUniqueVertices*ELEMENTS_PER_TEXCOORDS);
+    header.normOffset = appendCacheSection(&buffer, object->normArray, sizeof(GLfloat)*object->numOfUniqueVertices*ELEMENTS_PER_VERTEX);
+    header.indexOffset = appendCacheSection(&buffer, object->indexArray, object->indexSize*object->numOfFaces*ELEMENTS_PER_FACE);
+    header.materialOffset = appendCacheSection(&buffer, cacheMaterials, sizeof(meshCacheMaterial_t)*header.materialCount);
+    header.materialChangeOffset = appendCacheSection(&buffer, cacheChanges, sizeof(meshCacheChange_t)*header.materialChangeCount);
+    header.stringOffset = appendCacheSection(&buffer, strings.data, strings.count);
+    header.stringSize = strings.count;
+
+    memcpy(buffer.data, &header, sizeof(header));
+
+    result = cacheWriteFile(cacheFileName, buffer.data, buffer.count);
+
+    free(cacheMaterials);
+    free(cacheChanges);
+    arrayFree(&strings);
+    arrayFree(&buffer);
+
+    return result;
+}
+
+
+const char *getCacheString(const meshCacheHeader_t *header, GLuint offset)
+{
+    const char *strings = (const char *)header + header->stringOffset;
+
+    /* Strings must be terminated inside the string table */
+    if (offset >= header->stringSize || memchr(&strings[offset], '\0', header->stringSize - offset) == NULL)
+    {
+        return NULL;
+    }
+
+    return &strings[offset];
+}
+
+
+char *copyCacheString(const meshCacheHeader_t *header, GLuint offset)
+{
+    const char *string = getCacheString(header, offset);
+    char *copy;
+
+    if (string == NULL)
+    {
+        return NULL;
+    }
+
+    copy = (char *)malloc(strlen(string) + 1);
+    strcpy(copy, string);
+
+    return copy;
+}
+
+
+GLboolean checkCacheSection(size_t cacheSize, GLuint offset, size_t size)
+{
+    return (offset % CACHE_ALIGNMENT == 0 && offset <= cacheSize && size <= cacheSize - offset) ? GL_TRUE : GL_FALSE;
+}
+
+
+GLboolean validateMeshCache(const meshCacheHeader_t *header, size_t cacheSize, char *objFileName, char *path)
+{
+    const meshCacheChange_t *changes;
+    const meshCacheMaterial_t *cacheMaterials;
+    const GLubyte *indices;
+    const char *mtlName;
+    char *mtlFile;
+    GLuint i, index, maxIndex = 0;
+    GLboolean result;
+
+    if ( cacheSize < sizeof(meshCacheHeader_t) ||
+         header->magic != MESH_CACHE_MAGIC || header->version != MESH_CACHE_VERSION ||
+         (header->indexSize != sizeof(GLushort) && header->indexSize != sizeof(GLuint)) )
+    {
+        return GL_FALSE;
+    }
+
+    /* Generated normals have to match the current options */
+    if ( header->generatedNormals != 0 && (header->normalWeighting != normalWeighting || header->creaseAngle != creaseAngle) )
+    {
+        return GL_FALSE;
+    }
+
+    /* Every section has to lie inside the file */
+    if ( GL_FALSE == checkCacheSection(cacheSize, header->vertOffset, (size_t)sizeof(GLfloat)*header->numOfUniqueVertices*ELEMENTS_PER_VERTEX) ||
+         GL_FALSE == checkCacheSection(cacheSize, header->texOffset, (size_t)sizeof(GLfloat)*header->numOfUniqueVertices*ELEMENTS_PER_TEXCOORDS) ||
+         GL_FALSE == checkCacheSection(cacheSize, header->normOffset, (size_t)sizeof(GLfloat)*header->numOfUniqueVertices*ELEMENTS_PER_VERTEX) ||
+         GL_FALSE == checkCacheSection(cacheSize, header->indexOffset, (size_t)header->indexSize*header->numOfFaces*ELEMENTS_PER_FACE) ||
+         GL_FALSE == checkCacheSection(cacheSize, header->materialOffset, sizeof(meshCacheMaterial_t)*header->materialCount) ||
+         GL_FALSE == checkCacheSection(cacheSize, header->materialChangeOffset, sizeof(meshCacheChange_t)*header->materialChangeCount) ||
+         GL_FALSE == checkCacheSection(cacheSize, header->stringOffset, header->stringSize) )
+    {
+        return GL_FALSE;
+    }
+
+    cacheMaterials = (const meshCacheMaterial_t *)((const GLubyte *)header + header->materialOffset);
+    for(i=0;i<header->materialCount;i++)
+    {
+        if ( getCacheString(header, cacheMaterials[i].nameOffset) == NULL ||
+             (cacheMaterials[i].fileNameOffset != MESH_CACHE_NO_STRING && getCacheString(header, cacheMaterials[i].fileNameOffset) == NULL) )
+        {
+            return GL_FALSE;
+        }
+    }
+
+    changes = (const meshCacheChange_t *)((const GLubyte *)header + header->materialChangeOffset);
+    for(i=0;i<header->materialChangeCount;i++)
+    {
+        if (changes[i].material >= header->materialCount || changes[i].startFace > header->numOfFaces)
+        {
+            return GL_FALSE;
+        }
+    }
+
+    /* The indices are drawn straight from the mapping, each has to name a vertex */
+    indices = (const GLubyte *)header + header->indexOffset;
+    for(i=0;i<header->numOfFaces*ELEMENTS_PER_FACE;i++)
+    {
+        index = (header->indexSize == sizeof(GLushort)) ? ((const GLushort *)indices)[i] : ((const GLuint *)indices)[i];
+        if (index > maxIndex)
+        {
+            maxIndex = index;
+        }
+    }
+
+    if (header->numOfFaces > 0 && maxIndex >= header->numOfUniqueVertices)
+    {
+        return GL_FALSE;
+    }
+
+    /* No mtllib line is a valid, empty material library */
+    mtlName = getCacheString(header, header->materialLibOffset);
+    if (mtlName == NULL && header->materialLibOffset != MESH_CACHE_NO_STRING)
+    {
+        return GL_FALSE;
+    }
+
+    /* Finally the OBJ and MTL sources must be the ones the cache was built from */
+    result = cacheCheckKey(objFileName, &header->objKey);
+
+    if (GL_TRUE == result && mtlName != NULL)
+    {
+        mtlFile = (char *)malloc(strlen(path) + strlen(mtlName) + 1);
+        strcpy(mtlFile, path);
+        strcat(mtlFile, mtlName);
+
+        result = cacheCheckKey(mtlFile, &header->mtlKey);
+
+        free(mtlFile);
+    }
+
+    return result;
+}
+
+
+GLboolean loadMeshCache(object_t *object, materialLib_t *materials, char *cacheFileName, char *objFileName, char *path)
+{
+    const meshCacheHeader_t *header;
+    const meshCacheMaterial_t *cacheMaterials;
+    const meshCacheChange_t *changes;
+    const GLubyte *data;
+    const char *name;
+    material_t *material;
+    material_change_t change;
+    size_t size;
+    GLuint i, index, fileId;
+
+    data = (const GLubyte *)cacheMapFile(cacheFileName, &size);
+    if (data == NULL)
+    {
+        return GL_FALSE;
+    }
+
+    header = (const meshCacheHeader_t *)data;
+    if ( GL_FALSE == validateMeshCache(header, size, objFileName, path) )
+    {
+        cacheUnmapFile(data, size);
+        return GL_FALSE;
+    }
+
+    /* The vertex and index arrays are used straight from the mapping */
+    object->cacheData = data;
+    object->cacheSize = size;
+
+    object->vertArray = (GLfloat *)(data + header->vertOffset);
+    object->texArray = (GLfloat *)(data + header->texOffset);
+    object->normArray = (GLfloat *)(data + header->normOffset);
+    object->indexArray = (GLvoid *)(data + header->indexOffset);
+    object->indexSize = header->indexSize;
+    object->indexType = (header->indexSize == sizeof(GLushort)) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+    object->numOfVertices = header->numOfVertices;
+    object->numOfTexCoords = header->numOfTexCoords;
+    object->numOfNormals = header->numOfNormals;
+    object->numOfFaces = header->numOfFaces;
+    object->generatedNormals = (header->generatedNormals != 0) ? GL_TRUE : GL_FALSE;
+    object->numOfUniqueVertices = header->numOfUniqueVertices;
+    object->materialLibFilename = copyCacheString(header, header->materialLibOffset);
+
+    /* Materials were written in index order, adding them in turn gives the same indices */
+    cacheMaterials = (const meshCacheMaterial_t *)(data + header->materialOffset);
+    for(i=0;i<header->materialCount;i++)
+    {
+        name = getCacheString(header, cacheMaterials[i].nameOffset);
+        index = addMaterial(materials, name, strlen(name));
+        if (index != i)
+        {
+            freeObject(object, materials);
+            initObject(object);
+            initMaterialLib(materials);
+            return GL_FALSE;
+        }
+
+        material = getMaterial(materials, index);
+        name = getCacheString(header, cacheMaterials[i].fileNameOffset);
+        fileId = (name != NULL) ? internString(materials, name, strlen(name)) : STRING_TABLE_NOT_FOUND;
+        material->fileName = (fileId != STRING_TABLE_NOT_FOUND) ? stringTableGet(&materials->strings, fileId) : NULL;
+        material->Ns = cacheMaterials[i].Ns;
+        material->Ka = cacheMaterials[i].Ka;
+        material->Kd = cacheMaterials[i].Kd;
+        material->Ks = cacheMaterials[i].Ks;
+        material->Ni = cacheMaterials[i].Ni;
+        material->d = cacheMaterials[i].d;
+        material->illum = cacheMaterials[i].illum;
+    }
+
+    changes = (const meshCacheChange_t *)(data + header->materialChangeOffset);
+    arrayReserve(&object->materialChange, header->materialChangeCount);
+    for(i=0;i<header->materialChangeCount;i++)
+    {
+        change.startFace = changes[i].startFace;
+        change.material = changes[i].material;
+        arrayAppend(&object->materialChange, &change, 1);
+    }
+
+    /* The lightpos/campos/camfront/camup lines of the source file */
+    object->settings = header->settings;
+    object->lightPosition = header->lightPosition;
+    object->cameraPosition = header->cameraPosition;
+    object->cameraFront = header->cameraFront;
+    object->cameraUp = header->cameraUp;
+
+    return GL_TRUE;
+}
+
+
+GLboolean finishModel(object_t *object, materialLib_t *materials, mtlLoad_t *mtl, char *objFileName, char *path, char *cacheFileName)
+{
+    char *mtlFile = NULL;
+
+    if ( GL_TRUE == mtl->submitted )
+    {
+        threadPoolWait(threadPool);
+    }
+
+    /* Without a mtllib line the materials keep their defaults */
+    if (object->materialLibFilename == NULL)
+    {
+        printf("No material library named, using default materials\n");
+    }
+    else
+    {
+        /* Construct material filename */
+        mtlFile = (char *)malloc(strlen(path) + strlen(object->materialLibFilename) + 1);
+        strcpy(mtlFile, path);
+        strcat(mtlFile, object->materialLibFilename);
+
+        /* Parse it here if it was not, or a later mtllib line replaced the first */
+        if ( GL_FALSE == mtl->submitted || 0 != strcmp(mtl->fileName, mtlFile) )
+        {
+            freeMtlLoad(mtl);
+            initMaterialLib(&mtl->library);
+            mtl->fileName = (char *)malloc(strlen(mtlFile) + 1);
+            strcpy(mtl->fileName, mtlFile);
+            loadMtlTask(mtl);
+        }
+
+        if ( GL_FALSE == mtl->result )
+        {
+            free(mtlFile);
+            return GL_FALSE;
+        }
+
+        printf("Loaded mtl file: %s, %d materials in %.2f ms%s\n", mtlFile, mtl->library.materials.count, mtl->time,
+               (GL_TRUE == mtl->submitted) ? " alongside the OBJ" : "");
+
+        resolveMaterials(materials, &mtl->library);
+    }
+
+    /* Prepare indexed vertex arrays */
+    prepareObjectArrays(object, materials);
+
+    /* Store the result so the next start can skip all of the above */
+    if ( GL_TRUE == useMeshCache && GL_FALSE == saveMeshCache(object, materials, cacheFileName, objFileName, mtlFile) )
+    {
+        printf("Could not write mesh cache: %s\n", cacheFileName);
+    }
+
+    free(mtlFile);
+
+    return GL_TRUE;
+}
+
+
+GLboolean parseModel(object_t *object, materialLib_t *materials, char *objFileName, char *path, char *cacheFileName)
+{
+    mtlLoad_t mtl;
+    GLboolean result;
+
+    /* The material library is independent of the geometry, parse both at once */
+    startMtlLoad(&mtl, objFileName, path);
+
+    /* Load and parse obj file */
+    printf("Loading object file: %s...", objFileName);
+
+    result = loadObjFile(object, materials, objFileName);
+    if ( GL_TRUE == result )
+    {
+        printf("done\n");
+        result = finishModel(object, materials, &mtl, objFileName, path, cacheFileName);
+    }
+    else if ( GL_TRUE == mtl.submitted )
+    {
+        threadPoolWait(threadPool);
+    }
+
+    freeMtlLoad(&mtl);
+
+    return result;
+}
+
+
+char *getCacheFileName(char *objFileName)
+{
+    char *cacheFile;
+
+    cacheFile = (char *)malloc(strlen(objFileName) + strlen(MESH_CACHE_SUFFIX) + 1);
+    strcpy(cacheFile, objFileName);
+    strcat(cacheFile, MESH_CACHE_SUFFIX);
+
+    return cacheFile;
+}
+
+
+GLboolean loadTextures(materialLib_t *materials, char *path, threadPool_t *pool, GLboolean verbose)
+{
+    imageLoader_t loader;
+    imageLoad_t *loads;
+    imageLoad_t *load;
+    material_t *material;
+    GLuint *sharedLoads;
+    char *fileName;
+    GLuint count = 0;
+    GLuint i, j;
+    size_t size, textureSize = 0;
+    double start;
+
+    loads = (imageLoad_t *)calloc(materials->materials.count + 1, sizeof(imageLoad_t));
+    sharedLoads = (GLuint *)calloc(materials->materials.count + 1, sizeof(GLuint));
+    if (loads == NULL || sharedLoads == NULL)
+    {
+        free(loads);
+        free(sharedLoads);
+        return GL_FALSE;
+    }
+
+    start = getTimeMs();
+
+    /* Textures packed into an atlas are already uploaded, cached ones only take a reference */
+    for(i=0;i<materials->materials.count;i++)
+    {
+        material = getMaterial(materials, i);
+        sharedLoads[i] = TEXTURE_LOAD_NONE;
+
+        if (material->fileName == NULL || material->texId != 0)
+        {
+            continue;
+        }
+
+        fileName = getTexturePath(material, path);
+        material->texId = texCacheAcquire(&textureCache, fileName);
+
+        /* One decode per file, later materials with it pick it up from the cache after the upload */
+        for(j=0;j<count && material->texId == 0 && strcmp(loads[j].fileName, fileName) != 0;j++);
+
+        if (material->texId != 0 || j < count)
+        {
+            sharedLoads[i] = (material->texId == 0) ? j : TEXTURE_LOAD_NONE;
+            free(fileName);
+            continue;
+        }
+
+        loads[count].fileName = fileName;
+        loads[count].tag = i;
+        count++;
+    }
+
+    /* Decode on the workers, upload here in the order the decodes finish */
+    imageLoaderStart(&loader, pool, loads, count, textureLoadFlags);
+
+    while ((load = imageLoaderNext(&loader)) != NULL)
+    {
+        material = getMaterial(materials, load->tag);
+
+        /* A missing or broken file leaves the material untextured rather than failing the model */
+        if (GL_FALSE == load->result)
+        {
+            printf("Error loading tex file: %s, leaving it untextured\n", material->fileName);
+            continue;
+        }
+
+        /* Another spelling of a path uploaded earlier in this batch resolves to the same file */
+        material->texId = texCacheAcquire(&textureCache, load->fileName);
+        if (material->texId == 0)
+        {
+            uploadTexture(material, &load->image);
+            size = imageGetLevelOffset(&load->image, load->image.levels);
+            texCacheInsert(&textureCache, load->fileName, material->texId, size);
+            textureSize += size;
+        }
+        free(load->image.data);
+
+        if (GL_TRUE == verbose)
+        {
+            printf("Loaded tex file: %s\n", material->fileName);
+        }
+    }
+
+    imageLoaderFinish(&loader);
+
+    for(i=0;i<materials->materials.count;i++)
+    {
+        if (sharedLoads[i] != TEXTURE_LOAD_NONE)
+        {
+            getMaterial(materials, i)->texId = texCacheAcquire(&textureCache, loads[sharedLoads[i]].fileName);
+        }
+    }
+
+    if (GL_TRUE == verbose && count > 0)
+    {
+        printf("Textures ready in %.2f ms, %u files, %.2f MB %s, on %u threads\n", getTimeMs() - start, count, textureSize / (1024.0 * 1024.0),
+               (textureLoadFlags & IMAGE_LOAD_ETC2) ? "ETC2" : ((textureLoadFlags & IMAGE_LOAD_ETC1) ? "ETC1" : "RGB8"), (pool != NULL) ? pool->numOfThreads : 1);
+    }
+
+    for(i=0;i<count;i++)
+    {
+        free((char *)loads[i].fileName);
+    }
+    free(loads);
+    free(sharedLoads);
+
+    return GL_TRUE;
+}
+
+
+GLuint getObjectIndex(object_t *object, GLuint corner)
+{
+    return (object->indexType == GL_UNSIGNED_SHORT) ? ((GLushort *)object->indexArray)[corner] : ((GLuint *)object->indexArray)[corner];
+}
+
+
+void getMaterialTexCoordBounds(object_t *object, materialLib_t *materials, GLfloat *bounds)
+{
+    const material_change_t *changes = ARRAY_DATA(&object->materialChange, material_change_t);
+    GLuint i, j, endFace;
+    GLfloat *texCoord;
+    GLfloat *materialBounds;
+
+    /* Min u, min v, max u, max v of each material, the min stays above the max for unused ones */
+    for(i=0;i<materials->materials.count;i++)
+    {
+        bounds[(i*4)+0] = FLT_MAX;
+        bounds[(i*4)+1] = FLT_MAX;
+        bounds[(i*4)+2] = -FLT_MAX;
+        bounds[(i*4)+3] = -FLT_MAX;
+    }
+
+    for(i=0;i<object->materialChange.count;i++)
+    {
+        endFace = (i < object->materialChange.count - 1) ? changes[i+1].startFace : object->numOfFaces;
+        materialBounds = &bounds[changes[i].material*4];
+
+        for(j=changes[i].startFace*ELEMENTS_PER_FACE;j<endFace*ELEMENTS_PER_FACE;j++)
+        {
+            texCoord = &object->texArray[getObjectIndex(object, j)*ELEMENTS_PER_TEXCOORDS];
+
+            materialBounds[0] = (texCoord[0] < materialBounds[0]) ? texCoord[0] : materialBounds[0];
+            materialBounds[1] = (texCoord[1] < materialBounds[1]) ? texCoord[1] : materialBounds[1];
+            materialBounds[2] = (texCoord[0] > materialBounds[2]) ? texCoord[0] : materialBounds[2];
+            materialBounds[3] = (texCoord[1] > materialBounds[3]) ? texCoord[1] : materialBounds[3];
+        }
+    }
+}
+
+
+GLboolean applyTextureAtlas(object_t *object, materialLib_t *materials, const GLfloat *transforms, const GLuint *mapIds, GLuint numOfPages, GLuint *numOfSplit)
+{
+    material_change_t *changes = ARRAY_DATA(&object->materialChange, material_change_t);
+    material_change_t *grouped;
+    material_t *material;
+    GLuint numOfChanges = object->materialChange.count;
+    GLuint numOfMaterials = materials->materials.count;
+    GLuint numOfCorners = object->numOfFaces * ELEMENTS_PER_FACE;
+    GLuint numOfGrouped = 0;
+    GLuint pass, page, i, j, k, key, vertex, endFace, face;
+    GLuint *order;
+    GLuint *indices;
+    GLuint *split;
+    GLuint *splitRun;
+    GLuint *source;
+    GLuint *owner;
+    GLushort *shortIndices;
+    GLfloat *vertArray;
+    GLfloat *texArray;
+    GLfloat *normArray;
+    array_t sources;
+    array_t owners;
+    GLboolean result = GL_TRUE;
+
+    /* Each output vertex remembers the vertex it copies and the material whose texcoords it holds */
+    arrayInit(&sources, sizeof(GLuint));
+    arrayInit(&owners, sizeof(GLuint));
+
+    order = (GLuint *)malloc(sizeof(GLuint)*(numOfChanges + 1));
+    grouped = (material_change_t *)malloc(sizeof(material_change_t)*(numOfChanges + 1));
+    indices = (GLuint *)malloc(sizeof(GLuint)*(numOfCorners + 1));
+    split = (GLuint *)malloc(sizeof(GLuint)*(object->numOfUniqueVertices + 1));
+    splitRun = (GLuint *)malloc(sizeof(GLuint)*(object->numOfUniqueVertices + 1));
+
+    /* Nothing of the object is touched yet, the caller falls back to a texture per material */
+    if ( order == NULL || grouped == NULL || indices == NULL || split == NULL || splitRun == NULL ||
+         GL_FALSE == arrayResize(&sources, object->numOfUniqueVertices) ||
+         GL_FALSE == arrayResize(&owners, object->numOfUniqueVertices) )
+    {
+        arrayFree(&sources);
+        arrayFree(&owners);
+        free(order);
+        free(grouped);
+        free(indices);
+        free(split);
+        free(splitRun);
+        return GL_FALSE;
+    }
+
+    memset(splitRun, 0xFF, sizeof(GLuint)*object->numOfUniqueVertices);
+
+    /* Opaque then blended as before, within each the runs of one atlas page next to each other so they draw as one */
+    for(pass=0;pass<2;pass++)
+    {
+        for(page=0;page<=numOfPages;page++)
+        {
+            for(i=0;i<numOfChanges;i++)
+            {
+                material = getMaterial(materials, changes[i].material);
+
+                if ( isMaterialBlended(material) == (GLboolean)pass &&
+                     ((page < numOfPages) ? (material->materialMapId == mapIds[page]) : (material->materialMapId == 0)) )
+                {
+                    order[numOfGrouped++] = i;
+                }
+            }
+        }
+    }
+
+    for(i=0;i<object->numOfUniqueVertices;i++)
+    {
+        ARRAY_DATA(&sources, GLuint)[i] = i;
+        ARRAY_DATA(&owners, GLuint)[i] = DEDUP_EMPTY_SLOT;
+    }
+
+    /* Faces ahead of the first usemtl are not drawn, they stay in front */
+    face = (numOfChanges != 0) ? changes[0].startFace : object->numOfFaces;
+    for(j=0;j<face*ELEMENTS_PER_FACE;j++)
+    {
+        indices[j] = getObjectIndex(object, j);
+    }
+
+    for(k=0;k<numOfGrouped && GL_TRUE == result;k++)
+    {
+        i = order[k];
+        endFace = (i < numOfChanges - 1) ? changes[i+1].startFace : object->numOfFaces;
+        material = getMaterial(materials, changes[i].material);
+
+        grouped[k].startFace = face;
+        grouped[k].material = changes[i].material;
+
+        /* Materials drawing from their own texture all keep the original texcoords */
+        key = (material->materialMapId != 0) ? changes[i].material : numOfMaterials;
+
+        /* A vertex shared with a material that moves its texcoords differently gets a copy */
+        for(j=changes[i].startFace*ELEMENTS_PER_FACE;j<endFace*ELEMENTS_PER_FACE;j++)
+        {
+            vertex = getObjectIndex(object, j);
+
+            if (ARRAY_DATA(&owners, GLuint)[vertex] == DEDUP_EMPTY_SLOT)
+            {
+                ARRAY_DATA(&owners, GLuint)[vertex] = key;
+            }
+            else if (ARRAY_DATA(&owners, GLuint)[vertex] != key)
+            {
+                if (splitRun[vertex] != k)
+                {
+                    if (arrayAppend(&sources, &vertex, 1) == NULL || arrayAppend(&owners, &key, 1) == NULL)
+                    {
+                        result = GL_FALSE;
+                        break;
+                    }
+
+                    splitRun[vertex] = k;
+                    split[vertex] = sources.count - 1;
+                }
+                vertex = split[vertex];
+            }
+
+            indices[(face*ELEMENTS_PER_FACE) + j - (changes[i].startFace*ELEMENTS_PER_FACE)] = vertex;
+        }
+
+        face += endFace - changes[i].startFace;
+    }
+
+    /* Rebuild the vertex arrays, atlased texcoords moved into their rect */
+    source = ARRAY_DATA(&sources, GLuint);
+    owner = ARRAY_DATA(&owners, GLuint);
+
+    vertArray = (GLfloat *)malloc(sizeof(GLfloat)*sources.count*ELEMENTS_PER_VERTEX);
+    texArray = (GLfloat *)malloc(sizeof(GLfloat)*sources.count*ELEMENTS_PER_TEXCOORDS);
+    normArray = (GLfloat *)malloc(sizeof(GLfloat)*sources.count*ELEMENTS_PER_VERTEX);
+
+    if (GL_FALSE == result || vertArray == NULL || texArray == NULL || normArray == NULL)
+    {
+        arrayFree(&sources);
+        arrayFree(&owners);
+        free(order);
+        free(grouped);
+        free(indices);
+        free(split);
+        free(splitRun);
+        free(vertArray);
+        free(texArray);
+        free(normArray);
+        return GL_FALSE;
+    }
+
+    memcpy(changes, grouped, sizeof(material_change_t)*numOfGrouped);
+
+    for(i=0;i<sources.count;i++)
+    {
+        memcpy(&vertArray[i*ELEMENTS_PER_VERTEX], &object->vertArray[source[i]*ELEMENTS_PER_VERTEX], sizeof(GLfloat)*ELEMENTS_PER_VERTEX);
+        memcpy(&texArray[i*ELEMENTS_PER_TEXCOORDS], &object->texArray[source[i]*ELEMENTS_PER_TEXCOORDS], sizeof(GLfloat)*ELEMENTS_PER_TEXCOORDS);
+        memcpy(&normArray[i*ELEMENTS_PER_VERTEX], &object->normArray[source[i]*ELEMENTS_PER_VERTEX], sizeof(GLfloat)*ELEMENTS_PER_VERTEX);
+
+        if (owner[i] < numOfMaterials)
+        {
+            texArray[(i*ELEMENTS_PER_TEXCOORDS)+0] = (texArray[(i*ELEMENTS_PER_TEXCOORDS)+0] * transforms[(owner[i]*4)+0]) + transforms[(owner[i]*4)+2];
+            texArray[(i*ELEMENTS_PER_TEXCOORDS)+1] = (texArray[(i*ELEMENTS_PER_TEXCOORDS)+1] * transforms[(owner[i]*4)+1]) + transforms[(owner[i]*4)+3];
+        }
+    }
+
+    /* The arrays no longer point into the mesh cache */
+    if (object->cacheData != NULL)
+    {
+        cacheUnmapFile(object->cacheData, object->cacheSize);
+        object->cacheData = NULL;
+    }
+    else
+    {
+        free(object->vertArray);
+        free(object->texArray);
+        free(object->normArray);
+        free(object->indexArray);
+    }
+
+    object->vertArray = vertArray;
+    object->texArray = texArray;
+    object->normArray = normArray;
+    object->indexArray = indices;
+
+    *numOfSplit = sources.count - object->numOfUniqueVertices;
+    object->numOfUniqueVertices = sources.count;
+
+    /* Copies can push the vertex count past 16-bit indices */
+    if (object->numOfUniqueVertices <= MAX_SHORT_INDEX_VERTICES)
+    {
+        shortIndices = (GLushort *)indices;
+        for(j=0;j<numOfCorners;j++)
+        {
+            shortIndices[j] = (GLushort)indices[j];
+        }
+
+        object->indexType = GL_UNSIGNED_SHORT;
+        object->indexSize = sizeof(GLushort);
+    }
+    else
+    {
+        object->indexType = GL_UNSIGNED_INT;
+        object->indexSize = sizeof(GLuint);
+    }
+
+    arrayFree(&sources);
+    arrayFree(&owners);
+    free(order);
+    free(grouped);
+    free(split);
+    free(splitRun);
+
+    return GL_TRUE;
+}
+
+
+GLubyte encodeMaterialValue(GLfloat value)
+{
+    /* The lookup is unsigned, negative parameters clamp to zero */
+    value = (value < 0.0f) ? 0.0f : ((value > 1.0f) ? 1.0f : value);
+
+    return (GLubyte)((value * QUANT_UNORM8_MAX) + 0.5f);
+}
+
+
+GLuint createMaterialMap(materialLib_t *materials, const atlasPage_t *page, GLuint pageIndex, const atlasRect_t *rects, const GLuint *entries, GLuint numOfEntries)
+{
+    GLuint cellsX = page->width / ATLAS_ALIGN;
+    GLuint cellsY = page->height / ATLAS_ALIGN;
+    GLuint left, top, width, height;
+    GLuint i, x, y, k;
+    GLubyte values[MATERIAL_MAP_TEXELS][4];
+    GLubyte *texels;
+    material_t *material;
+    GLuint mapId;
+
+    texels = (GLubyte *)calloc((size_t)cellsX * MATERIAL_MAP_TEXELS * cellsY * 4, sizeof(GLubyte));
+
+    for(i=0;i<numOfEntries;i++)
+    {
+        if (rects[i].atlas != pageIndex)
+        {
+            continue;
+        }
+
+        material = getMaterial(materials, entries[i]);
+
+        values[0][0] = encodeMaterialValue(material->Ka.x);
+        values[0][1] = encodeMaterialValue(material->Ka.y);
+        values[0][2] = encodeMaterialValue(material->Ka.z);
+        values[0][3] = encodeMaterialValue(material->d);
+        values[1][0] = encodeMaterialValue(material->Kd.x);
+        values[1][1] = encodeMaterialValue(material->Kd.y);
+        values[1][2] = encodeMaterialValue(material->Kd.z);
+        values[1][3] = 0xFF;
+        values[2][0] = encodeMaterialValue(material->Ks.x);
+        values[2][1] = encodeMaterialValue(material->Ks.y);
+        values[2][2] = encodeMaterialValue(material->Ks.z);
+        values[2][3] = 0xFF;
+
+        /* Every cell of the padded rect, the lookups sit side by side one page width of cells apart */
+        left = (rects[i].x - ATLAS_PADDING) / ATLAS_ALIGN;
+        top = (rects[i].y - ATLAS_PADDING) / ATLAS_ALIGN;
+        width = atlasGetPaddedSize(rects[i].width) / ATLAS_ALIGN;
+        height = atlasGetPaddedSize(rects[i].height) / ATLAS_ALIGN;
+
+        for(y=top;y<top+height;y++)
+        {
+            for(x=left;x<left+width;x++)
+            {
+                for(k=0;k<MATERIAL_MAP_TEXELS;k++)
+                {
+                    memcpy(&texels[(((size_t)y * cellsX * MATERIAL_MAP_TEXELS) + (k * cellsX) + x) * 4], values[k], 4);
+                }
+            }
+        }
+    }
+
+    /* One texel per cell, never filtered */
+    glGenTextures(1, &mapId);
+    glBindTexture(GL_TEXTURE_2D, mapId);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, cellsX * MATERIAL_MAP_TEXELS, cellsY, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+    free(texels);
+
+    return mapId;
+}
+
+
+GLuint uploadAtlasPage(image_t *atlas)
+{
+    GLenum format = imageGetFormat(textureLoadFlags);
+    GLuint texId;
+
+    /* The page takes the same mips and compression as a single texture */
+    if ( (textureLoadFlags & IMAGE_LOAD_MIPS) && GL_FALSE == imageBuildMips(atlas) )
+    {
+        return 0;
+    }
+
+    if ( format != GL_RGB8 && GL_FALSE == imageCompress(atlas, format) )
+    {
+        return 0;
+    }
+
+    /* Texcoords never leave their rect, the padding does the clamping */
+    glGenTextures(1, &texId);
+    glBindTexture(GL_TEXTURE_2D, texId);
+    imageUploadTexture(atlas);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (atlas->levels > 1) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+
+    return texId;
+}
+
+
+GLboolean buildTextureAtlas(object_t *object, materialLib_t *materials, char *path, threadPool_t *pool)
+{
+    GLuint numOfMaterials = materials->materials.count;
+    imageLoader_t loader;
+    imageLoad_t *loads;
+    imageLoad_t *load;
+    atlasRect_t *rects;
+    atlasPage_t *page;
+    material_t *material;
+    material_t *other;
+    image_t atlas;
+    array_t pages;
+    GLuint *entries;
+    GLuint *entryLoads;
+    GLuint *entryOf;
+    GLuint *mapIds;
+    GLfloat *bounds;
+    GLfloat *transforms;
+    GLfloat tile[2];
+    GLuint numOfEntries = 0, numOfLoads = 0, numOfPacked = 0, numOfSplit = 0;
+    GLuint i, j, p, texId;
+    GLint maxSize;
+    GLboolean result = GL_TRUE;
+    GLboolean missing = GL_FALSE;
+    GLboolean packed = GL_FALSE;
+    size_t textureSize = 0;
+    drawStats_t before, after;
+    double start = getTimeMs();
+
+    loads = (imageLoad_t *)calloc(numOfMaterials + 1, sizeof(imageLoad_t));
+    rects = (atlasRect_t *)calloc(numOfMaterials + 1, sizeof(atlasRect_t));
+    entries = (GLuint *)calloc(numOfMaterials + 1, sizeof(GLuint));
+    entryLoads = (GLuint *)calloc(numOfMaterials + 1, sizeof(GLuint));
+    entryOf = (GLuint *)calloc(numOfMaterials + 1, sizeof(GLuint));
+    mapIds = (GLuint *)calloc(numOfMaterials + 1, sizeof(GLuint));
+    bounds = (GLfloat *)calloc((numOfMaterials + 1) * 4, sizeof(GLfloat));
+    transforms = (GLfloat *)calloc((numOfMaterials + 1) * 4, sizeof(GLfloat));
+    arrayInit(&pages, sizeof(atlasPage_t));
+
+    getDrawStats(object, materials, GL_TRUE, &before);
+    getMaterialTexCoordBounds(object, materials, bounds);
+
+    /* Only texcoords within one repeat of the texture can move into a rect, the tile is shifted out */
+    for(i=0;i<numOfMaterials;i++)
+    {
+        material = getMaterial(materials, i);
+        entryOf[i] = ATLAS_NONE;
+
+        if (material->fileName == NULL || bounds[(i*4)+0] > bounds[(i*4)+2])
+        {
+            continue;
+        }
+
+        tile[0] = floorf(bounds[(i*4)+0] + ATLAS_TEXCOORD_SLACK);
+        tile[1] = floorf(bounds[(i*4)+1] + ATLAS_TEXCOORD_SLACK);
+
+        if (bounds[(i*4)+2] <= tile[0] + 1.0f + ATLAS_TEXCOORD_SLACK && bounds[(i*4)+3] <= tile[1] + 1.0f + ATLAS_TEXCOORD_SLACK)
+        {
+            entryOf[i] = 0;
+            bounds[(i*4)+0] = tile[0];
+            bounds[(i*4)+1] = tile[1];
+        }
+    }
+
+    /* A file some material keeps as its own texture stays out, it would be decoded and uploaded twice */
+    for(i=0;i<numOfMaterials;i++)
+    {
+        material = getMaterial(materials, i);
+        if (material->fileName == NULL || entryOf[i] != ATLAS_NONE)
+        {
+            continue;
+        }
+
+        for(j=0;j<numOfMaterials;j++)
+        {
+            entryOf[j] = (getMaterial(materials, j)->fileName == material->fileName) ? ATLAS_NONE : entryOf[j];
+        }
+    }
+
+    /* Materials with the same file and parameters share a rect, each file is decoded once */
+    for(i=0;i<numOfMaterials;i++)
+    {
+        if (entryOf[i] == ATLAS_NONE)
+        {
+            continue;
+        }
+
+        material = getMaterial(materials, i);
+
+        for(j=0;j<numOfEntries;j++)
+        {
+            other = getMaterial(materials, entries[j]);
+
+            if ( other->fileName == material->fileName && other->d == material->d && 0 == memcmp(&other->Ka, &material->Ka, sizeof(vec3_t)) &&
+                 0 == memcmp(&other->Kd, &material->Kd, sizeof(vec3_t)) && 0 == memcmp(&other->Ks, &material->Ks, sizeof(vec3_t)) )
+            {
+                break;
+            }
+        }
+
+        entryOf[i] = j;
+        if (j < numOfEntries)
+        {
+            continue;
+        }
+
+        entries[numOfEntries] = i;
+        entryLoads[numOfEntries] = numOfLoads;
+
+        for(j=0;j<numOfEntries;j++)
+        {
+            if (getMaterial(materials, entries[j])->fileName == material->fileName)
+            {
+                entryLoads[numOfEntries] = entryLoads[j];
+                break;
+            }
+        }
+
+        if (entryLoads[numOfEntries] == numOfLoads)
+        {
+            loads[numOfLoads].fileName = getTexturePath(material, path);
+            loads[numOfLoads].tag = i;
+            numOfLoads++;
+        }
+
+        numOfEntries++;
+    }
+
+    if (numOfEntries > 1)
+    {
+        /* Plain decodes, the mips and compression are built per page */
+        imageLoaderStart(&loader, pool, loads, numOfLoads, 0);
+
+        while ((load = imageLoaderNext(&loader)) != NULL)
+        {
+            if (GL_FALSE == load->result)
+            {
+                printf("Error loading tex file: %s, packing no atlas\n", getMaterial(materials, load->tag)->fileName);
+                missing = GL_TRUE;
+                break;
+            }
+        }
+
+        imageLoaderFinish(&loader);
+    }
+
+    /* The textures then load one by one, where the missing file is left untextured */
+    if (numOfEntries > 1 && GL_FALSE == missing)
+    {
+        for(i=0;i<numOfEntries;i++)
+        {
+            rects[i].width = loads[entryLoads[i]].image.width;
+            rects[i].height = loads[entryLoads[i]].image.height;
+        }
+
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+        maxSize = (maxSize > ATLAS_MAX_SIZE) ? ATLAS_MAX_SIZE : maxSize;
+
+        /* ES2 only mipmaps power of two pages */
+        numOfPacked = atlasPack(rects, numOfEntries, (GLuint)maxSize, (textureLoadFlags & IMAGE_LOAD_POT) ? GL_TRUE : GL_FALSE, &pages);
+
+        for(p=0;p<pages.count && GL_TRUE == result;p++)
+        {
+            page = &ARRAY_DATA(&pages, atlasPage_t)[p];
+
+            atlas.width = page->width;
+            atlas.height = page->height;
+            atlas.levels = 1;
+            atlas.format = GL_RGB8;
+            atlas.data = (GLubyte *)calloc((size_t)page->width * page->height, BMP_PIX_PER_COL);
+
+            for(i=0;i<numOfEntries && atlas.data != NULL;i++)
+            {
+                if (rects[i].atlas == p)
+                {
+                    atlasBlit(&atlas, &loads[entryLoads[i]].image, &rects[i]);
+                }
+            }
+
+            texId = (atlas.data != NULL) ? uploadAtlasPage(&atlas) : 0;
+            if (texId == 0)
+            {
+                printf("Error building texture atlas page %u\n", p);
+                free(atlas.data);
+                result = GL_FALSE;
+                break;
+            }
+
+            textureSize += imageGetLevelOffset(&atlas, atlas.levels);
+            free(atlas.data);
+
+            mapIds[p] = createMaterialMap(materials, page, p, rects, entries, numOfEntries);
+
+            /* Texcoords scale into the image inside the rect, after the shift back to the first repeat */
+            for(i=0;i<numOfMaterials;i++)
+            {
+                if (entryOf[i] == ATLAS_NONE || rects[entryOf[i]].atlas != p)
+                {
+                    continue;
+                }
+
+                material = getMaterial(materials, i);
+                material->texId = texId;
+                material->materialMapId = mapIds[p];
+
+                transforms[(i*4)+0] = (GLfloat)rects[entryOf[i]].width / page->width;
+                transforms[(i*4)+1] = (GLfloat)rects[entryOf[i]].height / page->height;
+                transforms[(i*4)+2] = ((GLfloat)rects[entryOf[i]].x / page->width) - (bounds[(i*4)+0] * transforms[(i*4)+0]);
+                transforms[(i*4)+3] = ((GLfloat)rects[entryOf[i]].y / page->height) - (bounds[(i*4)+1] * transforms[(i*4)+1]);
+            }
+
+            printf("\tatlas page %u: %ux%u\n", p, page->width, page->height);
+        }
+
+        packed = (GL_TRUE == result) ? applyTextureAtlas(object, materials, transforms, mapIds, pages.count, &numOfSplit) : GL_FALSE;
+
+        /* Out of memory remapping the mesh, drop the pages and let the textures load one by one */
+        if (GL_TRUE == result && GL_FALSE == packed)
+        {
+            printf("Error applying the texture atlas, loading the textures one by one\n");
+            releaseTextures(materials);
+        }
+    }
+
+    if (numOfEntries < 2)
+    {
+        printf("Texture atlas: fewer than two textures with texcoords inside one repeat, nothing to pack\n");
+    }
+    else if (GL_TRUE == packed)
+    {
+        getDrawStats(object, materials, GL_TRUE, &after);
+
+        printf("Texture atlas: %u of %u texture rects packed in %u pages, %.2f MB %s, %u vertices split, in %.2f ms\n",
+               numOfPacked, numOfEntries, pages.count, textureSize / (1024.0 * 1024.0),
+               (textureLoadFlags & IMAGE_LOAD_ETC2) ? "ETC2" : ((textureLoadFlags & IMAGE_LOAD_ETC1) ? "ETC1" : "RGB8"), numOfSplit, getTimeMs() - start);
+        printf("\tdraw calls per frame: %d -> %d, texture binds %d -> %d, material uploads %d -> %d\n",
+               before.draws, after.draws, before.textureBinds, after.textureBinds, before.materialUploads, after.materialUploads);
+    }
+
+    for(i=0;i<numOfLoads;i++)
+    {
+        free((char *)loads[i].fileName);
+        free(loads[i].image.data);
+    }
+
+    arrayFree(&pages);
+    free(loads);
+    free(rects);
+    free(entries);
+    free(entryLoads);
+    free(entryOf);
+    free(mapIds);
+    free(bounds);
+    free(transforms);
+
+    return result;
+}
+
+
+void printModelInfo(object_t *object, materialLib_t *materials)
+{
+    GLint i;
+
+    printf("\tvertices:   %d\n", object->numOfVertices);
+    printf("\ttex coords: %d\n", object->numOfTexCoords);
+    printf("\tnormals:    %d\n", object->numOfNormals);
+    printf("\tfaces:      %d\n", object->numOfFaces);
+    printf("\tmaterials:  %d\n", materials->materials.count);
+
+    printVertexStats(object);
+
+    for(i=0; i<materials->materials.count; i++)
+    {
+        printf("\t%3d:   %s\tfilename: %s\n", i, getMaterial(materials, i)->name, getMaterial(materials, i)->fileName);
+    }
+}
+
+
+GLuint getLodIndex(object_t *object, GLuint corner)
+{
+    /* Corners past the full mesh belong to the levels of detail */
+    if (corner >= object->numOfFaces * ELEMENTS_PER_FACE)
+    {
+        return ARRAY_DATA(&object->lodIndices, GLuint)[corner - (object->numOfFaces * ELEMENTS_PER_FACE)];
+    }
+
+    return getObjectIndex(object, corner);
+}
+
+
+GLboolean buildObjectLod(object_t *object, objectLod_t *lod, GLuint level, GLfloat maxError)
+{
+    drawRuns_t runs = getDrawRuns(object, level);
+    material_change_t change;
+    GLuint *indices;
+    GLuint *simplified;
+    GLuint i, j, startFace, endFace, count;
+    GLfloat error;
+
+    arrayInit(&lod->materialChange, sizeof(material_change_t));
+    lod->numOfFaces = 0;
+    lod->error = 0.0f;
+
+    indices = (GLuint *)malloc(sizeof(GLuint)*((runs.endFace - runs.changes[0].startFace) * ELEMENTS_PER_FACE + 1));
+    simplified = (GLuint *)malloc(sizeof(GLuint)*((runs.endFace - runs.changes[0].startFace) * ELEMENTS_PER_FACE + 1));
+    if (indices == NULL || simplified == NULL)
+    {
+        free(indices);
+        free(simplified);
+        return GL_FALSE;
+    }
+
+    /* Each material run on its own, so the edges between materials stay where they are */
+    for(i=0;i<runs.count;i++)
+    {
+        startFace = runs.changes[i].startFace;
+        endFace = (i < runs.count - 1) ? runs.changes[i+1].startFace : runs.endFace;
+
+        for(j=startFace*ELEMENTS_PER_FACE;j<endFace*ELEMENTS_PER_FACE;j++)
+        {
+            indices[j - (startFace*ELEMENTS_PER_FACE)] = getLodIndex(object, j);
+        }
+
+        count = meshSimplify(simplified, indices, (endFace - startFace) * ELEMENTS_PER_FACE, object->vertArray, object->texArray, object->normArray,
+                             object->numOfUniqueVertices, (GLuint)((endFace - startFace) * LOD_REDUCTION) * ELEMENTS_PER_FACE, maxError, &error);
+
+        if (count != 0)
+        {
+            meshOptimizeVertexCache(indices, simplified, count, object->numOfUniqueVertices, MESH_VERTEX_CACHE_SIZE);
+        }
+
+        change.startFace = object->numOfFaces + (object->lodIndices.count / ELEMENTS_PER_FACE);
+        change.material = runs.changes[i].material;
+
+        if ( NULL == arrayAppend(&lod->materialChange, &change, 1) || (count != 0 && NULL == arrayAppend(&object->lodIndices, indices, count)) )
+        {
+            free(indices);
+            free(simplified);
+            return GL_FALSE;
+        }
+
+        lod->numOfFaces += count / ELEMENTS_PER_FACE;
+        lod->error = (error > lod->error) ? error : lod->error;
+    }
+
+    lod->endFace = object->numOfFaces + (object->lodIndices.count / ELEMENTS_PER_FACE);
+
+    free(indices);
+    free(simplified);
+
+    return GL_TRUE;
+}
+
+
+void updateObjectRadius(object_t *object)
+{
+    GLfloat length;
+    GLuint i;
+
+    /* The model turns around the origin, the bounding sphere is centered there */
+    object->radius = 0.0f;
+    for(i=0;i<object->numOfUniqueVertices;i++)
+    {
+        length = sqrtf((object->vertArray[i*3] * object->vertArray[i*3]) + (object->vertArray[i*3+1] * object->vertArray[i*3+1]) +
+                       (object->vertArray[i*3+2] * object->vertArray[i*3+2]));
+        object->radius = (length > object->radius) ? length : object->radius;
+    }
+}
+
+
+void buildObjectLods(object_t *object)
+{
+    objectLod_t lod;
+    GLuint i, previousFaces, firstIndex;
+    GLfloat previousError = 0.0f;
+    double start;
+
+    updateObjectRadius(object);
+
+    if (object->materialChange.count == 0)
+    {
+        return;
+    }
+
+    previousFaces = object->numOfFaces;
+
+    /* Every level is simplified from the one before, its error adds to theirs */
+    for(i=0;i<LOD_MAX_LEVELS && previousFaces >= LOD_MIN_FACES;i++)
+    {
+        start = getTimeMs();
+        firstIndex = object->lodIndices.count;
+
+        /* Dropped when stuck on borders, seams or the error limit */
+        if ( GL_FALSE == buildObjectLod(object, &lod, i, LOD_MAX_ERROR * object->radius) ||
+             lod.numOfFaces > previousFaces * (1.0f - LOD_MIN_SAVING) )
+        {
+            object->lodIndices.count = firstIndex;
+            arrayFree(&lod.materialChange);
+            break;
+        }
+
+        lod.error += previousError;
+        previousError = lod.error;
+        previousFaces = lod.numOfFaces;
+
+        arrayAppend(&object->lods, &lod, 1);
+
+        printf("LOD %u: %u faces, error %.4f, %.2f ms\n", i + 1, lod.numOfFaces, lod.error, getTimeMs() - start);
+    }
+}
+
+
+void setLodIndex(object_t *object, GLuint corner, GLuint index)
+{
+    if (corner >= object->numOfFaces * ELEMENTS_PER_FACE)
+    {
+        ARRAY_DATA(&object->lodIndices, GLuint)[corner - (object->numOfFaces * ELEMENTS_PER_FACE)] = index;
+    }
+    else if (object->indexType == GL_UNSIGNED_SHORT)
+    {
+        ((GLushort *)object->indexArray)[corner] = (GLushort)index;
+    }
+    else
+    {
+        ((GLuint *)object->indexArray)[corner] = index;
+    }
+}
+
+
+GLboolean detachMeshCache(object_t *object)
+{
+    void *arrays[4];
+    size_t sizes[4];
+    GLuint i;
+
+    if (object->cacheData == NULL)
+    {
+        return GL_TRUE;
+    }
+
+    sizes[0] = sizeof(GLfloat)*object->numOfUniqueVertices*ELEMENTS_PER_VERTEX;
+    sizes[1] = sizeof(GLfloat)*object->numOfUniqueVertices*ELEMENTS_PER_TEXCOORDS;
+    sizes[2] = sizeof(GLfloat)*object->numOfUniqueVertices*ELEMENTS_PER_VERTEX;
+    sizes[3] = (size_t)object->indexSize*object->numOfFaces*ELEMENTS_PER_FACE;
+
+    /* Private copies of the arrays so they can be changed, the mapping is read only */
+    for(i=0;i<4;i++)
+    {
+        arrays[i] = malloc(sizes[i] + 1);
+        if (arrays[i] == NULL)
+        {
+            while (i-- > 0)
+            {
+                free(arrays[i]);
+            }
+            return GL_FALSE;
+        }
+    }
+
+    memcpy(arrays[0], object->vertArray, sizes[0]);
+    memcpy(arrays[1], object->texArray, sizes[1]);
+    memcpy(arrays[2], object->normArray, sizes[2]);
+    memcpy(arrays[3], object->indexArray, sizes[3]);
+
+    cacheUnmapFile(object->cacheData, object->cacheSize);
+    object->cacheData = NULL;
+
+    object->vertArray = (GLfloat *)arrays[0];
+    object->texArray = (GLfloat *)arrays[1];
+    object->normArray = (GLfloat *)arrays[2];
+    object->indexArray = arrays[3];
+
+    return GL_TRUE;
+}
+
+
+GLboolean buildObjectClusters(object_t *object)
+{
+    drawRuns_t runs;
+    meshCluster_t *clusters;
+    objectLod_t *lod;
+    GLuint *indices;
+    GLuint *ordered;
+    GLuint level, i, j, k, count, startFace, endFace;
+    GLuint maxFaces = object->numOfFaces;
+    meshCacheStats_t before, after;
+    double start;
+
+    start = getTimeMs();
+
+    /* Triangles are reordered into their clusters */
+    if ( GL_FALSE == detachMeshCache(object) )
+    {
+        return GL_FALSE;
+    }
+
+    for(level=0;level<object->lods.count;level++)
+    {
+        maxFaces = (ARRAY_DATA(&object->lods, objectLod_t)[level].numOfFaces > maxFaces) ? ARRAY_DATA(&object->lods, objectLod_t)[level].numOfFaces : maxFaces;
+    }
+
+    indices = (GLuint *)malloc(sizeof(GLuint)*(maxFaces*ELEMENTS_PER_FACE + 1));
+    ordered = (GLuint *)malloc(sizeof(GLuint)*(maxFaces*ELEMENTS_PER_FACE + 1));
+    clusters = (meshCluster_t *)malloc(sizeof(meshCluster_t)*(maxFaces + 1));
+    if (indices == NULL || ordered == NULL || clusters == NULL)
+    {
+        free(indices);
+        free(ordered);
+        free(clusters);
+        return GL_FALSE;
+    }
+
+    for(j=0;j<object->numOfFaces*ELEMENTS_PER_FACE;j++)
+    {
+        indices[j] = getObjectIndex(object, j);
+    }
+    before = meshAnalyzeVertexCache(indices, object->numOfFaces*ELEMENTS_PER_FACE, object->numOfUniqueVertices, MESH_VERTEX_CACHE_SIZE);
+
+    /* Every level, every material run on its own so no cluster crosses a draw */
+    for(level=0;level<=object->lods.count;level++)
+    {
+        runs = getDrawRuns(object, level);
+
+        lod = (level == 0) ? NULL : &ARRAY_DATA(&object->lods, objectLod_t)[level - 1];
+        if (lod != NULL)
+        {
+            lod->firstCluster = object->clusters.count;
+        }
+
+        for(i=0;i<runs.count;i++)
+        {
+            startFace = runs.changes[i].startFace;
+            endFace = (i < runs.count - 1) ? runs.changes[i+1].startFace : runs.endFace;
+
+            for(j=startFace*ELEMENTS_PER_FACE;j<endFace*ELEMENTS_PER_FACE;j++)
+            {
+                indices[j - (startFace*ELEMENTS_PER_FACE)] = getLodIndex(object, j);
+            }
+
+            count = meshBuildClusters(clusters, ordered, indices, (endFace - startFace)*ELEMENTS_PER_FACE, object->vertArray, object->numOfUniqueVertices,
+                                      CLUSTER_MAX_TRIANGLES, CLUSTER_MAX_VERTICES);
+
+            for(j=startFace*ELEMENTS_PER_FACE;j<endFace*ELEMENTS_PER_FACE;j++)
+            {
+                setLodIndex(object, j, ordered[j - (startFace*ELEMENTS_PER_FACE)]);
+            }
+
+            for(k=0;k<count;k++)
+            {
+                clusters[k].firstIndex += startFace*ELEMENTS_PER_FACE;
+            }
+
+            /* Out of memory, a run without clusters would never be drawn */
+            if ((count == 0 && endFace != startFace) || (count != 0 && NULL == arrayAppend(&object->clusters, clusters, count)))
+            {
+                free(indices);
+                free(ordered);
+                free(clusters);
+                freeObjectClusters(object);
+                return GL_FALSE;
+            }
+        }
+
+        if (lod != NULL)
+        {
+            lod->numOfClusters = object->clusters.count - lod->firstCluster;
+        }
+        else
+        {
+            object->numOfClusters = object->clusters.count;
+        }
+    }
+
+    for(j=0;j<object->numOfFaces*ELEMENTS_PER_FACE;j++)
+    {
+        indices[j] = getObjectIndex(object, j);
+    }
+    after = meshAnalyzeVertexCache(indices, object->numOfFaces*ELEMENTS_PER_FACE, object->numOfUniqueVertices, MESH_VERTEX_CACHE_SIZE);
+
+    free(indices);
+    free(ordered);
+    free(clusters);
+
+    object->clusterVisible = (GLubyte *)calloc(object->clusters.count + 1, sizeof(GLubyte));
+    object->drawCounts = (GLsizei *)malloc(sizeof(GLsizei)*(object->clusters.count + 1));
+    object->drawOffsets = (const GLvoid **)malloc(sizeof(GLvoid *)*(object->clusters.count + 1));
+    if (object->clusterVisible == NULL || object->drawCounts == NULL || object->drawOffsets == NULL)
+    {
+        freeObjectClusters(object);
+        return GL_FALSE;
+    }
+
+    for(i=0,count=0;i<object->numOfClusters;i++)
+    {
+        count += (ARRAY_DATA(&object->clusters, meshCluster_t)[i].cutoff < MESH_CLUSTER_NO_CONE) ? 1 : 0;
+    }
+
+    printf("Clusters: %u for %u faces, %.1f triangles each, %u with a back face cone, ACMR %.3f -> %.3f, %.2f ms\n", object->numOfClusters,
+           object->numOfFaces, (object->numOfClusters != 0) ? (GLfloat)object->numOfFaces / object->numOfClusters : 0.0f, count, before.acmr, after.acmr,
+           getTimeMs() - start);
+
+    return GL_TRUE;
+}
+
+
+void printCullStats(void)
+{
+    if (cullStats.frames == 0 || cullStats.clusters == 0)
+    {
+        return;
+    }
+
+    printf("Culled %.1f%% of clusters (%.1f%% frustum, %.1f%% back facing), %.1f%% of triangles, %.1f draws per frame\n",
+           100.0f * (cullStats.frustumCulled + cullStats.backfaceCulled) / cullStats.clusters, 100.0f * cullStats.frustumCulled / cullStats.clusters,
+           100.0f * cullStats.backfaceCulled / cullStats.clusters, 100.0f * cullStats.trianglesCulled / cullStats.triangles,
+           (GLfloat)cullStats.draws / cullStats.frames);
+
+    memset(&cullStats, 0, sizeof(cullStats_t));
+}
+
+
+void selectObjectLod(object_t *object)
+{
+    GLfloat distance, pixelsPerUnit;
+    GLuint level = 0;
+
+    /* Distance from the camera to the nearest point of the bounding sphere */
+    distance = sqrtf(dotProd(cameraPosition, cameraPosition)) - object->radius;
+
+    /* The coarsest level whose error projects to no more than lodPixelError pixels */
+    if (distance > 0.0f && lodPixelError > 0.0f)
+    {
+        pixelsPerUnit = (DISPLAY_HEIGHT * 0.5f) / (tanf(DEFAULT_FOV * 0.5f * PI / 180.0f) * distance);
+
+        while (level < object->lods.count && ARRAY_DATA(&object->lods, objectLod_t)[level].error * pixelsPerUnit <= lodPixelError)
+        {
+            level++;
+        }
+    }
+
+    if (level != object->lodLevel)
+    {
+        printf("LOD %u: %u faces\n", level, (level == 0) ? object->numOfFaces : ARRAY_DATA(&object->lods, objectLod_t)[level - 1].numOfFaces);
+        object->lodLevel = level;
+    }
+}
+
+
+GLboolean buildObjectBvh(object_t *object, threadPool_t *pool)
+{
+    GLuint *indices;
+    GLuint i;
+    GLboolean result;
+    double start;
+
+    if (object->bvh.numOfTriangles != 0)
+    {
+        return GL_TRUE;
+    }
+
+    start = getTimeMs();
+
+    /* The full mesh only, the levels of detail are coarser copies of the same surface */
+    indices = (GLuint *)malloc(sizeof(GLuint) * object->numOfFaces * ELEMENTS_PER_FACE);
+    if (indices == NULL)
+    {
+        return GL_FALSE;
+    }
+
+    for(i=0;i<object->numOfFaces * ELEMENTS_PER_FACE;i++)
+    {
+        indices[i] = getObjectIndex(object, i);
+    }
+
+    result = bvhBuild(&object->bvh, object->vertArray, indices, object->numOfFaces, pool);
+    free(indices);
+
+    if ( GL_FALSE == result )
+    {
+        printf("Error building the BVH\n");
+        return GL_FALSE;
+    }
+
+    printf("BVH: %u nodes, depth %u, %.1f KB, %.2f ms\n", object->bvh.nodes.count, object->bvh.depth,
+           ((size_t)object->bvh.nodes.count * sizeof(bvhNode_t) + (size_t)object->bvh.numOfTriangles * (sizeof(GLuint) + sizeof(GLfloat) * 9)) / 1024.0,
+           getTimeMs() - start);
+
+    return GL_TRUE;
+}
+
+
+GLuint getFaceMaterial(object_t *object, GLuint face)
+{
+    const material_change_t *changes = ARRAY_DATA(&object->materialChange, material_change_t);
+    GLuint low = 0, high = object->materialChange.count;
+    GLuint middle;
+
+    /* The last run starting at or before the face */
+    while (low < high)
+    {
+        middle = (low + high) / 2;
+        if (changes[middle].startFace <= face)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return (low > 0) ? changes[low - 1].material : MATERIAL_NONE;
+}
+
+
+void getPickRay(GLFWwindow *window, double x, double y, GLfloat *origin, GLfloat *direction)
+{
+    GLfloat view[3];
+    GLfloat scale, length;
+    GLint width, height;
+    GLuint k;
+
+    glfwGetWindowSize(window, &width, &height);
+
+    /* Through the cursor on the near plane, in view space the camera looks down -z */
+    scale = tanf(DEFAULT_FOV * 0.5f * PI / 180.0f);
+    view[0] = ((2.0f * (GLfloat)x / width) - 1.0f) * scale * ((GLfloat)DISPLAY_WIDTH / (GLfloat)DISPLAY_HEIGHT);
+    view[1] = (1.0f - (2.0f * (GLfloat)y / height)) * scale;
+    view[2] = -1.0f;
+
+    /* Back to model space through the transposed rotation, the same camera the culling uses */
+    getCameraPosition(modelViewMatrix, origin);
+
+    length = 0.0f;
+    for(k=0;k<3;k++)
+    {
+        direction[k] = (modelViewMatrix[k] * view[0]) + (modelViewMatrix[4+k] * view[1]) + (modelViewMatrix[8+k] * view[2]);
+        length += direction[k] * direction[k];
+    }
+
+    length = sqrtf(length);
+    for(k=0;k<3;k++)
+    {
+        direction[k] /= length;
+    }
+}
+
+
+void pickObject(object_t *object, materialLib_t *materials, GLFWwindow *window)
+{
+    GLfloat origin[3], direction[3];
+    bvhHit_t hit;
+    GLuint material;
+
+    pickPending = GL_FALSE;
+
+    if ( GL_FALSE == buildObjectBvh(object, threadPool) )
+    {
+        return;
+    }
+
+    getPickRay(window, pickX, pickY, origin, direction);
+
+    if ( GL_FALSE == bvhRayCast(&object->bvh, origin, direction, FLT_MAX, &hit) )
+    {
+        printf("Picked nothing at %.0f, %.0f\n", pickX, pickY);
+        return;
+    }
+
+    material = getFaceMaterial(object, hit.triangle);
+
+    printf("Picked face %u, material %s, at %.3f %.3f %.3f, %.3f from the camera\n", hit.triangle,
+           (material != MATERIAL_NONE && getMaterial(materials, material)->name != NULL) ? getMaterial(materials, material)->name : "(none)",
+           hit.point[0], hit.point[1], hit.point[2], hit.distance);
+}
+
+
+GLboolean loadModel(object_t *object, materialLib_t *materials, char *objFileName)
+{
+    char *path;
+    char *cacheFile;
+    double start;
+
+    start = getTimeMs();
+
+    path = getPath(objFileName);
+    cacheFile = getCacheFileName(objFileName);
+
+    /* Use the mesh cache when it matches the source files, parse otherwise */
+    if ( GL_TRUE == useMeshCache && GL_TRUE == loadMeshCache(object, materials, cacheFile, objFileName, path) )
+    {
+        printf("Loaded mesh cache: %s\n", cacheFile);
+    }
+    else if ( GL_FALSE == parseModel(object, materials, objFileName, path, cacheFile) )
+    {
+        cleanUp(object, materials);
+        free(cacheFile);
+        free(path);
+        return GL_FALSE;
+    }
+
+    applyObjSettings(object);
+
+    printf("Mesh ready in %.2f ms\n", getTimeMs() - start);
+
+    printModelInfo(object, materials);
+
+    free(cacheFile);
+
+    /* Pack what fits into atlas pages first, the rest keep a texture each */
+    if ( GL_TRUE == useAtlas && GL_FALSE == buildTextureAtlas(object, materials, path, threadPool) )
+    {
+        free(path);
+        return GL_FALSE;
+    }
+
+    /* Load texture files */
+    if ( GL_FALSE == loadTextures(materials, path, threadPool, GL_TRUE) )
+    {
+        free(path);
+        return GL_FALSE;
+    }
+
+    printTextureCacheStats();
+
+    free(path);
+
+    /* After the atlas, which may add vertices and reorder the runs */
+    if (lodPixelError > 0.0f)
+    {
+        buildObjectLods(object);
+    }
+
+    /* Clusters cover the levels of detail too */
+    if ( GL_TRUE == useCulling && GL_FALSE == buildObjectClusters(object) )
+    {
+        return GL_FALSE;
+    }
+
+    return GL_TRUE;
+}
+
+
+void prepareInterleavedVbo(object_t *object)
+{
+    GLuint i;
+    vertex_t *vertices;
+
+    vertices = (vertex_t *)malloc(sizeof(vertex_t)*object->numOfUniqueVertices);
+
+    for(i=0;i<object->numOfUniqueVertices;i++)
+    {
+        memcpy(vertices[i].position, &object->vertArray[i*ELEMENTS_PER_VERTEX], sizeof(vertices[i].position));
+        memcpy(vertices[i].texCoord, &object->texArray[i*ELEMENTS_PER_TEXCOORDS], sizeof(vertices[i].texCoord));
+        memcpy(vertices[i].normal, &object->normArray[i*ELEMENTS_PER_VERTEX], sizeof(vertices[i].normal));
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, vboids[VBO_INTERLEAVED]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_t)*object->numOfUniqueVertices, vertices, GL_STATIC_DRAW);
+    glVertexAttribPointer(aVertexLoc, ELEMENTS_PER_VERTEX, GL_FLOAT, 0, sizeof(vertex_t), BUFFER_OFFSET(offsetof(vertex_t, position)));
+    glVertexAttribPointer(aTexCoordsLoc, ELEMENTS_PER_TEXCOORDS, GL_FLOAT, 0, sizeof(vertex_t), BUFFER_OFFSET(offsetof(vertex_t, texCoord)));
+    glVertexAttribPointer(aNormalLoc, ELEMENTS_PER_VERTEX, GL_FLOAT, 0, sizeof(vertex_t), BUFFER_OFFSET(offsetof(vertex_t, normal)));
+
+    free(vertices);
+}
+
+
+void getAttributeBounds(const GLfloat *values, GLuint count, GLuint size, GLfloat *minimum, GLfloat *range)
+{
+    GLuint i, j;
+    GLfloat maximum[ELEMENTS_PER_VERTEX];
+
+    for(j=0;j<size;j++)
+    {
+        minimum[j] = (count != 0) ? values[j] : 0.0f;
+        maximum[j] = minimum[j];
+    }
+
+    for(i=0;i<count;i++)
+    {
+        for(j=0;j<size;j++)
+        {
+            minimum[j] = (values[(i*size)+j] < minimum[j]) ? values[(i*size)+j] : minimum[j];
+            maximum[j] = (values[(i*size)+j] > maximum[j]) ? values[(i*size)+j] : maximum[j];
+        }
+    }
+
+    /* Values decode as unorm * range + minimum */
+    for(j=0;j<size;j++)
+    {
+        range[j] = maximum[j] - minimum[j];
+    }
+}
+
+
+GLushort quantizeUnorm16(GLfloat value, GLfloat minimum, GLfloat range)
+{
+    GLfloat unorm = (range > 0.0f) ? (value - minimum) / range : 0.0f;
+
+    unorm = (unorm < 0.0f) ? 0.0f : ((unorm > 1.0f) ? 1.0f : unorm);
+
+    return (GLushort)((unorm * QUANT_UNORM16_MAX) + 0.5f);
+}
+
+
+void encodeOctahedral(const GLfloat *normal, GLubyte *dest, GLfloat *decoded)
+{
+    GLfloat l1 = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+    GLfloat x, y, z, fold;
+
+    x = (l1 > 0.0f) ? normal[0] / l1 : 0.0f;
+    y = (l1 > 0.0f) ? normal[1] / l1 : 0.0f;
+
+    /* Fold the lower hemisphere over the diagonals of the square */
+    if (l1 > 0.0f && normal[2] < 0.0f)
+    {
+        fold = x;
+        x = (1.0f - fabsf(y)) * ((fold >= 0.0f) ? 1.0f : -1.0f);
+        y = (1.0f - fabsf(fold)) * ((y >= 0.0f) ? 1.0f : -1.0f);
+    }
+
+    dest[0] = (GLubyte)((((x * 0.5f) + 0.5f) * QUANT_UNORM8_MAX) + 0.5f);
+    dest[1] = (GLubyte)((((y * 0.5f) + 0.5f) * QUANT_UNORM8_MAX) + 0.5f);
+
+    /* Decode the same way the vertex shader does, for the error report */
+    x = ((dest[0] / QUANT_UNORM8_MAX) * 2.0f) - 1.0f;
+    y = ((dest[1] / QUANT_UNORM8_MAX) * 2.0f) - 1.0f;
+    z = 1.0f - fabsf(x) - fabsf(y);
+    fold = (z < 0.0f) ? -z : 0.0f;
+    x += (x >= 0.0f) ? -fold : fold;
+    y += (y >= 0.0f) ? -fold : fold;
+
+    l1 = sqrtf((x * x) + (y * y) + (z * z));
+    decoded[0] = x / l1;
+    decoded[1] = y / l1;
+    decoded[2] = z / l1;
+}
+
+
+void prepareCompactVbo(object_t *object)
+{
+    GLuint i, j;
+    GLuint numOfNormals = 0;
+    compactVertex_t *vertices;
+    GLfloat positionMin[ELEMENTS_PER_VERTEX], positionRange[ELEMENTS_PER_VERTEX];
+    GLfloat texCoordMin[ELEMENTS_PER_VERTEX], texCoordRange[ELEMENTS_PER_VERTEX];
+    GLfloat decoded[ELEMENTS_PER_VERTEX];
+    GLfloat *normal;
+    GLfloat length, error, diagonal;
+    GLfloat positionError = 0.0f, texCoordError = 0.0f;
+    GLfloat normalError = 0.0f, normalErrorSum = 0.0f;
+
+    getAttributeBounds(object->vertArray, object->numOfUniqueVertices, ELEMENTS_PER_VERTEX, positionMin, positionRange);
+    getAttributeBounds(object->texArray, object->numOfUniqueVertices, ELEMENTS_PER_TEXCOORDS, texCoordMin, texCoordRange);
+
+    vertices = (compactVertex_t *)calloc(object->numOfUniqueVertices, sizeof(compactVertex_t));
+
+    for(i=0;i<object->numOfUniqueVertices;i++)
+    {
+        for(j=0;j<ELEMENTS_PER_VERTEX;j++)
+        {
+            vertices[i].position[j] = quantizeUnorm16(object->vertArray[(i*ELEMENTS_PER_VERTEX)+j], positionMin[j], positionRange[j]);
+
+            error = fabsf(((vertices[i].position[j] / QUANT_UNORM16_MAX) * positionRange[j]) + positionMin[j] - object->vertArray[(i*ELEMENTS_PER_VERTEX)+j]);
+            positionError = (error > positionError) ? error : positionError;
+        }
+
+        for(j=0;j<ELEMENTS_PER_TEXCOORDS;j++)
+        {
+            vertices[i].texCoord[j] = quantizeUnorm16(object->texArray[(i*ELEMENTS_PER_TEXCOORDS)+j], texCoordMin[j], texCoordRange[j]);
+
+            error = fabsf(((vertices[i].texCoord[j] / QUANT_UNORM16_MAX) * texCoordRange[j]) + texCoordMin[j] - object->texArray[(i*ELEMENTS_PER_TEXCOORDS)+j]);
+            texCoordError = (error > texCoordError) ? error : texCoordError;
+        }
+
+        normal = &object->normArray[i*ELEMENTS_PER_VERTEX];
+        encodeOctahedral(normal, vertices[i].normal, decoded);
+
+        /* Missing normals have no direction to lose */
+        length = sqrtf((normal[0] * normal[0]) + (normal[1] * normal[1]) + (normal[2] * normal[2]));
+        if (length > 0.0f)
+        {
+            error = ((normal[0] * decoded[0]) + (normal[1] * decoded[1]) + (normal[2] * decoded[2])) / length;
+            error = acosf((error > 1.0f) ? 1.0f : error) * (180.0f / PI);
+            normalError = (error > normalError) ? error : normalError;
+            normalErrorSum += error;
+            numOfNormals++;
+        }
+    }
+
+    /* The shader decodes with these, positions through uMVP as well */
+    positionScale = (vec3_t){ positionRange[0], positionRange[1], positionRange[2] };
+    positionOffset = (vec3_t){ positionMin[0], positionMin[1], positionMin[2] };
+
+    glUniform3f(uPositionScaleLoc, positionScale.x, positionScale.y, positionScale.z);
+    glUniform3f(uPositionOffsetLoc, positionOffset.x, positionOffset.y, positionOffset.z);
+    glUniform2f(uTexCoordScaleLoc, texCoordRange[0], texCoordRange[1]);
+    glUniform2f(uTexCoordOffsetLoc, texCoordMin[0], texCoordMin[1]);
+    updateModelViewProjMatrix();
+
+    glBindBuffer(GL_ARRAY_BUFFER, vboids[VBO_INTERLEAVED]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(compactVertex_t)*object->numOfUniqueVertices, vertices, GL_STATIC_DRAW);
+    glVertexAttribPointer(aVertexLoc, ELEMENTS_PER_VERTEX, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(compactVertex_t), BUFFER_OFFSET(offsetof(compactVertex_t, position)));
+    glVertexAttribPointer(aTexCoordsLoc, ELEMENTS_PER_TEXCOORDS, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(compactVertex_t), BUFFER_OFFSET(offsetof(compactVertex_t, texCoord)));
+    glVertexAttribPointer(aNormalLoc, 2, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(compactVertex_t), BUFFER_OFFSET(offsetof(compactVertex_t, normal)));
+
+    free(vertices);
+
+    diagonal = sqrtf((positionRange[0] * positionRange[0]) + (positionRange[1] * positionRange[1]) + (positionRange[2] * positionRange[2]));
+
+    printf("\tcompact vertices: %d -> %d bytes per vertex, %.1f KB saved\n",
+           (GLint)sizeof(vertex_t), (GLint)sizeof(compactVertex_t),
+           ((sizeof(vertex_t) - sizeof(compactVertex_t)) * object->numOfUniqueVertices) / 1024.0f);
+    printf("\tquantization error: position max %g (%.5f%% of bounds diagonal), texcoord max %g, normal max %.3f deg avg %.3f deg\n",
+           positionError, (diagonal > 0.0f) ? 100.0f * positionError / diagonal : 0.0f, texCoordError,
+           normalError, (numOfNormals != 0) ? normalErrorSum / numOfNormals : 0.0f);
+}
+
+
+void prepareSeparateVbos(object_t *object)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, vboids[VBO_VERT]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*object->numOfUniqueVertices*ELEMENTS_PER_VERTEX, object->vertArray, GL_STATIC_DRAW);
+    glVertexAttribPointer(aVertexLoc, ELEMENTS_PER_VERTEX, GL_FLOAT, 0, 0, BUFFER_OFFSET(0));
+
+    glBindBuffer(GL_ARRAY_BUFFER, vboids[VBO_TEX]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*object->numOfUniqueVertices*ELEMENTS_PER_TEXCOORDS, object->texArray, GL_STATIC_DRAW);
+    glVertexAttribPointer(aTexCoordsLoc, ELEMENTS_PER_TEXCOORDS, GL_FLOAT, 0, 0, BUFFER_OFFSET(0));
+
+    glBindBuffer(GL_ARRAY_BUFFER, vboids[VBO_NORM]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*object->numOfUniqueVertices*ELEMENTS_PER_VERTEX, object->normArray, GL_STATIC_DRAW);
+    glVertexAttribPointer(aNormalLoc, ELEMENTS_PER_VERTEX, GL_FLOAT, 0, 0, BUFFER_OFFSET(0));
+}
+
+
+void prepareIndexBuffer(object_t *object)
+{
+    GLsizeiptr baseSize = object->indexSize*object->numOfFaces*ELEMENTS_PER_FACE;
+    GLushort *shortIndices;
+    GLuint i;
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vboids[VBO_INDEX]);
+
+    if (object->lodIndices.count == 0)
+    {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, baseSize, object->indexArray, GL_STATIC_DRAW);
+        return;
+    }
+
+    /* Levels of detail follow the full mesh in the same buffer and index type */
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, baseSize + (object->indexSize*object->lodIndices.count), NULL, GL_STATIC_DRAW);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, baseSize, object->indexArray);
+
+    if (object->indexType == GL_UNSIGNED_INT)
+    {
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, baseSize, sizeof(GLuint)*object->lodIndices.count, object->lodIndices.data);
+        return;
+    }
+
+    shortIndices = (GLushort *)malloc(sizeof(GLushort)*object->lodIndices.count);
+    if (shortIndices == NULL)
+    {
+        return;
+    }
+
+    for(i=0;i<object->lodIndices.count;i++)
+    {
+        shortIndices[i] = (GLushort)ARRAY_DATA(&object->lodIndices, GLuint)[i];
+    }
+
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, baseSize, sizeof(GLushort)*object->lodIndices.count, shortIndices);
+    free(shortIndices);
+}
+
+
+GLboolean prepareVbos(object_t *object)
+{
+    if (object->indexType == GL_UNSIGNED_INT && GL_FALSE == useUintIndices)
+    {
+        printf("Model has %u vertices, more than 16-bit indices reach, and the context has neither OpenGL ES 3 nor OES_element_index_uint\n",
+               object->numOfUniqueVertices);
+        return GL_FALSE;
+    }
+
+    /* Record the attribute setup in the VAO when there is one */
+    if (vaoId != 0)
+    {
+        bindVertexArrayOES(vaoId);
+    }
+
+    if (vertexFormat == VERTEX_FORMAT_COMPACT)
+    {
+        prepareCompactVbo(object);
+    }
+    else if (vertexLayout == VERTEX_LAYOUT_INTERLEAVED)
+    {
+        prepareInterleavedVbo(object);
+    }
+    else
+    {
+        prepareSeparateVbos(object);
+    }
+
+    prepareIndexBuffer(object);
+
+    glEnableVertexAttribArray(aVertexLoc);
+    glEnableVertexAttribArray(aNormalLoc);
+    glEnableVertexAttribArray(aTexCoordsLoc);
+
+    return GL_TRUE;
+}
+
+
+void queueStreamVertices(streamLoad_t *stream, objChunk_t *chunk, GLuint firstFace)
+{
+    GLuint i, numOfFaces;
+    GLuint *corner;
+    vertex_t *vertices;
+    GLuint numOfVertices = chunk->v.count / ELEMENTS_PER_VERTEX;
+    GLuint numOfTexCoords = chunk->vt.count / ELEMENTS_PER_TEXCOORDS;
+    GLuint numOfNormals = chunk->vn.count / ELEMENTS_PER_VERTEX;
+
+    numOfFaces = (chunk->f.count / INDICES_PER_FACE) - firstFace;
+    if (numOfFaces == 0)
+    {
+        return;
+    }
+
+    /* Expand the new faces outside the lock, the render loop only copies them */
+    vertices = (vertex_t *)malloc(sizeof(vertex_t)*numOfFaces*ELEMENTS_PER_FACE);
+
+    for(i=0;i<numOfFaces*ELEMENTS_PER_FACE;i++)
+    {
+        corner = &ARRAY_DATA(&chunk->f, GLuint)[(firstFace*INDICES_PER_FACE) + (i*ELEMENTS_PER_CORNER)];
+
+        copyIndexedElement(vertices[i].position, ARRAY_DATA(&chunk->v, GLfloat), corner[0], numOfVertices, ELEMENTS_PER_VERTEX);
+        copyIndexedElement(vertices[i].texCoord, ARRAY_DATA(&chunk->vt, GLfloat), corner[1], numOfTexCoords, ELEMENTS_PER_TEXCOORDS);
+        copyIndexedElement(vertices[i].normal, ARRAY_DATA(&chunk->vn, GLfloat), corner[2], numOfNormals, ELEMENTS_PER_VERTEX);
+    }
+
+    pthread_mutex_lock(&stream->lock);
+    arrayAppend(&stream->pendingVertices, vertices, numOfFaces*ELEMENTS_PER_FACE);
+    pthread_mutex_unlock(&stream->lock);
+
+    free(vertices);
+}
+
+
+void queueStreamSettings(streamLoad_t *stream, objChunk_t *chunk, GLuint firstEvent)
+{
+    objEvent_t *events = ARRAY_DATA(&chunk->events, objEvent_t);
+    GLuint i;
+
+    pthread_mutex_lock(&stream->lock);
+
+    for(i=firstEvent;i<chunk->events.count;i++)
+    {
+        switch(events[i].type)
+        {
+            case OBJ_EVENT_LIGHTPOS: memcpy(&stream->lightPosition, events[i].value, sizeof(vec3_t));  stream->settings |= OBJ_SETTING_LIGHTPOS; break;
+            case OBJ_EVENT_CAMPOS:   memcpy(&stream->cameraPosition, events[i].value, sizeof(vec3_t)); stream->settings |= OBJ_SETTING_CAMPOS;   break;
+            case OBJ_EVENT_CAMFRONT: memcpy(&stream->cameraFront, events[i].value, sizeof(vec3_t));    stream->settings |= OBJ_SETTING_CAMFRONT; break;
+            case OBJ_EVENT_CAMUP:    memcpy(&stream->cameraUp, events[i].value, sizeof(vec3_t));       stream->settings |= OBJ_SETTING_CAMUP;    break;
+            default: break;
+        }
+    }
+
+    pthread_mutex_unlock(&stream->lock);
+}
+
+
+GLboolean streamObjFile(streamLoad_t *stream)
+{
+    objChunk_t chunk;
+    const char *data;
+    const char *end;
+    const char *sliceEnd;
+    size_t size;
+    GLuint queuedFaces = 0;
+    GLuint queuedEvents = 0;
+    GLboolean result;
+
+    data = mapFile(stream->objFileName, &size);
+    if (data == NULL)
+    {
+       printf("Error opening OBJ file\n");
+       return GL_FALSE;
+    }
+
+    /* One chunk grows over the whole file, so all indices resolve as they are read */
+    initObjChunk(&chunk);
+    chunk.object = stream->object;
+    chunk.end = data;
+    end = data + size;
+
+    while (chunk.end < end)
+    {
+        chunk.start = chunk.end;
+        sliceEnd = ((size_t)(end - chunk.start) > STREAM_SLICE_SIZE) ? chunk.start + STREAM_SLICE_SIZE : end;
+        sliceEnd = (const char *)memchr(sliceEnd - 1, '\n', end - (sliceEnd - 1));
+        chunk.end = (sliceEnd == NULL) ? end : sliceEnd + 1;
+
+        parseObjChunk(&chunk);
+
+        queueStreamVertices(stream, &chunk, queuedFaces);
+        queueStreamSettings(stream, &chunk, queuedEvents);
+
+        queuedFaces = chunk.f.count / INDICES_PER_FACE;
+        queuedEvents = chunk.events.count;
+    }
+
+    takeChunkArray(&stream->object->v, &chunk.v);
+    takeChunkArray(&stream->object->vt, &chunk.vt);
+    takeChunkArray(&stream->object->vn, &chunk.vn);
+    takeChunkArray(&stream->object->f, &chunk.f);
+
+    /* Settings only go to the object here, the render loop already has them */
+    result = applyObjEvents(stream->object, stream->materials, &chunk);
+
+    freeObjChunk(&chunk);
+    finishObjectData(stream->object);
+    unmapFile(data, size);
+
+    return result;
+}
+
+
+void streamLoadTask(void *arg)
+{
+    streamLoad_t *stream = (streamLoad_t *)arg;
+    streamTexture_t texture;
+    mtlLoad_t mtl;
+    imageLoader_t loader;
+    imageLoad_t *loads = NULL;
+    imageLoad_t *load;
+    GLboolean result = GL_TRUE;
+    GLuint count = 0;
+    GLuint i, j;
+
+    /* Parse unless the mesh came from the cache */
+    if (GL_FALSE == stream->meshReady)
+    {
+        startMtlLoad(&mtl, stream->objFileName, stream->path);
+
+        result = streamObjFile(stream);
+
+        if ( GL_TRUE == result )
+        {
+            result = finishModel(stream->object, stream->materials, &mtl, stream->objFileName, stream->path, stream->cacheFileName);
+        }
+        else if ( GL_TRUE == mtl.submitted )
+        {
+            threadPoolWait(threadPool);
+        }
+
+        freeMtlLoad(&mtl);
+
+        /* From here on the render loop owns the object */
+        pthread_mutex_lock(&stream->lock);
+        stream->meshReady = result;
+        pthread_mutex_unlock(&stream->lock);
+    }
+
+    if (GL_TRUE == result)
+    {
+        loads = (imageLoad_t *)calloc(stream->materials->materials.count + 1, sizeof(imageLoad_t));
+        result = (loads != NULL) ? GL_TRUE : GL_FALSE;
+    }
+
+    /* One decode per file, the render loop hands it to every material using it */
+    for(i=0;i<stream->materials->materials.count && GL_TRUE == result;i++)
+    {
+        for(j=0;j<i && getMaterial(stream->materials, j)->fileName != getMaterial(stream->materials, i)->fileName;j++);
+
+        if (getMaterial(stream->materials, i)->fileName != NULL && j == i)
+        {
+            loads[count].fileName = getTexturePath(getMaterial(stream->materials, i), stream->path);
+            loads[count].tag = i;
+            count++;
+        }
+    }
+
+    /* Decode the textures on the workers, the render loop uploads them as they arrive */
+    if (GL_TRUE == result)
+    {
+        imageLoaderStart(&loader, threadPool, loads, count, textureLoadFlags);
+
+        while ((load = imageLoaderNext(&loader)) != NULL)
+        {
+            /* Queued without data, the render loop leaves the material untextured */
+            texture.material = load->tag;
+            texture.image = load->image;
+            texture.image.data = (GL_TRUE == load->result) ? load->image.data : NULL;
+
+            pthread_mutex_lock(&stream->lock);
+            arrayAppend(&stream->pendingTextures, &texture, 1);
+            pthread_mutex_unlock(&stream->lock);
+        }
+
+        imageLoaderFinish(&loader);
+    }
+
+    for(i=0;i<count;i++)
+    {
+        free((char *)loads[i].fileName);
+    }
+    free(loads);
+
+    pthread_mutex_lock(&stream->lock);
+    stream->result = result;
+    stream->finished = GL_TRUE;
+    pthread_mutex_unlock(&stream->lock);
+}
+
+
+void startStreamLoad(streamLoad_t *stream, object_t *object, materialLib_t *materials, char *objFileName)
+{
+    GLubyte placeholder[] = { STREAM_PLACEHOLDER_COLOR };
+
+    memset(stream, 0, sizeof(streamLoad_t));
+
+    stream->object = object;
+    stream->materials = materials;
+    stream->objFileName = objFileName;
+    stream->path = getPath(objFileName);
+    stream->cacheFileName = getCacheFileName(objFileName);
+    stream->start = getTimeMs();
+
+    pthread_mutex_init(&stream->lock, NULL);
+    arrayInit(&stream->pendingVertices, sizeof(vertex_t));
+    arrayInit(&stream->pendingTextures, sizeof(streamTexture_t));
+    arrayInit(&stream->previewVertices, sizeof(vertex_t));
+
+    /* Textures show a flat placeholder until their decode finishes */
+    glGenTextures(1, &stream->placeholderTexId);
+    glBindTexture(GL_TEXTURE_2D, stream->placeholderTexId);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB8, 1, 1);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGB, GL_UNSIGNED_BYTE, placeholder);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+    glGenBuffers(1, &stream->previewVbo);
+
+    /* A valid cache is mapped right away, only the textures stream in then */
+    if ( GL_TRUE == useMeshCache && GL_TRUE == loadMeshCache(object, materials, stream->cacheFileName, objFileName, stream->path) )
+    {
+        printf("Loaded mesh cache: %s\n", stream->cacheFileName);
+        stream->meshReady = GL_TRUE;
+
+        /* Hand the cached settings over the same way parsed ones are */
+        stream->settings = object->settings;
+        stream->lightPosition = object->lightPosition;
+        stream->cameraPosition = object->cameraPosition;
+        stream->cameraFront = object->cameraFront;
+        stream->cameraUp = object->cameraUp;
+    }
+    else
+    {
+        printf("Streaming object file: %s\n", objFileName);
+    }
+
+    stream->loader = threadPoolCreate(1);
+    threadPoolSubmit(stream->loader, streamLoadTask, stream);
+}
+
+
+void appendPreviewVertices(streamLoad_t *stream, array_t *vertices)
+{
+    GLuint offset = stream->previewVertices.count;
+
+    if (vertices->count == 0)
+    {
+        return;
+    }
+
+    if (offset == 0)
+    {
+        printf("First triangles after %.2f ms\n", getTimeMs() - stream->start);
+    }
+
+    arrayAppend(&stream->previewVertices, vertices->data, vertices->count);
+
+    glBindBuffer(GL_ARRAY_BUFFER, stream->previewVbo);
+
+    /* Grow geometrically, a new store is filled from the CPU copy */
+    if (stream->previewVertices.count > stream->previewCapacity)
+    {
+        stream->previewCapacity = (stream->previewCapacity < STREAM_MIN_VBO_VERTICES) ? STREAM_MIN_VBO_VERTICES : stream->previewCapacity;
+        while (stream->previewCapacity < stream->previewVertices.count)
+        {
+            stream->previewCapacity *= 2;
+        }
+
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_t)*stream->previewCapacity, NULL, GL_DYNAMIC_DRAW);
+        offset = 0;
+    }
+
+    glBufferSubData(GL_ARRAY_BUFFER, sizeof(vertex_t)*offset, sizeof(vertex_t)*(stream->previewVertices.count - offset),
+                    ARRAY_DATA(&stream->previewVertices, vertex_t) + offset);
+}
+
+
+GLboolean updateStreamLoad(streamLoad_t *stream)
+{
+    array_t vertices;
+    array_t textures;
+    streamTexture_t *texture;
+    material_t *material;
+    char *fileName;
+    GLuint settings;
+    GLboolean meshReady;
+    GLboolean finished;
+    GLuint i, j;
+
+    arrayInit(&vertices, sizeof(vertex_t));
+    arrayInit(&textures, sizeof(streamTexture_t));
+
+    /* Take whatever the loader has produced since the last frame */
+    pthread_mutex_lock(&stream->lock);
+
+    takeChunkArray(&vertices, &stream->pendingVertices);
+    takeChunkArray(&textures, &stream->pendingTextures);
+    settings = stream->settings;
+    stream->settings = 0;
+    lightPosition = (settings & OBJ_SETTING_LIGHTPOS) ? stream->lightPosition : lightPosition;
+    cameraPosition = (settings & OBJ_SETTING_CAMPOS) ? stream->cameraPosition : cameraPosition;
+    cameraFront = (settings & OBJ_SETTING_CAMFRONT) ? stream->cameraFront : cameraFront;
+    cameraUp = (settings & OBJ_SETTING_CAMUP) ? stream->cameraUp : cameraUp;
+    meshReady = stream->meshReady;
+    finished = stream->finished;
+
+    pthread_mutex_unlock(&stream->lock);
+
+    if (settings & OBJ_SETTING_LIGHTPOS)
+    {
+        glUniform3fv(uLightPosLoc, 1, (GLfloat*)&lightPosition);
+    }
+
+    /* Switch to the final indexed mesh once it is complete */
+    if ( GL_TRUE == meshReady && GL_FALSE == stream->meshActive )
+    {
+        printf("Mesh ready in %.2f ms\n", getTimeMs() - stream->start);
+        printModelInfo(stream->object, stream->materials);
+
+        for(i=0;i<stream->materials->materials.count;i++)
+        {
+            material = getMaterial(stream->materials, i);
+            material->texId = (material->fileName != NULL) ? stream->placeholderTexId : material->texId;
+        }
+
+        if ( GL_FALSE == prepareVbos(stream->object) )
+        {
+            return GL_FALSE;
+        }
+
+        glDeleteBuffers(1, &stream->previewVbo);
+        stream->previewVbo = 0;
+        arrayFree(&stream->previewVertices);
+        stream->meshActive = GL_TRUE;
+    }
+    else if ( GL_FALSE == stream->meshActive )
+    {
+        appendPreviewVertices(stream, &vertices);
+    }
+
+    texture = ARRAY_DATA(&textures, streamTexture_t);
+    for(i=0;i<textures.count;i++)
+    {
+        material = getMaterial(stream->materials, texture[i].material);
+        fileName = getTexturePath(material, stream->path);
+
+        /* Upload unless an earlier model already has this file */
+        material->texId = texCacheAcquire(&textureCache, fileName);
+        if (material->texId == 0 && texture[i].image.data == NULL)
+        {
+            printf("Error loading tex file: %s, leaving it untextured\n", material->fileName);
+        }
+        else if (material->texId == 0)
+        {
+            uploadTexture(material, &texture[i].image);
+            texCacheInsert(&textureCache, fileName, material->texId, imageGetLevelOffset(&texture[i].image, texture[i].image.levels));
+        }
+
+        for(j=texture[i].material + 1;j<stream->materials->materials.count;j++)
+        {
+            if (getMaterial(stream->materials, j)->fileName == material->fileName)
+            {
+                getMaterial(stream->materials, j)->texId = texCacheAcquire(&textureCache, fileName);
+            }
+        }
+
+        free(fileName);
+        free(texture[i].image.data);
+        printf("Loaded tex file: %s after %.2f ms\n", material->fileName, getTimeMs() - stream->start);
+    }
+
+    arrayFree(&vertices);
+    arrayFree(&textures);
+
+    if ( GL_TRUE == finished && stream->loader != NULL )
+    {
+        threadPoolDestroy(stream->loader);
+        stream->loader = NULL;
+
+        if ( GL_FALSE == stream->result )
+        {
+            printf("\nError loading model\n");
+            return GL_FALSE;
+        }
+
+        printTextureCacheStats();
+    }
+
+    return GL_TRUE;
+}
+
+
+void drawStreamPreview(streamLoad_t *stream)
+{
+    material_t material;
+
+    if (stream->previewVertices.count == 0)
+    {
+        return;
+    }
+
+    if (vaoId != 0)
+    {
+        bindVertexArrayOES(0);
+    }
+
+    /* Untextured default material until the real ones are loaded */
+    memset(&material, 0, sizeof(material_t));
+    setMaterialDefaults(&material);
+    glBindTexture(GL_TEXTURE_2D, stream->placeholderTexId);
+    glUniform3fv(uKaLoc, 1, (GLfloat *)&material.Ka);
+    glUniform3fv(uKdLoc, 1, (GLfloat *)&material.Kd);
+    glUniform3fv(uKsLoc, 1, (GLfloat *)&material.Ks);
+    glUniform1f(uDLoc, material.d);
+    glDisable(GL_BLEND);
+
+    glBindBuffer(GL_ARRAY_BUFFER, stream->previewVbo);
+    glVertexAttribPointer(aVertexLoc, ELEMENTS_PER_VERTEX, GL_FLOAT, 0, sizeof(vertex_t), BUFFER_OFFSET(offsetof(vertex_t, position)));
+    glVertexAttribPointer(aTexCoordsLoc, ELEMENTS_PER_TEXCOORDS, GL_FLOAT, 0, sizeof(vertex_t), BUFFER_OFFSET(offsetof(vertex_t, texCoord)));
+    glVertexAttribPointer(aNormalLoc, ELEMENTS_PER_VERTEX, GL_FLOAT, 0, sizeof(vertex_t), BUFFER_OFFSET(offsetof(vertex_t, normal)));
+    glEnableVertexAttribArray(aVertexLoc);
+    glEnableVertexAttribArray(aNormalLoc);
+    glEnableVertexAttribArray(aTexCoordsLoc);
+
+    glDrawArrays(GL_TRIANGLES, 0, stream->previewVertices.count);
+}
+
+
+void finishStreamLoad(streamLoad_t *stream)
+{
+    GLuint i;
+
+    /* Let the loader finish before the object is freed */
+    if (stream->loader != NULL)
+    {
+        threadPoolDestroy(stream->loader);
+        stream->loader = NULL;
+    }
+
+    /* Textures decoded after the last frame were never uploaded */
+    for(i=0;i<stream->pendingTextures.count;i++)
+    {
+        free(ARRAY_DATA(&stream->pendingTextures, streamTexture_t)[i].image.data);
+    }
+
+    pthread_mutex_destroy(&stream->lock);
+    arrayFree(&stream->pendingVertices);
+    arrayFree(&stream->pendingTextures);
+    arrayFree(&stream->previewVertices);
+    glDeleteBuffers(1, &stream->previewVbo);
+    glDeleteTextures(1, &stream->placeholderTexId);
+    free(stream->path);
+    free(stream->cacheFileName);
+}
+
+
+GLint benchmarkDraw(object_t *object, materialLib_t *materials, GLint frames)
+{
+    static const char *layoutNames[] = { "interleaved", "separate" };
+    vertexLayout_e layouts[] = { VERTEX_LAYOUT_SEPARATE, VERTEX_LAYOUT_INTERLEAVED };
+    GLuint vertexArrayObject = vaoId;
+    GLuint i, j, k;
+    double start, elapsed, best;
+
+    printf("%-12s %5s %10s %10s %10s\n", "layout", "vao", "min ms", "avg ms", "frames/s");
+
+    /* Every layout without a VAO first, then with one if available */
+    for(k=0;k<(GLuint)((vertexArrayObject != 0) ? 2 : 1);k++)
+    {
+        vaoId = (k == 0) ? 0 : vertexArrayObject;
+        if (vertexArrayObject != 0)
+        {
+            bindVertexArrayOES(vaoId);
+        }
+
+        /* The compact format is always interleaved */
+        for(i=0;i<((vertexFormat == VERTEX_FORMAT_COMPACT) ? 1 : sizeof(layouts)/sizeof(layouts[0]));i++)
+        {
+            vertexLayout = layouts[i];
+            prepareVbos(object);
+
+            for(j=0;j<BENCH_WARMUP_FRAMES;j++)
+            {
+                glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+                drawVertices(object, materials);
+            }
+            glFinish();
+
+            /* Wait for every frame so the GPU time is included */
+            best = 0.0;
+            start = getTimeMs();
+            for(j=0;j<(GLuint)frames;j++)
+            {
+                elapsed = getTimeMs();
+
+                glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+                drawVertices(object, materials);
+                glFinish();
+
+                elapsed = getTimeMs() - elapsed;
+                best = (j == 0 || elapsed < best) ? elapsed : best;
+            }
+            elapsed = getTimeMs() - start;
+
+            printf("%-12s %5s %10.3f %10.3f %10.1f\n", (vertexFormat == VERTEX_FORMAT_COMPACT) ? "compact" : layoutNames[layouts[i]], (vaoId != 0) ? "yes" : "no",
+                   best, elapsed / frames, frames / (elapsed / 1000.0));
+        }
+    }
+
+    return 0;
+}
+
+
+void releaseBenchTextures(void *arg)
+{
+    releaseTextures(((textureBench_t *)arg)->materials);
+}
+
+
+GLboolean reloadBenchTextures(threadPool_t *pool, void *arg)
+{
+    textureBench_t *bench = (textureBench_t *)arg;
+
+    return loadTextures(bench->materials, bench->path, pool, GL_FALSE);
+}
+
+
+GLint benchmarkTextures(materialLib_t *materials, char *objFileName, GLint iterations, GLuint maxThreads)
+{
+    textureBench_t bench;
+    GLint ret;
+
+    bench.materials = materials;
+    bench.path = getPath(objFileName);
+
+    ret = imageBenchmarkLoads(releaseBenchTextures, reloadBenchTextures, &bench, materials->materials.count, iterations, maxThreads);
+
+    free(bench.path);
+
+    return ret;
+}
+
+
+GLint benchmarkDecode(materialLib_t *materials, char *objFileName, GLint iterations)
+{
+    material_t *material;
+    char **fileNames;
+    char *path;
+    GLuint i, j, count = 0;
+    GLint ret;
+
+    path = getPath(objFileName);
+
+    fileNames = (char **)calloc(materials->materials.count + 1, sizeof(char *));
+    if (fileNames == NULL)
+    {
+        free(path);
+        return -1;
+    }
+
+    for(i=0;i<materials->materials.count;i++)
+    {
+        material = getMaterial(materials, i);
+
+        /* Each file once, the names are interned so a pointer compare is enough */
+        for(j=0;j<i && getMaterial(materials, j)->fileName != material->fileName;j++);
+        if (material->fileName != NULL && j == i)
+        {
+            fileNames[count++] = getTexturePath(material, path);
+        }
+    }
+
+    ret = imageBenchmarkDecode((const char **)fileNames, count, iterations);
+
+    for(i=0;i<count;i++)
+    {
+        free(fileNames[i]);
+    }
+    free(fileNames);
+    free(path);
+
+    return ret;
+}
+
+
+GLfloat getBenchRandom(GLuint *seed)
+{
+    /* xorshift, the same rays on every run */
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+
+    return (GLfloat)(*seed & 0xFFFFFF) / (GLfloat)0x1000000;
+}
+
+
+void getBenchSpherePoint(GLuint *seed, GLfloat radius, GLboolean surface, GLfloat *point)
+{
+    GLfloat length;
+    GLuint k;
+
+    /* Rejection sampled in the unit ball, pushed out to the surface if asked */
+    do
+    {
+        length = 0.0f;
+        for(k=0;k<3;k++)
+        {
+            point[k] = (getBenchRandom(seed) * 2.0f) - 1.0f;
+            length += point[k] * point[k];
+        }
+    } while (length > 1.0f || length < 0.0001f);
+
+    length = ( GL_TRUE == surface ) ? sqrtf(length) : 1.0f;
+    for(k=0;k<3;k++)
+    {
+        point[k] *= radius / length;
+    }
+}
+
+
+void castBenchRays(void *arg)
+{
+    rayBenchTask_t *task = (rayBenchTask_t *)arg;
+    bvhHit_t hit;
+    GLuint i;
+
+    task->hits = 0;
+
+    for(i=task->start;i<task->end;i++)
+    {
+        if ( GL_TRUE == task->closestPoint )
+        {
+            task->hits += (GL_TRUE == bvhClosestPoint(task->bvh, &task->rays[i*6], FLT_MAX, &hit)) ? 1 : 0;
+        }
+        else
+        {
+            task->hits += (GL_TRUE == bvhRayCast(task->bvh, &task->rays[i*6], &task->rays[i*6+3], FLT_MAX, &hit)) ? 1 : 0;
+        }
+    }
+}
+
+
+GLuint runBenchRays(threadPool_t *pool, rayBenchTask_t *tasks, GLuint numOfTasks)
+{
+    GLuint hits = 0;
+    GLuint i;
+
+    if (pool != NULL && numOfTasks > 1)
+    {
+        for(i=0;i<numOfTasks;i++)
+        {
+            threadPoolSubmit(pool, castBenchRays, &tasks[i]);
+        }
+        threadPoolWait(pool);
+    }
+    else
+    {
+        for(i=0;i<numOfTasks;i++)
+        {
+            castBenchRays(&tasks[i]);
+        }
+    }
+
+    for(i=0;i<numOfTasks;i++)
+    {
+        hits += tasks[i].hits;
+    }
+
+    return hits;
+}
+
+
+GLint benchmarkRays(object_t *object, GLint count)
+{
+    static const char *queryNames[] = { "ray cast", "closest point" };
+    rayBenchTask_t tasks[MAX_PARSE_THREADS];
+    GLfloat *rays;
+    GLfloat target[3];
+    GLuint numOfRays = (GLuint)count;
+    GLuint numOfPasses = (objParseThreads > 1) ? 2 : 1;
+    GLuint numOfTasks, query, pass, hits, seed = 1;
+    GLuint i, k;
+    double start, elapsed, single = 0.0;
+
+    /* One thread first, then the pool, both give the same nodes */
+    for(pass=0;pass<numOfPasses;pass++)
+    {
+        bvhFree(&object->bvh);
+        printf("%u thread(s) ", (pass == 0) ? 1 : objParseThreads);
+        if ( GL_FALSE == buildObjectBvh(object, (pass == 0) ? NULL : threadPool) )
+        {
+            return -1;
+        }
+    }
+
+    /* Rays from outside the model towards points inside it, closest points in and around it */
+    updateObjectRadius(object);
+    rays = (GLfloat *)malloc(sizeof(GLfloat) * 6 * numOfRays);
+    if (rays == NULL)
+    {
+        return -1;
+    }
+
+    printf("%-14s %8s %10s %12s %10s %10s\n", "query", "threads", "hit %", "queries/s", "ms", "speedup");
+
+    for(query=0;query<2;query++)
+    {
+        for(i=0;i<numOfRays;i++)
+        {
+            if (query == 0)
+            {
+                getBenchSpherePoint(&seed, object->radius * BENCH_RAY_ORIGIN_RADIUS, GL_TRUE, &rays[i*6]);
+                getBenchSpherePoint(&seed, object->radius, GL_FALSE, target);
+
+                for(k=0;k<3;k++)
+                {
+                    rays[i*6+3+k] = target[k] - rays[i*6+k];
+                }
+            }
+            else
+            {
+                getBenchSpherePoint(&seed, object->radius * BENCH_RAY_ORIGIN_RADIUS, GL_FALSE, &rays[i*6]);
+            }
+        }
+
+        for(pass=0;pass<numOfPasses;pass++)
+        {
+            numOfTasks = (pass == 0) ? 1 : objParseThreads;
+            for(i=0;i<numOfTasks;i++)
+            {
+                tasks[i].bvh = &object->bvh;
+                tasks[i].rays = rays;
+                tasks[i].closestPoint = (query == 1) ? GL_TRUE : GL_FALSE;
+                tasks[i].start = (GLuint)(((uint64_t)numOfRays * i) / numOfTasks);
+                tasks[i].end = (GLuint)(((uint64_t)numOfRays * (i + 1)) / numOfTasks);
+            }
+
+            start = getTimeMs();
+            hits = runBenchRays((pass == 0) ? NULL : threadPool, tasks, numOfTasks);
+            elapsed = getTimeMs() - start;
+            single = (pass == 0) ? elapsed : single;
+
+            printf("%-14s %8u %10.1f %12.0f %10.2f %9.2fx\n", queryNames[query], numOfTasks, 100.0 * hits / numOfRays,
+                   numOfRays / (elapsed / 1000.0), elapsed, single / elapsed);
+        }
+    }
+
+    free(rays);
+
+    return 0;
+}
+
+
+GLint benchmarkLoad(char **objFileNames, GLint fileCount, GLint iterations, GLuint maxThreads)
+{
+    GLint i, j;
+    GLuint threads;
+    object_t object;
+    materialLib_t materials;
+    struct stat fileInfo;
+    double start, elapsed, best, total;
+    double sizeMb;
+
+    printf("%-48s %8s %10s %10s %10s %10s\n", "model", "threads", "size MB", "min ms", "avg ms", "MB/s");
+
+    for(i=0;i<fileCount;i++)
+    {
+        if ( stat(objFileNames[i], &fileInfo) != 0 )
+        {
+            printf("Error opening OBJ file %s\n", objFileNames[i]);
+            return -1;
+        }
+
+        sizeMb = (double)fileInfo.st_size / (1024.0 * 1024.0);
+
+        /* Sweep 1, 2, 4 ... threads up to the requested count */
+        for(threads=1;threads<=maxThreads;threads*=2)
+        {
+            threads = (threads*2 > maxThreads) ? maxThreads : threads;
+            objParseThreads = threads;
+            best = 0.0;
+            total = 0.0;
+
+            for(j=0;j<iterations;j++)
+            {
+                initObject(&object);
+                initMaterialLib(&materials);
+
+                /* Time the OBJ parse only, no GL work is involved */
+                start = getTimeMs();
+                if ( GL_FALSE == loadObjFile(&object, &materials, objFileNames[i]) )
+                {
+                    return -1;
+                }
+                elapsed = getTimeMs() - start;
+
+                best = (j == 0 || elapsed < best) ? elapsed : best;
+                total += elapsed;
+
+                freeObject(&object, &materials);
+            }
+
+            printf("%-48s %8u %10.2f %10.2f %10.2f %10.1f\n", objFileNames[i], threads, sizeMb, best, total / iterations, sizeMb / (best / 1000.0));
+
+            /* The stdio parser is single threaded, there is nothing to sweep */
+            if (objParser == OBJ_PARSER_STDIO)
+            {
+                break;
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+void printUsage(char *name)
+{
+    printf("Usage: %s [options] model.obj [camera distance]\n", name);
+    printf("  -b, --bench-load N     parse each model N times without rendering and report load times\n");
+    printf("  -p, --parser NAME      OBJ parser, mmap (default) or stdio\n");
+    printf("  -t, --threads N        OBJ parse and texture decode threads, 0 for one per CPU (default 1)\n");
+    printf("  -n, --no-cache         always parse the OBJ/MTL/BMP files, do not read or write the .objc and .bmpc caches\n");
+    printf("  -l, --layout NAME      vertex layout, interleaved (default) or separate\n");
+    printf("  -v, --no-vao           do not use OES_vertex_array_object\n");
+    printf("  -d, --bench-draw N     draw the model N times per vertex layout and report frame times\n");
+    printf("  -f, --vertex-format F  float (default) or compact, 16-bit positions/texcoords and octahedral normals\n");
+    printf("  -s, --stream           load in the background and draw the model while it is still being read\n");
+    printf("  -w, --normal-weight W  weighting of generated normals for files without vn, angle (default) or area\n");
+    printf("  -c, --crease DEG       hard edges between faces more than DEG degrees apart in generated normals (default 180, off)\n");
+    printf("  -x, --bench-textures N load the textures N times with 1 up to --threads decode threads and report startup times\n");
+    printf("  -k, --bench-decode N   decode each BMP texture N times with plain C and SIMD rows and report MB/s\n");
+    printf("  -e, --no-etc           upload RGB8 textures even when ETC1/ETC2 is available\n");
+    printf("  -a, --atlas            pack the diffuse textures into atlas pages so materials share draw calls\n");
+    printf("  -o, --lod PIXELS       build simplified levels of detail and draw the coarsest whose error stays under PIXELS on screen\n");
+    printf("  -u, --cull             cull back faces and skip clusters of triangles outside the view or facing away, report the share culled\n");
+    printf("  -r, --bench-rays N     build a BVH over the triangles, cast N rays and N closest point queries and report queries/s\n");
+    printf("  -P, --profile N        time the input, update, draw and swap phases and the GPU frame, print histograms every N frames (0 on exit only)\n");
+    printf("  -H, --headless N       no window, draw N frames along a scripted camera path offscreen with EGL and report frame times\n");
+    printf("  -J, --json FILE        write the --headless min/avg/p99 frame times as JSON to FILE (default standard output)\n");
+    printf("  -D, --dump-frames LIST write the --headless frames in the comma separated LIST as %s_NNNNN.ppm\n", HEADLESS_NAME);
+    printf("Click the model to print the face and material under the cursor\n");
+}
+
+
+void mouseButtonCallback(GLFWwindow *window, int button, int action, int mods)
+{
+    /* The main loop picks, it owns the object */
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
+    {
+        glfwGetCursorPos(window, &pickX, &pickY);
+        pickPending = GL_TRUE;
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    object_t object;
+    materialLib_t materials;
+    GLint benchIterations = 0;
+    GLint benchFrames = 0;
+    GLint benchTextures = 0;
+    GLint benchDecode = 0;
+    GLint benchRays = 0;
+    GLint opt;
+    GLint ret;
+    GLuint headlessFrames = 0;
+    GLint profileFrames = -1;
+    GLfloat headlessDistance;
+    headlessCameraKey_t cameraKey;
+    const char *reportFile = NULL;
+    const char *dumpFrames = NULL;
+
+    static struct option longOptions[] =
+    {
+        {"bench-load", required_argument, NULL, 'b'},
+        {"parser",     required_argument, NULL, 'p'},
+        {"threads",    required_argument, NULL, 't'},
+        {"no-cache",   no_argument,       NULL, 'n'},
+        {"layout",     required_argument, NULL, 'l'},
+        {"no-vao",     no_argument,       NULL, 'v'},
+        {"bench-draw", required_argument, NULL, 'd'},
+        {"vertex-format", required_argument, NULL, 'f'},
+        {"stream",     no_argument,       NULL, 's'},
+        {"normal-weight", required_argument, NULL, 'w'},
+        {"crease",     required_argument, NULL, 'c'},
+        {"bench-textures", required_argument, NULL, 'x'},
+        {"bench-decode", required_argument, NULL, 'k'},
+        {"no-etc",     no_argument,       NULL, 'e'},
+        {"atlas",      no_argument,       NULL, 'a'},
+        {"lod",        required_argument, NULL, 'o'},
+        {"cull",       no_argument,       NULL, 'u'},
+        {"bench-rays", required_argument, NULL, 'r'},
+        {"profile",    required_argument, NULL, 'P'},
+        {"headless",   required_argument, NULL, 'H'},
+        {"json",       required_argument, NULL, 'J'},
+        {"dump-frames", required_argument, NULL, 'D'},
+        {"help",       no_argument,       NULL, 'h'},
+        {NULL,         0,                 NULL, 0}
+    };
+
+    GLFWwindow* window = NULL;
+
+    /* Parse command line options */
+    while ((opt = getopt_long(argc, argv, "b:p:t:nl:vd:f:sw:c:x:k:eao:ur:P:H:J:D:h", longOptions, NULL)) != -1)
+    {
+        switch(opt)
+        {
+            case 'b': benchIterations = atoi(optarg); break;
+            case 'p': objParser = (0 == strcmp(optarg, "stdio")) ? OBJ_PARSER_STDIO : OBJ_PARSER_MMAP; break;
+            case 't': objParseThreads = (GLuint)atoi(optarg); break;
+            case 'n': useMeshCache = GL_FALSE; textureLoadFlags &= ~IMAGE_LOAD_CACHE; break;
+            case 'l': vertexLayout = (0 == strcmp(optarg, "separate")) ? VERTEX_LAYOUT_SEPARATE : VERTEX_LAYOUT_INTERLEAVED; break;
+            case 'v': useVao = GL_FALSE; break;
+            case 'd': benchFrames = atoi(optarg); break;
+            case 'f': vertexFormat = (0 == strcmp(optarg, "compact")) ? VERTEX_FORMAT_COMPACT : VERTEX_FORMAT_FLOAT; break;
+            case 's': useStreamLoad = GL_TRUE; break;
+            case 'w': normalWeighting = (0 == strcmp(optarg, "area")) ? MESH_NORMAL_WEIGHT_AREA : MESH_NORMAL_WEIGHT_ANGLE; break;
+            case 'c': creaseAngle = (GLfloat)atof(optarg); break;
+            case 'x': benchTextures = atoi(optarg); break;
+            case 'k': benchDecode = atoi(optarg); break;
+            case 'e': useEtc = GL_FALSE; break;
+            case 'a': useAtlas = GL_TRUE; break;
+            case 'o': lodPixelError = (GLfloat)atof(optarg); break;
+            case 'u': useCulling = GL_TRUE; break;
+            case 'r': benchRays = atoi(optarg); break;
+            case 'P': profileFrames = atoi(optarg); break;
+            case 'H': useHeadless = GL_TRUE; headlessFrames = (GLuint)atoi(optarg); break;
+            case 'J': reportFile = optarg; break;
+            case 'D': dumpFrames = optarg; break;
+            default:  printUsage(argv[0]); return -1;
+        }
+    }
+
+    if (optind >= argc)
+    {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    /* The texture benchmark reloads every texture on its own */
+    if ( GL_TRUE == useAtlas && benchTextures > 0 )
+    {
+        printf("The texture atlas is not used with --bench-textures\n");
+        useAtlas = GL_FALSE;
+    }
+
+    /* Zero threads means one per CPU, the pool is only needed above one */
+    objParseThreads = (objParseThreads == 0) ? threadPoolGetNumOfCpus() : objParseThreads;
+    objParseThreads = (objParseThreads > MAX_PARSE_THREADS) ? MAX_PARSE_THREADS : objParseThreads;
+    if (objParseThreads > 1)
+    {
+        threadPool = threadPoolCreate(objParseThreads);
+    }
+
+    /* Parse benchmark, the remaining arguments are all model files */
+    if (benchIterations > 0)
+    {
+        benchIterations = (benchIterations > BENCH_MAX_ITERATIONS) ? BENCH_MAX_ITERATIONS : benchIterations;
+        ret = benchmarkLoad(&argv[optind], argc - optind, benchIterations, objParseThreads);
+        threadPoolDestroy(threadPool);
+        return ret;
+    }
+
+    initObject(&object);
+    initMaterialLib(&materials);
+    texCacheInit(&textureCache);
+
+    if ( GL_TRUE == useHeadless )
+    {
+        /* Offscreen EGL context, no window system or terminal needed */
+        if ( GL_FALSE == headlessCreate(&headless, DISPLAY_WIDTH, DISPLAY_HEIGHT, headlessFrames) )
+        {
+            threadPoolDestroy(threadPool);
+            return -1;
+        }
+
+        if ( dumpFrames != NULL && GL_FALSE == headlessSetDumpFrames(&headless, dumpFrames) )
+        {
+            printf("Invalid frame list: %s\n", dumpFrames);
+            headlessDestroy(&headless);
+            threadPoolDestroy(threadPool);
+            return -1;
+        }
+    }
+    else
+    {
+        glfwInit();    
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+
+        /* Create window */
+        window = glfwCreateWindow(DISPLAY_WIDTH, DISPLAY_HEIGHT, __FILE__, NULL, NULL);
+
+        /* Make window current */
+        glfwMakeContextCurrent(window);
+
+        /* Clicks pick a face of the model */
+        glfwSetMouseButtonCallback(window, mouseButtonCallback);
+    }
+
+    /* Load Shader */
+    loadShader();
+
+    /* Without NPOT support textures are resized before their mips are built */
+    if ( GL_FALSE == imageGetNpotSupport() )
+    {
+        textureLoadFlags |= IMAGE_LOAD_POT;
+    }
+
+    /* Compress when the context can sample ETC, RGB8 otherwise */
+    if ( GL_TRUE == useEtc )
+    {
+        textureLoadFlags |= imageGetEtcSupport();
+    }
+
+    /* Set camera distance if provided */
+    if (argc > optind + 1)
+    {
+        cameraPosition.z = atof(argv[optind + 1]);
+    }
+
+    /* The preview is drawn from float vertices, benchmarks need the whole model */
+    if ( GL_TRUE == useStreamLoad && (benchFrames > 0 || benchTextures > 0 || benchDecode > 0 || benchRays > 0 || vertexFormat == VERTEX_FORMAT_COMPACT || GL_TRUE == useAtlas ||
+                                      lodPixelError > 0.0f || GL_TRUE == useCulling) )
+    {
+        printf("Streaming needs the float vertex format, no atlas, no levels of detail, no culling and no benchmark, loading up front\n");
+        useStreamLoad = GL_FALSE;
+    }
+
+    if ( GL_TRUE == useStreamLoad )
+    {
+        /* GL initialization, the model arrives while the loop runs */
+        initGL();
+        startStreamLoad(&streamLoad, &object, &materials, argv[optind]);
+    }
+    else
+    {
+        /* Load model */
+        if ( GL_FALSE == loadModel(&object, &materials, argv[optind]) )
+        {
+            printf("\nError loading model\n");
+            return -1;
+        }
+
+        /* GL initialization */
+        initGL();
+
+        /* Prepare VBOs */
+        if ( GL_FALSE == prepareVbos(&object) )
+        {
+            cleanUp(&object, &materials);
+            texCacheFree(&textureCache);
+            headlessDestroy(&headless);
+            glfwTerminate();
+            threadPoolDestroy(threadPool);
+            return -1;
+        }
+    }
+
+    /* Texture benchmark, reloads the model's textures with more and more threads */
+    if (benchTextures > 0)
+    {
+        benchTextures = (benchTextures > BENCH_MAX_ITERATIONS) ? BENCH_MAX_ITERATIONS : benchTextures;
+        ret = benchmarkTextures(&materials, argv[optind], benchTextures, objParseThreads);
+        cleanUp(&object, &materials);
+        texCacheFree(&textureCache);
+        headlessDestroy(&headless);
+        glfwTerminate();
+        threadPoolDestroy(threadPool);
+        return ret;
+    }
+
+    /* Decode benchmark, the model's BMP files with and without the SIMD rows */
+    if (benchDecode > 0)
+    {
+        benchDecode = (benchDecode > BENCH_MAX_ITERATIONS) ? BENCH_MAX_ITERATIONS : benchDecode;
+        ret = benchmarkDecode(&materials, argv[optind], benchDecode);
+        cleanUp(&object, &materials);
+        texCacheFree(&textureCache);
+        headlessDestroy(&headless);
+        glfwTerminate();
+        threadPoolDestroy(threadPool);
+        return ret;
+    }
+
+    /* Ray benchmark, the BVH over the loaded triangles */
+    if (benchRays > 0)
+    {
+        benchRays = (benchRays > BENCH_MAX_RAYS) ? BENCH_MAX_RAYS : benchRays;
+        ret = benchmarkRays(&object, benchRays);
+        cleanUp(&object, &materials);
+        texCacheFree(&textureCache);
+        headlessDestroy(&headless);
+        glfwTerminate();
+        threadPoolDestroy(threadPool);
+        return ret;
+    }
+
+    /* Draw benchmark, compares the vertex layouts on the loaded model */
+    if (benchFrames > 0)
+    {
+        glfwSwapInterval(0);
+        ret = benchmarkDraw(&object, &materials, benchFrames);
+        cleanUp(&object, &materials);
+        texCacheFree(&textureCache);
+        headlessDestroy(&headless);
+        glfwTerminate();
+        threadPoolDestroy(threadPool);
+        return ret;
+    }
+
+    /* The scripted path is scaled to the distance the camera starts at */
+    headlessDistance = cameraPosition.z;
+
+    /* GPU frame times when the context has timer queries, CPU phases always */
+    if (profileFrames >= 0)
+    {
+        profileInit(&profile, framePhaseNames, NUM_OF_FRAME_PHASES, (GLuint)profileFrames, headlessExtensionSupported("GL_EXT_disjoint_timer_query"), headlessGetProcAddress);
+    }
+
+    /* Loop until we need to shutdown */
+    while ( appShutdown == 0 && GL_FALSE == headlessShouldClose(&headless, window) )
+    {
+        profileBeginFrame(&profile);
+
+        if ( GL_TRUE == useHeadless )
+        {
+            /* The scripted path stands in for the keyboard and the spin */
+            headlessBeginFrame(&headless);
+            profileBeginPhase(&profile, FRAME_PHASE_UPDATE);
+            headlessFollowCameraPath(&headless, cameraPath, sizeof(cameraPath)/sizeof(headlessCameraKey_t), headlessDistance, &cameraKey);
+            setCameraKey(&cameraKey);
+        }
+        else
+        {
+            /* Check for events */
+            profileBeginPhase(&profile, FRAME_PHASE_INPUT);
+            glfwPollEvents();
+
+            /* Check user input */
+            checkUserInput();
+        }
+
+        /* Pick up what the background loader has finished */
+        if ( GL_TRUE == useStreamLoad && GL_FALSE == updateStreamLoad(&streamLoad) )
+        {
+            break;
+        }
+
+        /* Clear the color and depth buffer */
+        profileBeginPhase(&profile, FRAME_PHASE_DRAW);
+        glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+
+        /* Draw the object */
+        if ( GL_FALSE == useStreamLoad || GL_TRUE == streamLoad.meshActive )
+        {
+            profileBeginPhase(&profile, FRAME_PHASE_UPDATE);
+            selectObjectLod(&object);
+            profileBeginPhase(&profile, FRAME_PHASE_DRAW);
+            drawVertices(&object, &materials);
+
+            /* Against the matrices the frame was drawn with */
+            if ( GL_TRUE == pickPending )
+            {
+                profileBeginPhase(&profile, FRAME_PHASE_UPDATE);
+                pickObject(&object, &materials, window);
+            }
+
+            if (cullStats.frames >= CULL_REPORT_FRAMES)
+            {
+                printCullStats();
+            }
+        }
+        else
+        {
+            drawStreamPreview(&streamLoad);
+        }
+
+        /* Rotate the object, headless runs turn it along their path */
+        if ( GL_FALSE == useHeadless )
+        {
+            profileBeginPhase(&profile, FRAME_PHASE_UPDATE);
+            modelRotationUp -= 0.5f;
+            if(modelRotationUp > 360.0f)
+            {
+                modelRotationUp = modelRotationUp-360.0f;
+            }
+
+            /* Update camera position */
+            updateCameraPosition();
+        }
+
+        /* Swap buffers, headless frames are finished and timed */
+        profileBeginPhase(&profile, FRAME_PHASE_SWAP);
+        if ( GL_TRUE == useHeadless )
+        {
+            headlessEndFrame(&headless, HEADLESS_NAME);
+        }
+        else
+        {
+            glfwSwapBuffers(window);
+        }
+
+        profileEndFrame(&profile);
+    }
+
+    /* Frames since the last report, all of them without a report interval */
+    if (profileFrames == 0 || (profileFrames > 0 && (profile.frames % profileFrames) != 0))
+    {
+        profilePrint(&profile);
+    }
+    profileFree(&profile);
+
+    if ( GL_TRUE == useStreamLoad )
+    {
+        finishStreamLoad(&streamLoad);
+    }
+
+    cleanUp(&object, &materials);
+
+    texCacheFree(&textureCache);
+
+    if ( GL_TRUE == useHeadless )
+    {
+        if ( GL_FALSE == headlessWriteReport(&headless, HEADLESS_NAME, reportFile) )
+        {
+            printf("Error writing the frame time report\n");
+        }
 
-        /* Swap buffers */
-        glfwSwapBuffers(window);
+        headlessDestroy(&headless);
     }
 
     glfwTerminate();
 
-    cleanUp(&object, materials);
+    threadPoolDestroy(threadPool);
 
     return 0;
 }
@@ -1,7 +1,8 @@
 /**********************************************************
 * Solar System OpenGL ES2
 * Description: Solar system model
-* Build command:  gcc SpaceScene.c ../lib/glmath.c -lGLESv2 -lglfw -lm -Wall
+* Build command:  gcc SpaceScene.c ../lib/glmath.c ../lib/glarray.c ../lib/glthreadpool.c ../lib/glcache.c ../lib/gletc.c ../lib/glimage.c ../lib/glocclusion.c ../lib/glheadless.c ../lib/glprofile.c ../lib/gltime.c -lGLESv2 -lEGL -lglfw -lm -lpthread -Wall
+* Usage: ./a.out [--threads N] [--bench-textures N] [--bench-decode N] [--no-cache] [--no-etc] [--occlusion] [--profile N] [--headless N [--json FILE] [--dump-frames LIST]]
 * References:
 **********************************************************/
 
@@ -19,8 +20,16 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <termios.h>
+#include <getopt.h>
 
 #include "../lib/glmath.h"
+#include "../lib/gltime.h"
+#include "../lib/glarray.h"
+#include "../lib/glthreadpool.h"
+#include "../lib/glimage.h"
+#include "../lib/glocclusion.h"
+#include "../lib/glheadless.h"
+#include "../lib/glprofile.h"
 
 /*******************************************************************/
 /*  Defines                                                        */
@@ -30,11 +39,6 @@
 #define DISPLAY_WIDTH               1024.0f
 #define DISPLAY_HEIGHT              768.0f
 
-#define BMP_WIDTH_OFFSET            18
-#define BMP_HEIGHT_OFFSET           22
-#define BMP_PIX_PER_COL             3
-#define BMP_HEADER_SIZE             54
-
 #define DIFFUSE_LIMIT               5.28f
 
 #define SCENE_NEAR                  0.1f
@@ -49,6 +53,25 @@
 
 #define DEFAULT_FOV                 35.0f
 
+#define NUM_OF_CELESTIAL_OBJECTS    (sizeof(celestialObject)/sizeof(celestial_t))
+
+/* Color, ring color and ring mask per body */
+#define MAX_SCENE_TEXTURES          (NUM_OF_CELESTIAL_OBJECTS * 3)
+
+#define MAX_TEXTURE_THREADS         64
+#define BENCH_MAX_ITERATIONS        1000
+
+/* Coarse depth the occluders are drawn into, a quarter of the display each way */
+#define OCCLUSION_WIDTH             256
+#define OCCLUSION_HEIGHT            192
+
+/* Segments around the low-poly occluder spheres, half as many from pole to pole */
+#define OCCLUDER_SEGMENTS           16
+#define OCCLUSION_REPORT_FRAMES     120
+
+/* Report and dumped frame names for --headless */
+#define HEADLESS_NAME               "SpaceScene"
+
 #define KEYS_UP                     65
 #define KEYS_DOWN                   'B'
 #define KEYS_RIGHT                  'C'
@@ -130,8 +153,30 @@ typedef struct _celestial_t
     vec3_t scale;
     GLfloat diffuseValue;
     rings_t rings;
+
+    /* Scale, spin and orbit of the current frame, as uRotateMatrix */
+    GLfloat modelMatrix[16];
+
+    /* Low-poly sphere inside the drawn one, drawn into the occlusion buffer */
+    GLfloat *occluderVerts;
+    GLushort *occluderIndices;
+    GLuint numOfOccluderTriangles;
+
+    /* Skipped this frame, behind the occluders or outside the view */
+    GLboolean hidden;
 } celestial_t;
 
+/* Objects the occlusion pass skipped since the last report */
+typedef struct _occlusionStats_t
+{
+    GLuint frames;
+    GLuint objects;
+    GLuint hidden;
+    GLuint outside;
+    GLuint triangles;
+    double time;
+} occlusionStats_t;
+
 
 /*******************************************************************/
 /*  Enums                                                          */
@@ -141,6 +186,15 @@ typedef enum _retCode_e {
     RET_SUCCESS,
 } retCode_e;
 
+typedef enum _framePhase_e {
+    FRAME_PHASE_INPUT,
+    FRAME_PHASE_UPDATE,
+    FRAME_PHASE_CULL,
+    FRAME_PHASE_DRAW,
+    FRAME_PHASE_SWAP,
+    NUM_OF_FRAME_PHASES,
+} framePhase_e;
+
 
 /*******************************************************************/
 /*  Globals                                                        */
@@ -378,7 +432,7 @@ static celestial_t celestialObject[] = {
 
 static const GLchar* vertex_shader_source =    
 {
-    "precision mediump float;\n"
+    "precision highp float;\n"
 
     "attribute vec2 aTexCoords;\n"
     "attribute vec4 aPosition;\n"
@@ -428,12 +482,26 @@ static const GLchar* fragment_shader_source =
         "vec4 color = texture2D(uTextureColor, vTexCoords);\n"
         "vec4 mask = texture2D(uTextureMask, vTexCoords);\n"
         
-        "gl_FragColor = (uBlendTextures == true) ? vec4((color.bgr * mask.bgr), 0.3) : gl_FragColor = vec4(color.bgr, 1.0) * diffuse;\n"
+        "gl_FragColor = (uBlendTextures == true) ? vec4((color.rgb * mask.rgb), 0.3) : gl_FragColor = vec4(color.rgb, 1.0) * diffuse;\n"
     "}\n"
 };
 
 
+static const char *framePhaseNames[NUM_OF_FRAME_PHASES] = { "input", "update", "cull", "draw", "swap" };
+
+/* Headless camera, out past Pluto, in by the sun, around the far side and back */
+static const headlessCameraKey_t cameraPath[] =
+{
+    {0.00f, {-840.0f, 0.0f, 3620.0f},  50.0f, -19.0f},
+    {0.25f, {-400.0f, 0.0f, 2200.0f}, 110.0f, -12.0f},
+    {0.50f, {   0.0f, 0.0f, 1200.0f}, 200.0f,  -4.0f},
+    {0.75f, { 400.0f, 0.0f, 2200.0f}, 320.0f, -12.0f},
+    {1.00f, {-840.0f, 0.0f, 3620.0f}, 410.0f, -19.0f},
+};
+
+
 static GLfloat persepctiveProjMatrix[16] = {0.0f};
+static GLfloat modelViewMatrix[16]       = {0.0f};
 static GLfloat modelViewProjMatrix[16]   = {0.0f};
 static GLfloat rotationMatrixUp[16]      = {0};
 static GLfloat rotationMatrixRight[16]   = {0};
@@ -465,6 +533,16 @@ static GLint uRotateMatrixLoc            = -1;
 
 static GLint appShutdown                 = 0;
 
+static GLuint textureThreads             = 1;
+static GLuint textureLoadFlags           = IMAGE_LOAD_MIPS | IMAGE_LOAD_CACHE;
+static GLboolean useEtc                  = GL_TRUE;
+static GLboolean useOcclusion            = GL_FALSE;
+static occlusionBuffer_t occlusionBuffer;
+static occlusionStats_t occlusionStats;
+static GLboolean useHeadless             = GL_FALSE;
+static headless_t headless;
+static profile_t profile;
+
 
 /*******************************************************************/
 /*  Functions                                                      */
@@ -699,7 +777,7 @@ void loadShader(void)
 }
 
 
-void drawcelestialObject(celestial_t *body)
+void updateCelestialObject(celestial_t *body)
 {
     GLfloat rotationPlanet[16]          = {0.0f};
     GLfloat rotationOrbit[16]           = {0.0f};
@@ -728,10 +806,14 @@ void drawcelestialObject(celestial_t *body)
 
     /* Rotate orbit */
     generateRotationMatrix(body->rotAngleOrbit, body->rotAxisOrbit, rotationOrbit);
-    matrix4x4By4x4(rotationOrbit, rotationPlanet, rotationOrbit);
+    matrix4x4By4x4(rotationOrbit, rotationPlanet, body->modelMatrix);
+}
 
+
+void drawcelestialObject(celestial_t *body)
+{
     /* Load the scale/rotation matrix */
-    glUniformMatrix4fv(uRotateMatrixLoc, 1, 0, rotationOrbit);
+    glUniformMatrix4fv(uRotateMatrixLoc, 1, 0, body->modelMatrix);
 
     /* Override the diffuse value.  Used to light up the sun and universe */
     glUniform1f(uDiffuseValueLoc, body->diffuseValue);
@@ -790,77 +872,174 @@ void drawcelestialObject(celestial_t *body)
 }
 
 
-retCode_e loadTexture(textureData_t *texStruct)
+void uploadTexture(textureData_t *texStruct, image_t *image)
+{
+    texStruct->width = image->width;
+    texStruct->height = image->height;
+
+    /* Generate and store texture, the full mip chain so trilinear filtering is complete */
+    glGenTextures(1, &texStruct->id);
+    glBindTexture(GL_TEXTURE_2D, texStruct->id);
+    imageUploadTexture(image);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,GL_REPEAT);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,GL_REPEAT);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,GL_LINEAR_MIPMAP_LINEAR);
+}
+
+
+GLuint getSceneTextures(textureData_t **textures)
 {
-    GLubyte *data = NULL;
-    FILE *file = NULL;
+    GLuint count = 0;
+    GLuint i;
 
-    /* Open File */
-    file = fopen( texStruct->fileName, "rb" );
-    if ( file == NULL ) 
+    for(i=0;i<NUM_OF_CELESTIAL_OBJECTS;i++)
     {
-        return RET_FAIL;
+        textures[count++] = &celestialObject[i].texColor;
+
+        /* If this planet has rings */
+        if ( celestialObject[i].rings.texColor.fileName != NULL )
+        {
+            textures[count++] = &celestialObject[i].rings.texColor;
+            textures[count++] = &celestialObject[i].rings.texMask;
+        }
     }
 
-    /* Read file */
-    data = (GLubyte *)malloc( BMP_HEADER_SIZE );
+    return count;
+}
 
-    /* Read BMP Header */
-    fread(data, BMP_HEADER_SIZE, 1, file);
 
-    /* Get width and height from header */
-    texStruct->width = *(GLuint *)(&data[BMP_WIDTH_OFFSET]);
-    texStruct->height = *(GLuint *)(&data[BMP_HEIGHT_OFFSET]);
+retCode_e loadTextures(threadPool_t *pool, GLboolean verbose)
+{
+    textureData_t *textures[MAX_SCENE_TEXTURES];
+    imageLoad_t loads[MAX_SCENE_TEXTURES];
+    imageLoader_t loader;
+    imageLoad_t *load;
+    retCode_e ret = RET_SUCCESS;
+    GLuint count, i;
+    size_t textureSize = 0;
+    double start;
+
+    start = getTimeMs();
+
+    count = getSceneTextures(textures);
+    for(i=0;i<count;i++)
+    {
+        loads[i].fileName = textures[i]->fileName;
+        loads[i].tag = i;
+    }
 
-    /* Read pixel data */
-    data = (GLubyte *)realloc( data, texStruct->width * texStruct->height * 3 );
-    fread( data, texStruct->width * texStruct->height * BMP_PIX_PER_COL, 1, file );
-    fclose( file );
+    /* Decode on the workers, upload here in the order the decodes finish */
+    imageLoaderStart(&loader, pool, loads, count, textureLoadFlags);
 
-    /* Generate and store texture */
-    glGenTextures(1, &texStruct->id);
-    glBindTexture(GL_TEXTURE_2D, texStruct->id);
-    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB8, texStruct->width, texStruct->height);
-    glTexSubImage2D(GL_TEXTURE_2D, 0,0,0, texStruct->width, texStruct->height, GL_RGB, GL_UNSIGNED_BYTE, data);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,GL_REPEAT);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,GL_REPEAT);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,GL_NEAREST_MIPMAP_NEAREST);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,GL_NEAREST_MIPMAP_NEAREST);
+    while ((load = imageLoaderNext(&loader)) != NULL)
+    {
+        if ( GL_FALSE == load->result )
+        {
+            printf("Error loading texture %s\n", load->fileName);
+            ret = RET_FAIL;
+            continue;
+        }
+
+        uploadTexture(textures[load->tag], &load->image);
+        textureSize += imageGetLevelOffset(&load->image, load->image.levels);
+        free(load->image.data);
+    }
+
+    imageLoaderFinish(&loader);
 
-    /* Free data */
-    free(data);
+    if ( GL_TRUE == verbose )
+    {
+        printf("Textures ready in %.2f ms, %u files, %.2f MB %s, on %u threads\n", getTimeMs() - start, count, textureSize / (1024.0 * 1024.0),
+               (textureLoadFlags & IMAGE_LOAD_ETC2) ? "ETC2" : ((textureLoadFlags & IMAGE_LOAD_ETC1) ? "ETC1" : "RGB8"), (pool != NULL) ? pool->numOfThreads : 1);
+    }
 
-    return RET_SUCCESS;
+    return ret;
 }
 
 
-void createCelestialObjectObject(celestial_t *body)
+void deleteTextures(void)
 {
-    GLint i;
-    GLfloat rotationMatrix[16] = {0.0};
+    textureData_t *textures[MAX_SCENE_TEXTURES];
+    GLuint count, i;
 
-    /* Load planet texture */
-    if ( RET_FAIL == loadTexture(&body->texColor) )
+    count = getSceneTextures(textures);
+    for(i=0;i<count;i++)
     {
-        printf("Error loading planet texture\n");
+        glDeleteTextures(1, &textures[i]->id);
+        textures[i]->id = 0;
     }
+}
 
-    /* If this planet has rings */
-    if ( body->rings.texColor.fileName != NULL )
+
+void createOccluder(celestial_t *body)
+{
+    GLuint rows = OCCLUDER_SEGMENTS / 2;
+    GLuint count = 0;
+    GLuint i, j, next;
+    GLfloat radius, theta, phi;
+
+    /* Vertices on a sphere no larger than the largest one inside the drawn strips */
+    radius = body->sphere.radius * cosf(PI / body->sphere.gradation) * cosf(PI / body->sphere.gradation);
+
+    body->occluderVerts = (GLfloat *)malloc(sizeof(GLfloat) * 3 * (rows + 1) * OCCLUDER_SEGMENTS);
+    body->occluderIndices = (GLushort *)malloc(sizeof(GLushort) * 3 * 2 * rows * OCCLUDER_SEGMENTS);
+    if (body->occluderVerts == NULL || body->occluderIndices == NULL)
     {
-        printf("\tCreating rings\n");
+        body->numOfOccluderTriangles = 0;
+        return;
+    }
 
-        /* Load ring color */
-        if ( RET_FAIL == loadTexture(&body->rings.texColor) )
+    for(i=0;i<=rows;i++)
+    {
+        theta = PI * (GLfloat)i / (GLfloat)rows;
+
+        for(j=0;j<OCCLUDER_SEGMENTS;j++)
         {
-            printf("Error loading rings color texture\n");
+            phi = 2.0f * PI * (GLfloat)j / (GLfloat)OCCLUDER_SEGMENTS;
+
+            body->occluderVerts[((i * OCCLUDER_SEGMENTS) + j) * 3 + 0] = radius * sinf(theta) * cosf(phi);
+            body->occluderVerts[((i * OCCLUDER_SEGMENTS) + j) * 3 + 1] = radius * sinf(theta) * sinf(phi);
+            body->occluderVerts[((i * OCCLUDER_SEGMENTS) + j) * 3 + 2] = radius * cosf(theta);
         }
+    }
 
-        /* Load ring mask */
-        if ( RET_FAIL == loadTexture(&body->rings.texMask) )
+    /* Two triangles per quad, one at the poles where the other collapses */
+    for(i=0;i<rows;i++)
+    {
+        for(j=0;j<OCCLUDER_SEGMENTS;j++)
         {
-            printf("Error loading rings mask texture\n");
+            next = (j + 1) % OCCLUDER_SEGMENTS;
+
+            if (i + 1 < rows)
+            {
+                body->occluderIndices[count++] = (i * OCCLUDER_SEGMENTS) + j;
+                body->occluderIndices[count++] = ((i + 1) * OCCLUDER_SEGMENTS) + j;
+                body->occluderIndices[count++] = ((i + 1) * OCCLUDER_SEGMENTS) + next;
+            }
+
+            if (i > 0)
+            {
+                body->occluderIndices[count++] = (i * OCCLUDER_SEGMENTS) + j;
+                body->occluderIndices[count++] = ((i + 1) * OCCLUDER_SEGMENTS) + next;
+                body->occluderIndices[count++] = (i * OCCLUDER_SEGMENTS) + next;
+            }
         }
+    }
+
+    body->numOfOccluderTriangles = count / 3;
+}
+
+
+void createCelestialObjectObject(celestial_t *body)
+{
+    GLint i;
+    GLfloat rotationMatrix[16] = {0.0};
+
+    /* If this planet has rings */
+    if ( body->rings.texColor.fileName != NULL )
+    {
+        printf("\tCreating rings\n");
 
         /* Create the rings */
         createRings(body);
@@ -889,6 +1068,12 @@ void createCelestialObjectObject(celestial_t *body)
 
     /* Set current position */
     body->currentPosition = body->origin;
+
+    /* Stand-in drawn into the occlusion buffer */
+    if ( GL_TRUE == useOcclusion )
+    {
+        createOccluder(body);
+    }
 }
 
 
@@ -907,6 +1092,9 @@ void cleanUpcelestialObject(celestial_t *body)
         free(body->rings.model.verts);
         free(body->rings.model.texCoords);
     }
+
+    free(body->occluderVerts);
+    free(body->occluderIndices);
 }
 
 
@@ -927,7 +1115,8 @@ void updateModelViewProjMatrix(void)
     matrix4x4By4x4(rotationMatrixUp, rotationMatrixRight, rotationMatrixRight);
     matrix4x4By4x4(viewMatrix, rotationMatrixRight, viewMatrix);
 
-    /* Set the modelViewMatrix */
+    /* Set the modelViewMatrix, kept to find the camera for the occlusion pass */
+    memcpy(modelViewMatrix, viewMatrix, sizeof(modelViewMatrix));
     matrix4x4By4x4(persepctiveProjMatrix, viewMatrix, modelViewProjMatrix);
 
     /* Load modelview matrix */
@@ -935,6 +1124,85 @@ void updateModelViewProjMatrix(void)
 }
 
 
+void cullCelestialObjects(threadPool_t *pool)
+{
+    celestial_t *body;
+    GLfloat mvp[16];
+    GLfloat camera[3], min[3], max[3];
+    GLfloat radius, distance;
+    GLuint i, k, result;
+    double start;
+
+    start = getTimeMs();
+
+    occlusionClear(&occlusionBuffer);
+
+    getCameraPosition(modelViewMatrix, camera);
+
+    /* Every sphere the camera is outside of occludes, the universe around it does not */
+    for(i=0;i<NUM_OF_CELESTIAL_OBJECTS;i++)
+    {
+        body = &celestialObject[i];
+
+        distance = 0.0f;
+        for(k=0;k<3;k++)
+        {
+            distance += (camera[k] - body->modelMatrix[k*4+3]) * (camera[k] - body->modelMatrix[k*4+3]);
+        }
+
+        if (body->numOfOccluderTriangles > 0 && sqrtf(distance) > body->sphere.radius)
+        {
+            matrix4x4By4x4(modelViewProjMatrix, body->modelMatrix, mvp);
+            occlusionAddOccluder(&occlusionBuffer, mvp, body->occluderVerts, body->occluderIndices, body->numOfOccluderTriangles);
+        }
+    }
+
+    occlusionStats.triangles += occlusionBuffer.triangles.count;
+    occlusionRasterize(&occlusionBuffer, pool);
+
+    /* A box around the sphere and its rings, whatever way the object is turned */
+    for(i=0;i<NUM_OF_CELESTIAL_OBJECTS;i++)
+    {
+        body = &celestialObject[i];
+
+        radius = (body->rings.outerRadius > body->sphere.radius) ? body->rings.outerRadius : body->sphere.radius;
+        radius *= fmaxf(body->scale.x, fmaxf(body->scale.y, body->scale.z));
+
+        for(k=0;k<3;k++)
+        {
+            min[k] = body->modelMatrix[k*4+3] - radius;
+            max[k] = body->modelMatrix[k*4+3] + radius;
+        }
+
+        result = occlusionTestBox(&occlusionBuffer, modelViewProjMatrix, min, max);
+        body->hidden = (result != OCCLUSION_VISIBLE) ? GL_TRUE : GL_FALSE;
+
+        occlusionStats.objects++;
+        occlusionStats.hidden += (result == OCCLUSION_HIDDEN) ? 1 : 0;
+        occlusionStats.outside += (result == OCCLUSION_OUTSIDE) ? 1 : 0;
+    }
+
+    occlusionStats.time += getTimeMs() - start;
+    occlusionStats.frames++;
+}
+
+
+void printOcclusionStats(void)
+{
+    if (occlusionStats.frames == 0)
+    {
+        return;
+    }
+
+    printf("Occlusion: %.2f of %u objects hidden, %.2f outside the view, %u occluder triangles, %.3f ms per frame\n",
+           (GLfloat)occlusionStats.hidden / occlusionStats.frames, occlusionStats.objects / occlusionStats.frames,
+           (GLfloat)occlusionStats.outside / occlusionStats.frames, occlusionStats.triangles / occlusionStats.frames,
+           occlusionStats.time / occlusionStats.frames);
+
+    memset(&occlusionStats, 0, sizeof(occlusionStats_t));
+}
+
+
 void initGL(void)
 {
     /* Set Aspect ratio */
@@ -1009,25 +1277,214 @@ void checkUserInput(void)
 }
 
 
-int main(void)
+void setCameraKey(const headlessCameraKey_t *key)
+{
+    cameraPosition = (vec3_t){key->position[0], key->position[1], key->position[2]};
+    modelRotationUp = key->rotationUp;
+    modelRotationRight = key->rotationRight;
+
+    /* Update camera position, as a key press would */
+    cameraDirection = normalize(subProd(cameraPosition, cameraTarget));
+    cameraRight = normalize(crossProd(cameraUp, cameraDirection));
+    cameraUp = crossProd(cameraDirection, cameraRight);
+
+    /* Update model view projection matrix */
+    updateModelViewProjMatrix();
+}
+
+
+void releaseBenchTextures(void *arg)
+{
+    deleteTextures();
+}
+
+
+GLboolean reloadBenchTextures(threadPool_t *pool, void *arg)
+{
+    return ( RET_FAIL == loadTextures(pool, GL_FALSE) ) ? GL_FALSE : GL_TRUE;
+}
+
+
+GLint benchmarkTextures(GLint iterations, GLuint maxThreads)
+{
+    textureData_t *textures[MAX_SCENE_TEXTURES];
+
+    return imageBenchmarkLoads(releaseBenchTextures, reloadBenchTextures, NULL, getSceneTextures(textures), iterations, maxThreads);
+}
+
+
+GLint benchmarkDecode(GLint iterations)
+{
+    textureData_t *textures[MAX_SCENE_TEXTURES];
+    const char *fileNames[MAX_SCENE_TEXTURES];
+    GLuint count, i;
+
+    count = getSceneTextures(textures);
+    for(i=0;i<count;i++)
+    {
+        fileNames[i] = textures[i]->fileName;
+    }
+
+    return imageBenchmarkDecode(fileNames, count, iterations);
+}
+
+
+void printUsage(char *name)
+{
+    printf("Usage: %s [options]\n", name);
+    printf("  -t, --threads N        texture decode threads, 0 for one per CPU (default 1)\n");
+    printf("  -x, --bench-textures N load the textures N times with 1 up to --threads decode threads and report startup times\n");
+    printf("  -k, --bench-decode N   decode each BMP texture N times with plain C and SIMD rows and report MB/s\n");
+    printf("  -n, --no-cache         always decode the BMP files and build their mips, do not read or write the .bmpc caches\n");
+    printf("  -e, --no-etc           upload RGB8 textures even when ETC1/ETC2 is available\n");
+    printf("  -o, --occlusion        skip objects hidden behind the planets in a CPU drawn coarse depth buffer, report the count and cost\n");
+    printf("  -P, --profile N        time the input, update, cull, draw and swap phases and the GPU frame, print histograms every N frames (0 on exit only)\n");
+    printf("  -H, --headless N       no window, draw N frames along a scripted camera path offscreen with EGL and report frame times\n");
+    printf("  -J, --json FILE        write the --headless min/avg/p99 frame times as JSON to FILE (default standard output)\n");
+    printf("  -D, --dump-frames LIST write the --headless frames in the comma separated LIST as %s_NNNNN.ppm\n", HEADLESS_NAME);
+}
+
+
+int main(int argc, char **argv)
 {
     GLint i;
-    GLFWwindow* window;
-    
-    glfwInit();    
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+    GLint benchTextures = 0;
+    GLint benchDecode = 0;
+    GLint opt;
+    GLint ret;
+    GLuint headlessFrames = 0;
+    headlessCameraKey_t cameraKey;
+    GLint profileFrames = -1;
+    const char *reportFile = NULL;
+    const char *dumpFrames = NULL;
+    threadPool_t *pool = NULL;
+    GLFWwindow* window = NULL;
+
+    static struct option longOptions[] =
+    {
+        {"threads",    required_argument, NULL, 't'},
+        {"bench-textures", required_argument, NULL, 'x'},
+        {"bench-decode", required_argument, NULL, 'k'},
+        {"no-cache",   no_argument,       NULL, 'n'},
+        {"no-etc",     no_argument,       NULL, 'e'},
+        {"occlusion",  no_argument,       NULL, 'o'},
+        {"profile",    required_argument, NULL, 'P'},
+        {"headless",   required_argument, NULL, 'H'},
+        {"json",       required_argument, NULL, 'J'},
+        {"dump-frames", required_argument, NULL, 'D'},
+        {"help",       no_argument,       NULL, 'h'},
+        {NULL,         0,                 NULL, 0}
+    };
+
+    /* Parse command line options */
+    while ((opt = getopt_long(argc, argv, "t:x:k:neoP:H:J:D:h", longOptions, NULL)) != -1)
+    {
+        switch(opt)
+        {
+            case 't': textureThreads = (GLuint)atoi(optarg); break;
+            case 'x': benchTextures = atoi(optarg); break;
+            case 'k': benchDecode = atoi(optarg); break;
+            case 'n': textureLoadFlags &= ~IMAGE_LOAD_CACHE; break;
+            case 'e': useEtc = GL_FALSE; break;
+            case 'o': useOcclusion = GL_TRUE; break;
+            case 'P': profileFrames = atoi(optarg); break;
+            case 'H': useHeadless = GL_TRUE; headlessFrames = (GLuint)atoi(optarg); break;
+            case 'J': reportFile = optarg; break;
+            case 'D': dumpFrames = optarg; break;
+            default:  printUsage(argv[0]); return -1;
+        }
+    }
+
+    /* Decode benchmark, the BMP files only, no GL work is involved */
+    if (benchDecode > 0)
+    {
+        benchDecode = (benchDecode > BENCH_MAX_ITERATIONS) ? BENCH_MAX_ITERATIONS : benchDecode;
+        return benchmarkDecode(benchDecode);
+    }
 
-    /* Create window */
-    window = glfwCreateWindow(DISPLAY_WIDTH, DISPLAY_HEIGHT, __FILE__, NULL, NULL);
+    /* Zero threads means one per CPU, the pool is only needed above one */
+    textureThreads = (textureThreads == 0) ? threadPoolGetNumOfCpus() : textureThreads;
+    textureThreads = (textureThreads > MAX_TEXTURE_THREADS) ? MAX_TEXTURE_THREADS : textureThreads;
+    if (textureThreads > 1)
+    {
+        pool = threadPoolCreate(textureThreads);
+    }
 
-    /* Make window current */
-    glfwMakeContextCurrent(window);
+    if ( GL_TRUE == useHeadless )
+    {
+        /* Offscreen EGL context, no window system or terminal needed */
+        if ( GL_FALSE == headlessCreate(&headless, DISPLAY_WIDTH, DISPLAY_HEIGHT, headlessFrames) )
+        {
+            threadPoolDestroy(pool);
+            return -1;
+        }
+
+        if ( dumpFrames != NULL && GL_FALSE == headlessSetDumpFrames(&headless, dumpFrames) )
+        {
+            printf("Invalid frame list: %s\n", dumpFrames);
+            headlessDestroy(&headless);
+            threadPoolDestroy(pool);
+            return -1;
+        }
+    }
+    else
+    {
+        glfwInit();    
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+
+        /* Create window */
+        window = glfwCreateWindow(DISPLAY_WIDTH, DISPLAY_HEIGHT, __FILE__, NULL, NULL);
+
+        /* Make window current */
+        glfwMakeContextCurrent(window);
+    }
 
     /* Load Shader */
     loadShader();
 
+    /* Without NPOT support textures are resized before their mips are built */
+    if ( GL_FALSE == imageGetNpotSupport() )
+    {
+        textureLoadFlags |= IMAGE_LOAD_POT;
+    }
+
+    /* Compress when the context can sample ETC, RGB8 otherwise */
+    if ( GL_TRUE == useEtc )
+    {
+        textureLoadFlags |= imageGetEtcSupport();
+    }
+
+    /* Texture benchmark, reloads the scene textures with more and more threads */
+    if (benchTextures > 0)
+    {
+        benchTextures = (benchTextures > BENCH_MAX_ITERATIONS) ? BENCH_MAX_ITERATIONS : benchTextures;
+        ret = benchmarkTextures(benchTextures, textureThreads);
+        headlessDestroy(&headless);
+        glfwTerminate();
+        threadPoolDestroy(pool);
+        return ret;
+    }
+
+    /* Decode every texture up front, in parallel when there is a pool */
+    if ( RET_FAIL == loadTextures(pool, GL_TRUE) )
+    {
+        printf("Error loading textures\n");
+    }
+
+    /* The pool stays for the occlusion rasterizer */
+    if ( GL_FALSE == useOcclusion )
+    {
+        threadPoolDestroy(pool);
+        pool = NULL;
+    }
+    else if ( GL_FALSE == occlusionInit(&occlusionBuffer, OCCLUSION_WIDTH, OCCLUSION_HEIGHT) )
+    {
+        printf("Error creating the occlusion buffer\n");
+        useOcclusion = GL_FALSE;
+    }
+
     /* Create objects */
     for(i=0;i<sizeof(celestialObject)/sizeof(celestial_t); i++)
     {
@@ -1038,27 +1495,88 @@ int main(void)
     /* GL initialization */
     initGL();
 
+    /* GPU frame times when the context has timer queries, CPU phases always */
+    if (profileFrames >= 0)
+    {
+        profileInit(&profile, framePhaseNames, NUM_OF_FRAME_PHASES, (GLuint)profileFrames, headlessExtensionSupported("GL_EXT_disjoint_timer_query"), headlessGetProcAddress);
+    }
+
     /* Loop until we need to shutdown */
-    while (!glfwWindowShouldClose(window) && appShutdown == 0) 
+    while ( appShutdown == 0 && GL_FALSE == headlessShouldClose(&headless, window) )
     {
-        /* Check for events */
-        glfwPollEvents();
+        profileBeginFrame(&profile);
 
-        /* Check user input */
-        checkUserInput();
+        if ( GL_TRUE == useHeadless )
+        {
+            /* The scripted path stands in for the keyboard */
+            headlessBeginFrame(&headless);
+            profileBeginPhase(&profile, FRAME_PHASE_UPDATE);
+            headlessFollowCameraPath(&headless, cameraPath, sizeof(cameraPath)/sizeof(headlessCameraKey_t), 1.0f, &cameraKey);
+            setCameraKey(&cameraKey);
+        }
+        else
+        {
+            /* Check for events */
+            profileBeginPhase(&profile, FRAME_PHASE_INPUT);
+            glfwPollEvents();
+
+            /* Check user input */
+            checkUserInput();
+        }
 
         /* Clear the color and depth buffer */
+        profileBeginPhase(&profile, FRAME_PHASE_DRAW);
         glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
 
+        /* Move the objects */
+        profileBeginPhase(&profile, FRAME_PHASE_UPDATE);
+        for(i=0;i<sizeof(celestialObject)/sizeof(celestial_t); i++)
+        {
+            updateCelestialObject(&celestialObject[i]);
+        }
+
+        /* Find what the planets hide before any of it is drawn */
+        if ( GL_TRUE == useOcclusion )
+        {
+            profileBeginPhase(&profile, FRAME_PHASE_CULL);
+            cullCelestialObjects(pool);
+
+            if (occlusionStats.frames >= OCCLUSION_REPORT_FRAMES)
+            {
+                printOcclusionStats();
+            }
+        }
+
         /* Draw the objects */
+        profileBeginPhase(&profile, FRAME_PHASE_DRAW);
         for(i=0;i<sizeof(celestialObject)/sizeof(celestial_t); i++)
         {
-            drawcelestialObject(&celestialObject[i]);
+            if ( GL_FALSE == celestialObject[i].hidden )
+            {
+                drawcelestialObject(&celestialObject[i]);
+            }
+        }
+
+        /* Swap buffers, headless frames are finished and timed */
+        profileBeginPhase(&profile, FRAME_PHASE_SWAP);
+        if ( GL_TRUE == useHeadless )
+        {
+            headlessEndFrame(&headless, HEADLESS_NAME);
+        }
+        else
+        {
+            glfwSwapBuffers(window);
         }
 
-        /* Swap buffers */
-        glfwSwapBuffers(window);
+        profileEndFrame(&profile);
+    }
+
+    /* Frames since the last report, all of them without a report interval */
+    if (profileFrames == 0 || (profileFrames > 0 && (profile.frames % profileFrames) != 0))
+    {
+        profilePrint(&profile);
     }
+    profileFree(&profile);
 
     /* Clean up */
     for(i=0;i<sizeof(celestialObject)/sizeof(celestial_t); i++)
@@ -1066,8 +1584,25 @@ int main(void)
         cleanUpcelestialObject(&celestialObject[i]);
     }
 
+    if ( GL_TRUE == useOcclusion )
+    {
+        occlusionFree(&occlusionBuffer);
+    }
+
+    if ( GL_TRUE == useHeadless )
+    {
+        if ( GL_FALSE == headlessWriteReport(&headless, HEADLESS_NAME, reportFile) )
+        {
+            printf("Error writing the frame time report\n");
+        }
+
+        headlessDestroy(&headless);
+    }
+
     glfwTerminate();
 
+    threadPoolDestroy(pool);
+
     return 0;
 }
 
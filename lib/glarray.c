@@ -0,0 +1,93 @@
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#include "glarray.h"
+
+/*******************************************************************/
+/*  Functions                                                      */
+/*******************************************************************/
+void arrayInit(array_t *array, GLuint elementSize)
+{
+    array->data = NULL;
+    array->count = 0;
+    array->capacity = 0;
+    array->elementSize = elementSize;
+}
+
+
+GLboolean arrayReserve(array_t *array, GLuint capacity)
+{
+    void *data;
+
+    if (capacity <= array->capacity)
+    {
+        return GL_TRUE;
+    }
+
+    data = realloc(array->data, (size_t)capacity * array->elementSize);
+    if (data == NULL)
+    {
+        return GL_FALSE;
+    }
+
+    array->data = data;
+    array->capacity = capacity;
+
+    return GL_TRUE;
+}
+
+
+GLboolean arrayGrow(array_t *array, GLuint count)
+{
+    GLuint capacity = (array->capacity < ARRAY_MIN_CAPACITY) ? ARRAY_MIN_CAPACITY : array->capacity;
+
+    /* Grow geometrically so appends are amortized O(1) */
+    while (capacity < count)
+    {
+        capacity += capacity / 2;
+    }
+
+    return arrayReserve(array, capacity);
+}
+
+
+GLboolean arrayResize(array_t *array, GLuint count)
+{
+    if ( GL_FALSE == arrayGrow(array, count) )
+    {
+        return GL_FALSE;
+    }
+
+    array->count = count;
+
+    return GL_TRUE;
+}
+
+
+void arrayShrink(array_t *array)
+{
+    void *data;
+
+    if (array->count == 0 || array->count == array->capacity)
+    {
+        return;
+    }
+
+    /* Release the unused tail once loading has finished */
+    data = realloc(array->data, (size_t)array->count * array->elementSize);
+    if (data != NULL)
+    {
+        array->data = data;
+        array->capacity = array->count;
+    }
+}
+
+
+void arrayFree(array_t *array)
+{
+    free(array->data);
+    array->data = NULL;
+    array->count = 0;
+    array->capacity = 0;
+}
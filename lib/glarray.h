@@ -0,0 +1,72 @@
+#ifndef __GL_ARRAY_H__
+#define __GL_ARRAY_H__
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#define GLFW_INCLUDE_ES2
+#include <GLFW/glfw3.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************************/
+/*  Defines                                                        */
+/*******************************************************************/
+#define ARRAY_MIN_CAPACITY          64
+
+/* Typed access to the array storage, e.g. ARRAY_DATA(&object->v, GLfloat) */
+#define ARRAY_DATA(array, type)     ((type *)(array)->data)
+
+
+/*******************************************************************/
+/*  Typedefs                                                       */
+/*******************************************************************/
+typedef struct _array_t
+{
+    void *data;
+    GLuint count;
+    GLuint capacity;
+    GLuint elementSize;
+} array_t;
+
+
+/*******************************************************************/
+/*  Prototypes                                                     */
+/*******************************************************************/
+void arrayInit(array_t *array, GLuint elementSize);
+GLboolean arrayReserve(array_t *array, GLuint capacity);
+GLboolean arrayGrow(array_t *array, GLuint count);
+GLboolean arrayResize(array_t *array, GLuint count);
+void arrayShrink(array_t *array);
+void arrayFree(array_t *array);
+
+
+/*******************************************************************/
+/*  Inline Functions                                               */
+/*******************************************************************/
+
+/* Appends sit on the hot path of the loaders, keep the common case inline */
+static inline void *arrayAppend(array_t *array, const void *data, GLuint count)
+{
+    GLubyte *dest;
+
+    if (array->count + count > array->capacity && GL_FALSE == arrayGrow(array, array->count + count))
+    {
+        return NULL;
+    }
+
+    dest = (GLubyte *)array->data + (size_t)array->count * array->elementSize;
+    array->count += count;
+
+    if (data != NULL)
+    {
+        memcpy(dest, data, (size_t)count * array->elementSize);
+    }
+
+    return dest;
+}
+
+#endif
@@ -0,0 +1,212 @@
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#include "glatlas.h"
+
+
+/*******************************************************************/
+/*  Typedefs                                                       */
+/*******************************************************************/
+typedef struct _atlasSortKey_t
+{
+    GLuint height;
+    GLuint width;
+    GLuint index;
+} atlasSortKey_t;
+
+
+/*******************************************************************/
+/*  Functions                                                      */
+/*******************************************************************/
+int atlasCompareKeys(const void *a, const void *b)
+{
+    const atlasSortKey_t *keyA = (const atlasSortKey_t *)a;
+    const atlasSortKey_t *keyB = (const atlasSortKey_t *)b;
+
+    /* Tallest first, then widest, ties in the caller's order */
+    if (keyA->height != keyB->height)
+    {
+        return (keyA->height > keyB->height) ? -1 : 1;
+    }
+
+    if (keyA->width != keyB->width)
+    {
+        return (keyA->width > keyB->width) ? -1 : 1;
+    }
+
+    return (keyA->index < keyB->index) ? -1 : ((keyA->index > keyB->index) ? 1 : 0);
+}
+
+
+GLuint atlasRoundUp(GLuint size, GLboolean powerOfTwo)
+{
+    GLuint result = ATLAS_ALIGN;
+
+    /* Without the power of two rule the cell grid is enough */
+    if ( GL_FALSE == powerOfTwo )
+    {
+        return (size + ATLAS_ALIGN - 1) & ~(ATLAS_ALIGN - 1);
+    }
+
+    while (result < size)
+    {
+        result *= 2;
+    }
+
+    return result;
+}
+
+
+GLboolean atlasShelfPack(atlasRect_t *rects, const atlasSortKey_t *keys, GLuint count, GLuint size, GLboolean singlePage, GLboolean powerOfTwo, array_t *pages)
+{
+    atlasPage_t page = { 0, 0 };
+    atlasRect_t *rect;
+    GLuint shelfX = 0, shelfY = 0, shelfHeight = 0;
+    GLuint i;
+
+    pages->count = 0;
+
+    /* Rows of rects left to right, the first rect of a row is its tallest */
+    for(i=0;i<count;i++)
+    {
+        rect = &rects[keys[i].index];
+        rect->atlas = ATLAS_NONE;
+
+        if (keys[i].width > size || keys[i].height > size)
+        {
+            if ( GL_TRUE == singlePage )
+            {
+                return GL_FALSE;
+            }
+            continue;
+        }
+
+        if (shelfX + keys[i].width > size)
+        {
+            shelfY += shelfHeight;
+            shelfX = 0;
+            shelfHeight = 0;
+        }
+
+        if (shelfY + keys[i].height > size)
+        {
+            if ( GL_TRUE == singlePage )
+            {
+                return GL_FALSE;
+            }
+
+            arrayAppend(pages, &page, 1);
+            page.width = 0;
+            page.height = 0;
+            shelfX = 0;
+            shelfY = 0;
+            shelfHeight = 0;
+        }
+
+        rect->atlas = pages->count;
+        rect->x = shelfX + ATLAS_PADDING;
+        rect->y = shelfY + ATLAS_PADDING;
+
+        shelfX += keys[i].width;
+        shelfHeight = (keys[i].height > shelfHeight) ? keys[i].height : shelfHeight;
+
+        page.width = (shelfX > page.width) ? shelfX : page.width;
+        page.height = (shelfY + keys[i].height > page.height) ? shelfY + keys[i].height : page.height;
+    }
+
+    if (page.width != 0)
+    {
+        arrayAppend(pages, &page, 1);
+    }
+
+    /* Trim each page to what it holds */
+    for(i=0;i<pages->count;i++)
+    {
+        ARRAY_DATA(pages, atlasPage_t)[i].width = atlasRoundUp(ARRAY_DATA(pages, atlasPage_t)[i].width, powerOfTwo);
+        ARRAY_DATA(pages, atlasPage_t)[i].height = atlasRoundUp(ARRAY_DATA(pages, atlasPage_t)[i].height, powerOfTwo);
+    }
+
+    return GL_TRUE;
+}
+
+
+GLuint atlasPack(atlasRect_t *rects, GLuint count, GLuint maxSize, GLboolean powerOfTwo, array_t *pages)
+{
+    atlasSortKey_t *keys;
+    GLuint i, size, packed = 0;
+    size_t area = 0;
+
+    keys = (atlasSortKey_t *)malloc(sizeof(atlasSortKey_t)*(count + 1));
+    if (keys == NULL)
+    {
+        return 0;
+    }
+
+    for(i=0;i<count;i++)
+    {
+        keys[i].width = atlasGetPaddedSize(rects[i].width);
+        keys[i].height = atlasGetPaddedSize(rects[i].height);
+        keys[i].index = i;
+
+        area += (keys[i].width <= maxSize && keys[i].height <= maxSize) ? (size_t)keys[i].width * keys[i].height : 0;
+    }
+
+    qsort(keys, count, sizeof(atlasSortKey_t), atlasCompareKeys);
+
+    /* The smallest square page that takes everything, more pages once that passes maxSize */
+    for(size=ATLAS_ALIGN;(size_t)size * size < area && size < maxSize;size*=2);
+
+    while ( size < maxSize && GL_FALSE == atlasShelfPack(rects, keys, count, size, GL_TRUE, powerOfTwo, pages) )
+    {
+        size *= 2;
+    }
+
+    if (size >= maxSize)
+    {
+        atlasShelfPack(rects, keys, count, maxSize, GL_FALSE, powerOfTwo, pages);
+    }
+
+    for(i=0;i<count;i++)
+    {
+        packed += (rects[i].atlas != ATLAS_NONE) ? 1 : 0;
+    }
+
+    free(keys);
+
+    return packed;
+}
+
+
+void atlasBlit(image_t *page, const image_t *image, const atlasRect_t *rect)
+{
+    GLuint left = rect->x - ATLAS_PADDING;
+    GLuint top = rect->y - ATLAS_PADDING;
+    GLuint width = atlasGetPaddedSize(image->width);
+    GLuint height = atlasGetPaddedSize(image->height);
+    GLuint x, y, srcX, srcY;
+    GLubyte *dest;
+
+    /* The whole padded rect, texels outside the image repeat its nearest edge */
+    for(y=0;y<height;y++)
+    {
+        srcY = (y < ATLAS_PADDING) ? 0 : y - ATLAS_PADDING;
+        srcY = (srcY < image->height) ? srcY : image->height - 1;
+
+        dest = &page->data[(((size_t)(top + y) * page->width) + left) * BMP_PIX_PER_COL];
+
+        memcpy(&dest[ATLAS_PADDING * BMP_PIX_PER_COL], &image->data[(size_t)srcY * image->width * BMP_PIX_PER_COL],
+               (size_t)image->width * BMP_PIX_PER_COL);
+
+        for(x=0;x<ATLAS_PADDING;x++)
+        {
+            memcpy(&dest[x * BMP_PIX_PER_COL], &image->data[(size_t)srcY * image->width * BMP_PIX_PER_COL], BMP_PIX_PER_COL);
+        }
+
+        for(x=ATLAS_PADDING + image->width;x<width;x++)
+        {
+            srcX = image->width - 1;
+            memcpy(&dest[x * BMP_PIX_PER_COL], &image->data[(((size_t)srcY * image->width) + srcX) * BMP_PIX_PER_COL], BMP_PIX_PER_COL);
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef __GL_ATLAS_H__
+#define __GL_ATLAS_H__
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#define GLFW_INCLUDE_ES2
+#include <GLFW/glfw3.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "glarray.h"
+#include "glimage.h"
+
+/*******************************************************************/
+/*  Defines                                                        */
+/*******************************************************************/
+
+/* Padded rects start and end on this grid, a lookup cell never spans two images */
+#define ATLAS_ALIGN                 16
+
+/* Edge texels repeated around each image, bilinear taps and the first mip levels stay inside */
+#define ATLAS_PADDING               8
+
+#define ATLAS_NONE                  0xFFFFFFFF
+
+
+/*******************************************************************/
+/*  Typedefs                                                       */
+/*******************************************************************/
+/* One image to place, width and height from the caller, the rest from atlasPack() */
+typedef struct _atlasRect_t
+{
+    GLuint width;
+    GLuint height;
+
+    /* Page and texel the image starts at, inside its padding, ATLAS_NONE if it did not fit */
+    GLuint atlas;
+    GLuint x;
+    GLuint y;
+} atlasRect_t;
+
+/* Page holding every rect with its index, a power of two unless the caller allows otherwise */
+typedef struct _atlasPage_t
+{
+    GLuint width;
+    GLuint height;
+} atlasPage_t;
+
+
+/*******************************************************************/
+/*  Prototypes                                                     */
+/*******************************************************************/
+GLuint atlasPack(atlasRect_t *rects, GLuint count, GLuint maxSize, GLboolean powerOfTwo, array_t *pages);
+void atlasBlit(image_t *page, const image_t *image, const atlasRect_t *rect);
+
+
+/*******************************************************************/
+/*  Inline Functions                                               */
+/*******************************************************************/
+/* Size of an image with its padding, rounded up to the cell grid */
+static inline GLuint atlasGetPaddedSize(GLuint size)
+{
+    return (size + (2 * ATLAS_PADDING) + ATLAS_ALIGN - 1) & ~(ATLAS_ALIGN - 1);
+}
+
+#endif
@@ -0,0 +1,888 @@
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#include "glbvh.h"
+
+
+/*******************************************************************/
+/*  Defines                                                        */
+/*******************************************************************/
+
+/* Cost of visiting a node against testing one triangle */
+#define BVH_TRAVERSAL_COST              1.0f
+
+/* Below this depth splits are halves by index, which keeps the tree under BVH_MAX_DEPTH */
+#define BVH_MEDIAN_DEPTH                (BVH_MAX_DEPTH - 32)
+
+#define BVH_TASKS_PER_THREAD            4
+#define BVH_MIN_TASK_SIZE               4096
+
+
+/*******************************************************************/
+/*  Typedefs                                                       */
+/*******************************************************************/
+typedef struct _bvhBuildContext_t
+{
+    const GLfloat *positions;
+    const GLuint *indices;
+
+    /* Per triangle, min then max, and the centroid */
+    GLfloat *bounds;
+    GLfloat *centroids;
+
+    /* Triangle ids, partitioned in place as the tree goes down */
+    GLuint *refs;
+    GLuint numOfTriangles;
+
+    /* Ranges this small are left to the pool */
+    GLuint taskSize;
+    array_t subtrees;
+} bvhBuildContext_t;
+
+typedef struct _bvhRangeTask_t
+{
+    bvhBuildContext_t *context;
+    GLuint start;
+    GLuint end;
+} bvhRangeTask_t;
+
+/* A range of the top tree built on its own, root first, then stitched in */
+typedef struct _bvhSubtree_t
+{
+    bvhBuildContext_t *context;
+    GLuint start;
+    GLuint end;
+    GLuint node;
+    GLuint depth;
+
+    array_t nodes;
+    GLuint maxDepth;
+    GLboolean result;
+} bvhSubtree_t;
+
+typedef struct _bvhBin_t
+{
+    GLfloat min[3];
+    GLfloat max[3];
+    GLuint count;
+} bvhBin_t;
+
+
+/*******************************************************************/
+/*  Functions                                                      */
+/*******************************************************************/
+void bvhInit(bvh_t *bvh)
+{
+    arrayInit(&bvh->nodes, sizeof(bvhNode_t));
+
+    bvh->corners = NULL;
+    bvh->triangles = NULL;
+    bvh->numOfTriangles = 0;
+    bvh->depth = 0;
+}
+
+
+void bvhFree(bvh_t *bvh)
+{
+    arrayFree(&bvh->nodes);
+    free(bvh->corners);
+    free(bvh->triangles);
+
+    bvhInit(bvh);
+}
+
+
+void bvhResetBounds(GLfloat *min, GLfloat *max)
+{
+    GLuint i;
+
+    for(i=0;i<3;i++)
+    {
+        min[i] = FLT_MAX;
+        max[i] = -FLT_MAX;
+    }
+}
+
+
+void bvhGrowBounds(GLfloat *min, GLfloat *max, const GLfloat *pointMin, const GLfloat *pointMax)
+{
+    GLuint i;
+
+    for(i=0;i<3;i++)
+    {
+        min[i] = (pointMin[i] < min[i]) ? pointMin[i] : min[i];
+        max[i] = (pointMax[i] > max[i]) ? pointMax[i] : max[i];
+    }
+}
+
+
+GLfloat bvhGetHalfArea(const GLfloat *min, const GLfloat *max)
+{
+    GLfloat x = max[0] - min[0];
+    GLfloat y = max[1] - min[1];
+    GLfloat z = max[2] - min[2];
+
+    /* Empty bins keep their reset bounds */
+    if (x < 0.0f)
+    {
+        return 0.0f;
+    }
+
+    return (x * y) + (y * z) + (z * x);
+}
+
+
+void bvhTriangleBoundsTask(void *arg)
+{
+    bvhRangeTask_t *task = (bvhRangeTask_t *)arg;
+    bvhBuildContext_t *context = task->context;
+    const GLfloat *corner;
+    GLfloat *min, *max;
+    GLuint i, j, k;
+
+    for(i=task->start;i<task->end;i++)
+    {
+        min = &context->bounds[i*6];
+        max = &context->bounds[i*6+3];
+        bvhResetBounds(min, max);
+
+        for(j=0;j<3;j++)
+        {
+            corner = &context->positions[context->indices[i*3+j]*3];
+            bvhGrowBounds(min, max, corner, corner);
+        }
+
+        for(k=0;k<3;k++)
+        {
+            context->centroids[i*3+k] = (min[k] + max[k]) * 0.5f;
+        }
+
+        context->refs[i] = i;
+    }
+}
+
+
+void bvhRunRangeTasks(threadPool_t *pool, threadTask_f func, bvhBuildContext_t *context, GLuint count)
+{
+    bvhRangeTask_t *tasks;
+    GLuint numOfTasks = 1;
+    GLuint taskSize, i;
+
+    if (pool != NULL)
+    {
+        numOfTasks = pool->numOfThreads * BVH_TASKS_PER_THREAD;
+        while (numOfTasks > 1 && count / numOfTasks < BVH_MIN_TASK_SIZE)
+        {
+            numOfTasks--;
+        }
+    }
+
+    taskSize = (count + numOfTasks - 1) / numOfTasks;
+    tasks = (bvhRangeTask_t *)malloc(sizeof(bvhRangeTask_t) * numOfTasks);
+
+    for(i=0;i<numOfTasks;i++)
+    {
+        tasks[i].context = context;
+        tasks[i].start = (i * taskSize < count) ? i * taskSize : count;
+        tasks[i].end = (tasks[i].start + taskSize < count) ? tasks[i].start + taskSize : count;
+    }
+
+    if (numOfTasks > 1)
+    {
+        for(i=0;i<numOfTasks;i++)
+        {
+            threadPoolSubmit(pool, func, &tasks[i]);
+        }
+        threadPoolWait(pool);
+    }
+    else
+    {
+        func(&tasks[0]);
+    }
+
+    free(tasks);
+}
+
+
+GLuint bvhFindSplit(const bvhBuildContext_t *context, GLuint start, GLuint end, const GLfloat *centroidMin, const GLfloat *centroidMax,
+                    GLfloat parentArea, GLuint *splitAxis, GLfloat *splitPosition, GLfloat *splitCost)
+{
+    bvhBin_t bins[BVH_NUM_OF_BINS];
+    GLfloat rightArea[BVH_NUM_OF_BINS];
+    GLuint rightCount[BVH_NUM_OF_BINS];
+    GLfloat min[3], max[3];
+    GLfloat extent, scale, cost, bestCost;
+    GLuint axis, bin, leftCount, i;
+    GLuint bestBin = BVH_NUM_OF_BINS;
+
+    bestCost = FLT_MAX;
+
+    for(axis=0;axis<3;axis++)
+    {
+        extent = centroidMax[axis] - centroidMin[axis];
+        if (extent <= 0.0f)
+        {
+            continue;
+        }
+
+        for(bin=0;bin<BVH_NUM_OF_BINS;bin++)
+        {
+            bvhResetBounds(bins[bin].min, bins[bin].max);
+            bins[bin].count = 0;
+        }
+
+        scale = (GLfloat)BVH_NUM_OF_BINS / extent;
+        for(i=start;i<end;i++)
+        {
+            bin = (GLuint)((context->centroids[context->refs[i]*3+axis] - centroidMin[axis]) * scale);
+            bin = (bin < BVH_NUM_OF_BINS) ? bin : BVH_NUM_OF_BINS - 1;
+
+            bvhGrowBounds(bins[bin].min, bins[bin].max, &context->bounds[context->refs[i]*6], &context->bounds[context->refs[i]*6+3]);
+            bins[bin].count++;
+        }
+
+        /* Right sides from the top bin down, then the left sides on the way up */
+        bvhResetBounds(min, max);
+        rightCount[0] = 0;
+        for(bin=BVH_NUM_OF_BINS-1;bin>0;bin--)
+        {
+            bvhGrowBounds(min, max, bins[bin].min, bins[bin].max);
+            rightArea[bin] = bvhGetHalfArea(min, max);
+            rightCount[bin] = ((bin + 1 < BVH_NUM_OF_BINS) ? rightCount[bin+1] : 0) + bins[bin].count;
+        }
+
+        bvhResetBounds(min, max);
+        leftCount = 0;
+        for(bin=0;bin+1<BVH_NUM_OF_BINS;bin++)
+        {
+            bvhGrowBounds(min, max, bins[bin].min, bins[bin].max);
+            leftCount += bins[bin].count;
+
+            if (leftCount == 0 || rightCount[bin+1] == 0)
+            {
+                continue;
+            }
+
+            /* One visit plus a test per triangle on each side, weighted by the odds of reaching it */
+            cost = (BVH_TRAVERSAL_COST * parentArea) + (bvhGetHalfArea(min, max) * leftCount) + (rightArea[bin+1] * rightCount[bin+1]);
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestBin = bin;
+                *splitAxis = axis;
+                *splitPosition = centroidMin[axis] + ((GLfloat)(bin + 1) / scale);
+            }
+        }
+    }
+
+    *splitCost = bestCost;
+
+    return bestBin;
+}
+
+
+GLboolean bvhBuildRange(bvhBuildContext_t *context, array_t *nodes, array_t *subtrees, GLuint nodeIndex, GLuint start, GLuint end, GLuint depth, GLuint *maxDepth)
+{
+    bvhSubtree_t subtree;
+    bvhNode_t *node;
+    GLfloat centroidMin[3], centroidMax[3];
+    GLfloat splitPosition = 0.0f, splitCost, area;
+    GLuint splitAxis = 0;
+    GLuint count = end - start;
+    GLuint bin, middle, left, swap, i;
+
+    *maxDepth = (depth > *maxDepth) ? depth : *maxDepth;
+
+    node = &ARRAY_DATA(nodes, bvhNode_t)[nodeIndex];
+    bvhResetBounds(node->min, node->max);
+    bvhResetBounds(centroidMin, centroidMax);
+
+    for(i=start;i<end;i++)
+    {
+        bvhGrowBounds(node->min, node->max, &context->bounds[context->refs[i]*6], &context->bounds[context->refs[i]*6+3]);
+        bvhGrowBounds(centroidMin, centroidMax, &context->centroids[context->refs[i]*3], &context->centroids[context->refs[i]*3]);
+    }
+
+    node->first = start;
+    node->count = count;
+
+    if (count <= 1)
+    {
+        return GL_TRUE;
+    }
+
+    /* Small enough for a thread of its own, the bounds above stay for the parent */
+    if (subtrees != NULL && count <= context->taskSize)
+    {
+        subtree.context = context;
+        subtree.start = start;
+        subtree.end = end;
+        subtree.node = nodeIndex;
+        subtree.depth = depth;
+
+        node->count = 0;
+
+        return (arrayAppend(subtrees, &subtree, 1) != NULL) ? GL_TRUE : GL_FALSE;
+    }
+
+    middle = start + (count / 2);
+
+    if (depth >= BVH_MEDIAN_DEPTH && count <= BVH_MAX_LEAF_SIZE)
+    {
+        return GL_TRUE;
+    }
+
+    if (depth < BVH_MEDIAN_DEPTH)
+    {
+        area = bvhGetHalfArea(node->min, node->max);
+        bin = bvhFindSplit(context, start, end, centroidMin, centroidMax, area, &splitAxis, &splitPosition, &splitCost);
+
+        /* Small ranges stay a leaf unless a split pays for its extra visit */
+        if (count <= BVH_MAX_LEAF_SIZE && (bin == BVH_NUM_OF_BINS || splitCost >= area * count))
+        {
+            return GL_TRUE;
+        }
+
+        if (bin != BVH_NUM_OF_BINS)
+        {
+            left = start;
+            for(i=start;i<end;i++)
+            {
+                if (context->centroids[context->refs[i]*3+splitAxis] < splitPosition)
+                {
+                    swap = context->refs[i];
+                    context->refs[i] = context->refs[left];
+                    context->refs[left] = swap;
+                    left++;
+                }
+            }
+
+            /* Rounding can put a bin edge past every centroid, halves are still a valid split */
+            middle = (left != start && left != end) ? left : middle;
+        }
+    }
+
+    left = nodes->count;
+    if (arrayAppend(nodes, NULL, 2) == NULL)
+    {
+        return GL_FALSE;
+    }
+
+    node = &ARRAY_DATA(nodes, bvhNode_t)[nodeIndex];
+    node->first = left;
+    node->count = 0;
+
+    if ( GL_FALSE == bvhBuildRange(context, nodes, subtrees, left, start, middle, depth + 1, maxDepth) )
+    {
+        return GL_FALSE;
+    }
+
+    return bvhBuildRange(context, nodes, subtrees, left + 1, middle, end, depth + 1, maxDepth);
+}
+
+
+void bvhSubtreeTask(void *arg)
+{
+    bvhSubtree_t *subtree = (bvhSubtree_t *)arg;
+
+    subtree->maxDepth = subtree->depth;
+    subtree->result = GL_FALSE;
+
+    if (arrayAppend(&subtree->nodes, NULL, 1) != NULL)
+    {
+        subtree->result = bvhBuildRange(subtree->context, &subtree->nodes, NULL, 0, subtree->start, subtree->end, subtree->depth, &subtree->maxDepth);
+    }
+}
+
+
+GLboolean bvhAttachSubtree(bvh_t *bvh, const bvhSubtree_t *subtree)
+{
+    bvhNode_t *nodes;
+    GLuint base = bvh->nodes.count;
+    GLuint i;
+
+    if (subtree->nodes.count > 1 && arrayAppend(&bvh->nodes, &ARRAY_DATA(&subtree->nodes, bvhNode_t)[1], subtree->nodes.count - 1) == NULL)
+    {
+        return GL_FALSE;
+    }
+
+    /* The subtree root takes the place the top tree kept for it, the rest follow from base */
+    nodes = ARRAY_DATA(&bvh->nodes, bvhNode_t);
+    nodes[subtree->node] = ARRAY_DATA(&subtree->nodes, bvhNode_t)[0];
+
+    if (nodes[subtree->node].count == 0)
+    {
+        nodes[subtree->node].first += base - 1;
+    }
+
+    for(i=base;i<bvh->nodes.count;i++)
+    {
+        nodes[i].first += (nodes[i].count == 0) ? base - 1 : 0;
+    }
+
+    bvh->depth = (subtree->maxDepth > bvh->depth) ? subtree->maxDepth : bvh->depth;
+
+    return GL_TRUE;
+}
+
+
+GLboolean bvhBuild(bvh_t *bvh, const GLfloat *positions, const GLuint *indices, GLuint numOfTriangles, threadPool_t *pool)
+{
+    bvhBuildContext_t context;
+    bvhSubtree_t *subtrees;
+    GLboolean result = GL_TRUE;
+    GLuint i, j;
+
+    bvhFree(bvh);
+
+    if (numOfTriangles == 0)
+    {
+        return GL_FALSE;
+    }
+
+    context.positions = positions;
+    context.indices = indices;
+    context.numOfTriangles = numOfTriangles;
+    context.bounds = (GLfloat *)malloc(sizeof(GLfloat) * 6 * numOfTriangles);
+    context.centroids = (GLfloat *)malloc(sizeof(GLfloat) * 3 * numOfTriangles);
+    context.refs = (GLuint *)malloc(sizeof(GLuint) * numOfTriangles);
+    arrayInit(&context.subtrees, sizeof(bvhSubtree_t));
+
+    /* The top of the tree is split here, every range under this size becomes one task */
+    context.taskSize = 0;
+    if (pool != NULL && pool->numOfThreads > 1)
+    {
+        context.taskSize = numOfTriangles / (pool->numOfThreads * BVH_TASKS_PER_THREAD);
+        context.taskSize = (context.taskSize > BVH_MIN_TASK_SIZE) ? context.taskSize : BVH_MIN_TASK_SIZE;
+    }
+
+    if (context.bounds == NULL || context.centroids == NULL || context.refs == NULL ||
+        arrayReserve(&bvh->nodes, 2 * ((numOfTriangles / BVH_MAX_LEAF_SIZE) + 1)) == GL_FALSE || arrayAppend(&bvh->nodes, NULL, 1) == NULL)
+    {
+        result = GL_FALSE;
+    }
+
+    if ( GL_TRUE == result )
+    {
+        bvhRunRangeTasks(pool, bvhTriangleBoundsTask, &context, numOfTriangles);
+        result = bvhBuildRange(&context, &bvh->nodes, (context.taskSize != 0) ? &context.subtrees : NULL, 0, 0, numOfTriangles, 0, &bvh->depth);
+    }
+
+    subtrees = ARRAY_DATA(&context.subtrees, bvhSubtree_t);
+    for(i=0;i<context.subtrees.count;i++)
+    {
+        arrayInit(&subtrees[i].nodes, sizeof(bvhNode_t));
+    }
+
+    if ( GL_TRUE == result && context.subtrees.count > 0 )
+    {
+        for(i=0;i<context.subtrees.count;i++)
+        {
+            threadPoolSubmit(pool, bvhSubtreeTask, &subtrees[i]);
+        }
+        threadPoolWait(pool);
+
+        for(i=0;i<context.subtrees.count && GL_TRUE == result;i++)
+        {
+            result = (GL_TRUE == subtrees[i].result) ? bvhAttachSubtree(bvh, &subtrees[i]) : GL_FALSE;
+        }
+    }
+
+    for(i=0;i<context.subtrees.count;i++)
+    {
+        arrayFree(&subtrees[i].nodes);
+    }
+
+    /* Corners in leaf order, a leaf reads one contiguous block */
+    bvh->corners = (GLfloat *)malloc(sizeof(GLfloat) * 9 * numOfTriangles);
+    if ( GL_TRUE == result && bvh->corners != NULL )
+    {
+        for(i=0;i<numOfTriangles;i++)
+        {
+            for(j=0;j<3;j++)
+            {
+                memcpy(&bvh->corners[(i*9)+(j*3)], &positions[indices[(context.refs[i]*3)+j]*3], sizeof(GLfloat) * 3);
+            }
+        }
+
+        bvh->triangles = context.refs;
+        bvh->numOfTriangles = numOfTriangles;
+        context.refs = NULL;
+        arrayShrink(&bvh->nodes);
+    }
+    else
+    {
+        result = GL_FALSE;
+    }
+
+    free(context.bounds);
+    free(context.centroids);
+    free(context.refs);
+    arrayFree(&context.subtrees);
+
+    if ( GL_FALSE == result )
+    {
+        bvhFree(bvh);
+    }
+
+    return result;
+}
+
+
+GLfloat bvhIntersectBox(const bvhNode_t *node, const GLfloat *origin, const GLfloat *invDirection, GLfloat maxDistance)
+{
+    GLfloat near = 0.0f, far = maxDistance;
+    GLfloat t0, t1, swap;
+    GLuint i;
+
+    /* Slabs, a zero direction gives infinities which still order correctly */
+    for(i=0;i<3;i++)
+    {
+        t0 = (node->min[i] - origin[i]) * invDirection[i];
+        t1 = (node->max[i] - origin[i]) * invDirection[i];
+
+        if (t0 > t1)
+        {
+            swap = t0;
+            t0 = t1;
+            t1 = swap;
+        }
+
+        near = (t0 > near) ? t0 : near;
+        far = (t1 < far) ? t1 : far;
+    }
+
+    return (near <= far) ? near : FLT_MAX;
+}
+
+
+GLboolean bvhIntersectTriangle(const GLfloat *corners, const GLfloat *origin, const GLfloat *direction, GLfloat maxDistance, GLfloat *result)
+{
+    GLfloat edge1[3], edge2[3], p[3], s[3], q[3];
+    GLfloat det, invDet, u, v, t;
+    GLuint i;
+
+    for(i=0;i<3;i++)
+    {
+        edge1[i] = corners[3+i] - corners[i];
+        edge2[i] = corners[6+i] - corners[i];
+        s[i] = origin[i] - corners[i];
+    }
+
+    /* Moller-Trumbore, both faces count as a hit */
+    p[0] = (direction[1] * edge2[2]) - (direction[2] * edge2[1]);
+    p[1] = (direction[2] * edge2[0]) - (direction[0] * edge2[2]);
+    p[2] = (direction[0] * edge2[1]) - (direction[1] * edge2[0]);
+
+    det = (edge1[0] * p[0]) + (edge1[1] * p[1]) + (edge1[2] * p[2]);
+    if (det > -FLT_EPSILON * FLT_EPSILON && det < FLT_EPSILON * FLT_EPSILON)
+    {
+        return GL_FALSE;
+    }
+
+    invDet = 1.0f / det;
+    u = ((s[0] * p[0]) + (s[1] * p[1]) + (s[2] * p[2])) * invDet;
+    if (u < 0.0f || u > 1.0f)
+    {
+        return GL_FALSE;
+    }
+
+    q[0] = (s[1] * edge1[2]) - (s[2] * edge1[1]);
+    q[1] = (s[2] * edge1[0]) - (s[0] * edge1[2]);
+    q[2] = (s[0] * edge1[1]) - (s[1] * edge1[0]);
+
+    v = ((direction[0] * q[0]) + (direction[1] * q[1]) + (direction[2] * q[2])) * invDet;
+    if (v < 0.0f || u + v > 1.0f)
+    {
+        return GL_FALSE;
+    }
+
+    t = ((edge2[0] * q[0]) + (edge2[1] * q[1]) + (edge2[2] * q[2])) * invDet;
+    if (t < 0.0f || t >= maxDistance)
+    {
+        return GL_FALSE;
+    }
+
+    result[0] = t;
+    result[1] = u;
+    result[2] = v;
+
+    return GL_TRUE;
+}
+
+
+GLboolean bvhRayCast(const bvh_t *bvh, const GLfloat *origin, const GLfloat *direction, GLfloat maxDistance, bvhHit_t *hit)
+{
+    const bvhNode_t *nodes = ARRAY_DATA(&bvh->nodes, bvhNode_t);
+    const bvhNode_t *node;
+    GLuint stack[BVH_MAX_DEPTH * 2];
+    GLfloat stackDistances[BVH_MAX_DEPTH * 2];
+    GLfloat invDirection[3], result[3];
+    GLfloat nearLeft, nearRight;
+    GLuint numOfEntries = 0;
+    GLuint i;
+
+    hit->triangle = BVH_NO_HIT;
+    hit->distance = maxDistance;
+
+    if (bvh->numOfTriangles == 0)
+    {
+        return GL_FALSE;
+    }
+
+    for(i=0;i<3;i++)
+    {
+        invDirection[i] = 1.0f / direction[i];
+    }
+
+    stack[numOfEntries] = 0;
+    stackDistances[numOfEntries++] = bvhIntersectBox(&nodes[0], origin, invDirection, maxDistance);
+
+    while (numOfEntries > 0)
+    {
+        numOfEntries--;
+
+        /* A hit found since the push may rule the node out */
+        if (stackDistances[numOfEntries] >= hit->distance)
+        {
+            continue;
+        }
+
+        node = &nodes[stack[numOfEntries]];
+
+        if (node->count != 0)
+        {
+            for(i=node->first;i<node->first+node->count;i++)
+            {
+                if ( GL_TRUE == bvhIntersectTriangle(&bvh->corners[i*9], origin, direction, hit->distance, result) )
+                {
+                    hit->triangle = i;
+                    hit->distance = result[0];
+                    hit->u = result[1];
+                    hit->v = result[2];
+                }
+            }
+            continue;
+        }
+
+        nearLeft = bvhIntersectBox(&nodes[node->first], origin, invDirection, hit->distance);
+        nearRight = bvhIntersectBox(&nodes[node->first+1], origin, invDirection, hit->distance);
+
+        /* Farther child pushed first, the nearer one comes off the stack next */
+        if (nearLeft <= nearRight)
+        {
+            stack[numOfEntries] = node->first + 1;
+            stackDistances[numOfEntries++] = nearRight;
+            stack[numOfEntries] = node->first;
+            stackDistances[numOfEntries++] = nearLeft;
+        }
+        else
+        {
+            stack[numOfEntries] = node->first;
+            stackDistances[numOfEntries++] = nearLeft;
+            stack[numOfEntries] = node->first + 1;
+            stackDistances[numOfEntries++] = nearRight;
+        }
+    }
+
+    if (hit->triangle == BVH_NO_HIT)
+    {
+        return GL_FALSE;
+    }
+
+    for(i=0;i<3;i++)
+    {
+        hit->point[i] = origin[i] + (direction[i] * hit->distance);
+    }
+    hit->triangle = bvh->triangles[hit->triangle];
+
+    return GL_TRUE;
+}
+
+
+GLfloat bvhGetBoxDistance(const bvhNode_t *node, const GLfloat *point)
+{
+    GLfloat distance = 0.0f;
+    GLfloat d;
+    GLuint i;
+
+    /* Squared, zero inside the box */
+    for(i=0;i<3;i++)
+    {
+        d = (point[i] < node->min[i]) ? node->min[i] - point[i] : ((point[i] > node->max[i]) ? point[i] - node->max[i] : 0.0f);
+        distance += d * d;
+    }
+
+    return distance;
+}
+
+
+GLfloat bvhDot(const GLfloat *a, const GLfloat *b)
+{
+    return (a[0] * b[0]) + (a[1] * b[1]) + (a[2] * b[2]);
+}
+
+
+GLfloat bvhClosestPointOnTriangle(const GLfloat *corners, const GLfloat *point, GLfloat *result)
+{
+    GLfloat ab[3], ac[3], ap[3], bp[3], cp[3], closest[3];
+    GLfloat d1, d2, d3, d4, d5, d6, va, vb, vc, denom, distance;
+    GLfloat u, v;
+    GLuint i;
+
+    for(i=0;i<3;i++)
+    {
+        ab[i] = corners[3+i] - corners[i];
+        ac[i] = corners[6+i] - corners[i];
+        ap[i] = point[i] - corners[i];
+        bp[i] = point[i] - corners[3+i];
+        cp[i] = point[i] - corners[6+i];
+    }
+
+    /* Voronoi regions of the corners, then the edges, then the face */
+    d1 = bvhDot(ab, ap);
+    d2 = bvhDot(ac, ap);
+    d3 = bvhDot(ab, bp);
+    d4 = bvhDot(ac, bp);
+    d5 = bvhDot(ab, cp);
+    d6 = bvhDot(ac, cp);
+
+    vc = (d1 * d4) - (d3 * d2);
+    vb = (d5 * d2) - (d1 * d6);
+    va = (d3 * d6) - (d5 * d4);
+
+    if (d1 <= 0.0f && d2 <= 0.0f)
+    {
+        u = 0.0f;
+        v = 0.0f;
+    }
+    else if (d3 >= 0.0f && d4 <= d3)
+    {
+        u = 1.0f;
+        v = 0.0f;
+    }
+    else if (d6 >= 0.0f && d5 <= d6)
+    {
+        u = 0.0f;
+        v = 1.0f;
+    }
+    else if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+    {
+        u = d1 / (d1 - d3);
+        v = 0.0f;
+    }
+    else if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+    {
+        u = 0.0f;
+        v = d2 / (d2 - d6);
+    }
+    else if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+    {
+        v = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        u = 1.0f - v;
+    }
+    else
+    {
+        denom = 1.0f / (va + vb + vc);
+        u = vb * denom;
+        v = vc * denom;
+    }
+
+    distance = 0.0f;
+    for(i=0;i<3;i++)
+    {
+        closest[i] = corners[i] + (ab[i] * u) + (ac[i] * v);
+        distance += (point[i] - closest[i]) * (point[i] - closest[i]);
+    }
+
+    memcpy(result, closest, sizeof(GLfloat) * 3);
+    result[3] = u;
+    result[4] = v;
+
+    return distance;
+}
+
+
+GLboolean bvhClosestPoint(const bvh_t *bvh, const GLfloat *point, GLfloat maxDistance, bvhHit_t *hit)
+{
+    const bvhNode_t *nodes = ARRAY_DATA(&bvh->nodes, bvhNode_t);
+    const bvhNode_t *node;
+    GLuint stack[BVH_MAX_DEPTH * 2];
+    GLfloat stackDistances[BVH_MAX_DEPTH * 2];
+    GLfloat result[5];
+    GLfloat nearLeft, nearRight, distance, best;
+    GLuint numOfEntries = 0;
+    GLuint i;
+
+    hit->triangle = BVH_NO_HIT;
+    hit->distance = maxDistance;
+
+    if (bvh->numOfTriangles == 0)
+    {
+        return GL_FALSE;
+    }
+
+    /* Squared distances while searching, the same order as the ray cast */
+    best = (maxDistance < FLT_MAX) ? maxDistance * maxDistance : FLT_MAX;
+
+    stack[numOfEntries] = 0;
+    stackDistances[numOfEntries++] = bvhGetBoxDistance(&nodes[0], point);
+
+    while (numOfEntries > 0)
+    {
+        numOfEntries--;
+
+        if (stackDistances[numOfEntries] >= best)
+        {
+            continue;
+        }
+
+        node = &nodes[stack[numOfEntries]];
+
+        if (node->count != 0)
+        {
+            for(i=node->first;i<node->first+node->count;i++)
+            {
+                distance = bvhClosestPointOnTriangle(&bvh->corners[i*9], point, result);
+                if (distance < best)
+                {
+                    best = distance;
+                    hit->triangle = i;
+                    memcpy(hit->point, result, sizeof(GLfloat) * 3);
+                    hit->u = result[3];
+                    hit->v = result[4];
+                }
+            }
+            continue;
+        }
+
+        nearLeft = bvhGetBoxDistance(&nodes[node->first], point);
+        nearRight = bvhGetBoxDistance(&nodes[node->first+1], point);
+
+        if (nearLeft <= nearRight)
+        {
+            stack[numOfEntries] = node->first + 1;
+            stackDistances[numOfEntries++] = nearRight;
+            stack[numOfEntries] = node->first;
+            stackDistances[numOfEntries++] = nearLeft;
+        }
+        else
+        {
+            stack[numOfEntries] = node->first;
+            stackDistances[numOfEntries++] = nearLeft;
+            stack[numOfEntries] = node->first + 1;
+            stackDistances[numOfEntries++] = nearRight;
+        }
+    }
+
+    if (hit->triangle == BVH_NO_HIT)
+    {
+        return GL_FALSE;
+    }
+
+    hit->distance = sqrtf(best);
+    hit->triangle = bvh->triangles[hit->triangle];
+
+    return GL_TRUE;
+}
@@ -0,0 +1,90 @@
+#ifndef __GL_BVH_H__
+#define __GL_BVH_H__
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#define GLFW_INCLUDE_ES2
+#include <GLFW/glfw3.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+#include "glarray.h"
+#include "glthreadpool.h"
+
+/*******************************************************************/
+/*  Defines                                                        */
+/*******************************************************************/
+
+/* Centroid bins tried along each axis for a split */
+#define BVH_NUM_OF_BINS             16
+
+/* Leaves never hold more, ranges with equal centroids are halved instead */
+#define BVH_MAX_LEAF_SIZE           8
+
+/* Deepest path a query walks, one stack slot per level */
+#define BVH_MAX_DEPTH               64
+
+#define BVH_NO_HIT                  0xFFFFFFFF
+
+
+/*******************************************************************/
+/*  Typedefs                                                       */
+/*******************************************************************/
+/* 32 bytes, the children of an inner node sit side by side at first and first + 1 */
+typedef struct _bvhNode_t
+{
+    GLfloat min[3];
+
+    /* Inner, the left child. Leaf, the first of its triangles */
+    GLuint first;
+
+    GLfloat max[3];
+
+    /* Triangles in the leaf, zero for an inner node */
+    GLuint count;
+} bvhNode_t;
+
+/* Nodes from the root down and the triangles in leaf order, the mesh is not needed after the build */
+typedef struct _bvh_t
+{
+    array_t nodes;
+
+    /* Three corners per triangle and the index the caller built it with */
+    GLfloat *corners;
+    GLuint *triangles;
+    GLuint numOfTriangles;
+
+    GLuint depth;
+} bvh_t;
+
+typedef struct _bvhHit_t
+{
+    /* BVH_NO_HIT until a query finds one */
+    GLuint triangle;
+
+    /* Along the ray for a cast, from the query point for a closest point */
+    GLfloat distance;
+    GLfloat point[3];
+
+    /* Barycentrics of the point on the second and third corner */
+    GLfloat u;
+    GLfloat v;
+} bvhHit_t;
+
+
+/*******************************************************************/
+/*  Prototypes                                                     */
+/*******************************************************************/
+void bvhInit(bvh_t *bvh);
+void bvhFree(bvh_t *bvh);
+GLboolean bvhBuild(bvh_t *bvh, const GLfloat *positions, const GLuint *indices, GLuint numOfTriangles, threadPool_t *pool);
+GLboolean bvhRayCast(const bvh_t *bvh, const GLfloat *origin, const GLfloat *direction, GLfloat maxDistance, bvhHit_t *hit);
+GLboolean bvhClosestPoint(const bvh_t *bvh, const GLfloat *point, GLfloat maxDistance, bvhHit_t *hit);
+
+#endif
@@ -0,0 +1,213 @@
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "glcache.h"
+
+/*******************************************************************/
+/*  Defines                                                        */
+/*******************************************************************/
+#define CACHE_HASH_SEED             0x9E3779B97F4A7C15ull
+#define CACHE_HASH_PRIME1           0x87C37B91114253D5ull
+#define CACHE_HASH_PRIME2           0x4CF5AD432745937Full
+#define CACHE_HASH_PRIME3           0xFF51AFD7ED558CCDull
+
+#define CACHE_TMP_SUFFIX            ".tmpXXXXXX"
+#define CACHE_FILE_MODE             0644
+
+
+/*******************************************************************/
+/*  Functions                                                      */
+/*******************************************************************/
+uint64_t cacheHash(const void *data, size_t size)
+{
+    const GLubyte *p = (const GLubyte *)data;
+    uint64_t hash = CACHE_HASH_SEED ^ size;
+    uint64_t word;
+
+    /* Mix a word at a time, the tail is zero padded to a full word */
+    while (size != 0)
+    {
+        word = 0;
+        memcpy(&word, p, (size < sizeof(word)) ? size : sizeof(word));
+
+        hash ^= word * CACHE_HASH_PRIME1;
+        hash = ((hash << 31) | (hash >> 33)) * CACHE_HASH_PRIME2;
+
+        p += (size < sizeof(word)) ? size : sizeof(word);
+        size -= (size < sizeof(word)) ? size : sizeof(word);
+    }
+
+    hash ^= hash >> 33;
+    hash *= CACHE_HASH_PRIME3;
+    hash ^= hash >> 29;
+
+    return hash;
+}
+
+
+GLboolean cacheStatFile(const char *fileName, cacheKey_t *key)
+{
+    struct stat fileInfo;
+
+    if ( stat(fileName, &fileInfo) != 0 )
+    {
+        return GL_FALSE;
+    }
+
+    key->size = (uint64_t)fileInfo.st_size;
+    key->mtime = ((int64_t)fileInfo.st_mtim.tv_sec * 1000000000) + fileInfo.st_mtim.tv_nsec;
+
+    return GL_TRUE;
+}
+
+
+GLboolean cacheHashFile(const char *fileName, uint64_t *hash)
+{
+    const void *data;
+    size_t size;
+    struct stat fileInfo;
+
+    /* An empty file cannot be mapped */
+    if ( stat(fileName, &fileInfo) == 0 && fileInfo.st_size == 0 )
+    {
+        *hash = cacheHash(NULL, 0);
+        return GL_TRUE;
+    }
+
+    data = cacheMapFile(fileName, &size);
+    if (data == NULL)
+    {
+        return GL_FALSE;
+    }
+
+    *hash = cacheHash(data, size);
+
+    cacheUnmapFile(data, size);
+
+    return GL_TRUE;
+}
+
+
+GLboolean cacheMakeKey(const char *fileName, cacheKey_t *key)
+{
+    if ( GL_FALSE == cacheStatFile(fileName, key) )
+    {
+        return GL_FALSE;
+    }
+
+    return cacheHashFile(fileName, &key->hash);
+}
+
+
+GLboolean cacheCheckKey(const char *fileName, const cacheKey_t *key)
+{
+    cacheKey_t current;
+
+    if ( GL_FALSE == cacheStatFile(fileName, &current) || current.size != key->size )
+    {
+        return GL_FALSE;
+    }
+
+    /* Same size and time is trusted, only a touched file is hashed again */
+    if (current.mtime == key->mtime)
+    {
+        return GL_TRUE;
+    }
+
+    return ( GL_TRUE == cacheHashFile(fileName, &current.hash) && current.hash == key->hash ) ? GL_TRUE : GL_FALSE;
+}
+
+
+const void *cacheMapFile(const char *fileName, size_t *size)
+{
+    struct stat fileInfo;
+    void *data;
+    GLint fd;
+
+    fd = open(fileName, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    if ( fstat(fd, &fileInfo) != 0 || fileInfo.st_size == 0 )
+    {
+        close(fd);
+        return NULL;
+    }
+
+    data = mmap(NULL, fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    /* Caches are read front to back, let the kernel read ahead */
+    madvise(data, fileInfo.st_size, MADV_WILLNEED);
+
+    *size = fileInfo.st_size;
+
+    return data;
+}
+
+
+void cacheUnmapFile(const void *data, size_t size)
+{
+    munmap((void *)data, size);
+}
+
+
+GLboolean cacheWriteFile(const char *fileName, const void *data, size_t size)
+{
+    FILE *pFile = NULL;
+    char *tmpName;
+    GLboolean result;
+    GLint fd;
+
+    tmpName = (char *)malloc(strlen(fileName) + strlen(CACHE_TMP_SUFFIX) + 1);
+    strcpy(tmpName, fileName);
+    strcat(tmpName, CACHE_TMP_SUFFIX);
+
+    /* Write beside the cache and rename, readers never see a partial file.
+       The name is unique so loader threads writing the same cache never share it */
+    fd = mkstemp(tmpName);
+    if (fd >= 0)
+    {
+        fchmod(fd, CACHE_FILE_MODE);
+        pFile = fdopen(fd, "wb");
+    }
+
+    if (pFile == NULL)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+            unlink(tmpName);
+        }
+        free(tmpName);
+        return GL_FALSE;
+    }
+
+    result = (fwrite(data, 1, size, pFile) == size) ? GL_TRUE : GL_FALSE;
+    result = (fclose(pFile) == 0) ? result : GL_FALSE;
+
+    if ( GL_FALSE == result || rename(tmpName, fileName) != 0 )
+    {
+        unlink(tmpName);
+        result = GL_FALSE;
+    }
+
+    free(tmpName);
+
+    return result;
+}
@@ -0,0 +1,47 @@
+#ifndef __GL_CACHE_H__
+#define __GL_CACHE_H__
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#define GLFW_INCLUDE_ES2
+#include <GLFW/glfw3.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/*******************************************************************/
+/*  Defines                                                        */
+/*******************************************************************/
+#define CACHE_ALIGNMENT             16
+
+/* Round a cache section offset up so mapped sections stay aligned */
+#define CACHE_ALIGN(offset)         (((offset) + (CACHE_ALIGNMENT - 1)) & ~(size_t)(CACHE_ALIGNMENT - 1))
+
+
+/*******************************************************************/
+/*  Typedefs                                                       */
+/*******************************************************************/
+
+/* Identifies the source file a cache was built from */
+typedef struct _cacheKey_t
+{
+    uint64_t size;
+    int64_t mtime;
+    uint64_t hash;
+} cacheKey_t;
+
+
+/*******************************************************************/
+/*  Prototypes                                                     */
+/*******************************************************************/
+uint64_t cacheHash(const void *data, size_t size);
+GLboolean cacheMakeKey(const char *fileName, cacheKey_t *key);
+GLboolean cacheCheckKey(const char *fileName, const cacheKey_t *key);
+const void *cacheMapFile(const char *fileName, size_t *size);
+void cacheUnmapFile(const void *data, size_t size);
+GLboolean cacheWriteFile(const char *fileName, const void *data, size_t size);
+
+#endif
@@ -0,0 +1,277 @@
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#include "gletc.h"
+
+/*******************************************************************/
+/*  Defines                                                        */
+/*******************************************************************/
+#define ETC_TEXELS                  (ETC_BLOCK_SIZE * ETC_BLOCK_SIZE)
+#define ETC_SUBBLOCK_TEXELS         (ETC_TEXELS / 2)
+#define ETC_NUM_OF_TABLES           8
+#define ETC_CHANNELS                3
+
+/* Differential mode stores the second color as a 3-bit signed offset */
+#define ETC_DELTA_MIN               -4
+#define ETC_DELTA_MAX               3
+
+
+/*******************************************************************/
+/*  Typedefs                                                       */
+/*******************************************************************/
+typedef struct _etcSubblock_t
+{
+    GLint color[ETC_CHANNELS];
+    GLuint table;
+    GLuint indices[ETC_SUBBLOCK_TEXELS];
+    GLuint error;
+} etcSubblock_t;
+
+
+/*******************************************************************/
+/*  Globals                                                        */
+/*******************************************************************/
+
+/* Intensity modifiers, a texel index selects +a, +b, -a or -b */
+static const GLint etcModifiers[ETC_NUM_OF_TABLES][2] = {
+    {2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183}
+};
+
+
+/*******************************************************************/
+/*  Functions                                                      */
+/*******************************************************************/
+GLint etcClamp(GLint value)
+{
+    return (value < 0) ? 0 : ((value > 255) ? 255 : value);
+}
+
+
+void etcGetSubblock(const GLubyte *texels, GLuint flip, GLuint subblock, const GLubyte **dest)
+{
+    GLuint x, y, i = 0;
+
+    /* Side by side 2x4 halves, or 4x2 halves on top of each other when flipped */
+    for(x=0;x<ETC_BLOCK_SIZE;x++)
+    {
+        for(y=0;y<ETC_BLOCK_SIZE;y++)
+        {
+            if ( ((flip ? y : x) >> 1) == subblock )
+            {
+                dest[i++] = &texels[(y * ETC_BLOCK_SIZE + x) * ETC_CHANNELS];
+            }
+        }
+    }
+}
+
+
+void etcFitSubblock(etcSubblock_t *subblock, const GLubyte **texels)
+{
+    GLuint indices[ETC_SUBBLOCK_TEXELS];
+    GLint modifier[4];
+    GLuint table, i, j, c;
+    GLuint error, best, texelError;
+    GLint diff;
+
+    subblock->error = 0xFFFFFFFF;
+
+    /* Every table, each texel takes its closest modifier */
+    for(table=0;table<ETC_NUM_OF_TABLES;table++)
+    {
+        modifier[0] = etcModifiers[table][0];
+        modifier[1] = etcModifiers[table][1];
+        modifier[2] = -etcModifiers[table][0];
+        modifier[3] = -etcModifiers[table][1];
+
+        /* Give up on a table once it is worse than the best so far */
+        error = 0;
+        for(i=0;i<ETC_SUBBLOCK_TEXELS && error < subblock->error;i++)
+        {
+            best = 0xFFFFFFFF;
+
+            for(j=0;j<4;j++)
+            {
+                texelError = 0;
+                for(c=0;c<ETC_CHANNELS;c++)
+                {
+                    diff = etcClamp(subblock->color[c] + modifier[j]) - texels[i][c];
+                    texelError += diff * diff;
+                }
+
+                if (texelError < best)
+                {
+                    best = texelError;
+                    indices[i] = j;
+                }
+            }
+
+            error += best;
+        }
+
+        if (i == ETC_SUBBLOCK_TEXELS && error < subblock->error)
+        {
+            subblock->error = error;
+            subblock->table = table;
+            memcpy(subblock->indices, indices, sizeof(indices));
+        }
+    }
+}
+
+
+void etcPackBlock(GLubyte *dest, GLuint high, const etcSubblock_t *subblocks, GLuint flip)
+{
+    GLuint low = 0;
+    GLuint x, y, s, i;
+    GLuint count[2] = { 0, 0 };
+
+    high |= (subblocks[0].table << 5) | (subblocks[1].table << 2) | flip;
+
+    /* Texel indices are column major, high bits in the top half of the word */
+    for(x=0;x<ETC_BLOCK_SIZE;x++)
+    {
+        for(y=0;y<ETC_BLOCK_SIZE;y++)
+        {
+            s = ((flip ? y : x) >> 1);
+            i = subblocks[s].indices[count[s]++];
+
+            low |= ((i >> 1) << (16 + x*4 + y)) | ((i & 1) << (x*4 + y));
+        }
+    }
+
+    /* Big endian */
+    dest[0] = (GLubyte)(high >> 24);
+    dest[1] = (GLubyte)(high >> 16);
+    dest[2] = (GLubyte)(high >> 8);
+    dest[3] = (GLubyte)high;
+    dest[4] = (GLubyte)(low >> 24);
+    dest[5] = (GLubyte)(low >> 16);
+    dest[6] = (GLubyte)(low >> 8);
+    dest[7] = (GLubyte)low;
+}
+
+
+void etcEncodeBlock(GLubyte *dest, const GLubyte *texels)
+{
+    const GLubyte *subblockTexels[2][ETC_SUBBLOCK_TEXELS];
+    etcSubblock_t subblocks[2];
+    etcSubblock_t best[2];
+    GLuint bestHigh = 0, bestFlip = 0, bestError = 0xFFFFFFFF;
+    GLint average[2][ETC_CHANNELS];
+    GLint quant[2][ETC_CHANNELS];
+    GLuint flip, s, i, c, high;
+    GLboolean differential;
+
+    /* Try both splits, each in differential mode if the colors are close enough and individual mode */
+    for(flip=0;flip<2;flip++)
+    {
+        for(s=0;s<2;s++)
+        {
+            etcGetSubblock(texels, flip, s, subblockTexels[s]);
+
+            for(c=0;c<ETC_CHANNELS;c++)
+            {
+                average[s][c] = 0;
+                for(i=0;i<ETC_SUBBLOCK_TEXELS;i++)
+                {
+                    average[s][c] += subblockTexels[s][i][c];
+                }
+            }
+        }
+
+        /* 5:5:5 base plus 3-bit offsets */
+        differential = GL_TRUE;
+        for(c=0;c<ETC_CHANNELS;c++)
+        {
+            quant[0][c] = (average[0][c] * 31 + 255 * ETC_SUBBLOCK_TEXELS / 2) / (255 * ETC_SUBBLOCK_TEXELS);
+            quant[1][c] = (average[1][c] * 31 + 255 * ETC_SUBBLOCK_TEXELS / 2) / (255 * ETC_SUBBLOCK_TEXELS);
+
+            if (quant[1][c] - quant[0][c] < ETC_DELTA_MIN || quant[1][c] - quant[0][c] > ETC_DELTA_MAX)
+            {
+                differential = GL_FALSE;
+            }
+        }
+
+        if ( GL_TRUE == differential )
+        {
+            for(s=0;s<2;s++)
+            {
+                for(c=0;c<ETC_CHANNELS;c++)
+                {
+                    subblocks[s].color[c] = (quant[s][c] << 3) | (quant[s][c] >> 2);
+                }
+                etcFitSubblock(&subblocks[s], subblockTexels[s]);
+            }
+
+            high = ((GLuint)quant[0][0] << 27) | ((GLuint)((quant[1][0] - quant[0][0]) & 7) << 24) |
+                   ((GLuint)quant[0][1] << 19) | ((GLuint)((quant[1][1] - quant[0][1]) & 7) << 16) |
+                   ((GLuint)quant[0][2] << 11) | ((GLuint)((quant[1][2] - quant[0][2]) & 7) << 8) | 0x2;
+
+            if (subblocks[0].error + subblocks[1].error < bestError)
+            {
+                bestError = subblocks[0].error + subblocks[1].error;
+                bestHigh = high;
+                bestFlip = flip;
+                best[0] = subblocks[0];
+                best[1] = subblocks[1];
+            }
+        }
+
+        /* 4:4:4 per half */
+        for(s=0;s<2;s++)
+        {
+            for(c=0;c<ETC_CHANNELS;c++)
+            {
+                quant[s][c] = (average[s][c] * 15 + 255 * ETC_SUBBLOCK_TEXELS / 2) / (255 * ETC_SUBBLOCK_TEXELS);
+                subblocks[s].color[c] = (quant[s][c] << 4) | quant[s][c];
+            }
+            etcFitSubblock(&subblocks[s], subblockTexels[s]);
+        }
+
+        high = ((GLuint)quant[0][0] << 28) | ((GLuint)quant[1][0] << 24) |
+               ((GLuint)quant[0][1] << 20) | ((GLuint)quant[1][1] << 16) |
+               ((GLuint)quant[0][2] << 12) | ((GLuint)quant[1][2] << 8);
+
+        if (subblocks[0].error + subblocks[1].error < bestError)
+        {
+            bestError = subblocks[0].error + subblocks[1].error;
+            bestHigh = high;
+            bestFlip = flip;
+            best[0] = subblocks[0];
+            best[1] = subblocks[1];
+        }
+    }
+
+    etcPackBlock(dest, bestHigh, best, bestFlip);
+}
+
+
+void etcEncodeRows(GLubyte *dest, const GLubyte *src, GLuint width, GLuint height, GLuint firstBlockRow, GLuint blockRowCount)
+{
+    GLubyte texels[ETC_TEXELS * ETC_CHANNELS];
+    GLuint blocksPerRow = (width + ETC_BLOCK_SIZE - 1) / ETC_BLOCK_SIZE;
+    GLuint blockRow, block, x, y, sx, sy;
+
+    for(blockRow=firstBlockRow;blockRow<firstBlockRow + blockRowCount;blockRow++)
+    {
+        for(block=0;block<blocksPerRow;block++)
+        {
+            /* Blocks past the edge of small levels repeat the last row and column */
+            for(y=0;y<ETC_BLOCK_SIZE;y++)
+            {
+                sy = blockRow * ETC_BLOCK_SIZE + y;
+                sy = (sy < height) ? sy : height - 1;
+
+                for(x=0;x<ETC_BLOCK_SIZE;x++)
+                {
+                    sx = block * ETC_BLOCK_SIZE + x;
+                    sx = (sx < width) ? sx : width - 1;
+
+                    memcpy(&texels[(y * ETC_BLOCK_SIZE + x) * ETC_CHANNELS], &src[((size_t)sy * width + sx) * ETC_CHANNELS], ETC_CHANNELS);
+                }
+            }
+
+            etcEncodeBlock(&dest[((size_t)blockRow * blocksPerRow + block) * ETC_BLOCK_BYTES], texels);
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef __GL_ETC_H__
+#define __GL_ETC_H__
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#define GLFW_INCLUDE_ES2
+#include <GLFW/glfw3.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************************/
+/*  Defines                                                        */
+/*******************************************************************/
+#define ETC_BLOCK_SIZE              4
+#define ETC_BLOCK_BYTES             8
+
+/* Bytes of ETC1 data for a width x height level, partial blocks round up */
+#define ETC_LEVEL_SIZE(w, h)        ((size_t)(((w) + ETC_BLOCK_SIZE - 1) / ETC_BLOCK_SIZE) * (((h) + ETC_BLOCK_SIZE - 1) / ETC_BLOCK_SIZE) * ETC_BLOCK_BYTES)
+
+
+/*******************************************************************/
+/*  Prototypes                                                     */
+/*******************************************************************/
+void etcEncodeBlock(GLubyte *dest, const GLubyte *texels);
+void etcEncodeRows(GLubyte *dest, const GLubyte *src, GLuint width, GLuint height, GLuint firstBlockRow, GLuint blockRowCount);
+
+#endif
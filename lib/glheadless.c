@@ -0,0 +1,498 @@
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#include "glheadless.h"
+
+
+/*******************************************************************/
+/*  Defines                                                        */
+/*******************************************************************/
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA   0x31DD
+#endif
+
+/* Nearest rank percentile reported next to the min and average */
+#define HEADLESS_PERCENTILE             0.99
+
+
+/*******************************************************************/
+/*  Functions                                                      */
+/*******************************************************************/
+EGLDisplay headlessGetDisplay(void)
+{
+    const char *extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay;
+    EGLDisplay display = EGL_NO_DISPLAY;
+
+    /* Mesa can run with no window system at all, llvmpipe on a CI host with no X or Wayland */
+    if ( extensions != NULL && strstr(extensions, "EGL_MESA_platform_surfaceless") != NULL )
+    {
+        getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay != NULL)
+        {
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        }
+    }
+
+    return (display != EGL_NO_DISPLAY) ? display : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+
+GLboolean headlessCreateFramebuffer(headless_t *headless)
+{
+    glGenFramebuffers(1, &headless->framebuffer);
+    glGenRenderbuffers(1, &headless->colorBuffer);
+    glGenRenderbuffers(1, &headless->depthBuffer);
+
+    /* Same color and depth sizes as the pbuffer config */
+    glBindRenderbuffer(GL_RENDERBUFFER, headless->colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8_OES, headless->width, headless->height);
+    glBindRenderbuffer(GL_RENDERBUFFER, headless->depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24_OES, headless->width, headless->height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, headless->framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headless->colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, headless->depthBuffer);
+
+    return (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) ? GL_TRUE : GL_FALSE;
+}
+
+
+GLboolean headlessCreate(headless_t *headless, GLuint width, GLuint height, GLuint numOfFrames)
+{
+    EGLint configAttribs[] =
+    {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+    EGLint surfaceAttribs[] = { EGL_WIDTH, (EGLint)width, EGL_HEIGHT, (EGLint)height, EGL_NONE };
+    EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+    EGLConfig config;
+    EGLint numOfConfigs = 0;
+    const char *extensions;
+    GLboolean surfaceless;
+
+    memset(headless, 0, sizeof(headless_t));
+    headless->surface = EGL_NO_SURFACE;
+    headless->context = EGL_NO_CONTEXT;
+    headless->width = width;
+    headless->height = height;
+    headless->numOfFrames = numOfFrames;
+
+    headless->frameTimes = (double *)malloc(sizeof(double) * ((numOfFrames > 0) ? numOfFrames : 1));
+    if (headless->frameTimes == NULL)
+    {
+        return GL_FALSE;
+    }
+
+    headless->display = headlessGetDisplay();
+    if ( headless->display == EGL_NO_DISPLAY || EGL_FALSE == eglInitialize(headless->display, NULL, NULL) )
+    {
+        printf("No EGL display for headless rendering\n");
+        headless->display = EGL_NO_DISPLAY;
+        headlessDestroy(headless);
+        return GL_FALSE;
+    }
+
+    eglBindAPI(EGL_OPENGL_ES_API);
+    extensions = eglQueryString(headless->display, EGL_EXTENSIONS);
+
+    surfaceless = ( extensions != NULL && strstr(extensions, "EGL_KHR_surfaceless_context") != NULL ) ? GL_TRUE : GL_FALSE;
+
+    /* A pbuffer when the display has one, otherwise a surfaceless context drawing into a framebuffer object */
+    eglChooseConfig(headless->display, configAttribs, &config, 1, &numOfConfigs);
+    if (numOfConfigs > 0)
+    {
+        headless->surface = eglCreatePbufferSurface(headless->display, config, surfaceAttribs);
+        if (headless->surface == EGL_NO_SURFACE)
+        {
+            if ( GL_FALSE == surfaceless )
+            {
+                printf("Error creating a %ux%u EGL pbuffer, 0x%x, and no surfaceless context to fall back on\n", width, height, eglGetError());
+                headlessDestroy(headless);
+                return GL_FALSE;
+            }
+
+            printf("Error creating a %ux%u EGL pbuffer, 0x%x, drawing surfaceless instead\n", width, height, eglGetError());
+        }
+    }
+
+    if (headless->surface == EGL_NO_SURFACE)
+    {
+        if ( GL_FALSE == surfaceless )
+        {
+            printf("No EGL pbuffer or surfaceless context for headless rendering\n");
+            headlessDestroy(headless);
+            return GL_FALSE;
+        }
+
+        configAttribs[1] = 0;
+        eglChooseConfig(headless->display, configAttribs, &config, 1, &numOfConfigs);
+    }
+
+    if (numOfConfigs > 0)
+    {
+        headless->context = eglCreateContext(headless->display, config, EGL_NO_CONTEXT, contextAttribs);
+    }
+
+    if ( headless->context == EGL_NO_CONTEXT ||
+         EGL_FALSE == eglMakeCurrent(headless->display, headless->surface, headless->surface, headless->context) )
+    {
+        printf("Error creating the headless EGL context\n");
+        headlessDestroy(headless);
+        return GL_FALSE;
+    }
+
+    if ( headless->surface == EGL_NO_SURFACE && GL_FALSE == headlessCreateFramebuffer(headless) )
+    {
+        printf("Error creating the headless framebuffer\n");
+        headlessDestroy(headless);
+        return GL_FALSE;
+    }
+
+    /* Frames are timed as fast as they render */
+    eglSwapInterval(headless->display, 0);
+
+    printf("Headless %ux%u %s on %s\n", width, height, (headless->surface != EGL_NO_SURFACE) ? "pbuffer" : "surfaceless",
+           (const char *)glGetString(GL_RENDERER));
+
+    return GL_TRUE;
+}
+
+
+void headlessDestroy(headless_t *headless)
+{
+    if (headless->framebuffer != 0)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &headless->framebuffer);
+        glDeleteRenderbuffers(1, &headless->colorBuffer);
+        glDeleteRenderbuffers(1, &headless->depthBuffer);
+    }
+
+    if (headless->display != EGL_NO_DISPLAY)
+    {
+        eglMakeCurrent(headless->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+        if (headless->context != EGL_NO_CONTEXT)
+        {
+            eglDestroyContext(headless->display, headless->context);
+        }
+
+        if (headless->surface != EGL_NO_SURFACE)
+        {
+            eglDestroySurface(headless->display, headless->surface);
+        }
+
+        eglTerminate(headless->display);
+    }
+
+    free(headless->frameTimes);
+
+    memset(headless, 0, sizeof(headless_t));
+}
+
+
+GLboolean headlessSetDumpFrames(headless_t *headless, const char *list)
+{
+    char *end;
+    unsigned long frame;
+
+    headless->numOfDumpFrames = 0;
+
+    /* Comma separated frame numbers, 0 is the first frame */
+    while (*list != '\0')
+    {
+        frame = strtoul(list, &end, 10);
+        if (end == list || headless->numOfDumpFrames >= HEADLESS_MAX_DUMP_FRAMES)
+        {
+            return GL_FALSE;
+        }
+
+        headless->dumpFrames[headless->numOfDumpFrames++] = (GLuint)frame;
+
+        list = (*end == ',') ? end + 1 : end;
+        if (*end != ',' && *end != '\0')
+        {
+            return GL_FALSE;
+        }
+    }
+
+    return GL_TRUE;
+}
+
+
+GLboolean headlessIsDone(const headless_t *headless)
+{
+    return (headless->frame >= headless->numOfFrames) ? GL_TRUE : GL_FALSE;
+}
+
+
+GLboolean headlessShouldClose(const headless_t *headless, GLFWwindow *window)
+{
+    /* Headless runs end after their frames, there is no window to close */
+    if (window == NULL)
+    {
+        return headlessIsDone(headless);
+    }
+
+    return glfwWindowShouldClose(window) ? GL_TRUE : GL_FALSE;
+}
+
+
+void headlessBeginFrame(headless_t *headless)
+{
+    headless->frameStart = getTimeMs();
+}
+
+
+void headlessEndFrame(headless_t *headless, const char *name)
+{
+    char fileName[256];
+    GLuint i;
+
+    /* The frame is done once the GPU is, a swap alone only queues it */
+    if (headless->surface != EGL_NO_SURFACE)
+    {
+        eglSwapBuffers(headless->display, headless->surface);
+    }
+    glFinish();
+
+    headless->frameTimes[headless->frame] = getTimeMs() - headless->frameStart;
+
+    /* Read back after the time is taken, the dump is not part of the frame */
+    for(i=0;i<headless->numOfDumpFrames;i++)
+    {
+        if (headless->dumpFrames[i] == headless->frame)
+        {
+            snprintf(fileName, sizeof(fileName), HEADLESS_DUMP_FORMAT, name, headless->frame);
+            if ( GL_FALSE == headlessWriteFrame(headless, fileName) )
+            {
+                printf("Error writing frame %u to %s\n", headless->frame, fileName);
+            }
+            break;
+        }
+    }
+
+    headless->frame++;
+}
+
+
+GLboolean headlessWriteFrame(const headless_t *headless, const char *fileName)
+{
+    GLubyte *pixels;
+    GLuint x, y;
+    FILE *file;
+    GLboolean ret = GL_TRUE;
+
+    pixels = (GLubyte *)malloc(headless->width * headless->height * 4);
+    if (pixels == NULL)
+    {
+        return GL_FALSE;
+    }
+
+    file = fopen(fileName, "wb");
+    if (file == NULL)
+    {
+        free(pixels);
+        return GL_FALSE;
+    }
+
+    /* RGBA is the one format every ES2 implementation reads back */
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, headless->width, headless->height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+    /* Binary PPM, top row first, alpha dropped */
+    fprintf(file, "P6\n%u %u\n255\n", headless->width, headless->height);
+    for(y=headless->height;y>0 && ret == GL_TRUE;y--)
+    {
+        for(x=0;x<headless->width;x++)
+        {
+            if (fwrite(&pixels[((y - 1) * headless->width + x) * 4], 1, 3, file) != 3)
+            {
+                ret = GL_FALSE;
+                break;
+            }
+        }
+    }
+
+    fclose(file);
+    free(pixels);
+
+    return ret;
+}
+
+
+int headlessCompareTimes(const void *a, const void *b)
+{
+    double timeA = *(const double *)a;
+    double timeB = *(const double *)b;
+
+    return (timeA > timeB) - (timeA < timeB);
+}
+
+
+void headlessWriteString(FILE *file, const char *string)
+{
+    fputc('"', file);
+
+    for(;string != NULL && *string != '\0';string++)
+    {
+        if (*string == '"' || *string == '\\')
+        {
+            fputc('\\', file);
+        }
+
+        if ((unsigned char)*string >= 0x20)
+        {
+            fputc(*string, file);
+        }
+    }
+
+    fputc('"', file);
+}
+
+
+GLboolean headlessWriteReport(const headless_t *headless, const char *name, const char *fileName)
+{
+    double *sorted;
+    double total = 0.0;
+    GLuint count = headless->frame;
+    GLuint i, rank;
+    FILE *file;
+
+    if (count == 0)
+    {
+        return GL_FALSE;
+    }
+
+    sorted = (double *)malloc(sizeof(double) * count);
+    if (sorted == NULL)
+    {
+        return GL_FALSE;
+    }
+
+    memcpy(sorted, headless->frameTimes, sizeof(double) * count);
+    qsort(sorted, count, sizeof(double), headlessCompareTimes);
+
+    for(i=0;i<count;i++)
+    {
+        total += sorted[i];
+    }
+
+    /* Smallest time at least the percentile of frames stay under */
+    rank = (GLuint)((HEADLESS_PERCENTILE * count) + 0.999999);
+    rank = (rank < 1) ? 1 : rank;
+
+    /* Standard output when no file is given */
+    file = (fileName != NULL && 0 != strcmp(fileName, "-")) ? fopen(fileName, "w") : stdout;
+    if (file == NULL)
+    {
+        free(sorted);
+        return GL_FALSE;
+    }
+
+    fprintf(file, "{\n");
+    fprintf(file, "    \"name\": ");
+    headlessWriteString(file, name);
+    fprintf(file, ",\n    \"renderer\": ");
+    headlessWriteString(file, (const char *)glGetString(GL_RENDERER));
+    fprintf(file, ",\n    \"surface\": \"%s\"", (headless->surface != EGL_NO_SURFACE) ? "pbuffer" : "surfaceless");
+    fprintf(file, ",\n    \"width\": %u,\n", headless->width);
+    fprintf(file, "    \"height\": %u,\n", headless->height);
+    fprintf(file, "    \"frames\": %u,\n", count);
+    fprintf(file, "    \"min_ms\": %.4f,\n", sorted[0]);
+    fprintf(file, "    \"avg_ms\": %.4f,\n", total / count);
+    fprintf(file, "    \"p99_ms\": %.4f,\n", sorted[rank - 1]);
+    fprintf(file, "    \"max_ms\": %.4f\n", sorted[count - 1]);
+    fprintf(file, "}\n");
+
+    if (file != stdout)
+    {
+        fclose(file);
+    }
+
+    free(sorted);
+
+    return GL_TRUE;
+}
+
+
+void headlessGetCameraKey(const headlessCameraKey_t *keys, GLuint numOfKeys, GLfloat time, headlessCameraKey_t *key)
+{
+    GLuint i = 0;
+    GLfloat t;
+
+    /* Held at the ends, linear between the two keys around the time */
+    while (i + 1 < numOfKeys && keys[i + 1].time <= time)
+    {
+        i++;
+    }
+
+    if (i + 1 >= numOfKeys || time <= keys[i].time)
+    {
+        *key = keys[i];
+        key->time = time;
+        return;
+    }
+
+    t = (time - keys[i].time) / (keys[i + 1].time - keys[i].time);
+
+    key->time = time;
+    key->position[0] = keys[i].position[0] + (keys[i + 1].position[0] - keys[i].position[0]) * t;
+    key->position[1] = keys[i].position[1] + (keys[i + 1].position[1] - keys[i].position[1]) * t;
+    key->position[2] = keys[i].position[2] + (keys[i + 1].position[2] - keys[i].position[2]) * t;
+    key->rotationUp = keys[i].rotationUp + (keys[i + 1].rotationUp - keys[i].rotationUp) * t;
+    key->rotationRight = keys[i].rotationRight + (keys[i + 1].rotationRight - keys[i].rotationRight) * t;
+}
+
+
+void headlessFollowCameraPath(const headless_t *headless, const headlessCameraKey_t *keys, GLuint numOfKeys, GLfloat distance, headlessCameraKey_t *key)
+{
+    GLfloat time = (headless->numOfFrames > 1) ? (GLfloat)headless->frame / (GLfloat)(headless->numOfFrames - 1) : 0.0f;
+
+    headlessGetCameraKey(keys, numOfKeys, time, key);
+
+    /* Paths are written for a unit distance when the scene sets its own */
+    key->position[0] *= distance;
+    key->position[1] *= distance;
+    key->position[2] *= distance;
+}
+
+
+GLboolean headlessExtensionSupported(const char *extension)
+{
+    /* GLFW only answers for its own windows, the string works for any current context */
+    const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+    const char *match;
+    size_t length = strlen(extension);
+
+    /* Whole names only, one extension can be the start of another */
+    for(match = extensions; match != NULL && (match = strstr(match, extension)) != NULL; match += length)
+    {
+        if ((match == extensions || match[-1] == ' ') && (match[length] == ' ' || match[length] == '\0'))
+        {
+            return GL_TRUE;
+        }
+    }
+
+    return GL_FALSE;
+}
+
+
+void *headlessGetProcAddress(const char *name)
+{
+    /* A headless context, or a window GLFW made through EGL, otherwise GLFW knows its own loader */
+    if (eglGetCurrentContext() != EGL_NO_CONTEXT)
+    {
+        return (void *)eglGetProcAddress(name);
+    }
+
+    return (void *)glfwGetProcAddress(name);
+}
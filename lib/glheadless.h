@@ -0,0 +1,86 @@
+#ifndef __GL_HEADLESS_H__
+#define __GL_HEADLESS_H__
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#define GLFW_INCLUDE_ES2
+#include <GLFW/glfw3.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "gltime.h"
+
+/*******************************************************************/
+/*  Defines                                                        */
+/*******************************************************************/
+
+/* Frames that can be picked with headlessSetDumpFrames */
+#define HEADLESS_MAX_DUMP_FRAMES    32
+
+/* Written in the current directory, the name passed in and the frame number */
+#define HEADLESS_DUMP_FORMAT        "%s_%05u.ppm"
+
+
+/*******************************************************************/
+/*  Typedefs                                                       */
+/*******************************************************************/
+/* A camera pose at a point along a scripted path, time runs from 0 to 1 */
+typedef struct _headlessCameraKey_t
+{
+    GLfloat time;
+    GLfloat position[3];
+    GLfloat rotationUp;
+    GLfloat rotationRight;
+} headlessCameraKey_t;
+
+/* An EGL context with no window, drawn into a pbuffer or into a framebuffer object when only surfaceless contexts exist */
+typedef struct _headless_t
+{
+    EGLDisplay display;
+    EGLContext context;
+    EGLSurface surface;
+
+    /* Only created for a surfaceless context */
+    GLuint framebuffer;
+    GLuint colorBuffer;
+    GLuint depthBuffer;
+
+    GLuint width;
+    GLuint height;
+
+    /* Frames to run and the time of each one in ms, from headlessBeginFrame to the GPU finishing it */
+    GLuint numOfFrames;
+    GLuint frame;
+    double *frameTimes;
+    double frameStart;
+
+    GLuint dumpFrames[HEADLESS_MAX_DUMP_FRAMES];
+    GLuint numOfDumpFrames;
+} headless_t;
+
+
+/*******************************************************************/
+/*  Prototypes                                                     */
+/*******************************************************************/
+GLboolean headlessCreate(headless_t *headless, GLuint width, GLuint height, GLuint numOfFrames);
+void headlessDestroy(headless_t *headless);
+GLboolean headlessSetDumpFrames(headless_t *headless, const char *list);
+GLboolean headlessIsDone(const headless_t *headless);
+GLboolean headlessShouldClose(const headless_t *headless, GLFWwindow *window);
+void headlessBeginFrame(headless_t *headless);
+void headlessEndFrame(headless_t *headless, const char *name);
+GLboolean headlessWriteFrame(const headless_t *headless, const char *fileName);
+GLboolean headlessWriteReport(const headless_t *headless, const char *name, const char *fileName);
+void headlessGetCameraKey(const headlessCameraKey_t *keys, GLuint numOfKeys, GLfloat time, headlessCameraKey_t *key);
+void headlessFollowCameraPath(const headless_t *headless, const headlessCameraKey_t *keys, GLuint numOfKeys, GLfloat distance, headlessCameraKey_t *key);
+GLboolean headlessExtensionSupported(const char *extension);
+void *headlessGetProcAddress(const char *name);
+
+#endif
@@ -0,0 +1,1038 @@
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#include "glimage.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* The swizzle needs pshufb, built for SSSE3 on its own and picked when the CPU has it */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <tmmintrin.h>
+#define IMAGE_SWIZZLE_SSSE3
+#endif
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+
+/*******************************************************************/
+/*  Typedefs                                                       */
+/*******************************************************************/
+typedef struct _imageEncodeTask_t
+{
+    imageLoad_t *load;
+    GLuint level;
+    GLuint firstBlockRow;
+    GLuint blockRowCount;
+} imageEncodeTask_t;
+
+
+/*******************************************************************/
+/*  Functions                                                      */
+/*******************************************************************/
+GLuint imageReadLe16(const GLubyte *p)
+{
+    return (GLuint)p[0] | ((GLuint)p[1] << 8);
+}
+
+
+GLuint imageReadLe32(const GLubyte *p)
+{
+    return (GLuint)p[0] | ((GLuint)p[1] << 8) | ((GLuint)p[2] << 16) | ((GLuint)p[3] << 24);
+}
+
+
+#if defined(IMAGE_SWIZZLE_SSSE3)
+__attribute__((target("ssse3")))
+GLuint imageSwizzleRowSsse3(GLubyte *dest, const GLubyte *src, GLuint width, GLuint bytesPerPixel)
+{
+    const __m128i bgr = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+    const __m128i bgrx = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    GLuint x = 0;
+
+    /* Full 16 byte stores, the bytes past the texels done are rewritten by the next one, never past the row */
+    if (bytesPerPixel == 3)
+    {
+        for(;x*3 + 16 <= width*3;x+=5)
+        {
+            _mm_storeu_si128((__m128i *)&dest[x*3], _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&src[x*3]), bgr));
+        }
+    }
+    else
+    {
+        for(;x*4 + 16 <= width*4 && x*3 + 16 <= width*3;x+=4)
+        {
+            _mm_storeu_si128((__m128i *)&dest[x*3], _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&src[x*4]), bgrx));
+        }
+    }
+
+    return x;
+}
+#endif
+
+
+void imageSwizzleRow(GLubyte *dest, const GLubyte *src, GLuint width, GLuint bytesPerPixel, GLboolean vectorized)
+{
+    GLuint x = 0;
+
+#if defined(IMAGE_SWIZZLE_SSSE3)
+    if ( GL_TRUE == vectorized && __builtin_cpu_supports("ssse3") )
+    {
+        x = imageSwizzleRowSsse3(dest, src, width, bytesPerPixel);
+    }
+#elif defined(__ARM_NEON)
+    uint8x16x3_t rgb;
+    uint8x16x4_t bgrx;
+    uint8x16_t swap;
+
+    /* De-interleaving loads put each channel in a register of its own */
+    for(;GL_TRUE == vectorized && bytesPerPixel == 3 && x + 16 <= width;x+=16)
+    {
+        rgb = vld3q_u8(&src[x*3]);
+        swap = rgb.val[0];
+        rgb.val[0] = rgb.val[2];
+        rgb.val[2] = swap;
+        vst3q_u8(&dest[x*3], rgb);
+    }
+
+    for(;GL_TRUE == vectorized && bytesPerPixel == 4 && x + 16 <= width;x+=16)
+    {
+        bgrx = vld4q_u8(&src[x*4]);
+        rgb.val[0] = bgrx.val[2];
+        rgb.val[1] = bgrx.val[1];
+        rgb.val[2] = bgrx.val[0];
+        vst3q_u8(&dest[x*3], rgb);
+    }
+#endif
+
+    for(;x<width;x++)
+    {
+        dest[x*3 + 0] = src[x*bytesPerPixel + 2];
+        dest[x*3 + 1] = src[x*bytesPerPixel + 1];
+        dest[x*3 + 2] = src[x*bytesPerPixel + 0];
+    }
+}
+
+
+GLubyte *imageDecodeBmp(const GLubyte *file, size_t size, GLuint *width, GLuint *height, GLboolean vectorized)
+{
+    GLuint infoSize, dataOffset, bitCount, compression, bytesPerPixel, y;
+    GLint signedHeight;
+    GLboolean topDown;
+    size_t stride;
+    GLubyte *data;
+
+    if (size < BMP_INFO_SIZE_OFFSET + 4 + BMP_CORE_INFO_SIZE || imageReadLe16(file) != BMP_SIGNATURE)
+    {
+        return NULL;
+    }
+
+    dataOffset = imageReadLe32(&file[BMP_DATA_OFFSET_OFFSET]);
+    infoSize = imageReadLe32(&file[BMP_INFO_SIZE_OFFSET]);
+
+    if (infoSize == BMP_CORE_INFO_SIZE)
+    {
+        *width = imageReadLe16(&file[BMP_CORE_WIDTH_OFFSET]);
+        signedHeight = (GLint)imageReadLe16(&file[BMP_CORE_HEIGHT_OFFSET]);
+        bitCount = imageReadLe16(&file[BMP_CORE_BIT_COUNT_OFFSET]);
+        compression = BMP_COMPRESSION_RGB;
+    }
+    else if (infoSize >= BMP_INFO_SIZE && size >= BMP_INFO_SIZE_OFFSET + BMP_INFO_SIZE)
+    {
+        *width = imageReadLe32(&file[BMP_WIDTH_OFFSET]);
+        signedHeight = (GLint)imageReadLe32(&file[BMP_HEIGHT_OFFSET]);
+        bitCount = imageReadLe16(&file[BMP_BIT_COUNT_OFFSET]);
+        compression = imageReadLe32(&file[BMP_COMPRESSION_OFFSET]);
+    }
+    else
+    {
+        return NULL;
+    }
+
+    /* A negative height stores the top row first */
+    topDown = (signedHeight < 0) ? GL_TRUE : GL_FALSE;
+    *height = (GL_TRUE == topDown) ? (GLuint)(-(int64_t)signedHeight) : (GLuint)signedHeight;
+
+    if (*width == 0 || *height == 0 || *width > BMP_MAX_SIZE || *height > BMP_MAX_SIZE)
+    {
+        return NULL;
+    }
+
+    /* 24-bit BGR, or 32-bit BGRX when the masks, if any, say so */
+    if (bitCount == 24 && compression == BMP_COMPRESSION_RGB)
+    {
+        bytesPerPixel = 3;
+    }
+    else if ( bitCount == 32 && (compression == BMP_COMPRESSION_RGB ||
+              (compression == BMP_COMPRESSION_BITFIELDS && size >= BMP_MASKS_OFFSET + 12 &&
+               imageReadLe32(&file[BMP_MASKS_OFFSET]) == 0x00FF0000 && imageReadLe32(&file[BMP_MASKS_OFFSET + 4]) == 0x0000FF00 &&
+               imageReadLe32(&file[BMP_MASKS_OFFSET + 8]) == 0x000000FF)) )
+    {
+        bytesPerPixel = 4;
+    }
+    else
+    {
+        return NULL;
+    }
+
+    /* Rows are padded to 4 bytes in the file, every one of them must be there */
+    stride = (((size_t)*width * bytesPerPixel) + 3) & ~(size_t)3;
+    if (dataOffset > size || (uint64_t)stride * (*height) > size - dataOffset)
+    {
+        return NULL;
+    }
+
+    data = (GLubyte *)malloc((size_t)(*width) * (*height) * BMP_PIX_PER_COL);
+    if (data == NULL)
+    {
+        return NULL;
+    }
+
+    /* Texels packed RGB, bottom row first like GL expects */
+    for(y=0;y<*height;y++)
+    {
+        imageSwizzleRow(&data[(size_t)((GL_TRUE == topDown) ? (*height - 1 - y) : y) * (*width) * BMP_PIX_PER_COL],
+                        &file[dataOffset + (stride * y)], *width, bytesPerPixel, vectorized);
+    }
+
+    return data;
+}
+
+
+GLubyte *imageReadBmp(const char *fileName, GLuint *width, GLuint *height)
+{
+    const GLubyte *file;
+    GLubyte *data;
+    size_t size;
+
+    file = (const GLubyte *)cacheMapFile(fileName, &size);
+    if (file == NULL)
+    {
+       printf("Error opening TEX file %s\n", fileName);
+       return NULL;
+    }
+
+    data = imageDecodeBmp(file, size, width, height, GL_TRUE);
+    if (data == NULL)
+    {
+        printf("Unsupported or truncated BMP file %s\n", fileName);
+    }
+
+    cacheUnmapFile(file, size);
+
+    return data;
+}
+
+
+size_t imageGetLevelSize(const image_t *image, GLuint level)
+{
+    GLuint width = imageGetLevelDim(image->width, level);
+    GLuint height = imageGetLevelDim(image->height, level);
+
+    return (image->format == GL_RGB8) ? (size_t)width * height * BMP_PIX_PER_COL : ETC_LEVEL_SIZE(width, height);
+}
+
+
+size_t imageGetLevelOffset(const image_t *image, GLuint level)
+{
+    size_t offset = 0;
+    GLuint i;
+
+    for(i=0;i<level;i++)
+    {
+        offset += imageGetLevelSize(image, i);
+    }
+
+    return offset;
+}
+
+
+GLuint imageGetPowerOfTwo(GLuint size)
+{
+    GLuint pot = 1;
+
+    while (pot < size)
+    {
+        pot <<= 1;
+    }
+
+    /* Nearest power of two, halfway rounds up */
+    return (pot - size > size - pot/2) ? pot/2 : pot;
+}
+
+
+GLboolean imageResize(image_t *image, GLuint width, GLuint height)
+{
+    GLubyte *data;
+    const GLubyte *row0, *row1;
+    GLfloat sx, sy, fx, fy;
+    GLuint x, y, c, x0, x1, y0, y1;
+
+    data = (GLubyte *)malloc((size_t)width * height * BMP_PIX_PER_COL);
+    if (data == NULL)
+    {
+        return GL_FALSE;
+    }
+
+    /* Bilinear, texel centres map onto texel centres, edges clamp */
+    for(y=0;y<height;y++)
+    {
+        sy = ((GLfloat)y + 0.5f) * image->height / height - 0.5f;
+        sy = (sy < 0.0f) ? 0.0f : sy;
+        y0 = (GLuint)sy;
+        y1 = (y0 + 1 < image->height) ? y0 + 1 : y0;
+        fy = sy - y0;
+
+        row0 = &image->data[(size_t)y0 * image->width * BMP_PIX_PER_COL];
+        row1 = &image->data[(size_t)y1 * image->width * BMP_PIX_PER_COL];
+
+        for(x=0;x<width;x++)
+        {
+            sx = ((GLfloat)x + 0.5f) * image->width / width - 0.5f;
+            sx = (sx < 0.0f) ? 0.0f : sx;
+            x0 = (GLuint)sx;
+            x1 = (x0 + 1 < image->width) ? x0 + 1 : x0;
+            fx = sx - x0;
+
+            for(c=0;c<BMP_PIX_PER_COL;c++)
+            {
+                data[((size_t)y * width + x) * BMP_PIX_PER_COL + c] = (GLubyte)(
+                    (row0[x0*BMP_PIX_PER_COL + c] * (1.0f - fx) + row0[x1*BMP_PIX_PER_COL + c] * fx) * (1.0f - fy) +
+                    (row1[x0*BMP_PIX_PER_COL + c] * (1.0f - fx) + row1[x1*BMP_PIX_PER_COL + c] * fx) * fy + 0.5f);
+            }
+        }
+    }
+
+    free(image->data);
+    image->data = data;
+    image->width = width;
+    image->height = height;
+    image->levels = 1;
+
+    return GL_TRUE;
+}
+
+
+void imageSumRows(GLushort *dest, const GLubyte *row0, const GLubyte *row1, GLuint count)
+{
+    GLuint i = 0;
+
+#if defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    __m128i a, b;
+
+    /* Widen 16 bytes of each row to 16 bits and add */
+    for(;i+16<=count;i+=16)
+    {
+        a = _mm_loadu_si128((const __m128i *)&row0[i]);
+        b = _mm_loadu_si128((const __m128i *)&row1[i]);
+
+        _mm_storeu_si128((__m128i *)&dest[i], _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)));
+        _mm_storeu_si128((__m128i *)&dest[i+8], _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)));
+    }
+#endif
+
+    for(;i<count;i++)
+    {
+        dest[i] = (GLushort)row0[i] + row1[i];
+    }
+}
+
+
+void imageBoxFilter(GLubyte *dest, GLuint width, GLuint height, const GLubyte *src, GLuint srcWidth, GLuint srcHeight, GLushort *rowSums)
+{
+    const GLubyte *row0, *row1;
+    GLubyte *out;
+    GLuint x, y, x0, x1;
+
+    for(y=0;y<height;y++)
+    {
+        /* An odd last row or column is dropped, a single one is repeated */
+        row0 = &src[(size_t)(y*2) * srcWidth * BMP_PIX_PER_COL];
+        row1 = (y*2 + 1 < srcHeight) ? row0 + srcWidth * BMP_PIX_PER_COL : row0;
+
+        /* Vertical pairs first, vectorized, then horizontal pairs of the sums */
+        imageSumRows(rowSums, row0, row1, srcWidth * BMP_PIX_PER_COL);
+
+        out = &dest[(size_t)y * width * BMP_PIX_PER_COL];
+        for(x=0;x<width;x++)
+        {
+            x0 = (x*2) * BMP_PIX_PER_COL;
+            x1 = (x*2 + 1 < srcWidth) ? x0 + BMP_PIX_PER_COL : x0;
+
+            out[x*BMP_PIX_PER_COL + 0] = (GLubyte)((rowSums[x0 + 0] + rowSums[x1 + 0] + 2) >> 2);
+            out[x*BMP_PIX_PER_COL + 1] = (GLubyte)((rowSums[x0 + 1] + rowSums[x1 + 1] + 2) >> 2);
+            out[x*BMP_PIX_PER_COL + 2] = (GLubyte)((rowSums[x0 + 2] + rowSums[x1 + 2] + 2) >> 2);
+        }
+    }
+}
+
+
+GLboolean imageBuildMips(image_t *image)
+{
+    GLubyte *data;
+    GLushort *rowSums;
+    GLuint levels = 1;
+    GLuint i;
+
+    /* Down to 1x1, GL wants the whole chain for a complete texture */
+    while ( levels < IMAGE_MAX_LEVELS && ((image->width >> levels) != 0 || (image->height >> levels) != 0) )
+    {
+        levels++;
+    }
+
+    image->levels = levels;
+    data = (GLubyte *)realloc(image->data, imageGetLevelOffset(image, levels));
+    rowSums = (GLushort *)malloc(sizeof(GLushort) * image->width * BMP_PIX_PER_COL);
+
+    if (data == NULL || rowSums == NULL)
+    {
+        image->levels = 1;
+        image->data = (data != NULL) ? data : image->data;
+        free(rowSums);
+        return GL_FALSE;
+    }
+
+    image->data = data;
+
+    for(i=1;i<levels;i++)
+    {
+        imageBoxFilter(&data[imageGetLevelOffset(image, i)], imageGetLevelDim(image->width, i), imageGetLevelDim(image->height, i),
+                       &data[imageGetLevelOffset(image, i - 1)], imageGetLevelDim(image->width, i - 1), imageGetLevelDim(image->height, i - 1), rowSums);
+    }
+
+    free(rowSums);
+
+    return GL_TRUE;
+}
+
+
+GLboolean imageCompress(image_t *image, GLenum format)
+{
+    image_t compressed = *image;
+    GLuint i;
+
+    compressed.format = format;
+    compressed.data = (GLubyte *)malloc(imageGetLevelOffset(&compressed, compressed.levels));
+    if (compressed.data == NULL)
+    {
+        return GL_FALSE;
+    }
+
+    for(i=0;i<image->levels;i++)
+    {
+        etcEncodeRows(&compressed.data[imageGetLevelOffset(&compressed, i)], &image->data[imageGetLevelOffset(image, i)],
+                      imageGetLevelDim(image->width, i), imageGetLevelDim(image->height, i),
+                      0, (imageGetLevelDim(image->height, i) + ETC_BLOCK_SIZE - 1) / ETC_BLOCK_SIZE);
+    }
+
+    free(image->data);
+    *image = compressed;
+
+    return GL_TRUE;
+}
+
+
+GLenum imageGetFormat(GLuint flags)
+{
+    if (flags & IMAGE_LOAD_ETC2)
+    {
+        return GL_COMPRESSED_RGB8_ETC2;
+    }
+
+    return (flags & IMAGE_LOAD_ETC1) ? GL_ETC1_RGB8_OES : GL_RGB8;
+}
+
+
+GLuint imageGetCacheFlags(GLuint flags)
+{
+    /* ETC1 and ETC2 uploads share the same blocks */
+    return (flags & (IMAGE_LOAD_MIPS | IMAGE_LOAD_POT)) | ((flags & (IMAGE_LOAD_ETC1 | IMAGE_LOAD_ETC2)) ? IMAGE_LOAD_ETC1 : 0);
+}
+
+
+char *imageGetCacheFileName(const char *fileName)
+{
+    char *cacheFile;
+
+    cacheFile = (char *)malloc(strlen(fileName) + strlen(IMAGE_CACHE_SUFFIX) + 1);
+    if (cacheFile != NULL)
+    {
+        strcpy(cacheFile, fileName);
+        strcat(cacheFile, IMAGE_CACHE_SUFFIX);
+    }
+
+    return cacheFile;
+}
+
+
+GLboolean imageReadCache(image_t *image, const char *fileName, GLuint flags)
+{
+    const imageCacheHeader_t *header;
+    const void *cacheData;
+    size_t cacheSize = 0;
+    size_t dataSize;
+    char *cacheFile;
+    GLboolean result = GL_FALSE;
+
+    cacheFile = imageGetCacheFileName(fileName);
+    cacheData = (cacheFile != NULL) ? cacheMapFile(cacheFile, &cacheSize) : NULL;
+    free(cacheFile);
+
+    if (cacheData == NULL)
+    {
+        return GL_FALSE;
+    }
+
+    header = (const imageCacheHeader_t *)cacheData;
+
+    if ( cacheSize >= sizeof(imageCacheHeader_t) &&
+         header->magic == IMAGE_CACHE_MAGIC &&
+         header->version == IMAGE_CACHE_VERSION &&
+         header->flags == imageGetCacheFlags(flags) &&
+         header->levels != 0 && header->levels <= IMAGE_MAX_LEVELS )
+    {
+        image->width = header->width;
+        image->height = header->height;
+        image->levels = header->levels;
+        image->format = imageGetFormat(flags);
+        dataSize = imageGetLevelOffset(image, image->levels);
+
+        /* Sizes first, the source key last as it may have to hash the file */
+        if ( header->dataOffset <= cacheSize && dataSize <= cacheSize - header->dataOffset &&
+             GL_TRUE == cacheCheckKey(fileName, &header->sourceKey) &&
+             (image->data = (GLubyte *)malloc(dataSize)) != NULL )
+        {
+            memcpy(image->data, (const GLubyte *)cacheData + header->dataOffset, dataSize);
+            result = GL_TRUE;
+        }
+    }
+
+    cacheUnmapFile(cacheData, cacheSize);
+
+    return result;
+}
+
+
+GLboolean imageWriteCache(const image_t *image, const char *fileName, GLuint flags)
+{
+    imageCacheHeader_t header;
+    GLubyte *buffer;
+    size_t dataSize = imageGetLevelOffset(image, image->levels);
+    char *cacheFile;
+    GLboolean result;
+
+    memset(&header, 0, sizeof(imageCacheHeader_t));
+    header.magic = IMAGE_CACHE_MAGIC;
+    header.version = IMAGE_CACHE_VERSION;
+    header.flags = imageGetCacheFlags(flags);
+    header.width = image->width;
+    header.height = image->height;
+    header.levels = image->levels;
+    header.dataOffset = CACHE_ALIGN(sizeof(imageCacheHeader_t));
+
+    if ( GL_FALSE == cacheMakeKey(fileName, &header.sourceKey) )
+    {
+        return GL_FALSE;
+    }
+
+    buffer = (GLubyte *)calloc(1, header.dataOffset + dataSize);
+    cacheFile = imageGetCacheFileName(fileName);
+    if (buffer == NULL || cacheFile == NULL)
+    {
+        free(buffer);
+        free(cacheFile);
+        return GL_FALSE;
+    }
+
+    memcpy(buffer, &header, sizeof(imageCacheHeader_t));
+    memcpy(&buffer[header.dataOffset], image->data, dataSize);
+
+    result = cacheWriteFile(cacheFile, buffer, header.dataOffset + dataSize);
+
+    free(buffer);
+    free(cacheFile);
+
+    return result;
+}
+
+
+GLboolean imageDecode(image_t *image, const char *fileName, GLuint flags, GLboolean *cached)
+{
+    GLuint width, height;
+
+    image->data = NULL;
+    image->levels = 1;
+    image->format = GL_RGB8;
+
+    *cached = ( (flags & IMAGE_LOAD_CACHE) && GL_TRUE == imageReadCache(image, fileName, flags) ) ? GL_TRUE : GL_FALSE;
+    if ( GL_TRUE == *cached )
+    {
+        return GL_TRUE;
+    }
+
+    image->data = imageReadBmp(fileName, &image->width, &image->height);
+    if (image->data == NULL)
+    {
+        return GL_FALSE;
+    }
+
+    /* ES2 only mipmaps and repeats power of two textures */
+    width = (flags & IMAGE_LOAD_POT) ? imageGetPowerOfTwo(image->width) : image->width;
+    height = (flags & IMAGE_LOAD_POT) ? imageGetPowerOfTwo(image->height) : image->height;
+
+    if ( (width != image->width || height != image->height) && GL_FALSE == imageResize(image, width, height) )
+    {
+        free(image->data);
+        image->data = NULL;
+        return GL_FALSE;
+    }
+
+    if ( (flags & IMAGE_LOAD_MIPS) && GL_FALSE == imageBuildMips(image) )
+    {
+        free(image->data);
+        image->data = NULL;
+        return GL_FALSE;
+    }
+
+    return GL_TRUE;
+}
+
+
+GLboolean imageLoad(image_t *image, const char *fileName, GLuint flags)
+{
+    GLboolean cached;
+
+    if ( GL_FALSE == imageDecode(image, fileName, flags, &cached) )
+    {
+        return GL_FALSE;
+    }
+
+    if ( GL_TRUE == cached )
+    {
+        return GL_TRUE;
+    }
+
+    if ( imageGetFormat(flags) != GL_RGB8 && GL_FALSE == imageCompress(image, imageGetFormat(flags)) )
+    {
+        free(image->data);
+        image->data = NULL;
+        return GL_FALSE;
+    }
+
+    /* A failed cache write only costs the next start */
+    if (flags & IMAGE_LOAD_CACHE)
+    {
+        imageWriteCache(image, fileName, flags);
+    }
+
+    return GL_TRUE;
+}
+
+
+GLboolean imageGetNpotSupport(void)
+{
+    const char *version = (const char *)glGetString(GL_VERSION);
+    const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+    GLint major = 0;
+
+    /* ES3 lifts the restriction, ES2 needs OES_texture_npot */
+    if ( version != NULL && sscanf(version, "OpenGL ES %d", &major) == 1 && major >= 3 )
+    {
+        return GL_TRUE;
+    }
+
+    return ( extensions != NULL && strstr(extensions, "GL_OES_texture_npot") != NULL ) ? GL_TRUE : GL_FALSE;
+}
+
+
+GLuint imageGetEtcSupport(void)
+{
+    const char *version = (const char *)glGetString(GL_VERSION);
+    const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+    GLint major = 0;
+
+    /* ETC2 is core in ES3, ES2 needs OES_compressed_ETC1_RGB8_texture */
+    if ( version != NULL && sscanf(version, "OpenGL ES %d", &major) == 1 && major >= 3 )
+    {
+        return IMAGE_LOAD_ETC2;
+    }
+
+    return ( extensions != NULL && strstr(extensions, "GL_OES_compressed_ETC1_RGB8_texture") != NULL ) ? IMAGE_LOAD_ETC1 : 0;
+}
+
+
+void imageUploadTexture(const image_t *image)
+{
+    GLuint i;
+
+    if (image->format != GL_RGB8)
+    {
+        for(i=0;i<image->levels;i++)
+        {
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, image->format, imageGetLevelDim(image->width, i), imageGetLevelDim(image->height, i), 0,
+                                   imageGetLevelSize(image, i), &image->data[imageGetLevelOffset(image, i)]);
+        }
+
+        return;
+    }
+
+    /* Levels are tightly packed, odd widths do not end on 4 bytes */
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    glTexStorage2D(GL_TEXTURE_2D, image->levels, GL_RGB8, image->width, image->height);
+
+    for(i=0;i<image->levels;i++)
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, imageGetLevelDim(image->width, i), imageGetLevelDim(image->height, i),
+                        GL_RGB, GL_UNSIGNED_BYTE, &image->data[imageGetLevelOffset(image, i)]);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+
+void imageFinishLoad(imageLoad_t *load, GLboolean result)
+{
+    imageLoader_t *loader = load->loader;
+    GLuint index = (GLuint)(load - loader->loads);
+
+    load->result = result;
+
+    pthread_mutex_lock(&loader->lock);
+    arrayAppend(&loader->done, &index, 1);
+    pthread_cond_signal(&loader->loadDone);
+    pthread_mutex_unlock(&loader->lock);
+}
+
+
+void imageEncodeTask(void *arg)
+{
+    imageEncodeTask_t *task = (imageEncodeTask_t *)arg;
+    imageLoad_t *load = task->load;
+    imageLoader_t *loader = load->loader;
+    image_t compressed = load->image;
+    GLboolean last;
+
+    compressed.format = imageGetFormat(loader->flags);
+    compressed.data = load->encoded;
+
+    etcEncodeRows(&compressed.data[imageGetLevelOffset(&compressed, task->level)], &load->image.data[imageGetLevelOffset(&load->image, task->level)],
+                  imageGetLevelDim(load->image.width, task->level), imageGetLevelDim(load->image.height, task->level),
+                  task->firstBlockRow, task->blockRowCount);
+
+    pthread_mutex_lock(&loader->lock);
+    last = (--load->pendingTasks == 0) ? GL_TRUE : GL_FALSE;
+    pthread_mutex_unlock(&loader->lock);
+
+    if ( GL_FALSE == last )
+    {
+        return;
+    }
+
+    /* Every block is done, swap the texels for the blocks and publish */
+    free(load->image.data);
+    free(load->tasks);
+    load->image = compressed;
+    load->encoded = NULL;
+    load->tasks = NULL;
+
+    if (loader->flags & IMAGE_LOAD_CACHE)
+    {
+        imageWriteCache(&load->image, load->fileName, loader->flags);
+    }
+
+    imageFinishLoad(load, GL_TRUE);
+}
+
+
+GLboolean imageStartEncode(imageLoad_t *load)
+{
+    imageLoader_t *loader = load->loader;
+    imageEncodeTask_t *tasks;
+    image_t compressed = load->image;
+    GLuint count = 0, blockRows, level, row, i;
+
+    compressed.format = imageGetFormat(loader->flags);
+
+    for(level=0;level<load->image.levels;level++)
+    {
+        blockRows = (imageGetLevelDim(load->image.height, level) + ETC_BLOCK_SIZE - 1) / ETC_BLOCK_SIZE;
+        count += (blockRows + IMAGE_ENCODE_BLOCK_ROWS - 1) / IMAGE_ENCODE_BLOCK_ROWS;
+    }
+
+    tasks = (imageEncodeTask_t *)malloc(sizeof(imageEncodeTask_t) * count);
+    load->encoded = (GLubyte *)malloc(imageGetLevelOffset(&compressed, compressed.levels));
+    if (tasks == NULL || load->encoded == NULL)
+    {
+        free(tasks);
+        free(load->encoded);
+        load->encoded = NULL;
+        return GL_FALSE;
+    }
+
+    /* Split every level into bands of block rows */
+    for(level=0, i=0;level<load->image.levels;level++)
+    {
+        blockRows = (imageGetLevelDim(load->image.height, level) + ETC_BLOCK_SIZE - 1) / ETC_BLOCK_SIZE;
+
+        for(row=0;row<blockRows;row+=IMAGE_ENCODE_BLOCK_ROWS, i++)
+        {
+            tasks[i].load = load;
+            tasks[i].level = level;
+            tasks[i].firstBlockRow = row;
+            tasks[i].blockRowCount = (row + IMAGE_ENCODE_BLOCK_ROWS < blockRows) ? IMAGE_ENCODE_BLOCK_ROWS : blockRows - row;
+        }
+    }
+
+    load->tasks = tasks;
+    load->pendingTasks = count;
+
+    for(i=0;i<count;i++)
+    {
+        threadPoolSubmit(loader->pool, imageEncodeTask, &tasks[i]);
+    }
+
+    return GL_TRUE;
+}
+
+
+void imageDecodeTask(void *arg)
+{
+    imageLoad_t *load = (imageLoad_t *)arg;
+    imageLoader_t *loader = load->loader;
+    GLboolean cached;
+
+    /* Without a pool or without compression the whole load happens here */
+    if ( loader->pool == NULL || imageGetFormat(loader->flags) == GL_RGB8 )
+    {
+        imageFinishLoad(load, imageLoad(&load->image, load->fileName, loader->flags));
+        return;
+    }
+
+    if ( GL_FALSE == imageDecode(&load->image, load->fileName, loader->flags, &cached) )
+    {
+        imageFinishLoad(load, GL_FALSE);
+        return;
+    }
+
+    if ( GL_TRUE == cached )
+    {
+        imageFinishLoad(load, GL_TRUE);
+        return;
+    }
+
+    /* The blocks are encoded by tasks of their own so one large texture still uses every worker */
+    if ( GL_FALSE == imageStartEncode(load) )
+    {
+        free(load->image.data);
+        load->image.data = NULL;
+        imageFinishLoad(load, GL_FALSE);
+    }
+}
+
+
+void imageLoaderStart(imageLoader_t *loader, threadPool_t *pool, imageLoad_t *loads, GLuint count, GLuint flags)
+{
+    GLuint i;
+
+    loader->pool = pool;
+    loader->loads = loads;
+    loader->count = count;
+    loader->flags = flags;
+    loader->nextDone = 0;
+
+    pthread_mutex_init(&loader->lock, NULL);
+    pthread_cond_init(&loader->loadDone, NULL);
+    arrayInit(&loader->done, sizeof(GLuint));
+
+    /* Reserve up front so workers never wait on a reallocation */
+    arrayReserve(&loader->done, count);
+
+    for(i=0;i<count;i++)
+    {
+        loads[i].loader = loader;
+        loads[i].image.data = NULL;
+        loads[i].result = GL_FALSE;
+        loads[i].encoded = NULL;
+        loads[i].tasks = NULL;
+        loads[i].pendingTasks = 0;
+    }
+
+    /* Without a pool every file is decoded on demand by imageLoaderNext */
+    if (pool != NULL)
+    {
+        for(i=0;i<count;i++)
+        {
+            threadPoolSubmit(pool, imageDecodeTask, &loads[i]);
+        }
+    }
+}
+
+
+imageLoad_t *imageLoaderNext(imageLoader_t *loader)
+{
+    GLuint index;
+
+    if (loader->nextDone == loader->count)
+    {
+        return NULL;
+    }
+
+    if (loader->pool == NULL)
+    {
+        imageDecodeTask(&loader->loads[loader->nextDone]);
+    }
+
+    /* Hand out whichever decode finished first, the caller owns its data */
+    pthread_mutex_lock(&loader->lock);
+
+    while (loader->done.count == loader->nextDone)
+    {
+        pthread_cond_wait(&loader->loadDone, &loader->lock);
+    }
+
+    index = ARRAY_DATA(&loader->done, GLuint)[loader->nextDone++];
+
+    pthread_mutex_unlock(&loader->lock);
+
+    return &loader->loads[index];
+}
+
+
+void imageLoaderFinish(imageLoader_t *loader)
+{
+    GLuint i;
+
+    /* Let queued decodes finish, the loads array must outlive them */
+    pthread_mutex_lock(&loader->lock);
+
+    while (loader->pool != NULL && loader->done.count < loader->count)
+    {
+        pthread_cond_wait(&loader->loadDone, &loader->lock);
+    }
+
+    pthread_mutex_unlock(&loader->lock);
+
+    /* Images that were never taken are still ours */
+    for(i=loader->nextDone;i<loader->done.count;i++)
+    {
+        free(loader->loads[ARRAY_DATA(&loader->done, GLuint)[i]].image.data);
+        loader->loads[ARRAY_DATA(&loader->done, GLuint)[i]].image.data = NULL;
+    }
+
+    pthread_mutex_destroy(&loader->lock);
+    pthread_cond_destroy(&loader->loadDone);
+    arrayFree(&loader->done);
+}
+
+
+GLint imageBenchmarkLoads(imageRelease_f release, imageReload_f reload, void *arg, GLuint numOfTextures, GLint iterations, GLuint maxThreads)
+{
+    threadPool_t *pool;
+    GLint i;
+    GLuint threads;
+    double start, elapsed, best, total, single = 0.0;
+
+    printf("%8s %10s %10s %10s %10s\n", "threads", "textures", "min ms", "avg ms", "speedup");
+
+    /* Sweep 1, 2, 4 ... decode threads up to the requested count */
+    for(threads=1;threads<=maxThreads;threads*=2)
+    {
+        threads = (threads*2 > maxThreads) ? maxThreads : threads;
+        pool = (threads > 1) ? threadPoolCreate(threads) : NULL;
+        best = 0.0;
+        total = 0.0;
+
+        for(i=0;i<iterations;i++)
+        {
+            release(arg);
+
+            /* Decode and upload, finished once the GL has the data */
+            start = getTimeMs();
+            if ( GL_FALSE == reload(pool, arg) )
+            {
+                threadPoolDestroy(pool);
+                return -1;
+            }
+            glFinish();
+            elapsed = getTimeMs() - start;
+
+            best = (i == 0 || elapsed < best) ? elapsed : best;
+            total += elapsed;
+        }
+
+        single = (threads == 1) ? best : single;
+        printf("%8u %10u %10.2f %10.2f %9.2fx\n", threads, numOfTextures, best, total / iterations, single / best);
+
+        threadPoolDestroy(pool);
+    }
+
+    return 0;
+}
+
+
+GLint imageBenchmarkDecode(const char **fileNames, GLuint count, GLint iterations)
+{
+    const GLubyte *file;
+    const char *name;
+    GLubyte *data;
+    GLuint i, pass, width, height;
+    GLint k;
+    size_t size = 0, totalSize = 0;
+    double start, elapsed, best[2], total[2] = { 0.0, 0.0 };
+
+    printf("%-32s %10s %12s %12s %10s\n", "texture", "size KB", "scalar MB/s", "simd MB/s", "speedup");
+
+    for(i=0;i<count;i++)
+    {
+        /* Map, decode and unmap like a load does, plain C rows first then the SIMD swizzle */
+        for(pass=0;pass<2;pass++)
+        {
+            best[pass] = 0.0;
+
+            for(k=0;k<iterations;k++)
+            {
+                start = getTimeMs();
+                file = (const GLubyte *)cacheMapFile(fileNames[i], &size);
+                data = (file != NULL) ? imageDecodeBmp(file, size, &width, &height, (pass == 1) ? GL_TRUE : GL_FALSE) : NULL;
+                if (file != NULL)
+                {
+                    cacheUnmapFile(file, size);
+                }
+                elapsed = getTimeMs() - start;
+
+                if (data == NULL)
+                {
+                    printf("Error loading tex file: %s\n", fileNames[i]);
+                    return -1;
+                }
+                free(data);
+
+                best[pass] = (k == 0 || elapsed < best[pass]) ? elapsed : best[pass];
+            }
+
+            total[pass] += best[pass];
+        }
+
+        /* The file name alone keeps the table narrow */
+        name = strrchr(fileNames[i], '/');
+        name = (name != NULL) ? name + 1 : fileNames[i];
+
+        totalSize += size;
+        printf("%-32s %10.1f %12.1f %12.1f %9.2fx\n", name, size / 1024.0,
+               size / (best[0] * 1048.576), size / (best[1] * 1048.576), best[0] / best[1]);
+    }
+
+    if (count > 0)
+    {
+        printf("%-32s %10.1f %12.1f %12.1f %9.2fx\n", "total", totalSize / 1024.0,
+               totalSize / (total[0] * 1048.576), totalSize / (total[1] * 1048.576), total[0] / total[1]);
+    }
+
+    return 0;
+}
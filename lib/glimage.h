@@ -0,0 +1,170 @@
+#ifndef __GL_IMAGE_H__
+#define __GL_IMAGE_H__
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#define GLFW_INCLUDE_ES2
+#include <GLFW/glfw3.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "glarray.h"
+#include "glthreadpool.h"
+#include "glcache.h"
+#include "gletc.h"
+#include "gltime.h"
+
+/*******************************************************************/
+/*  Defines                                                        */
+/*******************************************************************/
+/* Fields are little endian and not aligned, offsets are from the start of the file */
+#define BMP_SIGNATURE               0x4D42
+#define BMP_DATA_OFFSET_OFFSET      10
+#define BMP_INFO_SIZE_OFFSET        14
+#define BMP_WIDTH_OFFSET            18
+#define BMP_HEIGHT_OFFSET           22
+#define BMP_BIT_COUNT_OFFSET        28
+#define BMP_COMPRESSION_OFFSET      30
+#define BMP_MASKS_OFFSET            54
+
+/* OS/2 core header with 16-bit sizes, every later header starts like BITMAPINFOHEADER */
+#define BMP_CORE_INFO_SIZE          12
+#define BMP_CORE_WIDTH_OFFSET       18
+#define BMP_CORE_HEIGHT_OFFSET      20
+#define BMP_CORE_BIT_COUNT_OFFSET   24
+#define BMP_INFO_SIZE               40
+
+#define BMP_COMPRESSION_RGB         0
+#define BMP_COMPRESSION_BITFIELDS   3
+
+/* Decoded texels are RGB, the file holds BGR or BGRX */
+#define BMP_PIX_PER_COL             3
+#define BMP_MAX_SIZE                32768
+
+/* Enough levels for a 32768 texel edge */
+#define IMAGE_MAX_LEVELS            16
+
+/* Mip chains are cached beside the source, e.g. planet_Earth.bmpc */
+#define IMAGE_CACHE_SUFFIX          "c"
+#define IMAGE_CACHE_MAGIC           0x434D4942
+#define IMAGE_CACHE_VERSION         3
+
+/* Block rows per ETC encode task, 32 texel rows */
+#define IMAGE_ENCODE_BLOCK_ROWS     8
+
+#ifndef GL_ETC1_RGB8_OES
+#define GL_ETC1_RGB8_OES            0x8D64
+#endif
+
+
+/*******************************************************************/
+/*  Typedefs                                                       */
+/*******************************************************************/
+/* RGB8 texels with rows tightly packed or ETC blocks, every level back to back after level 0 */
+typedef struct _image_t
+{
+    GLubyte *data;
+    GLuint width;
+    GLuint height;
+    GLuint levels;
+    GLenum format;
+} image_t;
+
+typedef enum _imageLoadFlags_e {
+    IMAGE_LOAD_MIPS         = 0x1,  /* build the full mip chain */
+    IMAGE_LOAD_POT          = 0x2,  /* resize to the nearest power of two first */
+    IMAGE_LOAD_CACHE        = 0x4,  /* read and write the result in a cache beside the source */
+    IMAGE_LOAD_ETC1         = 0x8,  /* encode ETC1 blocks, uploaded as GL_ETC1_RGB8_OES */
+    IMAGE_LOAD_ETC2         = 0x10, /* the same blocks uploaded as GL_COMPRESSED_RGB8_ETC2, ETC1 is a subset */
+} imageLoadFlags_e;
+
+typedef struct _imageCacheHeader_t
+{
+    GLuint magic;
+    GLuint version;
+
+    cacheKey_t sourceKey;
+
+    GLuint flags;
+    GLuint width;
+    GLuint height;
+    GLuint levels;
+    GLuint dataOffset;
+} imageCacheHeader_t;
+
+struct _imageLoader_t;
+
+/* One file to decode, filled in by the caller, the result by the loader */
+typedef struct _imageLoad_t
+{
+    const char *fileName;
+    GLuint tag;
+
+    image_t image;
+    GLboolean result;
+    struct _imageLoader_t *loader;
+
+    /* Blocks being encoded on the pool, the last task to finish publishes the image */
+    GLubyte *encoded;
+    void *tasks;
+    GLuint pendingTasks;
+} imageLoad_t;
+
+/* Frees the textures a load benchmark made, then loads them again on the pool given */
+typedef void (*imageRelease_f)(void *arg);
+typedef GLboolean (*imageReload_f)(threadPool_t *pool, void *arg);
+
+/* Decodes a list of files on a thread pool and hands them back as they finish */
+typedef struct _imageLoader_t
+{
+    threadPool_t *pool;
+    imageLoad_t *loads;
+    GLuint count;
+    GLuint flags;
+
+    pthread_mutex_t lock;
+    pthread_cond_t loadDone;
+
+    /* Indices into loads in completion order, nextDone is the first not yet taken */
+    array_t done;
+    GLuint nextDone;
+} imageLoader_t;
+
+
+/*******************************************************************/
+/*  Prototypes                                                     */
+/*******************************************************************/
+GLubyte *imageDecodeBmp(const GLubyte *file, size_t size, GLuint *width, GLuint *height, GLboolean vectorized);
+GLubyte *imageReadBmp(const char *fileName, GLuint *width, GLuint *height);
+size_t imageGetLevelSize(const image_t *image, GLuint level);
+size_t imageGetLevelOffset(const image_t *image, GLuint level);
+GLboolean imageResize(image_t *image, GLuint width, GLuint height);
+GLboolean imageBuildMips(image_t *image);
+GLboolean imageCompress(image_t *image, GLenum format);
+GLboolean imageLoad(image_t *image, const char *fileName, GLuint flags);
+GLenum imageGetFormat(GLuint flags);
+GLboolean imageGetNpotSupport(void);
+GLuint imageGetEtcSupport(void);
+void imageUploadTexture(const image_t *image);
+void imageLoaderStart(imageLoader_t *loader, threadPool_t *pool, imageLoad_t *loads, GLuint count, GLuint flags);
+imageLoad_t *imageLoaderNext(imageLoader_t *loader);
+void imageLoaderFinish(imageLoader_t *loader);
+GLint imageBenchmarkLoads(imageRelease_f release, imageReload_f reload, void *arg, GLuint numOfTextures, GLint iterations, GLuint maxThreads);
+GLint imageBenchmarkDecode(const char **fileNames, GLuint count, GLint iterations);
+
+
+/*******************************************************************/
+/*  Inline Functions                                               */
+/*******************************************************************/
+static inline GLuint imageGetLevelDim(GLuint size, GLuint level)
+{
+    return (size >> level) ? (size >> level) : 1;
+}
+
+#endif
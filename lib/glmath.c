@@ -182,3 +182,15 @@ void generatePerspectiveProjectionMatrix(GLfloat fov, GLfloat aspect, GLfloat zN
     mat[3] = 0.0f;                            mat[7] = 0.0f;                            mat[11] = qn;     mat[15] = 0.0f;
 }
 
+
+void getCameraPosition(const GLfloat *view, GLfloat *position)
+{
+    GLuint k;
+
+    /* The view is a rotation and a translation, the camera sits at minus the translation turned back */
+    for(k=0;k<3;k++)
+    {
+        position[k] = -((view[k] * view[3]) + (view[4+k] * view[7]) + (view[8+k] * view[11]));
+    }
+}
+
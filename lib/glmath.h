@@ -55,6 +55,7 @@ void generateScaleTranslationMatrix(vec3_t scale, vec3_t translate, GLfloat *mat
 void setIdentityMatrix(GLfloat* mat);
 void generateLookAtMatrix(vec3_t eye, vec3_t target, vec3_t upDir, GLfloat *mat);
 void generatePerspectiveProjectionMatrix(GLfloat fov, GLfloat aspect, GLfloat zNear, GLfloat zFar, GLfloat *mat);
+void getCameraPosition(const GLfloat *view, GLfloat *position);
 
 #endif
 
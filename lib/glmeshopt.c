@@ -0,0 +1,1728 @@
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#include <math.h>
+#include <float.h>
+
+#include "glmeshopt.h"
+
+/*******************************************************************/
+/*  Defines                                                        */
+/*******************************************************************/
+#define MESH_NO_VERTEX              0xFFFFFFFF
+
+#define MESH_NORMAL_MIN_TASK_SIZE   4096
+#define MESH_NORMAL_TASKS_PER_THREAD 4
+
+/* Seam edges are held in place by planes through them, weighted above the faces */
+#define MESH_SIMPLIFY_SEAM_WEIGHT   10.0
+
+/* A collapse may turn a triangle by at most about 78 degrees */
+#define MESH_SIMPLIFY_MIN_NORMAL_DOT 0.2f
+
+#define MESH_SIMPLIFY_MAX_PASSES    64
+
+/* A cluster this full takes no triangle turned too far from its mean normal */
+#define MESH_CLUSTER_MIN_TRIANGLES  16
+#define MESH_CLUSTER_MIN_NORMAL_DOT 0.8f
+
+/* Cost of a triangle turning away from the mean normal, against one per new vertex */
+#define MESH_CLUSTER_CONE_WEIGHT    2.0f
+
+/* Cones wider than about 84 degrees either way cull too little to be tested */
+#define MESH_CLUSTER_MIN_CONE_DOT   0.1f
+
+
+/*******************************************************************/
+/*  Typedefs                                                       */
+/*******************************************************************/
+
+typedef struct _meshNormalContext_t
+{
+    const GLfloat *positions;
+    const GLuint *indices;
+    meshNormalWeight_e weighting;
+    GLboolean crease;
+    GLfloat cosCrease;
+
+    /* Per triangle unit normal and per corner weight */
+    GLfloat *faceNormals;
+    GLfloat *cornerWeights;
+
+    /* Corners around every vertex */
+    GLuint *offsets;
+    GLuint *adjacency;
+
+    /* Normal and local slot of every corner with hard edges, one per vertex without */
+    GLfloat *cornerNormals;
+    GLuint *cornerSlots;
+    GLfloat *vertexNormals;
+
+    /* Normals per vertex, then the first output normal of each */
+    GLuint *slotCounts;
+
+    GLfloat *normals;
+    GLuint *normalIndices;
+} meshNormalContext_t;
+
+typedef struct _meshNormalTask_t
+{
+    meshNormalContext_t *context;
+    GLuint start;
+    GLuint end;
+} meshNormalTask_t;
+
+/* Symmetric 4x4 plane quadric, the weighted sum of squared distances to its planes */
+typedef struct _meshQuadric_t
+{
+    double a2, b2, c2, ab, ac, bc, ad, bd, cd, d2;
+    double weight;
+} meshQuadric_t;
+
+/* Moving every wedge of one position onto its neighbor across an edge */
+typedef struct _meshCollapse_t
+{
+    GLuint from;
+    GLuint to;
+    GLfloat error;
+} meshCollapse_t;
+
+/*
+ * Vertices are welded twice, by position and texcoord into wedges and by position alone.
+ * Triangles refer to wedges, a position with more than one wedge sits on a UV seam.
+ * Every id is the original vertex that represents the group.
+ */
+typedef struct _meshSimplifyContext_t
+{
+    const GLfloat *positions;
+    GLuint vertexCount;
+
+    GLuint *wedgeOf;
+    GLuint *positionOf;
+
+    /* Live wedges of every position */
+    GLuint *wedgeHead;
+    GLuint *wedgeNext;
+
+    /* Triangles around every wedge */
+    GLuint *offsets;
+    GLuint *adjacency;
+
+    GLuint *indices;
+    GLuint *corners;
+    GLuint indexCount;
+
+    /* Per position, indexed by the representative */
+    meshQuadric_t *quadrics;
+    GLubyte *locked;
+    GLubyte *touched;
+    GLuint *marks;
+    GLuint stamp;
+
+    GLuint *collapseTo;
+} meshSimplifyContext_t;
+
+/* Triangles around every vertex and what is already in a cluster */
+typedef struct _meshClusterContext_t
+{
+    const GLuint *indices;
+
+    /* Vertices welded by position, split normals or texcoords do not break the adjacency */
+    GLuint *positionOf;
+
+    GLuint *offsets;
+    GLuint *adjacency;
+    GLfloat *normals;
+    GLubyte *emitted;
+
+    /* Vertices of the cluster being grown, marked with its stamp */
+    GLuint *marks;
+    GLuint *vertices;
+    GLuint stamp;
+
+    /* Cluster local vertex numbers for the cache optimizer */
+    GLuint *localOf;
+    GLuint *globalOf;
+    GLuint *local;
+    GLuint *optimized;
+} meshClusterContext_t;
+
+
+/*******************************************************************/
+/*  Functions                                                      */
+/*******************************************************************/
+meshCacheStats_t meshAnalyzeVertexCache(const GLuint *indices, GLuint indexCount, GLuint vertexCount, GLuint cacheSize)
+{
+    meshCacheStats_t stats = { 0, 0.0f, 0.0f };
+    GLuint *cacheTime;
+    GLuint *used;
+    GLuint numOfUsed = 0;
+    GLuint i;
+
+    cacheTime = (GLuint *)calloc(vertexCount, sizeof(GLuint));
+    used = (GLuint *)calloc(vertexCount, sizeof(GLuint));
+
+    /* A vertex is still cached if fewer than cacheSize misses happened since its own */
+    for(i=0;i<indexCount;i++)
+    {
+        if (cacheTime[indices[i]] == 0 || stats.transforms - cacheTime[indices[i]] >= cacheSize)
+        {
+            stats.transforms++;
+            cacheTime[indices[i]] = stats.transforms;
+        }
+
+        numOfUsed += (used[indices[i]] == 0) ? 1 : 0;
+        used[indices[i]] = 1;
+    }
+
+    /* Average cache miss ratio per triangle and transform to vertex ratio */
+    stats.acmr = (indexCount != 0) ? (GLfloat)stats.transforms / (indexCount / 3) : 0.0f;
+    stats.atvr = (numOfUsed != 0) ? (GLfloat)stats.transforms / numOfUsed : 0.0f;
+
+    free(cacheTime);
+    free(used);
+
+    return stats;
+}
+
+
+GLuint meshGetNextVertex(const GLuint *candidates, GLuint numOfCandidates, const GLuint *live, const GLuint *cacheTime,
+                         GLuint time, GLuint cacheSize, GLuint *deadEnd, GLuint *deadEndCount, GLuint *cursor, GLuint vertexCount)
+{
+    GLuint i, vertex;
+    GLuint next = MESH_NO_VERTEX;
+    GLint best = -1;
+    GLint priority;
+
+    /* Prefer the oldest candidate that stays cached while its triangles are emitted */
+    for(i=0;i<numOfCandidates;i++)
+    {
+        vertex = candidates[i];
+        if (live[vertex] > 0)
+        {
+            priority = 0;
+            if (time - cacheTime[vertex] + (2 * live[vertex]) <= cacheSize)
+            {
+                priority = time - cacheTime[vertex];
+            }
+
+            if (priority > best)
+            {
+                best = priority;
+                next = vertex;
+            }
+        }
+    }
+
+    if (next != MESH_NO_VERTEX)
+    {
+        return next;
+    }
+
+    /* Dead end, go back to a recently used vertex with triangles left */
+    while (*deadEndCount != 0)
+    {
+        vertex = deadEnd[--(*deadEndCount)];
+        if (live[vertex] > 0)
+        {
+            return vertex;
+        }
+    }
+
+    /* Otherwise continue with the next vertex in input order */
+    while (*cursor < vertexCount)
+    {
+        if (live[*cursor] > 0)
+        {
+            return *cursor;
+        }
+        (*cursor)++;
+    }
+
+    return MESH_NO_VERTEX;
+}
+
+
+void meshOptimizeVertexCache(GLuint *dest, const GLuint *indices, GLuint indexCount, GLuint vertexCount, GLuint cacheSize)
+{
+    GLuint *live;
+    GLuint *offsets;
+    GLuint *adjacency;
+    GLuint *cacheTime;
+    GLuint *deadEnd;
+    GLuint *candidates;
+    GLubyte *emitted;
+    GLuint numOfTriangles = indexCount / 3;
+    GLuint deadEndCount = 0;
+    GLuint numOfCandidates;
+    GLuint cursor = 0;
+    GLuint time = cacheSize + 1;
+    GLuint i, j, triangle, vertex;
+    GLuint written = 0;
+
+    /* Tipsify, Sander et al. 2007, linear time and close to Forsyth on scanned meshes */
+    live = (GLuint *)calloc(vertexCount, sizeof(GLuint));
+    offsets = (GLuint *)calloc(vertexCount + 1, sizeof(GLuint));
+    adjacency = (GLuint *)malloc(sizeof(GLuint) * (indexCount + 1));
+    cacheTime = (GLuint *)calloc(vertexCount, sizeof(GLuint));
+    deadEnd = (GLuint *)malloc(sizeof(GLuint) * (indexCount + 1));
+    candidates = (GLuint *)malloc(sizeof(GLuint) * (indexCount + 1));
+    emitted = (GLubyte *)calloc(numOfTriangles + 1, sizeof(GLubyte));
+
+    /* Build the vertex to triangle adjacency */
+    for(i=0;i<numOfTriangles*3;i++)
+    {
+        live[indices[i]]++;
+    }
+
+    for(i=0;i<vertexCount;i++)
+    {
+        offsets[i+1] = offsets[i] + live[i];
+    }
+
+    for(i=0;i<numOfTriangles*3;i++)
+    {
+        adjacency[offsets[indices[i]]++] = i / 3;
+    }
+
+    /* The fill above advanced every offset to the start of the next vertex */
+    for(i=vertexCount;i>0;i--)
+    {
+        offsets[i] = offsets[i-1];
+    }
+    offsets[0] = 0;
+
+    vertex = meshGetNextVertex(NULL, 0, live, cacheTime, time, cacheSize, deadEnd, &deadEndCount, &cursor, vertexCount);
+
+    while (vertex != MESH_NO_VERTEX)
+    {
+        numOfCandidates = 0;
+
+        /* Emit every remaining triangle around the fanning vertex */
+        for(i=offsets[vertex];i<offsets[vertex+1];i++)
+        {
+            triangle = adjacency[i];
+            if (emitted[triangle])
+            {
+                continue;
+            }
+
+            for(j=0;j<3;j++)
+            {
+                GLuint corner = indices[(triangle*3)+j];
+
+                dest[written++] = corner;
+                deadEnd[deadEndCount++] = corner;
+                candidates[numOfCandidates++] = corner;
+                live[corner]--;
+
+                if (time - cacheTime[corner] > cacheSize)
+                {
+                    cacheTime[corner] = time;
+                    time++;
+                }
+            }
+
+            emitted[triangle] = 1;
+        }
+
+        vertex = meshGetNextVertex(candidates, numOfCandidates, live, cacheTime, time, cacheSize, deadEnd, &deadEndCount, &cursor, vertexCount);
+    }
+
+    /* Keep any trailing partial triangle as it was */
+    for(i=numOfTriangles*3;i<indexCount;i++)
+    {
+        dest[written++] = indices[i];
+    }
+
+    free(live);
+    free(offsets);
+    free(adjacency);
+    free(cacheTime);
+    free(deadEnd);
+    free(candidates);
+    free(emitted);
+}
+
+
+GLuint meshOptimizeVertexFetchRemap(GLuint *remap, const GLuint *indices, GLuint indexCount, GLuint vertexCount)
+{
+    GLuint i;
+    GLuint next = 0;
+
+    memset(remap, 0xFF, sizeof(GLuint) * vertexCount);
+
+    /* Number vertices in the order the index buffer first touches them */
+    for(i=0;i<indexCount;i++)
+    {
+        if (remap[indices[i]] == MESH_NO_VERTEX)
+        {
+            remap[indices[i]] = next++;
+        }
+    }
+
+    /* Unreferenced vertices go to the end */
+    for(i=0;i<vertexCount;i++)
+    {
+        if (remap[i] == MESH_NO_VERTEX)
+        {
+            remap[i] = next++;
+        }
+    }
+
+    return next;
+}
+
+
+void meshRemapIndices(GLuint *indices, GLuint indexCount, const GLuint *remap)
+{
+    GLuint i;
+
+    for(i=0;i<indexCount;i++)
+    {
+        indices[i] = remap[indices[i]];
+    }
+}
+
+
+void meshRunTasks(threadPool_t *pool, threadTask_f func, meshNormalContext_t *context, GLuint count)
+{
+    meshNormalTask_t *tasks;
+    GLuint numOfTasks = 1;
+    GLuint taskSize, i;
+
+    /* A few tasks per thread evens out uneven ranges */
+    if (pool != NULL)
+    {
+        numOfTasks = pool->numOfThreads * MESH_NORMAL_TASKS_PER_THREAD;
+        while (numOfTasks > 1 && count / numOfTasks < MESH_NORMAL_MIN_TASK_SIZE)
+        {
+            numOfTasks--;
+        }
+    }
+
+    taskSize = (count + numOfTasks - 1) / numOfTasks;
+    tasks = (meshNormalTask_t *)malloc(sizeof(meshNormalTask_t) * numOfTasks);
+
+    for(i=0;i<numOfTasks;i++)
+    {
+        tasks[i].context = context;
+        tasks[i].start = (i * taskSize < count) ? i * taskSize : count;
+        tasks[i].end = (tasks[i].start + taskSize < count) ? tasks[i].start + taskSize : count;
+    }
+
+    if (numOfTasks > 1)
+    {
+        for(i=0;i<numOfTasks;i++)
+        {
+            threadPoolSubmit(pool, func, &tasks[i]);
+        }
+        threadPoolWait(pool);
+    }
+    else
+    {
+        func(&tasks[0]);
+    }
+
+    free(tasks);
+}
+
+
+GLfloat meshCornerAngle(GLfloat cosine)
+{
+    GLfloat x = fabsf(cosine);
+    GLfloat angle;
+
+    /* Abramowitz and Stegun 4.4.45, within 7e-5 radians which is plenty for a weight */
+    x = (x > 1.0f) ? 1.0f : x;
+    angle = sqrtf(1.0f - x) * (1.5707288f + (x * (-0.2121144f + (x * (0.0742610f - (x * 0.0187293f))))));
+
+    return (cosine < 0.0f) ? (GLfloat)M_PI - angle : angle;
+}
+
+
+void meshFaceNormalTask(void *arg)
+{
+    meshNormalTask_t *task = (meshNormalTask_t *)arg;
+    meshNormalContext_t *context = task->context;
+    const GLfloat *p0, *p1, *p2;
+    GLfloat e1[3], e2[3], e3[3], n[3];
+    GLfloat length, inverse;
+    GLfloat *faceNormal;
+    GLfloat *weight;
+    GLuint triangle;
+
+    /* Straight line code the compiler keeps in registers, the loads dominate anyway */
+    for(triangle=task->start;triangle<task->end;triangle++)
+    {
+        p0 = &context->positions[context->indices[(triangle*3)+0]*3];
+        p1 = &context->positions[context->indices[(triangle*3)+1]*3];
+        p2 = &context->positions[context->indices[(triangle*3)+2]*3];
+
+        e1[0] = p1[0] - p0[0];  e1[1] = p1[1] - p0[1];  e1[2] = p1[2] - p0[2];
+        e2[0] = p2[0] - p0[0];  e2[1] = p2[1] - p0[1];  e2[2] = p2[2] - p0[2];
+
+        /* Cross product, its length is twice the triangle area */
+        n[0] = (e1[1] * e2[2]) - (e1[2] * e2[1]);
+        n[1] = (e1[2] * e2[0]) - (e1[0] * e2[2]);
+        n[2] = (e1[0] * e2[1]) - (e1[1] * e2[0]);
+
+        length = sqrtf((n[0] * n[0]) + (n[1] * n[1]) + (n[2] * n[2]));
+        inverse = (length > 0.0f) ? 1.0f / length : 0.0f;
+
+        faceNormal = &context->faceNormals[triangle*3];
+        faceNormal[0] = n[0] * inverse;
+        faceNormal[1] = n[1] * inverse;
+        faceNormal[2] = n[2] * inverse;
+
+        weight = &context->cornerWeights[triangle*3];
+
+        if (context->weighting == MESH_NORMAL_WEIGHT_AREA || length == 0.0f)
+        {
+            weight[0] = weight[1] = weight[2] = 0.5f * length;
+            continue;
+        }
+
+        e3[0] = p2[0] - p1[0];  e3[1] = p2[1] - p1[1];  e3[2] = p2[2] - p1[2];
+
+        /* The three corner angles of a triangle add up to pi */
+        weight[0] = meshCornerAngle(((e1[0] * e2[0]) + (e1[1] * e2[1]) + (e1[2] * e2[2])) /
+                                    sqrtf(((e1[0] * e1[0]) + (e1[1] * e1[1]) + (e1[2] * e1[2])) * ((e2[0] * e2[0]) + (e2[1] * e2[1]) + (e2[2] * e2[2]))));
+        weight[1] = meshCornerAngle(-((e1[0] * e3[0]) + (e1[1] * e3[1]) + (e1[2] * e3[2])) /
+                                    sqrtf(((e1[0] * e1[0]) + (e1[1] * e1[1]) + (e1[2] * e1[2])) * ((e3[0] * e3[0]) + (e3[1] * e3[1]) + (e3[2] * e3[2]))));
+        weight[2] = (GLfloat)M_PI - weight[0] - weight[1];
+        weight[2] = (weight[2] > 0.0f) ? weight[2] : 0.0f;
+    }
+}
+
+
+void meshSumNormals(const meshNormalContext_t *context, GLuint first, GLuint last, const GLfloat *faceNormal, GLfloat *normal)
+{
+    const GLfloat *otherNormal;
+    GLfloat sum[3] = { 0.0f, 0.0f, 0.0f };
+    GLfloat weight, length;
+    GLuint i;
+
+    /* Sum the faces around the vertex that are not across a hard edge */
+    for(i=first;i<last;i++)
+    {
+        otherNormal = &context->faceNormals[(context->adjacency[i]/3)*3];
+
+        if ( GL_TRUE == context->crease &&
+             (faceNormal[0] * otherNormal[0]) + (faceNormal[1] * otherNormal[1]) + (faceNormal[2] * otherNormal[2]) < context->cosCrease )
+        {
+            continue;
+        }
+
+        weight = context->cornerWeights[context->adjacency[i]];
+        sum[0] += otherNormal[0] * weight;
+        sum[1] += otherNormal[1] * weight;
+        sum[2] += otherNormal[2] * weight;
+    }
+
+    length = sqrtf((sum[0] * sum[0]) + (sum[1] * sum[1]) + (sum[2] * sum[2]));
+
+    if (length > 0.0f)
+    {
+        normal[0] = sum[0] / length;
+        normal[1] = sum[1] / length;
+        normal[2] = sum[2] / length;
+    }
+    else if (faceNormal != NULL)
+    {
+        /* Only degenerate faces here, fall back to the face itself */
+        memcpy(normal, faceNormal, sizeof(GLfloat) * 3);
+    }
+    else
+    {
+        normal[0] = normal[1] = normal[2] = 0.0f;
+    }
+}
+
+
+void meshVertexNormalTask(void *arg)
+{
+    meshNormalTask_t *task = (meshNormalTask_t *)arg;
+    meshNormalContext_t *context = task->context;
+    const GLfloat *faceNormal;
+    GLfloat *normal;
+    GLuint vertex, i, k;
+    GLuint first, last, slots;
+
+    for(vertex=task->start;vertex<task->end;vertex++)
+    {
+        first = context->offsets[vertex];
+        last = context->offsets[vertex+1];
+
+        /* Without a crease the whole vertex gets one normal */
+        if ( GL_FALSE == context->crease )
+        {
+            meshSumNormals(context, first, last, NULL, &context->vertexNormals[vertex*3]);
+            context->slotCounts[vertex] = (last > first) ? 1 : 0;
+            continue;
+        }
+
+        slots = 0;
+
+        for(i=first;i<last;i++)
+        {
+            faceNormal = &context->faceNormals[(context->adjacency[i]/3)*3];
+            normal = &context->cornerNormals[i*3];
+
+            meshSumNormals(context, first, last, faceNormal, normal);
+
+            /* Corners that ended up with the same normal share a slot */
+            for(k=first;k<i;k++)
+            {
+                if ( 0 == memcmp(&context->cornerNormals[k*3], normal, sizeof(GLfloat) * 3) )
+                {
+                    break;
+                }
+            }
+
+            context->cornerSlots[i] = (k < i) ? context->cornerSlots[k] : slots++;
+        }
+
+        context->slotCounts[vertex] = slots;
+    }
+}
+
+
+void meshWriteNormalTask(void *arg)
+{
+    meshNormalTask_t *task = (meshNormalTask_t *)arg;
+    meshNormalContext_t *context = task->context;
+    const GLuint *base = context->slotCounts;
+    GLuint vertex, i, slot;
+
+    for(vertex=task->start;vertex<task->end;vertex++)
+    {
+        if ( GL_FALSE == context->crease )
+        {
+            if (context->offsets[vertex+1] > context->offsets[vertex])
+            {
+                memcpy(&context->normals[base[vertex]*3], &context->vertexNormals[vertex*3], sizeof(GLfloat) * 3);
+            }
+            continue;
+        }
+
+        for(i=context->offsets[vertex];i<context->offsets[vertex+1];i++)
+        {
+            slot = base[vertex] + context->cornerSlots[i];
+            context->normalIndices[context->adjacency[i]] = slot;
+            memcpy(&context->normals[slot*3], &context->cornerNormals[i*3], sizeof(GLfloat) * 3);
+        }
+    }
+}
+
+
+void meshWriteNormalIndexTask(void *arg)
+{
+    meshNormalTask_t *task = (meshNormalTask_t *)arg;
+    meshNormalContext_t *context = task->context;
+    GLuint i;
+
+    /* One normal per vertex, the corners simply follow their position */
+    for(i=task->start;i<task->end;i++)
+    {
+        context->normalIndices[i] = context->slotCounts[context->indices[i]];
+    }
+}
+
+
+GLuint meshGenerateNormals(GLfloat *normals, GLuint *normalIndices, const GLfloat *positions, GLuint vertexCount,
+                           const GLuint *indices, GLuint indexCount, meshNormalWeight_e weighting, GLfloat creaseAngle, threadPool_t *pool)
+{
+    meshNormalContext_t context;
+    GLuint numOfTriangles = indexCount / 3;
+    GLuint numOfCorners = numOfTriangles * 3;
+    GLuint vertex, i, count;
+    GLuint numOfNormals = 0;
+
+    memset(&context, 0, sizeof(meshNormalContext_t));
+
+    context.positions = positions;
+    context.indices = indices;
+    context.normals = normals;
+    context.normalIndices = normalIndices;
+    context.weighting = weighting;
+    context.crease = (creaseAngle < MESH_NORMAL_NO_CREASE) ? GL_TRUE : GL_FALSE;
+    context.cosCrease = cosf(creaseAngle * (GLfloat)M_PI / 180.0f);
+
+    context.faceNormals = (GLfloat *)malloc(sizeof(GLfloat) * (numOfCorners + 1));
+    context.cornerWeights = (GLfloat *)malloc(sizeof(GLfloat) * (numOfCorners + 1));
+    context.offsets = (GLuint *)calloc(vertexCount + 2, sizeof(GLuint));
+    context.adjacency = (GLuint *)malloc(sizeof(GLuint) * (numOfCorners + 1));
+    context.slotCounts = (GLuint *)malloc(sizeof(GLuint) * (vertexCount + 1));
+
+    /* Only hard edges need a normal per corner, smooth ones share the vertex normal */
+    if ( GL_TRUE == context.crease )
+    {
+        context.cornerNormals = (GLfloat *)malloc(sizeof(GLfloat) * 3 * (numOfCorners + 1));
+        context.cornerSlots = (GLuint *)malloc(sizeof(GLuint) * (numOfCorners + 1));
+    }
+    else
+    {
+        context.vertexNormals = (GLfloat *)malloc(sizeof(GLfloat) * 3 * (vertexCount + 1));
+    }
+
+    /* Face normals and corner weights, in parallel over the triangles */
+    meshRunTasks(pool, meshFaceNormalTask, &context, numOfTriangles);
+
+    /* Corners around every vertex, counted then filled like a counting sort */
+    for(i=0;i<numOfCorners;i++)
+    {
+        context.offsets[indices[i]+2]++;
+    }
+
+    for(vertex=2;vertex<vertexCount+2;vertex++)
+    {
+        context.offsets[vertex] += context.offsets[vertex-1];
+    }
+
+    /* Filling advances each start by one slot, which leaves offsets[v] at the start of v */
+    for(i=0;i<numOfCorners;i++)
+    {
+        context.adjacency[context.offsets[indices[i]+1]++] = i;
+    }
+
+    /* Vertex normals, each task only writes the corners of its own vertices */
+    meshRunTasks(pool, meshVertexNormalTask, &context, vertexCount);
+
+    /* Turn the slot counts into the first output normal of every vertex */
+    for(vertex=0;vertex<vertexCount;vertex++)
+    {
+        count = context.slotCounts[vertex];
+        context.slotCounts[vertex] = numOfNormals;
+        numOfNormals += count;
+    }
+
+    meshRunTasks(pool, meshWriteNormalTask, &context, vertexCount);
+
+    if ( GL_FALSE == context.crease )
+    {
+        meshRunTasks(pool, meshWriteNormalIndexTask, &context, numOfCorners);
+    }
+
+    free(context.faceNormals);
+    free(context.cornerWeights);
+    free(context.offsets);
+    free(context.adjacency);
+    free(context.slotCounts);
+    free(context.cornerNormals);
+    free(context.cornerSlots);
+    free(context.vertexNormals);
+
+    return numOfNormals;
+}
+
+
+GLuint meshHashFloats(const GLfloat *values, GLuint count)
+{
+    GLuint hash = 2166136261u;
+    GLuint bits, i;
+
+    for(i=0;i<count;i++)
+    {
+        memcpy(&bits, &values[i], sizeof(GLuint));
+        hash = (hash ^ bits) * 16777619u;
+    }
+
+    return hash ^ (hash >> 15);
+}
+
+
+void meshWeldVertices(GLuint *remap, const GLuint *indices, GLuint indexCount, GLuint vertexCount, const GLfloat *positions, const GLfloat *texCoords)
+{
+    GLfloat key[5];
+    GLfloat other[5];
+    GLuint *table;
+    GLuint tableSize, mask, slot, i, v, keySize;
+
+    keySize = (texCoords != NULL) ? 5 : 3;
+
+    /* Open addressed table at most half full, holds the first vertex seen with each value */
+    for(tableSize=1;tableSize<indexCount*2;tableSize*=2);
+    mask = tableSize - 1;
+
+    table = (GLuint *)malloc(sizeof(GLuint) * tableSize);
+    memset(table, 0xFF, sizeof(GLuint) * tableSize);
+    memset(remap, 0xFF, sizeof(GLuint) * vertexCount);
+
+    for(i=0;i<indexCount;i++)
+    {
+        v = indices[i];
+        if (remap[v] != MESH_NO_VERTEX)
+        {
+            continue;
+        }
+
+        memcpy(key, &positions[v*3], sizeof(GLfloat) * 3);
+        if (texCoords != NULL)
+        {
+            memcpy(&key[3], &texCoords[v*2], sizeof(GLfloat) * 2);
+        }
+
+        for(slot=meshHashFloats(key, keySize)&mask; table[slot] != MESH_NO_VERTEX; slot=(slot+1)&mask)
+        {
+            memcpy(other, &positions[table[slot]*3], sizeof(GLfloat) * 3);
+            if (texCoords != NULL)
+            {
+                memcpy(&other[3], &texCoords[table[slot]*2], sizeof(GLfloat) * 2);
+            }
+
+            if ( 0 == memcmp(key, other, sizeof(GLfloat) * keySize) )
+            {
+                break;
+            }
+        }
+
+        if (table[slot] == MESH_NO_VERTEX)
+        {
+            table[slot] = v;
+        }
+
+        remap[v] = table[slot];
+    }
+
+    free(table);
+}
+
+
+void meshQuadricAddPlane(meshQuadric_t *q, const double *n, double d, double weight)
+{
+    q->a2 += weight * n[0] * n[0];
+    q->b2 += weight * n[1] * n[1];
+    q->c2 += weight * n[2] * n[2];
+    q->ab += weight * n[0] * n[1];
+    q->ac += weight * n[0] * n[2];
+    q->bc += weight * n[1] * n[2];
+    q->ad += weight * n[0] * d;
+    q->bd += weight * n[1] * d;
+    q->cd += weight * n[2] * d;
+    q->d2 += weight * d * d;
+    q->weight += weight;
+}
+
+
+void meshQuadricAdd(meshQuadric_t *dest, const meshQuadric_t *src)
+{
+    dest->a2 += src->a2;
+    dest->b2 += src->b2;
+    dest->c2 += src->c2;
+    dest->ab += src->ab;
+    dest->ac += src->ac;
+    dest->bc += src->bc;
+    dest->ad += src->ad;
+    dest->bd += src->bd;
+    dest->cd += src->cd;
+    dest->d2 += src->d2;
+    dest->weight += src->weight;
+}
+
+
+double meshQuadricError(const meshQuadric_t *a, const meshQuadric_t *b, const GLfloat *p)
+{
+    double x = p[0], y = p[1], z = p[2];
+    double weight = a->weight + b->weight;
+    double error;
+
+    /* Mean squared distance of p to the planes of both quadrics */
+    error = ((a->a2 + b->a2) * x * x) + ((a->b2 + b->b2) * y * y) + ((a->c2 + b->c2) * z * z) +
+            2.0 * (((a->ab + b->ab) * x * y) + ((a->ac + b->ac) * x * z) + ((a->bc + b->bc) * y * z)) +
+            2.0 * (((a->ad + b->ad) * x) + ((a->bd + b->bd) * y) + ((a->cd + b->cd) * z)) + (a->d2 + b->d2);
+
+    return (weight > 0.0 && error > 0.0) ? error / weight : 0.0;
+}
+
+
+void meshTriangleNormal(const GLfloat *p0, const GLfloat *p1, const GLfloat *p2, double *n)
+{
+    double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+    double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+
+    n[0] = (e1[1] * e2[2]) - (e1[2] * e2[1]);
+    n[1] = (e1[2] * e2[0]) - (e1[0] * e2[2]);
+    n[2] = (e1[0] * e2[1]) - (e1[1] * e2[0]);
+}
+
+
+const GLfloat *meshGetPosition(const meshSimplifyContext_t *context, GLuint wedge)
+{
+    return &context->positions[context->positionOf[wedge]*3];
+}
+
+
+void meshBuildAdjacency(meshSimplifyContext_t *context)
+{
+    GLuint i, v;
+
+    memset(context->offsets, 0, sizeof(GLuint) * (context->vertexCount + 2));
+    memset(context->wedgeHead, 0xFF, sizeof(GLuint) * context->vertexCount);
+
+    /* Counting sort of the corners by wedge, like the normal generator */
+    for(i=0;i<context->indexCount;i++)
+    {
+        context->offsets[context->indices[i]+2]++;
+    }
+
+    for(v=2;v<context->vertexCount+2;v++)
+    {
+        context->offsets[v] += context->offsets[v-1];
+    }
+
+    for(i=0;i<context->indexCount;i++)
+    {
+        context->adjacency[context->offsets[context->indices[i]+1]++] = i / 3;
+    }
+
+    /* Wedges still in use, listed under their position */
+    for(v=0;v<context->vertexCount;v++)
+    {
+        if (context->offsets[v+1] > context->offsets[v])
+        {
+            context->wedgeNext[v] = context->wedgeHead[context->positionOf[v]];
+            context->wedgeHead[context->positionOf[v]] = v;
+        }
+    }
+}
+
+
+GLuint meshCountEdgeTriangles(const meshSimplifyContext_t *context, GLuint from, GLuint to, GLuint *sameDirection)
+{
+    const GLuint *tri;
+    GLuint w, t, k, count = 0;
+
+    *sameDirection = 0;
+
+    /* Triangles with an edge between the two positions, and how many of them run from -> to */
+    for(w=context->wedgeHead[from];w!=MESH_NO_VERTEX;w=context->wedgeNext[w])
+    {
+        for(t=context->offsets[w];t<context->offsets[w+1];t++)
+        {
+            tri = &context->indices[context->adjacency[t]*3];
+
+            for(k=0;k<3;k++)
+            {
+                if (tri[k] == w && context->positionOf[tri[(k+1)%3]] == to)
+                {
+                    count++;
+                    (*sameDirection)++;
+                }
+                else if (tri[k] == w && context->positionOf[tri[(k+2)%3]] == to)
+                {
+                    count++;
+                }
+            }
+        }
+    }
+
+    return count;
+}
+
+
+GLboolean meshHasWedgeEdge(const meshSimplifyContext_t *context, GLuint from, GLuint to)
+{
+    const GLuint *tri;
+    GLuint t, k;
+
+    /* Directed edge between two wedges */
+    for(t=context->offsets[from];t<context->offsets[from+1];t++)
+    {
+        tri = &context->indices[context->adjacency[t]*3];
+
+        for(k=0;k<3;k++)
+        {
+            if (tri[k] == from && tri[(k+1)%3] == to)
+            {
+                return GL_TRUE;
+            }
+        }
+    }
+
+    return GL_FALSE;
+}
+
+
+void meshClassifyPositions(meshSimplifyContext_t *context, GLboolean addQuadrics)
+{
+    const GLfloat *p[3];
+    const GLuint *tri;
+    double n[3], e[3], m[3], length, area;
+    GLuint i, k, a, b, pa, pb, count, sameDirection;
+
+    memset(context->locked, 0, sizeof(GLubyte) * context->vertexCount);
+
+    for(i=0;i<context->indexCount;i+=3)
+    {
+        tri = &context->indices[i];
+
+        /* Every edge of a closed two-manifold has two triangles running opposite ways */
+        for(k=0;k<3;k++)
+        {
+            pa = context->positionOf[tri[k]];
+            pb = context->positionOf[tri[(k+1)%3]];
+
+            count = meshCountEdgeTriangles(context, pa, pb, &sameDirection);
+            if (count != 2 || sameDirection != 1)
+            {
+                context->locked[pa] = 1;
+                context->locked[pb] = 1;
+            }
+        }
+
+        if ( GL_FALSE == addQuadrics )
+        {
+            continue;
+        }
+
+        p[0] = meshGetPosition(context, tri[0]);
+        p[1] = meshGetPosition(context, tri[1]);
+        p[2] = meshGetPosition(context, tri[2]);
+        meshTriangleNormal(p[0], p[1], p[2], n);
+
+        length = sqrt((n[0] * n[0]) + (n[1] * n[1]) + (n[2] * n[2]));
+        if (length <= 0.0)
+        {
+            continue;
+        }
+
+        /* Plane of the face weighted by its area */
+        area = length * 0.5;
+        n[0] /= length;
+        n[1] /= length;
+        n[2] /= length;
+
+        for(k=0;k<3;k++)
+        {
+            meshQuadricAddPlane(&context->quadrics[context->positionOf[tri[k]]], n,
+                                -((n[0] * p[0][0]) + (n[1] * p[0][1]) + (n[2] * p[0][2])), area);
+        }
+
+        /* Seam edges, no twin between the wedges although the positions have one */
+        for(k=0;k<3;k++)
+        {
+            a = tri[k];
+            b = tri[(k+1)%3];
+
+            if ( GL_TRUE == meshHasWedgeEdge(context, b, a) )
+            {
+                continue;
+            }
+
+            e[0] = p[(k+1)%3][0] - p[k][0];
+            e[1] = p[(k+1)%3][1] - p[k][1];
+            e[2] = p[(k+1)%3][2] - p[k][2];
+
+            m[0] = (e[1] * n[2]) - (e[2] * n[1]);
+            m[1] = (e[2] * n[0]) - (e[0] * n[2]);
+            m[2] = (e[0] * n[1]) - (e[1] * n[0]);
+
+            length = sqrt((m[0] * m[0]) + (m[1] * m[1]) + (m[2] * m[2]));
+            if (length <= 0.0)
+            {
+                continue;
+            }
+
+            m[0] /= length;
+            m[1] /= length;
+            m[2] /= length;
+
+            area = MESH_SIMPLIFY_SEAM_WEIGHT * ((e[0] * e[0]) + (e[1] * e[1]) + (e[2] * e[2]));
+            meshQuadricAddPlane(&context->quadrics[context->positionOf[a]], m, -((m[0] * p[k][0]) + (m[1] * p[k][1]) + (m[2] * p[k][2])), area);
+            meshQuadricAddPlane(&context->quadrics[context->positionOf[b]], m, -((m[0] * p[k][0]) + (m[1] * p[k][1]) + (m[2] * p[k][2])), area);
+        }
+    }
+}
+
+
+GLboolean meshCheckCollapse(meshSimplifyContext_t *context, GLuint from, GLuint to, GLuint *removed)
+{
+    const GLuint *tri;
+    const GLfloat *p[3];
+    GLfloat moved[3];
+    double before[3], after[3], dot, lengths;
+    GLuint w, t, k, target, common = 0, shared = 0;
+    GLboolean hasTo;
+
+    /* Each wedge moves onto the one wedge of the other position its triangles reach, a seam moves along itself */
+    for(w=context->wedgeHead[from];w!=MESH_NO_VERTEX;w=context->wedgeNext[w])
+    {
+        target = MESH_NO_VERTEX;
+
+        for(t=context->offsets[w];t<context->offsets[w+1];t++)
+        {
+            tri = &context->indices[context->adjacency[t]*3];
+
+            for(k=0;k<3;k++)
+            {
+                if (context->positionOf[tri[k]] != to)
+                {
+                    continue;
+                }
+
+                if (target != MESH_NO_VERTEX && target != tri[k])
+                {
+                    return GL_FALSE;
+                }
+                target = tri[k];
+            }
+        }
+
+        if (target == MESH_NO_VERTEX)
+        {
+            return GL_FALSE;
+        }
+
+        context->collapseTo[w] = target;
+    }
+
+    /* Neighbors of both ends, only the two across the edge may be shared or the surface folds */
+    context->stamp += 2;
+    for(w=context->wedgeHead[from];w!=MESH_NO_VERTEX;w=context->wedgeNext[w])
+    {
+        for(t=context->offsets[w];t<context->offsets[w+1];t++)
+        {
+            tri = &context->indices[context->adjacency[t]*3];
+            for(k=0;k<3;k++)
+            {
+                context->marks[context->positionOf[tri[k]]] = context->stamp;
+            }
+        }
+    }
+
+    for(w=context->wedgeHead[to];w!=MESH_NO_VERTEX;w=context->wedgeNext[w])
+    {
+        for(t=context->offsets[w];t<context->offsets[w+1];t++)
+        {
+            tri = &context->indices[context->adjacency[t]*3];
+            for(k=0;k<3;k++)
+            {
+                if (context->marks[context->positionOf[tri[k]]] == context->stamp &&
+                    context->positionOf[tri[k]] != from && context->positionOf[tri[k]] != to)
+                {
+                    context->marks[context->positionOf[tri[k]]] = context->stamp + 1;
+                    common++;
+                }
+            }
+        }
+    }
+
+    /* Triangles that stay must not flip or turn too far */
+    memcpy(moved, &context->positions[to*3], sizeof(moved));
+
+    for(w=context->wedgeHead[from];w!=MESH_NO_VERTEX;w=context->wedgeNext[w])
+    {
+        for(t=context->offsets[w];t<context->offsets[w+1];t++)
+        {
+            tri = &context->indices[context->adjacency[t]*3];
+            hasTo = GL_FALSE;
+
+            for(k=0;k<3;k++)
+            {
+                p[k] = meshGetPosition(context, tri[k]);
+                hasTo = (context->positionOf[tri[k]] == to) ? GL_TRUE : hasTo;
+            }
+
+            if ( GL_TRUE == hasTo )
+            {
+                shared++;
+                continue;
+            }
+
+            meshTriangleNormal(p[0], p[1], p[2], before);
+            for(k=0;k<3;k++)
+            {
+                p[k] = (tri[k] == w) ? moved : p[k];
+            }
+            meshTriangleNormal(p[0], p[1], p[2], after);
+
+            dot = (before[0] * after[0]) + (before[1] * after[1]) + (before[2] * after[2]);
+            lengths = sqrt(((before[0] * before[0]) + (before[1] * before[1]) + (before[2] * before[2])) *
+                           ((after[0] * after[0]) + (after[1] * after[1]) + (after[2] * after[2])));
+
+            if (lengths <= 0.0 || dot < MESH_SIMPLIFY_MIN_NORMAL_DOT * lengths)
+            {
+                return GL_FALSE;
+            }
+        }
+    }
+
+    if (common != shared)
+    {
+        return GL_FALSE;
+    }
+
+    *removed = shared;
+
+    return GL_TRUE;
+}
+
+
+int meshCompareCollapses(const void *a, const void *b)
+{
+    const meshCollapse_t *collapseA = (const meshCollapse_t *)a;
+    const meshCollapse_t *collapseB = (const meshCollapse_t *)b;
+
+    if (collapseA->error != collapseB->error)
+    {
+        return (collapseA->error < collapseB->error) ? -1 : 1;
+    }
+
+    return (collapseA->from < collapseB->from) ? -1 : ((collapseA->from > collapseB->from) ? 1 : 0);
+}
+
+
+GLuint meshCollectCollapses(meshSimplifyContext_t *context, meshCollapse_t *collapses)
+{
+    const GLuint *tri;
+    GLuint i, k, pa, pb, count = 0;
+
+    /* Both directions of every edge, seen once from the triangle that runs low to high */
+    for(i=0;i<context->indexCount;i+=3)
+    {
+        tri = &context->indices[i];
+
+        for(k=0;k<3;k++)
+        {
+            pa = context->positionOf[tri[k]];
+            pb = context->positionOf[tri[(k+1)%3]];
+
+            if (pa > pb)
+            {
+                continue;
+            }
+
+            if (0 == context->locked[pa])
+            {
+                collapses[count].from = pa;
+                collapses[count].to = pb;
+                collapses[count].error = (GLfloat)meshQuadricError(&context->quadrics[pa], &context->quadrics[pb], &context->positions[pb*3]);
+                count++;
+            }
+
+            if (0 == context->locked[pb])
+            {
+                collapses[count].from = pb;
+                collapses[count].to = pa;
+                collapses[count].error = (GLfloat)meshQuadricError(&context->quadrics[pb], &context->quadrics[pa], &context->positions[pa*3]);
+                count++;
+            }
+        }
+    }
+
+    qsort(collapses, count, sizeof(meshCollapse_t), meshCompareCollapses);
+
+    return count;
+}
+
+
+GLuint meshApplyCollapses(meshSimplifyContext_t *context)
+{
+    GLuint *tri;
+    GLuint i, k, count = 0;
+
+    /* Move the collapsed wedges, triangles across a collapsed edge are gone */
+    for(i=0;i<context->indexCount;i+=3)
+    {
+        tri = &context->indices[i];
+
+        for(k=0;k<3;k++)
+        {
+            tri[k] = (context->collapseTo[tri[k]] != MESH_NO_VERTEX) ? context->collapseTo[tri[k]] : tri[k];
+        }
+
+        if (context->positionOf[tri[0]] == context->positionOf[tri[1]] || context->positionOf[tri[1]] == context->positionOf[tri[2]] ||
+            context->positionOf[tri[0]] == context->positionOf[tri[2]])
+        {
+            continue;
+        }
+
+        memmove(&context->indices[count], tri, sizeof(GLuint) * 3);
+        memmove(&context->corners[count], &context->corners[i], sizeof(GLuint) * 3);
+        count += 3;
+    }
+
+    context->indexCount = count;
+
+    return count;
+}
+
+
+GLuint meshPickCorner(GLuint wedge, GLuint corner, const GLuint *wedgeOf, const GLuint *wedgeMembers, const GLuint *memberNext, const GLfloat *normals)
+{
+    GLuint v, best = wedge;
+    GLfloat dot, bestDot = -2.0f;
+
+    /* A moved corner keeps the wedge's texcoord, the normal closest to its old one if normals differ within it */
+    if (wedgeOf[corner] == wedge || normals == NULL)
+    {
+        return (wedgeOf[corner] == wedge) ? corner : wedge;
+    }
+
+    for(v=wedgeMembers[wedge];v!=MESH_NO_VERTEX;v=memberNext[v])
+    {
+        dot = (normals[v*3] * normals[corner*3]) + (normals[v*3+1] * normals[corner*3+1]) + (normals[v*3+2] * normals[corner*3+2]);
+        if (dot > bestDot)
+        {
+            bestDot = dot;
+            best = v;
+        }
+    }
+
+    return best;
+}
+
+
+GLuint meshSimplify(GLuint *dest, const GLuint *indices, GLuint indexCount, const GLfloat *positions, const GLfloat *texCoords,
+                    const GLfloat *normals, GLuint vertexCount, GLuint targetIndexCount, GLfloat maxError, GLfloat *resultError)
+{
+    meshSimplifyContext_t context;
+    meshCollapse_t *collapses;
+    GLuint *wedgeMembers;
+    GLuint *memberNext;
+    GLuint numOfCollapses, removed, needed, pass, i, k, w;
+    GLuint collapsed;
+    GLfloat limit = maxError * maxError;
+
+    *resultError = 0.0f;
+
+    memset(&context, 0, sizeof(meshSimplifyContext_t));
+    context.positions = positions;
+    context.vertexCount = vertexCount;
+
+    context.wedgeOf = (GLuint *)malloc(sizeof(GLuint) * (vertexCount + 1));
+    context.positionOf = (GLuint *)malloc(sizeof(GLuint) * (vertexCount + 1));
+    context.wedgeHead = (GLuint *)malloc(sizeof(GLuint) * (vertexCount + 1));
+    context.wedgeNext = (GLuint *)malloc(sizeof(GLuint) * (vertexCount + 1));
+    context.offsets = (GLuint *)malloc(sizeof(GLuint) * (vertexCount + 2));
+    context.adjacency = (GLuint *)malloc(sizeof(GLuint) * (indexCount + 1));
+    context.indices = (GLuint *)malloc(sizeof(GLuint) * (indexCount + 1));
+    context.corners = (GLuint *)malloc(sizeof(GLuint) * (indexCount + 1));
+    context.quadrics = (meshQuadric_t *)calloc(vertexCount + 1, sizeof(meshQuadric_t));
+    context.locked = (GLubyte *)malloc(sizeof(GLubyte) * (vertexCount + 1));
+    context.touched = (GLubyte *)malloc(sizeof(GLubyte) * (vertexCount + 1));
+    context.marks = (GLuint *)calloc(vertexCount + 1, sizeof(GLuint));
+    context.collapseTo = (GLuint *)malloc(sizeof(GLuint) * (vertexCount + 1));
+    collapses = (meshCollapse_t *)malloc(sizeof(meshCollapse_t) * (indexCount * 2 + 1));
+    wedgeMembers = (GLuint *)malloc(sizeof(GLuint) * (vertexCount + 1));
+    memberNext = (GLuint *)malloc(sizeof(GLuint) * (vertexCount + 1));
+
+    /* Wedges share position and texcoord, normals only pick the corner at the end */
+    meshWeldVertices(context.wedgeOf, indices, indexCount, vertexCount, positions, texCoords);
+    meshWeldVertices(context.positionOf, indices, indexCount, vertexCount, positions, NULL);
+
+    memset(wedgeMembers, 0xFF, sizeof(GLuint) * vertexCount);
+    memset(memberNext, 0xFF, sizeof(GLuint) * vertexCount);
+    memset(context.collapseTo, 0xFF, sizeof(GLuint) * vertexCount);
+
+    for(i=0;i<indexCount;i++)
+    {
+        w = context.wedgeOf[indices[i]];
+        if (context.collapseTo[indices[i]] == MESH_NO_VERTEX)
+        {
+            context.collapseTo[indices[i]] = 0;
+            memberNext[indices[i]] = wedgeMembers[w];
+            wedgeMembers[w] = indices[i];
+        }
+    }
+
+    /* Triangles already degenerate in position are dropped */
+    for(i=0;i<indexCount;i+=3)
+    {
+        for(k=0;k<3;k++)
+        {
+            context.indices[context.indexCount+k] = context.wedgeOf[indices[i+k]];
+            context.corners[context.indexCount+k] = indices[i+k];
+        }
+
+        if (context.positionOf[context.indices[context.indexCount]] != context.positionOf[context.indices[context.indexCount+1]] &&
+            context.positionOf[context.indices[context.indexCount+1]] != context.positionOf[context.indices[context.indexCount+2]] &&
+            context.positionOf[context.indices[context.indexCount]] != context.positionOf[context.indices[context.indexCount+2]])
+        {
+            context.indexCount += 3;
+        }
+    }
+
+    meshBuildAdjacency(&context);
+    meshClassifyPositions(&context, GL_TRUE);
+
+    /* Passes of independent collapses, cheapest first, until the target or the error limit */
+    for(pass=0;pass<MESH_SIMPLIFY_MAX_PASSES && context.indexCount > targetIndexCount;pass++)
+    {
+        numOfCollapses = meshCollectCollapses(&context, collapses);
+        needed = (context.indexCount - targetIndexCount) / 3;
+        removed = 0;
+        collapsed = 0;
+
+        memset(context.touched, 0, sizeof(GLubyte) * vertexCount);
+        memset(context.collapseTo, 0xFF, sizeof(GLuint) * vertexCount);
+
+        for(i=0;i<numOfCollapses && removed < needed;i++)
+        {
+            if (collapses[i].error > limit)
+            {
+                break;
+            }
+
+            if (context.touched[collapses[i].from] || context.touched[collapses[i].to])
+            {
+                continue;
+            }
+
+            if ( GL_FALSE == meshCheckCollapse(&context, collapses[i].from, collapses[i].to, &k) )
+            {
+                for(w=context.wedgeHead[collapses[i].from];w!=MESH_NO_VERTEX;w=context.wedgeNext[w])
+                {
+                    context.collapseTo[w] = MESH_NO_VERTEX;
+                }
+                continue;
+            }
+
+            /* The neighbors' triangles change, they wait for the next pass */
+            for(w=context.wedgeHead[collapses[i].from];w!=MESH_NO_VERTEX;w=context.wedgeNext[w])
+            {
+                for(k=context.offsets[w];k<context.offsets[w+1];k++)
+                {
+                    context.touched[context.positionOf[context.indices[context.adjacency[k]*3]]] = 1;
+                    context.touched[context.positionOf[context.indices[context.adjacency[k]*3+1]]] = 1;
+                    context.touched[context.positionOf[context.indices[context.adjacency[k]*3+2]]] = 1;
+                }
+            }
+
+            meshQuadricAdd(&context.quadrics[collapses[i].to], &context.quadrics[collapses[i].from]);
+            *resultError = (collapses[i].error > *resultError) ? collapses[i].error : *resultError;
+            removed += 2;
+            collapsed++;
+        }
+
+        if (collapsed == 0)
+        {
+            break;
+        }
+
+        meshApplyCollapses(&context);
+        meshBuildAdjacency(&context);
+        meshClassifyPositions(&context, GL_FALSE);
+    }
+
+    for(i=0;i<context.indexCount;i++)
+    {
+        dest[i] = meshPickCorner(context.indices[i], context.corners[i], context.wedgeOf, wedgeMembers, memberNext, normals);
+    }
+
+    *resultError = sqrtf(*resultError);
+
+    free(context.wedgeOf);
+    free(context.positionOf);
+    free(context.wedgeHead);
+    free(context.wedgeNext);
+    free(context.offsets);
+    free(context.adjacency);
+    free(context.indices);
+    free(context.corners);
+    free(context.quadrics);
+    free(context.locked);
+    free(context.touched);
+    free(context.marks);
+    free(context.collapseTo);
+    free(collapses);
+    free(wedgeMembers);
+    free(memberNext);
+
+    return context.indexCount;
+}
+
+
+void meshFinishCluster(meshCluster_t *cluster, const GLuint *indices, const GLfloat *positions)
+{
+    const GLfloat *p;
+    GLfloat minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    GLfloat maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    GLfloat normal[3], distance, length, dot, minDot = 1.0f;
+    double n[3];
+    GLuint i, k;
+
+    /* Sphere around the middle of the box */
+    for(i=cluster->firstIndex;i<cluster->firstIndex+cluster->indexCount;i++)
+    {
+        p = &positions[indices[i]*3];
+        for(k=0;k<3;k++)
+        {
+            minimum[k] = (p[k] < minimum[k]) ? p[k] : minimum[k];
+            maximum[k] = (p[k] > maximum[k]) ? p[k] : maximum[k];
+        }
+    }
+
+    cluster->radius = 0.0f;
+    for(k=0;k<3;k++)
+    {
+        cluster->center[k] = (minimum[k] + maximum[k]) * 0.5f;
+    }
+
+    for(i=cluster->firstIndex;i<cluster->firstIndex+cluster->indexCount;i++)
+    {
+        p = &positions[indices[i]*3];
+        distance = sqrtf(((p[0] - cluster->center[0]) * (p[0] - cluster->center[0])) + ((p[1] - cluster->center[1]) * (p[1] - cluster->center[1])) +
+                         ((p[2] - cluster->center[2]) * (p[2] - cluster->center[2])));
+        cluster->radius = (distance > cluster->radius) ? distance : cluster->radius;
+    }
+
+    /* Cone around the mean face normal through the widest face */
+    memset(cluster->axis, 0, sizeof(cluster->axis));
+    for(i=cluster->firstIndex;i<cluster->firstIndex+cluster->indexCount;i+=3)
+    {
+        meshTriangleNormal(&positions[indices[i]*3], &positions[indices[i+1]*3], &positions[indices[i+2]*3], n);
+        length = (GLfloat)sqrt((n[0] * n[0]) + (n[1] * n[1]) + (n[2] * n[2]));
+        if (length > 0.0f)
+        {
+            for(k=0;k<3;k++)
+            {
+                cluster->axis[k] += (GLfloat)n[k] / length;
+            }
+        }
+    }
+
+    length = sqrtf((cluster->axis[0] * cluster->axis[0]) + (cluster->axis[1] * cluster->axis[1]) + (cluster->axis[2] * cluster->axis[2]));
+    cluster->cutoff = MESH_CLUSTER_NO_CONE;
+    if (length <= 0.0f)
+    {
+        return;
+    }
+
+    for(k=0;k<3;k++)
+    {
+        cluster->axis[k] /= length;
+    }
+
+    for(i=cluster->firstIndex;i<cluster->firstIndex+cluster->indexCount;i+=3)
+    {
+        meshTriangleNormal(&positions[indices[i]*3], &positions[indices[i+1]*3], &positions[indices[i+2]*3], n);
+        length = (GLfloat)sqrt((n[0] * n[0]) + (n[1] * n[1]) + (n[2] * n[2]));
+        if (length > 0.0f)
+        {
+            normal[0] = (GLfloat)n[0] / length;
+            normal[1] = (GLfloat)n[1] / length;
+            normal[2] = (GLfloat)n[2] / length;
+            dot = (normal[0] * cluster->axis[0]) + (normal[1] * cluster->axis[1]) + (normal[2] * cluster->axis[2]);
+            minDot = (dot < minDot) ? dot : minDot;
+        }
+    }
+
+    if (minDot > MESH_CLUSTER_MIN_CONE_DOT)
+    {
+        cluster->cutoff = sqrtf(1.0f - (minDot * minDot));
+    }
+}
+
+
+GLuint meshFindClusterTriangle(const meshClusterContext_t *context, const GLuint *vertices, GLuint numOfVertices, const GLfloat *axis,
+                               GLuint numOfTriangles, GLuint room)
+{
+    const GLuint *tri;
+    GLuint i, j, k, t, newVertices, best = MESH_NO_VERTEX;
+    GLfloat dot, score, bestScore = FLT_MAX;
+
+    /* Triangles touching the cluster, fewest new vertices and closest to its mean normal first */
+    for(i=0;i<numOfVertices;i++)
+    {
+        for(j=context->offsets[vertices[i]];j<context->offsets[vertices[i]+1];j++)
+        {
+            t = context->adjacency[j];
+            if (context->emitted[t] != 0)
+            {
+                continue;
+            }
+
+            tri = &context->indices[t*3];
+            newVertices = 0;
+            for(k=0;k<3;k++)
+            {
+                newVertices += (context->marks[context->positionOf[tri[k]]] != context->stamp) ? 1 : 0;
+            }
+
+            dot = (context->normals[t*3] * axis[0]) + (context->normals[t*3+1] * axis[1]) + (context->normals[t*3+2] * axis[2]);
+            if (newVertices > room || (numOfTriangles >= MESH_CLUSTER_MIN_TRIANGLES && dot < MESH_CLUSTER_MIN_NORMAL_DOT))
+            {
+                continue;
+            }
+
+            score = (GLfloat)newVertices + ((1.0f - dot) * MESH_CLUSTER_CONE_WEIGHT);
+            if (score < bestScore)
+            {
+                bestScore = score;
+                best = t;
+            }
+        }
+    }
+
+    return best;
+}
+
+
+GLuint meshGrowCluster(meshClusterContext_t *context, meshCluster_t *cluster, GLuint *dest, GLuint seed, GLuint maxTriangles, GLuint maxVertices)
+{
+    GLuint numOfVertices = 0;
+    GLuint t, k, v;
+    GLfloat sum[3] = { 0.0f, 0.0f, 0.0f };
+    GLfloat axis[3] = { 0.0f, 0.0f, 0.0f };
+    GLfloat length;
+
+    context->stamp++;
+    cluster->indexCount = 0;
+
+    for(t=seed;t!=MESH_NO_VERTEX;t=meshFindClusterTriangle(context, context->vertices, numOfVertices, axis, cluster->indexCount / 3, maxVertices - numOfVertices))
+    {
+        context->emitted[t] = 1;
+
+        for(k=0;k<3;k++)
+        {
+            v = context->positionOf[context->indices[t*3+k]];
+            if (context->marks[v] != context->stamp)
+            {
+                context->marks[v] = context->stamp;
+                context->vertices[numOfVertices++] = v;
+            }
+
+            dest[cluster->firstIndex + cluster->indexCount + k] = context->indices[t*3+k];
+            sum[k] += context->normals[t*3+k];
+        }
+
+        cluster->indexCount += 3;
+
+        if (cluster->indexCount / 3 >= maxTriangles || numOfVertices >= maxVertices)
+        {
+            break;
+        }
+
+        /* Candidates are scored against the unit mean normal so far */
+        length = sqrtf((sum[0] * sum[0]) + (sum[1] * sum[1]) + (sum[2] * sum[2]));
+        for(k=0;k<3;k++)
+        {
+            axis[k] = (length > 0.0f) ? sum[k] / length : 0.0f;
+        }
+    }
+
+    return cluster->indexCount;
+}
+
+
+void meshOptimizeCluster(meshClusterContext_t *context, GLuint *indices, GLuint indexCount)
+{
+    GLuint i, numOfLocal = 0;
+
+    /* Small vertex numbers keep the optimizer's per vertex state to the cluster */
+    for(i=0;i<indexCount;i++)
+    {
+        if (context->localOf[indices[i]] == MESH_NO_VERTEX)
+        {
+            context->localOf[indices[i]] = numOfLocal;
+            context->globalOf[numOfLocal++] = indices[i];
+        }
+
+        context->local[i] = context->localOf[indices[i]];
+    }
+
+    meshOptimizeVertexCache(context->optimized, context->local, indexCount, numOfLocal, MESH_VERTEX_CACHE_SIZE);
+
+    for(i=0;i<indexCount;i++)
+    {
+        indices[i] = context->globalOf[context->optimized[i]];
+    }
+
+    for(i=0;i<numOfLocal;i++)
+    {
+        context->localOf[context->globalOf[i]] = MESH_NO_VERTEX;
+    }
+}
+
+
+GLuint meshBuildClusters(meshCluster_t *clusters, GLuint *dest, const GLuint *indices, GLuint indexCount, const GLfloat *positions, GLuint vertexCount,
+                         GLuint maxTriangles, GLuint maxVertices)
+{
+    meshClusterContext_t context;
+    GLuint numOfTriangles = indexCount / 3;
+    GLuint i, k, v, t, seed, written = 0, count = 0;
+    GLfloat length;
+    double n[3];
+
+    context.indices = indices;
+    context.positionOf = (GLuint *)malloc(sizeof(GLuint) * (vertexCount + 1));
+    context.offsets = (GLuint *)calloc(vertexCount + 2, sizeof(GLuint));
+    context.adjacency = (GLuint *)malloc(sizeof(GLuint) * (indexCount + 1));
+    context.normals = (GLfloat *)malloc(sizeof(GLfloat) * (indexCount + 1));
+    context.emitted = (GLubyte *)calloc(numOfTriangles + 1, sizeof(GLubyte));
+    context.marks = (GLuint *)calloc(vertexCount + 1, sizeof(GLuint));
+    context.vertices = (GLuint *)malloc(sizeof(GLuint) * (maxVertices + 1));
+    context.stamp = 0;
+
+    context.localOf = (GLuint *)malloc(sizeof(GLuint) * (vertexCount + 1));
+    context.globalOf = (GLuint *)malloc(sizeof(GLuint) * (maxTriangles * 3 + 1));
+    context.local = (GLuint *)malloc(sizeof(GLuint) * (maxTriangles * 3 + 1));
+    context.optimized = (GLuint *)malloc(sizeof(GLuint) * (maxTriangles * 3 + 1));
+
+    if (context.positionOf != NULL && context.offsets != NULL && context.adjacency != NULL && context.normals != NULL &&
+        context.emitted != NULL && context.marks != NULL && context.vertices != NULL && context.localOf != NULL &&
+        context.globalOf != NULL && context.local != NULL && context.optimized != NULL)
+    {
+        memset(context.localOf, 0xFF, sizeof(GLuint) * vertexCount);
+
+        meshWeldVertices(context.positionOf, indices, indexCount, vertexCount, positions, NULL);
+
+        /* Triangles around every position, counting sort like the normal generator */
+        for(i=0;i<indexCount;i++)
+        {
+            context.offsets[context.positionOf[indices[i]]+2]++;
+        }
+
+        for(v=2;v<vertexCount+2;v++)
+        {
+            context.offsets[v] += context.offsets[v-1];
+        }
+
+        for(i=0;i<indexCount;i++)
+        {
+            context.adjacency[context.offsets[context.positionOf[indices[i]]+1]++] = i / 3;
+        }
+
+        for(t=0;t<numOfTriangles;t++)
+        {
+            meshTriangleNormal(&positions[indices[t*3]*3], &positions[indices[t*3+1]*3], &positions[indices[t*3+2]*3], n);
+            length = (GLfloat)sqrt((n[0] * n[0]) + (n[1] * n[1]) + (n[2] * n[2]));
+            for(k=0;k<3;k++)
+            {
+                context.normals[t*3+k] = (length > 0.0f) ? (GLfloat)n[k] / length : 0.0f;
+            }
+        }
+
+        /* Each cluster grows from the first triangle left in the old order, which keeps the clusters near the cache order */
+        for(seed=0;seed<numOfTriangles;seed++)
+        {
+            if (context.emitted[seed] != 0)
+            {
+                continue;
+            }
+
+            clusters[count].firstIndex = written;
+            written += meshGrowCluster(&context, &clusters[count], dest, seed, maxTriangles, maxVertices);
+            meshOptimizeCluster(&context, &dest[clusters[count].firstIndex], clusters[count].indexCount);
+            meshFinishCluster(&clusters[count], dest, positions);
+            count++;
+        }
+    }
+
+    free(context.positionOf);
+    free(context.offsets);
+    free(context.adjacency);
+    free(context.normals);
+    free(context.emitted);
+    free(context.marks);
+    free(context.vertices);
+    free(context.localOf);
+    free(context.globalOf);
+    free(context.local);
+    free(context.optimized);
+
+    return count;
+}
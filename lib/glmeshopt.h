@@ -0,0 +1,75 @@
+#ifndef __GL_MESHOPT_H__
+#define __GL_MESHOPT_H__
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#define GLFW_INCLUDE_ES2
+#include <GLFW/glfw3.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "glthreadpool.h"
+
+/*******************************************************************/
+/*  Defines                                                        */
+/*******************************************************************/
+
+/* FIFO post-transform cache size assumed by the optimizer and the statistics */
+#define MESH_VERTEX_CACHE_SIZE      16
+
+/* A crease angle at or above this smooths across every edge */
+#define MESH_NORMAL_NO_CREASE       180.0f
+
+/* Cone cutoff of a cluster facing too many ways to ever be culled as back facing */
+#define MESH_CLUSTER_NO_CONE        1.0f
+
+
+/*******************************************************************/
+/*  Typedefs                                                       */
+/*******************************************************************/
+typedef struct _meshCacheStats_t
+{
+    GLuint transforms;
+    GLfloat acmr;
+    GLfloat atvr;
+} meshCacheStats_t;
+
+/* Neighboring triangles stored one after another and the bounds used to cull them */
+typedef struct _meshCluster_t
+{
+    GLuint firstIndex;
+    GLuint indexCount;
+
+    GLfloat center[3];
+    GLfloat radius;
+
+    /* Every triangle faces within the cone around axis, cutoff is the sine of its half angle */
+    GLfloat axis[3];
+    GLfloat cutoff;
+} meshCluster_t;
+
+typedef enum _meshNormalWeight_e {
+    MESH_NORMAL_WEIGHT_AREA,
+    MESH_NORMAL_WEIGHT_ANGLE,
+} meshNormalWeight_e;
+
+
+/*******************************************************************/
+/*  Prototypes                                                     */
+/*******************************************************************/
+meshCacheStats_t meshAnalyzeVertexCache(const GLuint *indices, GLuint indexCount, GLuint vertexCount, GLuint cacheSize);
+void meshOptimizeVertexCache(GLuint *dest, const GLuint *indices, GLuint indexCount, GLuint vertexCount, GLuint cacheSize);
+GLuint meshOptimizeVertexFetchRemap(GLuint *remap, const GLuint *indices, GLuint indexCount, GLuint vertexCount);
+void meshRemapIndices(GLuint *indices, GLuint indexCount, const GLuint *remap);
+GLuint meshGenerateNormals(GLfloat *normals, GLuint *normalIndices, const GLfloat *positions, GLuint vertexCount,
+                           const GLuint *indices, GLuint indexCount, meshNormalWeight_e weighting, GLfloat creaseAngle, threadPool_t *pool);
+GLuint meshSimplify(GLuint *dest, const GLuint *indices, GLuint indexCount, const GLfloat *positions, const GLfloat *texCoords,
+                    const GLfloat *normals, GLuint vertexCount, GLuint targetIndexCount, GLfloat maxError, GLfloat *resultError);
+GLuint meshBuildClusters(meshCluster_t *clusters, GLuint *dest, const GLuint *indices, GLuint indexCount, const GLfloat *positions, GLuint vertexCount,
+                         GLuint maxTriangles, GLuint maxVertices);
+
+#endif
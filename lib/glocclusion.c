@@ -0,0 +1,443 @@
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#include "glocclusion.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+
+/*******************************************************************/
+/*  Defines                                                        */
+/*******************************************************************/
+#define OCCLUSION_BANDS_PER_THREAD      2
+
+/* Rows per band never drop under this, the setup of every triangle is paid per band */
+#define OCCLUSION_MIN_BAND_HEIGHT       16
+
+
+/*******************************************************************/
+/*  Typedefs                                                       */
+/*******************************************************************/
+typedef struct _occlusionBandTask_t
+{
+    occlusionBuffer_t *buffer;
+    GLuint start;
+    GLuint end;
+} occlusionBandTask_t;
+
+
+/*******************************************************************/
+/*  Functions                                                      */
+/*******************************************************************/
+GLboolean occlusionInit(occlusionBuffer_t *buffer, GLuint width, GLuint height)
+{
+    GLuint i;
+
+    memset(buffer, 0, sizeof(occlusionBuffer_t));
+    arrayInit(&buffer->triangles, sizeof(occlusionTriangle_t));
+
+    /* Level 0 rows are whole groups of four, the rasterizer never runs past the end of one */
+    buffer->width[0] = (width + 3) & ~3;
+    buffer->height[0] = (height > 0) ? height : 1;
+    buffer->levels = 1;
+
+    while (buffer->levels < OCCLUSION_MAX_LEVELS && (buffer->width[buffer->levels-1] > 1 || buffer->height[buffer->levels-1] > 1))
+    {
+        buffer->width[buffer->levels] = (buffer->width[buffer->levels-1] + 1) / 2;
+        buffer->height[buffer->levels] = (buffer->height[buffer->levels-1] + 1) / 2;
+        buffer->levels++;
+    }
+
+    for(i=0;i<buffer->levels;i++)
+    {
+        buffer->depth[i] = (GLfloat *)calloc((size_t)buffer->width[i] * buffer->height[i], sizeof(GLfloat));
+        if (buffer->depth[i] == NULL)
+        {
+            occlusionFree(buffer);
+            return GL_FALSE;
+        }
+    }
+
+    return GL_TRUE;
+}
+
+
+void occlusionFree(occlusionBuffer_t *buffer)
+{
+    GLuint i;
+
+    for(i=0;i<buffer->levels;i++)
+    {
+        free(buffer->depth[i]);
+        buffer->depth[i] = NULL;
+    }
+
+    buffer->levels = 0;
+    arrayFree(&buffer->triangles);
+}
+
+
+void occlusionClear(occlusionBuffer_t *buffer)
+{
+    memset(buffer->depth[0], 0, sizeof(GLfloat) * buffer->width[0] * buffer->height[0]);
+    buffer->triangles.count = 0;
+}
+
+
+GLboolean occlusionProject(const occlusionBuffer_t *buffer, const GLfloat *mvp, const GLfloat *position, GLfloat *x, GLfloat *y, GLfloat *invW)
+{
+    GLfloat clip[4];
+    GLuint j;
+
+    /* Row vectors like the shaders, clip[j] = sum of mvp[j*4+i] * p[i] */
+    for(j=0;j<4;j++)
+    {
+        clip[j] = (mvp[j*4] * position[0]) + (mvp[j*4+1] * position[1]) + (mvp[j*4+2] * position[2]) + mvp[j*4+3];
+    }
+
+    if (clip[3] < OCCLUSION_NEAR_W)
+    {
+        return GL_FALSE;
+    }
+
+    *invW = 1.0f / clip[3];
+    *x = ((clip[0] * *invW) + 1.0f) * 0.5f * buffer->width[0];
+    *y = (1.0f - (clip[1] * *invW)) * 0.5f * buffer->height[0];
+
+    return GL_TRUE;
+}
+
+
+void occlusionAddOccluder(occlusionBuffer_t *buffer, const GLfloat *mvp, const GLfloat *positions, const GLushort *indices, GLuint numOfTriangles)
+{
+    occlusionTriangle_t triangle;
+    GLboolean inFront;
+    GLuint i, k;
+
+    for(i=0;i<numOfTriangles;i++)
+    {
+        inFront = GL_TRUE;
+        for(k=0;k<3 && GL_TRUE == inFront;k++)
+        {
+            inFront = occlusionProject(buffer, mvp, &positions[indices[i*3+k]*3], &triangle.x[k], &triangle.y[k], &triangle.invW[k]);
+        }
+
+        /* Not clipped, a triangle through the near plane simply occludes nothing */
+        if ( GL_FALSE == inFront )
+        {
+            continue;
+        }
+
+        if ((triangle.x[0] < 0.0f && triangle.x[1] < 0.0f && triangle.x[2] < 0.0f) ||
+            (triangle.y[0] < 0.0f && triangle.y[1] < 0.0f && triangle.y[2] < 0.0f) ||
+            (triangle.x[0] > buffer->width[0] && triangle.x[1] > buffer->width[0] && triangle.x[2] > buffer->width[0]) ||
+            (triangle.y[0] > buffer->height[0] && triangle.y[1] > buffer->height[0] && triangle.y[2] > buffer->height[0]))
+        {
+            continue;
+        }
+
+        arrayAppend(&buffer->triangles, &triangle, 1);
+    }
+}
+
+
+void occlusionRasterizeTriangle(occlusionBuffer_t *buffer, const occlusionTriangle_t *triangle, GLuint bandStart, GLuint bandEnd)
+{
+    const GLfloat *x = triangle->x;
+    const GLfloat *y = triangle->y;
+    GLfloat a[3], b[3], c[3], e[3];
+    GLfloat area, depthA, depthB, depthC, z, px, py;
+    GLfloat *row;
+    GLint minX, maxX, minY, maxY, column, lane;
+    GLuint k;
+
+    /* Edge k faces corner k, positive inside once the winding is made counter clockwise */
+    a[0] = y[1] - y[2];  b[0] = x[2] - x[1];  c[0] = (x[1] * y[2]) - (x[2] * y[1]);
+    a[1] = y[2] - y[0];  b[1] = x[0] - x[2];  c[1] = (x[2] * y[0]) - (x[0] * y[2]);
+    a[2] = y[0] - y[1];  b[2] = x[1] - x[0];  c[2] = (x[0] * y[1]) - (x[1] * y[0]);
+
+    area = c[0] + c[1] + c[2];
+    if (fabsf(area) < 0.0001f)
+    {
+        return;
+    }
+
+    if (area < 0.0f)
+    {
+        for(k=0;k<3;k++)
+        {
+            a[k] = -a[k];
+            b[k] = -b[k];
+            c[k] = -c[k];
+        }
+        area = -area;
+    }
+
+    /* 1/w is linear on screen, the plane is moved to its farthest value over a pixel */
+    depthA = ((a[0] * triangle->invW[0]) + (a[1] * triangle->invW[1]) + (a[2] * triangle->invW[2])) / area;
+    depthB = ((b[0] * triangle->invW[0]) + (b[1] * triangle->invW[1]) + (b[2] * triangle->invW[2])) / area;
+    depthC = ((c[0] * triangle->invW[0]) + (c[1] * triangle->invW[1]) + (c[2] * triangle->invW[2])) / area;
+    depthC -= 0.5f * (fabsf(depthA) + fabsf(depthB));
+
+    minX = (GLint)floorf(fminf(x[0], fminf(x[1], x[2])));
+    maxX = (GLint)ceilf(fmaxf(x[0], fmaxf(x[1], x[2])));
+    minY = (GLint)floorf(fminf(y[0], fminf(y[1], y[2])));
+    maxY = (GLint)ceilf(fmaxf(y[0], fmaxf(y[1], y[2])));
+
+    minX = (minX > 0) ? minX & ~3 : 0;
+    maxX = (maxX < (GLint)buffer->width[0]) ? maxX : (GLint)buffer->width[0] - 1;
+    minY = (minY > (GLint)bandStart) ? minY : (GLint)bandStart;
+    maxY = (maxY < (GLint)bandEnd) ? maxY : (GLint)bandEnd - 1;
+
+    for(;minY<=maxY;minY++)
+    {
+        row = &buffer->depth[0][(size_t)minY * buffer->width[0]];
+        py = (GLfloat)minY + 0.5f;
+        px = (GLfloat)minX + 0.5f;
+
+        /* Pixel centers four at a time, rows are padded to a multiple of four */
+        column = minX;
+
+#if defined(__SSE2__)
+        {
+            __m128 offsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+            __m128 e0 = _mm_add_ps(_mm_set1_ps((a[0] * px) + (b[0] * py) + c[0]), _mm_mul_ps(offsets, _mm_set1_ps(a[0])));
+            __m128 e1 = _mm_add_ps(_mm_set1_ps((a[1] * px) + (b[1] * py) + c[1]), _mm_mul_ps(offsets, _mm_set1_ps(a[1])));
+            __m128 e2 = _mm_add_ps(_mm_set1_ps((a[2] * px) + (b[2] * py) + c[2]), _mm_mul_ps(offsets, _mm_set1_ps(a[2])));
+            __m128 depth = _mm_add_ps(_mm_set1_ps((depthA * px) + (depthB * py) + depthC), _mm_mul_ps(offsets, _mm_set1_ps(depthA)));
+            __m128 step0 = _mm_set1_ps(a[0] * 4.0f), step1 = _mm_set1_ps(a[1] * 4.0f), step2 = _mm_set1_ps(a[2] * 4.0f);
+            __m128 stepDepth = _mm_set1_ps(depthA * 4.0f);
+            __m128 zero = _mm_setzero_ps();
+            __m128 inside, old;
+
+            for(;column<=maxX;column+=4)
+            {
+                inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+                old = _mm_loadu_ps(&row[column]);
+                _mm_storeu_ps(&row[column], _mm_or_ps(_mm_and_ps(inside, _mm_max_ps(old, depth)), _mm_andnot_ps(inside, old)));
+
+                e0 = _mm_add_ps(e0, step0);
+                e1 = _mm_add_ps(e1, step1);
+                e2 = _mm_add_ps(e2, step2);
+                depth = _mm_add_ps(depth, stepDepth);
+            }
+        }
+#elif defined(__ARM_NEON)
+        {
+            static const float offsetValues[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+            float32x4_t offsets = vld1q_f32(offsetValues);
+            float32x4_t e0 = vmlaq_n_f32(vdupq_n_f32((a[0] * px) + (b[0] * py) + c[0]), offsets, a[0]);
+            float32x4_t e1 = vmlaq_n_f32(vdupq_n_f32((a[1] * px) + (b[1] * py) + c[1]), offsets, a[1]);
+            float32x4_t e2 = vmlaq_n_f32(vdupq_n_f32((a[2] * px) + (b[2] * py) + c[2]), offsets, a[2]);
+            float32x4_t depth = vmlaq_n_f32(vdupq_n_f32((depthA * px) + (depthB * py) + depthC), offsets, depthA);
+            float32x4_t zero = vdupq_n_f32(0.0f);
+            float32x4_t old;
+            uint32x4_t inside;
+
+            for(;column<=maxX;column+=4)
+            {
+                inside = vandq_u32(vandq_u32(vcgeq_f32(e0, zero), vcgeq_f32(e1, zero)), vcgeq_f32(e2, zero));
+                old = vld1q_f32(&row[column]);
+                vst1q_f32(&row[column], vbslq_f32(inside, vmaxq_f32(old, depth), old));
+
+                e0 = vaddq_f32(e0, vdupq_n_f32(a[0] * 4.0f));
+                e1 = vaddq_f32(e1, vdupq_n_f32(a[1] * 4.0f));
+                e2 = vaddq_f32(e2, vdupq_n_f32(a[2] * 4.0f));
+                depth = vaddq_f32(depth, vdupq_n_f32(depthA * 4.0f));
+            }
+        }
+#endif
+
+        for(;column<=maxX;column+=4)
+        {
+            for(lane=0;lane<4;lane++)
+            {
+                px = (GLfloat)(column + lane) + 0.5f;
+                for(k=0;k<3;k++)
+                {
+                    e[k] = (a[k] * px) + (b[k] * py) + c[k];
+                }
+
+                z = (depthA * px) + (depthB * py) + depthC;
+                if (e[0] >= 0.0f && e[1] >= 0.0f && e[2] >= 0.0f && z > row[column+lane])
+                {
+                    row[column+lane] = z;
+                }
+            }
+        }
+    }
+}
+
+
+void occlusionBandTask(void *arg)
+{
+    occlusionBandTask_t *task = (occlusionBandTask_t *)arg;
+    GLuint i;
+
+    for(i=0;i<task->buffer->triangles.count;i++)
+    {
+        occlusionRasterizeTriangle(task->buffer, &ARRAY_DATA(&task->buffer->triangles, occlusionTriangle_t)[i], task->start, task->end);
+    }
+}
+
+
+void occlusionReduceLevel(occlusionBuffer_t *buffer, GLuint level)
+{
+    const GLfloat *src = buffer->depth[level-1];
+    const GLfloat *row0, *row1;
+    GLfloat *dest = buffer->depth[level];
+    GLuint srcWidth = buffer->width[level-1];
+    GLuint srcHeight = buffer->height[level-1];
+    GLuint x, y, x0, x1;
+
+    /* Each texel keeps the farthest of the four under it, odd edges repeat their last row or column */
+    for(y=0;y<buffer->height[level];y++)
+    {
+        row0 = &src[(size_t)(y * 2) * srcWidth];
+        row1 = &src[(size_t)((y * 2 + 1 < srcHeight) ? y * 2 + 1 : y * 2) * srcWidth];
+        x = 0;
+
+#if defined(__SSE2__)
+        {
+            __m128 a, b;
+
+            for(;x*2 + 8 <= srcWidth;x+=4)
+            {
+                a = _mm_min_ps(_mm_loadu_ps(&row0[x*2]), _mm_loadu_ps(&row1[x*2]));
+                b = _mm_min_ps(_mm_loadu_ps(&row0[x*2+4]), _mm_loadu_ps(&row1[x*2+4]));
+                _mm_storeu_ps(&dest[x], _mm_min_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))));
+            }
+        }
+#elif defined(__ARM_NEON)
+        {
+            float32x4x2_t a, b;
+
+            for(;x*2 + 8 <= srcWidth;x+=4)
+            {
+                a = vld2q_f32(&row0[x*2]);
+                b = vld2q_f32(&row1[x*2]);
+                vst1q_f32(&dest[x], vminq_f32(vminq_f32(a.val[0], a.val[1]), vminq_f32(b.val[0], b.val[1])));
+            }
+        }
+#endif
+
+        for(;x<buffer->width[level];x++)
+        {
+            x0 = x * 2;
+            x1 = (x0 + 1 < srcWidth) ? x0 + 1 : x0;
+            dest[x] = fminf(fminf(row0[x0], row0[x1]), fminf(row1[x0], row1[x1]));
+        }
+
+        dest += buffer->width[level];
+    }
+}
+
+
+void occlusionRasterize(occlusionBuffer_t *buffer, threadPool_t *pool)
+{
+    occlusionBandTask_t tasks[64];
+    GLuint numOfTasks = 1;
+    GLuint bandHeight, i;
+
+    /* Horizontal bands, every band walks all the triangles and writes only its own rows */
+    if (pool != NULL)
+    {
+        numOfTasks = pool->numOfThreads * OCCLUSION_BANDS_PER_THREAD;
+        numOfTasks = (numOfTasks < sizeof(tasks)/sizeof(tasks[0])) ? numOfTasks : sizeof(tasks)/sizeof(tasks[0]);
+        while (numOfTasks > 1 && buffer->height[0] / numOfTasks < OCCLUSION_MIN_BAND_HEIGHT)
+        {
+            numOfTasks--;
+        }
+    }
+
+    bandHeight = (buffer->height[0] + numOfTasks - 1) / numOfTasks;
+    for(i=0;i<numOfTasks;i++)
+    {
+        tasks[i].buffer = buffer;
+        tasks[i].start = (i * bandHeight < buffer->height[0]) ? i * bandHeight : buffer->height[0];
+        tasks[i].end = (tasks[i].start + bandHeight < buffer->height[0]) ? tasks[i].start + bandHeight : buffer->height[0];
+    }
+
+    if (numOfTasks > 1)
+    {
+        for(i=0;i<numOfTasks;i++)
+        {
+            threadPoolSubmit(pool, occlusionBandTask, &tasks[i]);
+        }
+        threadPoolWait(pool);
+    }
+    else
+    {
+        occlusionBandTask(&tasks[0]);
+    }
+
+    for(i=1;i<buffer->levels;i++)
+    {
+        occlusionReduceLevel(buffer, i);
+    }
+}
+
+
+GLuint occlusionTestBox(const occlusionBuffer_t *buffer, const GLfloat *mvp, const GLfloat *min, const GLfloat *max)
+{
+    GLfloat corner[3];
+    GLfloat x, y, invW, nearest = 0.0f, farthest = FLT_MAX;
+    GLfloat minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+    GLint x0, x1, y0, y1, column, row;
+    GLuint level, k;
+
+    for(k=0;k<8;k++)
+    {
+        corner[0] = (k & 1) ? max[0] : min[0];
+        corner[1] = (k & 2) ? max[1] : min[1];
+        corner[2] = (k & 4) ? max[2] : min[2];
+
+        /* Part of the box behind the camera, nothing to compare against */
+        if ( GL_FALSE == occlusionProject(buffer, mvp, corner, &x, &y, &invW) )
+        {
+            return OCCLUSION_VISIBLE;
+        }
+
+        minX = (x < minX) ? x : minX;
+        maxX = (x > maxX) ? x : maxX;
+        minY = (y < minY) ? y : minY;
+        maxY = (y > maxY) ? y : maxY;
+        nearest = (invW > nearest) ? invW : nearest;
+    }
+
+    if (maxX < 0.0f || maxY < 0.0f || minX > buffer->width[0] || minY > buffer->height[0])
+    {
+        return OCCLUSION_OUTSIDE;
+    }
+
+    /* A pixel more on each side, occluder edges cover whole pixels their centers fall in */
+    x0 = (GLint)floorf(minX) - 1;
+    y0 = (GLint)floorf(minY) - 1;
+    x1 = (GLint)ceilf(maxX) + 1;
+    y1 = (GLint)ceilf(maxY) + 1;
+
+    x0 = (x0 > 0) ? x0 : 0;
+    y0 = (y0 > 0) ? y0 : 0;
+    x1 = (x1 < (GLint)buffer->width[0]) ? x1 : (GLint)buffer->width[0] - 1;
+    y1 = (y1 < (GLint)buffer->height[0]) ? y1 : (GLint)buffer->height[0] - 1;
+
+    /* The first level where the rect is at most two texels across */
+    for(level=0;level+1<buffer->levels && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1);level++);
+
+    for(row=y0>>level;row<=(y1>>level);row++)
+    {
+        for(column=x0>>level;column<=(x1>>level);column++)
+        {
+            farthest = fminf(farthest, buffer->depth[level][(size_t)row * buffer->width[level] + column]);
+        }
+    }
+
+    return (nearest < farthest) ? OCCLUSION_HIDDEN : OCCLUSION_VISIBLE;
+}
@@ -0,0 +1,69 @@
+#ifndef __GL_OCCLUSION_H__
+#define __GL_OCCLUSION_H__
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#define GLFW_INCLUDE_ES2
+#include <GLFW/glfw3.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+#include "glarray.h"
+#include "glthreadpool.h"
+
+/*******************************************************************/
+/*  Defines                                                        */
+/*******************************************************************/
+
+/* Level 0 down to a single texel for any buffer up to 4096 wide */
+#define OCCLUSION_MAX_LEVELS        13
+
+/* Corners closer than this in view depth are treated as crossing the near plane */
+#define OCCLUSION_NEAR_W            0.0001f
+
+#define OCCLUSION_VISIBLE           0
+#define OCCLUSION_OUTSIDE           1
+#define OCCLUSION_HIDDEN            2
+
+
+/*******************************************************************/
+/*  Typedefs                                                       */
+/*******************************************************************/
+/* An occluder triangle in buffer pixels, y down, with 1/w per corner */
+typedef struct _occlusionTriangle_t
+{
+    GLfloat x[3];
+    GLfloat y[3];
+    GLfloat invW[3];
+} occlusionTriangle_t;
+
+/* Coarse depth of the occluders and its min pyramid, depths are 1/w so 0 is empty and larger is nearer */
+typedef struct _occlusionBuffer_t
+{
+    GLuint levels;
+    GLuint width[OCCLUSION_MAX_LEVELS];
+    GLuint height[OCCLUSION_MAX_LEVELS];
+    GLfloat *depth[OCCLUSION_MAX_LEVELS];
+
+    /* occlusionTriangle_t queued since the last clear */
+    array_t triangles;
+} occlusionBuffer_t;
+
+
+/*******************************************************************/
+/*  Prototypes                                                     */
+/*******************************************************************/
+GLboolean occlusionInit(occlusionBuffer_t *buffer, GLuint width, GLuint height);
+void occlusionFree(occlusionBuffer_t *buffer);
+void occlusionClear(occlusionBuffer_t *buffer);
+void occlusionAddOccluder(occlusionBuffer_t *buffer, const GLfloat *mvp, const GLfloat *positions, const GLushort *indices, GLuint numOfTriangles);
+void occlusionRasterize(occlusionBuffer_t *buffer, threadPool_t *pool);
+GLuint occlusionTestBox(const occlusionBuffer_t *buffer, const GLfloat *mvp, const GLfloat *min, const GLfloat *max);
+
+#endif
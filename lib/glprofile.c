@@ -0,0 +1,344 @@
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#include "glprofile.h"
+
+
+/*******************************************************************/
+/*  Defines                                                        */
+/*******************************************************************/
+/* Columns of the printed histogram, neighbouring buckets are merged to fit */
+#define PROFILE_HISTOGRAM_WIDTH     32
+
+/* Bar heights from an empty column to the fullest one */
+#define PROFILE_HISTOGRAM_LEVELS    " .:-=+*#"
+
+
+/*******************************************************************/
+/*  Functions                                                      */
+/*******************************************************************/
+GLuint profileGetBucket(GLfloat time)
+{
+    GLfloat us = time * 1000.0f;
+    GLfloat bucket;
+
+    if (us <= 1.0f)
+    {
+        return 0;
+    }
+
+    bucket = log2f(us) * PROFILE_BUCKETS_PER_OCTAVE;
+
+    return (bucket < PROFILE_NUM_OF_BUCKETS - 1) ? (GLuint)bucket : PROFILE_NUM_OF_BUCKETS - 1;
+}
+
+
+GLfloat profileGetBucketStart(GLuint bucket)
+{
+    return exp2f((GLfloat)bucket / PROFILE_BUCKETS_PER_OCTAVE) / 1000.0f;
+}
+
+
+void profileAddSample(profileHistogram_t *histogram, GLfloat time)
+{
+    /* A full window forgets its oldest frame */
+    if (histogram->count == PROFILE_WINDOW_FRAMES)
+    {
+        histogram->buckets[profileGetBucket(histogram->samples[histogram->next])]--;
+    }
+    else
+    {
+        histogram->count++;
+    }
+
+    histogram->samples[histogram->next] = time;
+    histogram->buckets[profileGetBucket(time)]++;
+    histogram->next = (histogram->next + 1) % PROFILE_WINDOW_FRAMES;
+}
+
+
+void profileInit(profile_t *profile, const char **phaseNames, GLuint numOfPhases, GLuint reportFrames, GLboolean useGpu, profileGetProcAddress_t getProcAddress)
+{
+    GLint disjoint;
+    GLuint i;
+
+    memset(profile, 0, sizeof(profile_t));
+
+    profile->enabled = GL_TRUE;
+    profile->numOfPhases = (numOfPhases < PROFILE_MAX_PHASES) ? numOfPhases : PROFILE_MAX_PHASES;
+    profile->reportFrames = reportFrames;
+    profile->phase = -1;
+
+    for(i=0;i<profile->numOfPhases;i++)
+    {
+        profile->phaseNames[i] = phaseNames[i];
+    }
+
+    /* The caller checks for EXT_disjoint_timer_query, the entry points come from its window system */
+    if ( GL_TRUE == useGpu && getProcAddress != NULL )
+    {
+        profile->genQueries = (PFNGLGENQUERIESEXTPROC)getProcAddress("glGenQueriesEXT");
+        profile->deleteQueries = (PFNGLDELETEQUERIESEXTPROC)getProcAddress("glDeleteQueriesEXT");
+        profile->beginQuery = (PFNGLBEGINQUERYEXTPROC)getProcAddress("glBeginQueryEXT");
+        profile->endQuery = (PFNGLENDQUERYEXTPROC)getProcAddress("glEndQueryEXT");
+        profile->getQueryObjectuiv = (PFNGLGETQUERYOBJECTUIVEXTPROC)getProcAddress("glGetQueryObjectuivEXT");
+        profile->getQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VEXTPROC)getProcAddress("glGetQueryObjectui64vEXT");
+
+        if (profile->genQueries != NULL && profile->deleteQueries != NULL && profile->beginQuery != NULL &&
+            profile->endQuery != NULL && profile->getQueryObjectuiv != NULL && profile->getQueryObjectui64v != NULL)
+        {
+            /* Reading the flag clears whatever happened before profiling started */
+            glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+
+            profile->genQueries(PROFILE_NUM_OF_QUERIES, profile->queries);
+            profile->useGpu = GL_TRUE;
+        }
+    }
+}
+
+
+void profileFree(profile_t *profile)
+{
+    if ( GL_TRUE == profile->useGpu )
+    {
+        if ( GL_TRUE == profile->queryActive )
+        {
+            profile->endQuery(GL_TIME_ELAPSED_EXT);
+        }
+
+        profile->deleteQueries(PROFILE_NUM_OF_QUERIES, profile->queries);
+    }
+
+    memset(profile, 0, sizeof(profile_t));
+}
+
+
+void profileCollectQueries(profile_t *profile)
+{
+    GLint disjoint = 0;
+    GLuint available, i;
+    GLuint64 elapsed;
+
+    /* Clock changes or power events since the last check spoil whatever finished in between */
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+
+    for(i=0;i<PROFILE_NUM_OF_QUERIES;i++)
+    {
+        if ( GL_FALSE == profile->queryPending[i] )
+        {
+            continue;
+        }
+
+        available = GL_FALSE;
+        profile->getQueryObjectuiv(profile->queries[i], GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+        if ( GL_FALSE == available )
+        {
+            continue;
+        }
+
+        profile->getQueryObjectui64v(profile->queries[i], GL_QUERY_RESULT_EXT, &elapsed);
+        profile->queryPending[i] = GL_FALSE;
+
+        if (disjoint != 0)
+        {
+            profile->disjointFrames++;
+        }
+        else
+        {
+            profileAddSample(&profile->gpuFrame, (GLfloat)(elapsed / 1000000.0));
+        }
+    }
+}
+
+
+void profileBeginFrame(profile_t *profile)
+{
+    GLuint query = profile->frames % PROFILE_NUM_OF_QUERIES;
+
+    if ( GL_FALSE == profile->enabled )
+    {
+        return;
+    }
+
+    /* A frame goes untimed on the GPU when every query is still in flight, the CPU never waits.
+       The first frame is skipped too, some drivers return a bogus time for the first query of a context */
+    if ( GL_TRUE == profile->useGpu )
+    {
+        profileCollectQueries(profile);
+
+        if ( GL_FALSE == profile->queryPending[query] && profile->frames > 0 )
+        {
+            profile->beginQuery(GL_TIME_ELAPSED_EXT, profile->queries[query]);
+            profile->queryActive = GL_TRUE;
+        }
+    }
+
+    memset(profile->phaseTimes, 0, sizeof(profile->phaseTimes));
+    profile->phase = -1;
+    profile->frameStart = getTimeMs();
+}
+
+
+void profileBeginPhase(profile_t *profile, GLuint phase)
+{
+    double now;
+
+    if ( GL_FALSE == profile->enabled || phase >= profile->numOfPhases )
+    {
+        return;
+    }
+
+    now = getTimeMs();
+
+    if (profile->phase >= 0)
+    {
+        profile->phaseTimes[profile->phase] += now - profile->phaseStart;
+    }
+
+    profile->phase = (GLint)phase;
+    profile->phaseStart = now;
+}
+
+
+void profileEndFrame(profile_t *profile)
+{
+    double now;
+    GLuint i;
+
+    if ( GL_FALSE == profile->enabled )
+    {
+        return;
+    }
+
+    now = getTimeMs();
+
+    if (profile->phase >= 0)
+    {
+        profile->phaseTimes[profile->phase] += now - profile->phaseStart;
+    }
+
+    if ( GL_TRUE == profile->queryActive )
+    {
+        profile->endQuery(GL_TIME_ELAPSED_EXT);
+        profile->queryPending[profile->frames % PROFILE_NUM_OF_QUERIES] = GL_TRUE;
+        profile->queryActive = GL_FALSE;
+    }
+
+    /* Every phase gets a sample each frame, zero when it was skipped */
+    for(i=0;i<profile->numOfPhases;i++)
+    {
+        profileAddSample(&profile->phases[i], (GLfloat)profile->phaseTimes[i]);
+    }
+    profileAddSample(&profile->cpuFrame, (GLfloat)(now - profile->frameStart));
+
+    profile->phase = -1;
+    profile->frames++;
+
+    if (profile->reportFrames > 0 && (profile->frames % profile->reportFrames) == 0)
+    {
+        profilePrint(profile);
+    }
+}
+
+
+int profileCompareTimes(const void *a, const void *b)
+{
+    GLfloat timeA = *(const GLfloat *)a;
+    GLfloat timeB = *(const GLfloat *)b;
+
+    return (timeA > timeB) - (timeA < timeB);
+}
+
+
+void profilePrintHistogram(const char *name, const profileHistogram_t *histogram)
+{
+    static const char levels[] = PROFILE_HISTOGRAM_LEVELS;
+    GLfloat sorted[PROFILE_WINDOW_FRAMES];
+    char bars[PROFILE_HISTOGRAM_WIDTH + 1];
+    GLuint sums[PROFILE_HISTOGRAM_WIDTH];
+    GLuint first = 0, last = PROFILE_NUM_OF_BUCKETS - 1;
+    GLuint span, columns, column, i, most = 0;
+    double total = 0.0;
+
+    if (histogram->count == 0)
+    {
+        printf("%-12s %9s\n", name, "n/a");
+        return;
+    }
+
+    memcpy(sorted, histogram->samples, sizeof(GLfloat) * histogram->count);
+    qsort(sorted, histogram->count, sizeof(GLfloat), profileCompareTimes);
+
+    for(i=0;i<histogram->count;i++)
+    {
+        total += sorted[i];
+    }
+
+    /* Only the buckets from the fastest to the slowest frame are drawn */
+    while (histogram->buckets[first] == 0)
+    {
+        first++;
+    }
+    while (histogram->buckets[last] == 0)
+    {
+        last--;
+    }
+
+    span = last - first + 1;
+    columns = (span < PROFILE_HISTOGRAM_WIDTH) ? span : PROFILE_HISTOGRAM_WIDTH;
+    memset(sums, 0, sizeof(sums));
+
+    for(i=0;i<span;i++)
+    {
+        column = (i * columns) / span;
+        sums[column] += histogram->buckets[first + i];
+        most = (sums[column] > most) ? sums[column] : most;
+    }
+
+    /* Any frame at all shows, the fullest column gets the tallest bar */
+    for(column=0;column<columns;column++)
+    {
+        bars[column] = levels[(sums[column] == 0) ? 0 : 1 + ((sums[column] * (sizeof(levels) - 3)) / most)];
+    }
+    bars[columns] = '\0';
+
+    printf("%-12s %9.3f %9.3f %9.3f %9.3f %9.3f   %8.3f |%s| %.3f\n", name,
+           sorted[0], total / histogram->count, sorted[(histogram->count - 1) / 2],
+           sorted[(GLuint)ceilf(0.99f * histogram->count) - 1], sorted[histogram->count - 1],
+           profileGetBucketStart(first), bars, profileGetBucketStart(last + 1));
+}
+
+
+void profilePrint(const profile_t *profile)
+{
+    GLuint i;
+
+    if ( GL_FALSE == profile->enabled || profile->frames == 0 )
+    {
+        return;
+    }
+
+    printf("Frame profile, last %u of %u frames in ms\n", profile->cpuFrame.count, profile->frames);
+    printf("%-12s %9s %9s %9s %9s %9s   histogram\n", "phase", "min", "avg", "p50", "p99", "max");
+
+    for(i=0;i<profile->numOfPhases;i++)
+    {
+        profilePrintHistogram(profile->phaseNames[i], &profile->phases[i]);
+    }
+
+    profilePrintHistogram("cpu frame", &profile->cpuFrame);
+
+    if ( GL_TRUE == profile->useGpu )
+    {
+        profilePrintHistogram("gpu frame", &profile->gpuFrame);
+
+        if (profile->disjointFrames > 0)
+        {
+            printf("%u GPU frames dropped on disjoint timer events\n", profile->disjointFrames);
+        }
+    }
+    else
+    {
+        printf("%-12s %9s no EXT_disjoint_timer_query\n", "gpu frame", "n/a");
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef __GL_PROFILE_H__
+#define __GL_PROFILE_H__
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#define GLFW_INCLUDE_ES2
+#include <GLFW/glfw3.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <float.h>
+#include <math.h>
+
+#include "gltime.h"
+
+/*******************************************************************/
+/*  Defines                                                        */
+/*******************************************************************/
+#define PROFILE_MAX_PHASES          8
+
+/* Histograms cover this many of the latest frames */
+#define PROFILE_WINDOW_FRAMES       512
+
+/* Four buckets per doubling from 1 us up to about 1 s */
+#define PROFILE_BUCKETS_PER_OCTAVE  4
+#define PROFILE_NUM_OF_BUCKETS      80
+
+/* GPU frames in flight before a timer result has to be ready */
+#define PROFILE_NUM_OF_QUERIES      4
+
+
+/*******************************************************************/
+/*  Typedefs                                                       */
+/*******************************************************************/
+/* Times in ms of the latest frames and their counts per log spaced bucket, the oldest drops out of both as a new one comes in */
+typedef struct _profileHistogram_t
+{
+    GLfloat samples[PROFILE_WINDOW_FRAMES];
+    GLuint buckets[PROFILE_NUM_OF_BUCKETS];
+    GLuint count;
+    GLuint next;
+} profileHistogram_t;
+
+typedef void *(*profileGetProcAddress_t)(const char *name);
+
+/* CPU time per phase of a frame, the whole frame, and the GPU time of the frame from EXT_disjoint_timer_query */
+typedef struct _profile_t
+{
+    GLboolean enabled;
+
+    GLuint numOfPhases;
+    const char *phaseNames[PROFILE_MAX_PHASES];
+    profileHistogram_t phases[PROFILE_MAX_PHASES];
+    profileHistogram_t cpuFrame;
+    profileHistogram_t gpuFrame;
+
+    /* Printed every so many frames, 0 only when asked */
+    GLuint reportFrames;
+    GLuint frames;
+
+    /* The frame being timed, a phase can be entered more than once */
+    GLint phase;
+    double phaseStart;
+    double frameStart;
+    double phaseTimes[PROFILE_MAX_PHASES];
+
+    /* One elapsed time query per frame, read back frames later once the GPU is done */
+    GLboolean useGpu;
+    GLuint queries[PROFILE_NUM_OF_QUERIES];
+    GLboolean queryPending[PROFILE_NUM_OF_QUERIES];
+    GLboolean queryActive;
+    GLuint disjointFrames;
+
+    PFNGLGENQUERIESEXTPROC genQueries;
+    PFNGLDELETEQUERIESEXTPROC deleteQueries;
+    PFNGLBEGINQUERYEXTPROC beginQuery;
+    PFNGLENDQUERYEXTPROC endQuery;
+    PFNGLGETQUERYOBJECTUIVEXTPROC getQueryObjectuiv;
+    PFNGLGETQUERYOBJECTUI64VEXTPROC getQueryObjectui64v;
+} profile_t;
+
+
+/*******************************************************************/
+/*  Prototypes                                                     */
+/*******************************************************************/
+void profileInit(profile_t *profile, const char **phaseNames, GLuint numOfPhases, GLuint reportFrames, GLboolean useGpu, profileGetProcAddress_t getProcAddress);
+void profileFree(profile_t *profile);
+void profileBeginFrame(profile_t *profile);
+void profileBeginPhase(profile_t *profile, GLuint phase);
+void profileEndFrame(profile_t *profile);
+void profilePrint(const profile_t *profile);
+
+#endif
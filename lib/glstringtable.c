@@ -0,0 +1,194 @@
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#include "glstringtable.h"
+
+/*******************************************************************/
+/*  Defines                                                        */
+/*******************************************************************/
+#define STRING_HASH_BASIS           2166136261u
+#define STRING_HASH_PRIME           16777619u
+
+
+/*******************************************************************/
+/*  Functions                                                      */
+/*******************************************************************/
+GLuint stringTableHash(const char *string, GLuint length)
+{
+    GLuint hash = STRING_HASH_BASIS;
+    GLuint i;
+
+    /* FNV-1a, names are short so a byte at a time is plenty */
+    for(i=0;i<length;i++)
+    {
+        hash = (hash ^ (GLubyte)string[i]) * STRING_HASH_PRIME;
+    }
+
+    return hash;
+}
+
+
+GLuint stringTableFindSlot(const stringTable_t *table, const char *string, GLuint length, GLuint hash)
+{
+    const stringTableEntry_t *entries = ARRAY_DATA(&table->entries, stringTableEntry_t);
+    const stringTableEntry_t *entry;
+    GLuint slot = hash & table->slotMask;
+
+    /* Linear probing, the table is never more than 3/4 full */
+    while (table->slots[slot] != STRING_TABLE_NOT_FOUND)
+    {
+        entry = &entries[table->slots[slot]];
+
+        if (entry->hash == hash && entry->length == length && 0 == memcmp(entry->string, string, length))
+        {
+            break;
+        }
+
+        slot = (slot + 1) & table->slotMask;
+    }
+
+    return slot;
+}
+
+
+GLboolean stringTableGrowSlots(stringTable_t *table)
+{
+    const stringTableEntry_t *entries = ARRAY_DATA(&table->entries, stringTableEntry_t);
+    GLuint slotCount = (table->slots == NULL) ? STRING_TABLE_MIN_SLOTS : (table->slotMask + 1) * 2;
+    GLuint *slots;
+    GLuint i, slot;
+
+    slots = (GLuint *)malloc(sizeof(GLuint)*slotCount);
+    if (slots == NULL)
+    {
+        return GL_FALSE;
+    }
+
+    memset(slots, 0xFF, sizeof(GLuint)*slotCount);
+
+    /* Entries keep their hash, rehashing never touches the strings */
+    for(i=0;i<table->entries.count;i++)
+    {
+        slot = entries[i].hash & (slotCount - 1);
+
+        while (slots[slot] != STRING_TABLE_NOT_FOUND)
+        {
+            slot = (slot + 1) & (slotCount - 1);
+        }
+
+        slots[slot] = i;
+    }
+
+    free(table->slots);
+    table->slots = slots;
+    table->slotMask = slotCount - 1;
+
+    return GL_TRUE;
+}
+
+
+char *stringTableStore(stringTable_t *table, const char *string, GLuint length)
+{
+    char *block;
+    GLuint blockSize;
+
+    /* Start a new block when this one is full, long strings get their own */
+    if (table->blocks.count == 0 || table->blockUsed + length + 1 > table->blockSize)
+    {
+        blockSize = (length + 1 > STRING_TABLE_BLOCK_SIZE) ? length + 1 : STRING_TABLE_BLOCK_SIZE;
+
+        block = (char *)malloc(blockSize);
+        if (block == NULL || NULL == arrayAppend(&table->blocks, &block, 1))
+        {
+            free(block);
+            return NULL;
+        }
+
+        table->blockUsed = 0;
+        table->blockSize = blockSize;
+    }
+
+    block = ARRAY_DATA(&table->blocks, char *)[table->blocks.count - 1] + table->blockUsed;
+    memcpy(block, string, length);
+    block[length] = '\0';
+
+    table->blockUsed += length + 1;
+
+    return block;
+}
+
+
+void stringTableInit(stringTable_t *table)
+{
+    memset(table, 0, sizeof(stringTable_t));
+
+    arrayInit(&table->entries, sizeof(stringTableEntry_t));
+    arrayInit(&table->blocks, sizeof(char *));
+}
+
+
+void stringTableFree(stringTable_t *table)
+{
+    GLuint i;
+
+    for(i=0;i<table->blocks.count;i++)
+    {
+        free(ARRAY_DATA(&table->blocks, char *)[i]);
+    }
+
+    arrayFree(&table->blocks);
+    arrayFree(&table->entries);
+    free(table->slots);
+
+    stringTableInit(table);
+}
+
+
+GLuint stringTableFind(const stringTable_t *table, const char *string, GLuint length)
+{
+    if (table->slots == NULL)
+    {
+        return STRING_TABLE_NOT_FOUND;
+    }
+
+    return table->slots[stringTableFindSlot(table, string, length, stringTableHash(string, length))];
+}
+
+
+GLuint stringTableIntern(stringTable_t *table, const char *string, GLuint length)
+{
+    stringTableEntry_t entry;
+    GLuint hash = stringTableHash(string, length);
+    GLuint slot;
+
+    if (table->slots != NULL)
+    {
+        slot = stringTableFindSlot(table, string, length, hash);
+        if (table->slots[slot] != STRING_TABLE_NOT_FOUND)
+        {
+            return table->slots[slot];
+        }
+    }
+
+    /* Keep the load factor below 3/4 so probe chains stay short */
+    if ( (table->slots == NULL || (table->entries.count + 1) * 4 > (table->slotMask + 1) * 3) &&
+         GL_FALSE == stringTableGrowSlots(table) )
+    {
+        return STRING_TABLE_NOT_FOUND;
+    }
+
+    entry.string = stringTableStore(table, string, length);
+    entry.length = length;
+    entry.hash = hash;
+
+    if (entry.string == NULL || NULL == arrayAppend(&table->entries, &entry, 1))
+    {
+        return STRING_TABLE_NOT_FOUND;
+    }
+
+    slot = stringTableFindSlot(table, string, length, hash);
+    table->slots[slot] = table->entries.count - 1;
+
+    return table->entries.count - 1;
+}
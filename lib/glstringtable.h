@@ -0,0 +1,73 @@
+#ifndef __GL_STRINGTABLE_H__
+#define __GL_STRINGTABLE_H__
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#define GLFW_INCLUDE_ES2
+#include <GLFW/glfw3.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "glarray.h"
+
+/*******************************************************************/
+/*  Defines                                                        */
+/*******************************************************************/
+#define STRING_TABLE_NOT_FOUND      0xFFFFFFFF
+#define STRING_TABLE_MIN_SLOTS      64
+#define STRING_TABLE_BLOCK_SIZE     4096
+
+
+/*******************************************************************/
+/*  Typedefs                                                       */
+/*******************************************************************/
+typedef struct _stringTableEntry_t
+{
+    const char *string;
+    GLuint length;
+    GLuint hash;
+} stringTableEntry_t;
+
+/* Interned strings, each distinct string is stored once and gets a dense id */
+typedef struct _stringTable_t
+{
+    /* Open addressed, holds entry ids or STRING_TABLE_NOT_FOUND */
+    GLuint *slots;
+    GLuint slotMask;
+
+    array_t entries;
+
+    /* Strings live in blocks that never move, returned pointers stay valid */
+    array_t blocks;
+    GLuint blockUsed;
+    GLuint blockSize;
+} stringTable_t;
+
+
+/*******************************************************************/
+/*  Prototypes                                                     */
+/*******************************************************************/
+void stringTableInit(stringTable_t *table);
+void stringTableFree(stringTable_t *table);
+GLuint stringTableFind(const stringTable_t *table, const char *string, GLuint length);
+GLuint stringTableIntern(stringTable_t *table, const char *string, GLuint length);
+
+
+/*******************************************************************/
+/*  Inline Functions                                               */
+/*******************************************************************/
+static inline const char *stringTableGet(const stringTable_t *table, GLuint id)
+{
+    return ARRAY_DATA(&table->entries, stringTableEntry_t)[id].string;
+}
+
+static inline GLuint stringTableCount(const stringTable_t *table)
+{
+    return table->entries.count;
+}
+
+#endif
@@ -0,0 +1,161 @@
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#include "gltexcache.h"
+
+
+/*******************************************************************/
+/*  Functions                                                      */
+/*******************************************************************/
+void texCacheInit(texCache_t *cache)
+{
+    stringTableInit(&cache->paths);
+    arrayInit(&cache->entries, sizeof(texCacheEntry_t));
+
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->savedSize = 0;
+}
+
+
+void texCacheFree(texCache_t *cache)
+{
+    GLuint i;
+
+    /* Textures still referenced go with the cache */
+    for(i=0;i<cache->entries.count;i++)
+    {
+        if (ARRAY_DATA(&cache->entries, texCacheEntry_t)[i].texId != 0)
+        {
+            glDeleteTextures(1, &ARRAY_DATA(&cache->entries, texCacheEntry_t)[i].texId);
+        }
+    }
+
+    stringTableFree(&cache->paths);
+    arrayFree(&cache->entries);
+}
+
+
+char *texCacheGetKey(const char *fileName)
+{
+    char *key;
+
+    /* The same file reached through different relative paths is one entry */
+    key = realpath(fileName, NULL);
+    if (key == NULL)
+    {
+        key = (char *)malloc(strlen(fileName) + 1);
+        if (key != NULL)
+        {
+            strcpy(key, fileName);
+        }
+    }
+
+    return key;
+}
+
+
+GLuint texCacheAcquire(texCache_t *cache, const char *fileName)
+{
+    texCacheEntry_t *entry;
+    char *key;
+    GLuint id;
+
+    key = texCacheGetKey(fileName);
+    if (key == NULL)
+    {
+        return 0;
+    }
+
+    id = stringTableFind(&cache->paths, key, strlen(key));
+    free(key);
+
+    if (id == STRING_TABLE_NOT_FOUND || ARRAY_DATA(&cache->entries, texCacheEntry_t)[id].texId == 0)
+    {
+        return 0;
+    }
+
+    entry = &ARRAY_DATA(&cache->entries, texCacheEntry_t)[id];
+    entry->refCount++;
+
+    cache->hits++;
+    cache->savedSize += entry->size;
+
+    return entry->texId;
+}
+
+
+void texCacheInsert(texCache_t *cache, const char *fileName, GLuint texId, size_t size)
+{
+    texCacheEntry_t empty = { 0, 0, 0 };
+    texCacheEntry_t *entry;
+    char *key;
+    GLuint id;
+
+    key = texCacheGetKey(fileName);
+    id = (key != NULL) ? stringTableIntern(&cache->paths, key, strlen(key)) : STRING_TABLE_NOT_FOUND;
+    free(key);
+
+    cache->misses++;
+
+    /* Not shared, the caller still owns the texture */
+    if (id == STRING_TABLE_NOT_FOUND)
+    {
+        return;
+    }
+
+    while (cache->entries.count <= id)
+    {
+        if (arrayAppend(&cache->entries, &empty, 1) == NULL)
+        {
+            return;
+        }
+    }
+
+    entry = &ARRAY_DATA(&cache->entries, texCacheEntry_t)[id];
+    entry->texId = texId;
+    entry->refCount = 1;
+    entry->size = size;
+}
+
+
+GLboolean texCacheRelease(texCache_t *cache, GLuint texId)
+{
+    texCacheEntry_t *entry;
+    GLuint i;
+
+    /* A handful of textures per model, a scan is enough */
+    for(i=0;i<cache->entries.count;i++)
+    {
+        entry = &ARRAY_DATA(&cache->entries, texCacheEntry_t)[i];
+
+        if (texId != 0 && entry->texId == texId)
+        {
+            entry->refCount--;
+            if (entry->refCount == 0)
+            {
+                glDeleteTextures(1, &entry->texId);
+                entry->texId = 0;
+            }
+
+            return GL_TRUE;
+        }
+    }
+
+    return GL_FALSE;
+}
+
+
+size_t texCacheGetResidentSize(const texCache_t *cache)
+{
+    size_t size = 0;
+    GLuint i;
+
+    for(i=0;i<cache->entries.count;i++)
+    {
+        size += (ARRAY_DATA(&cache->entries, texCacheEntry_t)[i].texId != 0) ? ARRAY_DATA(&cache->entries, texCacheEntry_t)[i].size : 0;
+    }
+
+    return size;
+}
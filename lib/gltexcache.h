@@ -0,0 +1,57 @@
+#ifndef __GL_TEXCACHE_H__
+#define __GL_TEXCACHE_H__
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#define GLFW_INCLUDE_ES2
+#include <GLFW/glfw3.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "glarray.h"
+#include "glstringtable.h"
+
+
+/*******************************************************************/
+/*  Typedefs                                                       */
+/*******************************************************************/
+typedef struct _texCacheEntry_t
+{
+    /* Zero once the last reference is released */
+    GLuint texId;
+    GLuint refCount;
+
+    /* Bytes of every uploaded level */
+    size_t size;
+} texCacheEntry_t;
+
+/* GL textures keyed by the resolved path of their file, shared by everything loaded */
+typedef struct _texCache_t
+{
+    /* Entry ids match the path ids */
+    stringTable_t paths;
+    array_t entries;
+
+    GLuint hits;
+    GLuint misses;
+
+    /* Uploads skipped by the hits */
+    size_t savedSize;
+} texCache_t;
+
+
+/*******************************************************************/
+/*  Prototypes                                                     */
+/*******************************************************************/
+void texCacheInit(texCache_t *cache);
+void texCacheFree(texCache_t *cache);
+GLuint texCacheAcquire(texCache_t *cache, const char *fileName);
+void texCacheInsert(texCache_t *cache, const char *fileName, GLuint texId, size_t size);
+GLboolean texCacheRelease(texCache_t *cache, GLuint texId);
+size_t texCacheGetResidentSize(const texCache_t *cache);
+
+#endif
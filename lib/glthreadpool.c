@@ -0,0 +1,148 @@
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#include <unistd.h>
+
+#include "glthreadpool.h"
+
+/*******************************************************************/
+/*  Functions                                                      */
+/*******************************************************************/
+GLuint threadPoolGetNumOfCpus(void)
+{
+    long numOfCpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (numOfCpus > 0) ? (GLuint)numOfCpus : 1;
+}
+
+
+void *threadPoolWorker(void *arg)
+{
+    threadPool_t *pool = (threadPool_t *)arg;
+    threadTask_t task;
+
+    pthread_mutex_lock(&pool->lock);
+
+    while (1)
+    {
+        /* Sleep until there is work or we are told to exit */
+        while (pool->nextTask == pool->tasks.count && GL_FALSE == pool->shutdown)
+        {
+            pthread_cond_wait(&pool->taskReady, &pool->lock);
+        }
+
+        if (pool->nextTask == pool->tasks.count)
+        {
+            break;
+        }
+
+        task = ARRAY_DATA(&pool->tasks, threadTask_t)[pool->nextTask++];
+
+        /* Rewind the queue once it has drained */
+        if (pool->nextTask == pool->tasks.count)
+        {
+            pool->nextTask = 0;
+            pool->tasks.count = 0;
+        }
+
+        pthread_mutex_unlock(&pool->lock);
+        task.func(task.arg);
+        pthread_mutex_lock(&pool->lock);
+
+        if (--pool->pendingTasks == 0)
+        {
+            pthread_cond_broadcast(&pool->tasksDone);
+        }
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+
+threadPool_t *threadPoolCreate(GLuint numOfThreads)
+{
+    threadPool_t *pool;
+    GLuint i;
+
+    pool = (threadPool_t *)calloc(1, sizeof(threadPool_t));
+    if (pool == NULL)
+    {
+        return NULL;
+    }
+
+    /* Zero threads means one per online CPU */
+    pool->numOfThreads = (numOfThreads == 0) ? threadPoolGetNumOfCpus() : numOfThreads;
+    pool->threads = (pthread_t *)calloc(pool->numOfThreads, sizeof(pthread_t));
+
+    arrayInit(&pool->tasks, sizeof(threadTask_t));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->taskReady, NULL);
+    pthread_cond_init(&pool->tasksDone, NULL);
+
+    for(i=0;i<pool->numOfThreads;i++)
+    {
+        pthread_create(&pool->threads[i], NULL, threadPoolWorker, pool);
+    }
+
+    return pool;
+}
+
+
+void threadPoolSubmit(threadPool_t *pool, threadTask_f func, void *arg)
+{
+    threadTask_t task = { func, arg };
+
+    pthread_mutex_lock(&pool->lock);
+
+    arrayAppend(&pool->tasks, &task, 1);
+    pool->pendingTasks++;
+
+    pthread_cond_signal(&pool->taskReady);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+
+void threadPoolWait(threadPool_t *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+
+    while (pool->pendingTasks != 0)
+    {
+        pthread_cond_wait(&pool->tasksDone, &pool->lock);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
+
+void threadPoolDestroy(threadPool_t *pool)
+{
+    GLuint i;
+
+    if (pool == NULL)
+    {
+        return;
+    }
+
+    /* Let the workers finish what is queued, then exit */
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = GL_TRUE;
+    pthread_cond_broadcast(&pool->taskReady);
+    pthread_mutex_unlock(&pool->lock);
+
+    for(i=0;i<pool->numOfThreads;i++)
+    {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->taskReady);
+    pthread_cond_destroy(&pool->tasksDone);
+
+    arrayFree(&pool->tasks);
+    free(pool->threads);
+    free(pool);
+}
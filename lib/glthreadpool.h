@@ -0,0 +1,52 @@
+#ifndef __GL_THREADPOOL_H__
+#define __GL_THREADPOOL_H__
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#define GLFW_INCLUDE_ES2
+#include <GLFW/glfw3.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+#include <pthread.h>
+
+#include "glarray.h"
+
+/*******************************************************************/
+/*  Typedefs                                                       */
+/*******************************************************************/
+typedef void (*threadTask_f)(void *arg);
+
+typedef struct _threadTask_t
+{
+    threadTask_f func;
+    void *arg;
+} threadTask_t;
+
+typedef struct _threadPool_t
+{
+    pthread_t *threads;
+    GLuint numOfThreads;
+
+    pthread_mutex_t lock;
+    pthread_cond_t taskReady;
+    pthread_cond_t tasksDone;
+
+    array_t tasks;
+    GLuint nextTask;
+    GLuint pendingTasks;
+    GLboolean shutdown;
+} threadPool_t;
+
+
+/*******************************************************************/
+/*  Prototypes                                                     */
+/*******************************************************************/
+GLuint threadPoolGetNumOfCpus(void);
+threadPool_t *threadPoolCreate(GLuint numOfThreads);
+void threadPoolSubmit(threadPool_t *pool, threadTask_f func, void *arg);
+void threadPoolWait(threadPool_t *pool);
+void threadPoolDestroy(threadPool_t *pool);
+
+#endif
@@ -0,0 +1,18 @@
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#include "gltime.h"
+
+
+/*******************************************************************/
+/*  Functions                                                      */
+/*******************************************************************/
+double getTimeMs(void)
+{
+    struct timespec now;
+
+    /* Monotonic, so benchmark and frame times never jump with the wall clock */
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double)now.tv_sec * 1000.0 + (double)now.tv_nsec / 1000000.0;
+}
@@ -0,0 +1,14 @@
+#ifndef __GL_TIME_H__
+#define __GL_TIME_H__
+
+/*******************************************************************/
+/*  Includes                                                       */
+/*******************************************************************/
+#include <time.h>
+
+/*******************************************************************/
+/*  Prototypes                                                     */
+/*******************************************************************/
+double getTimeMs(void);
+
+#endif